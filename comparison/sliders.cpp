@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+/*
+Perft speed of the slider backends, every leaf is made and unmade (no bulk counting),
+so the attack lookups of the last ply are part of the measurement.
+
+Build once per backend and compare the output:
+
+`g++ -O3 -march=native -std=c++17 -DNDEBUG sliders.cpp -o sliders_magic`
+`g++ -O3 -march=native -std=c++17 -DNDEBUG -DCHESS_USE_PEXT sliders.cpp -o sliders_pext`
+`g++ -O3 -march=native -std=c++17 -DNDEBUG -DCHESS_USE_KOGGE_STONE sliders.cpp -o sliders_kogge_stone`
+*/
+
+#include "../include/chess.hpp"
+
+using namespace chess;
+using namespace std::chrono;
+
+#if defined(CHESS_USE_KOGGE_STONE)
+static constexpr auto BACKEND = "kogge-stone";
+#elif defined(CHESS_USE_PEXT)
+static constexpr auto BACKEND = "pext";
+#else
+static constexpr auto BACKEND = "magic";
+#endif
+
+static std::uint64_t countLeaves(Board& board, int depth) {
+    if (depth == 0) return 1;
+
+    Movelist moves;
+    movegen::legalmoves(moves, board);
+
+    std::uint64_t nodes = 0;
+
+    for (const auto& move : moves) {
+        board.makeMove(move);
+        nodes += countLeaves(board, depth - 1);
+        board.unmakeMove(move);
+    }
+
+    return nodes;
+}
+
+int main() {
+    struct Position {
+        const char* fen;
+        int depth;
+        std::uint64_t nodes;
+    };
+
+    // the positions of docs/pages/attacks.md, 202450893 nodes in total
+    const Position positions[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+        {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+    };
+
+    std::uint64_t total_nodes = 0;
+    std::int64_t total_us     = 0;
+
+    for (const auto& position : positions) {
+        Board board(position.fen);
+
+        const auto t0    = high_resolution_clock::now();
+        const auto nodes = countLeaves(board, position.depth);
+        const auto t1    = high_resolution_clock::now();
+        const auto us    = duration_cast<microseconds>(t1 - t0).count();
+
+        if (nodes != position.nodes) {
+            std::cerr << "Wrong node count " << nodes << " for " << position.fen << "\n";
+            return 1;
+        }
+
+        total_nodes += nodes;
+        total_us += us;
+
+        std::cout << std::left << "depth " << position.depth << " nodes " << std::setw(10) << nodes << " Mnps "
+                  << std::setw(7) << nodes / double(us + 1) << " fen " << position.fen << "\n";
+    }
+
+    std::cout << std::left << std::setw(12) << BACKEND << " " << total_nodes / double(total_us + 1) << " Mnps\n";
+
+    return 0;
+}
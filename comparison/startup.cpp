@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/*
+Startup cost of the slider tables: the time of attacks::initAttacks() and of starting the whole process,
+which includes the static initialization of the library.
+
+`g++ -O2 -std=c++17 -DNDEBUG startup.cpp -o startup`
+`g++ -O2 -std=c++17 -DNDEBUG -DCHESS_CONSTEXPR_SLIDERS startup.cpp -o startup_constexpr`
+
+With CHESS_CONSTEXPR_SLIDERS initAttacks() does nothing, the tables are generated by the compiler,
+time the compilation of the second command to see what that costs per translation unit.
+*/
+
+#include "../include/chess.hpp"
+
+using namespace std::chrono;
+
+int main(int argc, char const* argv[]) {
+    // started by the process start measurement below
+    if (argc > 1 && std::string(argv[1]) == "--exit") return 0;
+
+    constexpr int runs = 20;
+
+    // the tables are already filled during static initialization, refilling them costs the same
+    auto init_us = 1e9;
+
+    for (int i = 0; i < runs; i++) {
+        const auto t0 = high_resolution_clock::now();
+        chess::attacks::initAttacks();
+        const auto t1 = high_resolution_clock::now();
+
+        init_us = std::min(init_us, duration<double, std::micro>(t1 - t0).count());
+    }
+
+    const auto command = std::string(argv[0]) + " --exit";
+    auto start_us      = 1e9;
+
+    for (int i = 0; i < runs; i++) {
+        const auto t0 = high_resolution_clock::now();
+
+        if (std::system(command.c_str()) != 0) {
+            std::cerr << "Failed to run " << command << "\n";
+            return 1;
+        }
+
+        const auto t1 = high_resolution_clock::now();
+
+        start_us = std::min(start_us, duration<double, std::micro>(t1 - t0).count());
+    }
+
+    std::cout << "initAttacks    " << init_us / 1000.0 << " ms (min of " << runs << ")\n";
+    std::cout << "process start  " << start_us / 1000.0 << " ms (min of " << runs << ", including the shell)\n";
+
+    return 0;
+}
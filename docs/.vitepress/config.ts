@@ -40,6 +40,8 @@ export default defineConfig({
           { text: "Move", link: "/pages/move" },
           { text: "Move Generation", link: "/pages/move-generation" },
           { text: "Movelist", link: "/pages/movelist" },
+          { text: "Move Picker", link: "/pages/movepicker" },
+          { text: "Perft", link: "/pages/perft" },
           { text: "PGN Utilities", link: "/pages/pgn-utilities" },
           { text: "Piece", link: "/pages/piece" },
           { text: "Piece Type", link: "/pages/piece-type" },
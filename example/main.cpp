@@ -1,11 +1,32 @@
+#include <atomic>
 #include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <new>
+#include <thread>
+#include <vector>
 
 #include "../include/chess.hpp"
 
 using namespace chess;
 
+// counts the allocations while parsing, the parallel mode allocates from several threads
+static std::atomic<std::size_t> allocations = 0;
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size)) return ptr;
+
+    throw std::bad_alloc();
+}
+
+// not inlined, otherwise gcc sees free() called on the result of operator new
+[[gnu::noinline]] void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { operator delete(ptr); }
+
 class MyVisitor : public pgn::Visitor {
    public:
     virtual ~MyVisitor() {}
@@ -24,30 +45,198 @@ class MyVisitor : public pgn::Visitor {
     Board board;
 };
 
+// replays the games and writes every move back as SAN, once per move and once per game with movesToSan,
+// counting the allocations of the writers only
+class SanWriter : public pgn::Visitor {
+   public:
+    SanWriter() {
+        moves_.reserve(1024);
+        out_.reserve(1 << 16);
+    }
+
+    void startPgn() {
+        board_.setFen(constants::STARTPOS);
+        moves_.clear();
+        valid_ = true;
+    }
+
+    void header(std::string_view key, std::string_view value) {
+        if (key == "FEN") board_.setFen(value);
+    }
+
+    void startMoves() { start_ = board_; }
+
+    void move(std::string_view move, std::string_view) {
+        if (!valid_) return;
+
+        // ambiguous or illegal moves end the replay of the game, without throwing
+        const auto result = uci::tryParseSan(board_, move);
+
+        if (!result) {
+            valid_ = false;
+            return;
+        }
+
+        const auto m = result.value();
+
+        const auto before = allocations.load();
+
+        out_.clear();
+        uci::moveToSan(board_, m, out_);
+        uci::moveToLan(board_, m, out_);
+        uci::moveToUci(m, out_);
+
+        allocations_ += allocations.load() - before;
+        moves_written_++;
+
+        moves_.push_back(m);
+        board_.makeMove(m);
+    }
+
+    void endPgn() {
+        const auto before = allocations.load();
+
+        out_.clear();
+        uci::movesToSan(start_, moves_, out_);
+
+        allocations_ += allocations.load() - before;
+    }
+
+    std::size_t movesWritten() const noexcept { return moves_written_; }
+    std::size_t writerAllocations() const noexcept { return allocations_; }
+
+   private:
+    Board board_;
+    Board start_;
+
+    std::vector<Move> moves_;
+    std::string out_;
+
+    std::size_t moves_written_ = 0;
+    std::size_t allocations_   = 0;
+    bool valid_                = true;
+};
+
+// counts the bytes read from a source, i.e. the decompressed size of a compressed file
+class CountingSource : public pgn::InputSource {
+   public:
+    explicit CountingSource(pgn::InputSource& source) : source_(source) {}
+
+    std::size_t read(char* buffer, std::size_t size) override {
+        const auto bytes = source_.read(buffer, size);
+        bytes_ += bytes;
+        return bytes;
+    }
+
+    std::size_t bytes() const noexcept { return bytes_; }
+
+   private:
+    pgn::InputSource& source_;
+    std::size_t bytes_ = 0;
+};
+
+// decompress the whole file first, then parse it, for comparison with parsing while decompressing
+pgn::StreamParserError parseDecompressed(pgn::InputSource& source, pgn::Visitor& vis) {
+    std::string data(1 << 20, '\0');
+    std::size_t size = 0;
+
+    while (const auto bytes = source.read(data.data() + size, data.size() - size)) {
+        size += bytes;
+        if (size == data.size()) data.resize(data.size() * 2);
+    }
+
+    return pgn::MappedParser(data.data(), size).readGames(vis);
+}
+
+// parses while decompressing or after decompressing everything, returns the decompressed size in bytes
+template <typename Source>
+pgn::StreamParserError parseCompressed(Source& source, bool buffered, pgn::Visitor& vis, std::size_t& bytes) {
+    CountingSource counted(source);
+
+    const auto error = buffered ? parseDecompressed(counted, vis) : pgn::StreamParser(counted).readGames(vis);
+
+    bytes = counted.bytes();
+
+    return error;
+}
+
 int main(int argc, char const* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <pgn_file>\n";
+        std::cerr << "Usage: " << argv[0]
+                  << " <pgn_file> [stream|mapped|parallel|headers|san|gzip|gzip-buffer|zstd|zstd-buffer]"
+                  << " [--skip-comments]\n";
         return 1;
     }
 
-    const auto file  = argv[1];
-    auto file_stream = std::ifstream(file);
+    const auto file   = argv[1];
+    const auto parser = std::string(argc > 2 ? argv[2] : "stream");
 
     auto vis = std::make_unique<MyVisitor>();
+    vis->skipComments(argc > 3 && std::string(argv[3]) == "--skip-comments");
+
+    const auto allocations_before = allocations.load();
 
     const auto t0 = std::chrono::high_resolution_clock::now();
 
-    pgn::StreamParser parser(file_stream);
-    auto error = parser.readGames(*vis);
+    pgn::StreamParserError error;
+
+    // the parsed bytes, the decompressed size for compressed files
+    std::size_t input_bytes = std::filesystem::file_size(file);
+    bool decompress_failed  = false;
+
+    if (parser == "headers") {
+        const pgn::MappedFile mapped_file(file);
+        vis->headersOnly(true);
+        error = pgn::MappedParser(mapped_file).readGames(*vis);
+    } else if (parser == "san") {
+        const pgn::MappedFile mapped_file(file);
+        SanWriter writer;
+        error = pgn::MappedParser(mapped_file).readGames(writer);
+
+        std::cout << "moves: " << writer.movesWritten() << "\n";
+        std::cout << "writer allocations per move: "
+                  << writer.writerAllocations() / std::max<double>(1.0, double(writer.movesWritten())) << "\n";
+    } else if (parser == "mapped") {
+        const pgn::MappedFile mapped_file(file);
+        error = pgn::MappedParser(mapped_file).readGames(*vis);
+    } else if (parser == "parallel") {
+        const pgn::MappedFile mapped_file(file);
+        std::vector<MyVisitor> visitors(std::max(1u, std::thread::hardware_concurrency()));
+        for (auto& visitor : visitors) visitor.skipComments(vis->skipComments());
+        error = pgn::ParallelParser(mapped_file).readGames(visitors);
+#if defined(CHESS_PGN_ZLIB)
+    } else if (parser == "gzip" || parser == "gzip-buffer") {
+        pgn::GzipSource source(file);
+        error             = parseCompressed(source, parser == "gzip-buffer", *vis, input_bytes);
+        decompress_failed = source.error();
+#endif
+#if defined(CHESS_PGN_ZSTD)
+    } else if (parser == "zstd" || parser == "zstd-buffer") {
+        pgn::ZstdSource source(file);
+        error             = parseCompressed(source, parser == "zstd-buffer", *vis, input_bytes);
+        decompress_failed = source.error();
+#endif
+    } else {
+        auto file_stream = std::ifstream(file);
+        error            = pgn::StreamParser(file_stream).readGames(*vis);
+    }
 
     if (error) {
         std::cerr << "Error: " << error.message() << "\n";
         return 1;
     }
 
+    // a corrupt or truncated archive ends the input early without a parser error
+    if (decompress_failed) {
+        std::cerr << "Error: failed to decompress " << file << "\n";
+        return 1;
+    }
+
     const auto t1 = std::chrono::high_resolution_clock::now();
 
-    const auto file_size_mb = std::filesystem::file_size(file) / 1000.0 / 1000.0;
+    const auto parse_allocations = allocations.load() - allocations_before;
+
+    const auto file_size_mb = input_bytes / 1000.0 / 1000.0;
 
     std::cout << "MB/s: "
               << (file_size_mb / (std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() / 1000.0))
@@ -55,5 +244,7 @@ int main(int argc, char const* argv[]) {
 
     std::cout << (std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() / 1000.0) << "\n";
 
+    std::cout << "allocations: " << parse_allocations << "\n";
+
     return 0;
 }
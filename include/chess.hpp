@@ -32,11 +32,42 @@ VERSION: 0.8.7
 #define CHESS_HPP
 
 
-#include <functional>
 #include <utility>
 
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+
+/*
+ The slider attacks are looked up with fancy magic bitboards by default.
+ Define one of these to select another backend at compile time:
+ CHESS_USE_PEXT          index the same tables with the BMI2 pext instruction, needs -mbmi2 or -march=native
+ CHESS_USE_KOGGE_STONE   branchless kogge-stone fills, no tables and no initialization
+
+ The tables are filled at startup, define CHESS_CONSTEXPR_SLIDERS to generate them at compile time instead.
+ This removes the startup initialization but costs a few seconds of compile time in every translation unit
+ which includes the library, clang may additionally need a higher -fconstexpr-steps.
+*/
+#if defined(CHESS_USE_PEXT) && defined(CHESS_USE_KOGGE_STONE)
+#    error "CHESS_USE_PEXT and CHESS_USE_KOGGE_STONE are mutually exclusive"
+#endif
+
+#if defined(CHESS_CONSTEXPR_SLIDERS)
+#    if defined(CHESS_USE_KOGGE_STONE)
+#        error "CHESS_CONSTEXPR_SLIDERS has no effect with CHESS_USE_KOGGE_STONE, which uses no tables"
+#    endif
+#    if defined(_MSC_VER)
+#        error "CHESS_CONSTEXPR_SLIDERS is not supported on MSVC"
+#    endif
+#endif
+
+#if defined(CHESS_USE_PEXT)
+#    if !defined(__BMI2__) && !defined(_MSC_VER)
+#        error "CHESS_USE_PEXT requires BMI2, compile with -mbmi2 or -march=native"
+#    endif
+#    include <immintrin.h>
+#endif
 
 
 #if __cplusplus >= 202002L
@@ -741,31 +772,168 @@ constexpr Bitboard operator&(std::uint64_t lhs, const Bitboard& rhs) { return rh
 constexpr Bitboard operator|(std::uint64_t lhs, const Bitboard& rhs) { return rhs | lhs; }
 }  // namespace chess
 
+
 namespace chess {
-class Board;
+struct BoardState;
+
+template <typename Derived = void, typename StateStack = std::vector<BoardState>>
+class BasicBoard;
+
+using Board = BasicBoard<>;
 }  // namespace chess
 
 namespace chess {
-class attacks {
-    using U64 = std::uint64_t;
-    struct Magic {
-        U64 mask;
-        U64 magic;
-        Bitboard *attacks;
-        U64 shift;
+namespace detail {
+struct SliderMagic {
+    std::uint64_t mask;
+    std::uint64_t magic;
+    std::uint64_t shift;
+    // index of the first attack of this square in SliderTable::attacks
+    std::uint32_t offset;
+
+    [[nodiscard]] std::uint64_t operator()(Bitboard b) const noexcept {
+#if defined(CHESS_USE_PEXT)
+        return _pext_u64(b.getBits(), mask);
+#else
+        return (((b & mask)).getBits() * magic) >> shift;
+#endif
+    }
+};
 
-        U64 operator()(Bitboard b) const { return (((b & mask)).getBits() * magic) >> shift; }
-    };
+template <std::size_t N>
+struct SliderTable {
+    SliderMagic magics[64];
+    std::uint64_t attacks[N];
+
+    [[nodiscard]] Bitboard operator()(Square sq, Bitboard occupied) const noexcept {
+        const auto &magic = magics[sq.index()];
+        return attacks[magic.offset + magic(occupied)];
+    }
+};
+
+// The rays from every square to the edge of the board.
+// Rook directions first: north, east, south, west, then north east, north west, south west, south east.
+struct SliderRays {
+    std::uint64_t rays[8][64];
+};
+
+[[nodiscard]] constexpr SliderRays sliderRays() noexcept {
+    constexpr int steps[8][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+
+    SliderRays rays{};
+
+    for (int d = 0; d < 8; d++) {
+        for (int sq = 0; sq < 64; sq++) {
+            int r = sq / 8 + steps[d][0];
+            int f = sq % 8 + steps[d][1];
+
+            for (; r >= 0 && r < 8 && f >= 0 && f < 8; r += steps[d][0], f += steps[d][1]) {
+                rays.rays[d][sq] |= 1ULL << (r * 8 + f);
+            }
+        }
+    }
+
+    return rays;
+}
+
+inline constexpr SliderRays SLIDER_RAYS = sliderRays();
+
+// Attacks along one ray, the first blocker is included.
+template <int direction>
+[[nodiscard]]
+#if !defined(_MSC_VER)
+constexpr
+#endif
+    std::uint64_t rayAttacks(int sq, std::uint64_t occupied) noexcept {
+    // north, east, north east and north west point towards higher squares
+    constexpr bool up = direction == 0 || direction == 1 || direction == 4 || direction == 5;
+
+    const auto ray      = SLIDER_RAYS.rays[direction][sq];
+    const auto blockers = ray & occupied;
+
+    if (!blockers) return ray;
+
+#if defined(_MSC_VER)
+    const int blocker = up ? Bitboard(blockers).lsb() : Bitboard(blockers).msb();
+#else
+    // cheaper to evaluate than Bitboard::lsb(), keeps CHESS_CONSTEXPR_SLIDERS well within the constexpr limits
+    const int blocker = up ? __builtin_ctzll(blockers) : 63 ^ __builtin_clzll(blockers);
+#endif
+
+    return ray ^ SLIDER_RAYS.rays[direction][blocker];
+}
+
+// Attacks of a rook or bishop, the first blocker on every ray is included.
+template <bool rook>
+[[nodiscard]]
+#if !defined(_MSC_VER)
+constexpr
+#endif
+    std::uint64_t sliderAttacks(int sq, std::uint64_t occupied) noexcept {
+    if constexpr (rook) {
+        return rayAttacks<0>(sq, occupied) | rayAttacks<1>(sq, occupied) | rayAttacks<2>(sq, occupied) |
+               rayAttacks<3>(sq, occupied);
+    } else {
+        return rayAttacks<4>(sq, occupied) | rayAttacks<5>(sq, occupied) | rayAttacks<6>(sq, occupied) |
+               rayAttacks<7>(sq, occupied);
+    }
+}
+
+// Fills the magics and attacks of a rook or bishop table, at startup or at compile time.
+template <bool rook, std::size_t N>
+#if !defined(_MSC_VER)
+constexpr
+#endif
+    void initSliderTable(SliderTable<N> &table, const std::uint64_t (&magics)[64]) noexcept {
+    std::uint32_t offset = 0;
+
+    for (int sq = 0; sq < 64; sq++) {
+        // The edges of the board are not considered for the attacks
+        // i.e. for the sq h7 edges will be a1-h1, a1-a8, a8-h8, ignoring the edge of the current square
+        const std::uint64_t rank  = 0xffULL << (sq & 56);
+        const std::uint64_t file  = 0x0101010101010101ULL << (sq & 7);
+        const std::uint64_t edges = (0xff000000000000ffULL & ~rank) | (0x8181818181818181ULL & ~file);
+
+        auto &magic = table.magics[sq];
+
+        magic.mask   = sliderAttacks<rook>(sq, 0ULL) & ~edges;
+        magic.magic  = magics[sq];
+        magic.shift  = 64 - Bitboard(magic.mask).count();
+        magic.offset = offset;
+
+        // enumerates all subsets of the mask in ascending order, which is also the order of their pext index
+        std::uint64_t occ = 0ULL;
+        [[maybe_unused]] std::uint64_t subset = 0;
+
+        do {
+#if defined(CHESS_USE_PEXT)
+            const auto index = subset++;
+#else
+            const auto index = (occ * magic.magic) >> magic.shift;
+#endif
+            table.attacks[offset + index] = sliderAttacks<rook>(sq, occ);
+            occ                           = (occ - magic.mask) & magic.mask;
+        } while (occ);
+
+        offset += 1U << (64 - magic.shift);
+    }
+}
 
-    // Slow function to calculate bishop attacks
-    [[nodiscard]] static Bitboard bishopAttacks(Square sq, Bitboard occupied);
+template <bool rook, std::size_t N>
+[[nodiscard]] constexpr SliderTable<N> sliderTable(const std::uint64_t (&magics)[64]) noexcept {
+    SliderTable<N> table{};
+    initSliderTable<rook>(table, magics);
+    return table;
+}
+}  // namespace detail
 
-    // Slow function to calculate rook attacks
-    [[nodiscard]] static Bitboard rookAttacks(Square sq, Bitboard occupied);
+class attacks {
+    using U64 = std::uint64_t;
 
-    // Initializes the magic bitboard tables for sliding pieces
-    static void initSliders(Square sq, Magic table[], U64 magic,
-                            const std::function<Bitboard(Square, Bitboard)> &attacks);
+    // Fills from gen in the direction of shift until a blocker is hit, the blocker is included.
+    // not_wrap are the squares which can be reached with a single step, i.e. no file A for an eastward shift.
+    template <int shift>
+    [[nodiscard]] static constexpr U64 koggeStone(U64 gen, U64 empty, U64 not_wrap) noexcept;
 
     // clang-format off
     // pre-calculated lookup table for pawn attacks
@@ -878,11 +1046,13 @@ class attacks {
         0xa010109502200ULL,    0x4a02012000ULL,       0x500201010098b028ULL, 0x8040002811040900ULL,
         0x28000010020204ULL,   0x6000020202d0240ULL,  0x8918844842082200ULL, 0x4010011029020020ULL};
 
-    static inline Bitboard RookAttacks[0x19000]  = {};
-    static inline Bitboard BishopAttacks[0x1480] = {};
-
-    static inline Magic RookTable[64]   = {};
-    static inline Magic BishopTable[64] = {};
+#if defined(CHESS_CONSTEXPR_SLIDERS)
+    static constexpr detail::SliderTable<0x19000> RookTable = detail::sliderTable<true, 0x19000>(RookMagics);
+    static constexpr detail::SliderTable<0x1480> BishopTable = detail::sliderTable<false, 0x1480>(BishopMagics);
+#elif !defined(CHESS_USE_KOGGE_STONE)
+    static inline detail::SliderTable<0x19000> RookTable = {};
+    static inline detail::SliderTable<0x1480> BishopTable = {};
+#endif
 
    public:
     static constexpr Bitboard MASK_RANK[8] = {0xff,         0xff00,         0xff0000,         0xff000000,
@@ -973,10 +1143,12 @@ class attacks {
      * @param square
      * @return
      */
-    [[nodiscard]] static Bitboard attackers(const Board &board, Color color, Square square) noexcept;
+    template <typename BoardT>
+    [[nodiscard]] static Bitboard attackers(const BoardT &board, Color color, Square square) noexcept;
 
     /**
-     * @brief [Internal Usage] Initializes the attacks for the bishop and rook. Called once at startup.
+     * @brief [Internal Usage] Initializes the attacks for the bishop and rook. Called once at startup,
+     * does nothing if the tables are generated at compile time.
      */
     static inline void initAttacks();
 };
@@ -984,7 +1156,9 @@ class attacks {
 
 #include <array>
 #include <cctype>
+#include <new>
 #include <optional>
+#include <type_traits>
 
 
 
@@ -1272,7 +1446,6 @@ inline std::ostream &operator<<(std::ostream &os, const Move &move) {
 
 
 
-#include <cstddef>
 #include <iterator>
 #include <stdexcept>
 
@@ -1405,11 +1578,14 @@ enum PieceGenType {
     KING   = 32,
 };
 
-class Board;
-
 class movegen {
    public:
-    enum class MoveGenType : std::uint8_t { ALL, CAPTURE, QUIET };
+    /**
+     * @brief ALL, CAPTURE and QUIET split the legal moves by whether they capture.
+     * EVASION generates all legal moves if the side to move is in check and none otherwise.
+     * CHECK generates the legal moves which give check, QUIET_CHECK only the non capturing ones.
+     */
+    enum class MoveGenType : std::uint8_t { ALL, CAPTURE, QUIET, EVASION, CHECK, QUIET_CHECK };
 
     /**
      * @brief Generates all legal moves for a position.
@@ -1418,38 +1594,112 @@ class movegen {
      * @param board
      * @param pieces
      */
-    template <MoveGenType mt = MoveGenType::ALL>
-    void static legalmoves(Movelist &movelist, const Board &board,
+    template <MoveGenType mt = MoveGenType::ALL, typename BoardT>
+    void static legalmoves(Movelist &movelist, const BoardT &board,
                            int pieces = PieceGenType::PAWN | PieceGenType::KNIGHT | PieceGenType::BISHOP |
                                         PieceGenType::ROOK | PieceGenType::QUEEN | PieceGenType::KING);
 
+    /**
+     * @brief Counts the legal moves for a position without generating them.
+     * Equal to the size of the movelist legalmoves would produce, but only
+     * popcounts the destination bitboards.
+     * @tparam mt
+     * @param board
+     * @param pieces
+     * @return
+     */
+    template <MoveGenType mt = MoveGenType::ALL, typename BoardT>
+    [[nodiscard]] static int countLegalMoves(const BoardT &board,
+                                             int pieces = PieceGenType::PAWN | PieceGenType::KNIGHT |
+                                                          PieceGenType::BISHOP | PieceGenType::ROOK |
+                                                          PieceGenType::QUEEN | PieceGenType::KING);
+
+    /**
+     * @brief Generates all pseudo legal moves for a position, these can leave the own king in check.
+     * Castling moves are only generated if they are legal. Only supports ALL, CAPTURE and QUIET.
+     * Filter the moves with Board::isLegal before playing them.
+     * @tparam mt
+     * @param movelist
+     * @param board
+     * @param pieces
+     */
+    template <MoveGenType mt = MoveGenType::ALL, typename BoardT>
+    static void pseudoLegalMoves(Movelist &movelist, const BoardT &board,
+                                 int pieces = PieceGenType::PAWN | PieceGenType::KNIGHT | PieceGenType::BISHOP |
+                                              PieceGenType::ROOK | PieceGenType::QUEEN | PieceGenType::KING);
+
    private:
     static auto init_squares_between();
     static const std::array<std::array<Bitboard, 64>, 64> SQUARES_BETWEEN_BB;
 
     // Generate the checkmask. Returns a bitboard where the attacker path between the king and enemy piece is set.
-    template <Color::underlying c>
-    [[nodiscard]] static std::pair<Bitboard, int> checkMask(const Board &board, Square sq);
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static std::pair<Bitboard, int> checkMask(const BoardT &board, Square sq);
 
     // Generate the pin mask for horizontal and vertical pins. Returns a bitboard where the ray between the king and the
     // pinner is set.
-    template <Color::underlying c>
-    [[nodiscard]] static Bitboard pinMaskRooks(const Board &board, Square sq, Bitboard occ_enemy, Bitboard occ_us);
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static Bitboard pinMaskRooks(const BoardT &board, Square sq, Bitboard occ_enemy, Bitboard occ_us);
 
     // Generate the pin mask for diagonal pins. Returns a bitboard where the ray between the king and the pinner is set.
-    template <Color::underlying c>
-    [[nodiscard]] static Bitboard pinMaskBishops(const Board &board, Square sq, Bitboard occ_enemy, Bitboard occ_us);
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static Bitboard pinMaskBishops(const BoardT &board, Square sq, Bitboard occ_enemy, Bitboard occ_us);
 
     // Returns the squares that are attacked by the enemy
-    template <Color::underlying c>
-    [[nodiscard]] static Bitboard seenSquares(const Board &board, Bitboard enemy_empty);
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static Bitboard seenSquares(const BoardT &board, Bitboard enemy_empty);
+
+    struct CheckInfo {
+        // the enemy king
+        Square king_sq;
+        // squares from which each piece type gives a direct check
+        std::array<Bitboard, 6> squares;
+        // own pieces which give a discovered check when leaving the line to the king
+        Bitboard blockers_hv;
+        Bitboard blockers_d;
+    };
+
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static CheckInfo checkInfo(const BoardT &board);
+
+    // Returns the targets of a piece on sq which uncover a check.
+    [[nodiscard]] static Bitboard discoveredCheckTargets(const CheckInfo &info, Square sq);
+
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool givesCheck(const BoardT &board, const CheckInfo &info, Move move);
+
+    // Same as above without a precomputed CheckInfo, for a single move.
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool givesCheck(const BoardT &board, Move move);
+
+    // Handles en passant and castling, which move two pieces.
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool givesCheckTwoPieces(const BoardT &board, Square king_sq, Move move);
+
+    struct PawnTargets {
+        Bitboard left;
+        Bitboard right;
+        Bitboard single_push;
+        Bitboard double_push;
+    };
+
+    // Returns the target squares of all legal pawn captures and pushes, en passant excluded.
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static PawnTargets pawnTargets(const BoardT &board, Bitboard pin_d, Bitboard pin_hv,
+                                                 Bitboard checkmask, Bitboard occ_enemy);
 
     // Generate pawn moves.
-    template <Color::underlying c, MoveGenType mt>
-    static void generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    static void generatePawnMoves(const BoardT &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
                                   Bitboard checkmask, Bitboard occ_enemy);
 
-    [[nodiscard]] static std::array<Move, 2> generateEPMove(const Board &board, Bitboard checkmask, Bitboard pin_d,
+    // Count pawn moves.
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    [[nodiscard]] static int countPawnMoves(const BoardT &board, Bitboard pin_d, Bitboard pin_hv, Bitboard checkmask,
+                                            Bitboard occ_enemy);
+
+    template <typename BoardT>
+    [[nodiscard]] static std::array<Move, 2> generateEPMove(const BoardT &board, Bitboard checkmask, Bitboard pin_d,
                                                             Bitboard pawns_lr, Square ep, Color c);
 
     [[nodiscard]] static Bitboard generateKnightMoves(Square sq);
@@ -1462,19 +1712,36 @@ class movegen {
 
     [[nodiscard]] static Bitboard generateKingMoves(Square sq, Bitboard seen, Bitboard movable_square);
 
-    template <Color::underlying c, MoveGenType mt>
-    [[nodiscard]] static Bitboard generateCastleMoves(const Board &board, Square sq, Bitboard seen, Bitboard pinHV);
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    [[nodiscard]] static Bitboard generateCastleMoves(const BoardT &board, Square sq, Bitboard seen, Bitboard pinHV);
 
     template <typename T>
     static void whileBitboardAdd(Movelist &movelist, Bitboard mask, T func);
 
-    template <Color::underlying c, MoveGenType mt>
-    static void legalmoves(Movelist &movelist, const Board &board, int pieces);
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    static void legalmoves(Movelist &movelist, const BoardT &board, int pieces);
 
-    template <Color::underlying c>
-    static bool isEpSquareValid(const Board &board, Square ep);
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    [[nodiscard]] static int countLegalMoves(const BoardT &board, int pieces);
+
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    static void pseudoLegalMoves(Movelist &movelist, const BoardT &board, int pieces);
 
-    friend class Board;
+    // Returns the rook squares of all legal castling moves.
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static Bitboard legalCastleMoves(const BoardT &board, Square king_sq);
+
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool isPseudoLegal(const BoardT &board, Move move);
+
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool isLegal(const BoardT &board, Move move);
+
+    template <Color::underlying c, typename BoardT>
+    static bool isEpSquareValid(const BoardT &board, Square ep);
+
+    template <typename, typename>
+    friend class BasicBoard;
 };
 
 }  // namespace chess
@@ -1703,7 +1970,8 @@ class Zobrist {
     [[nodiscard]] static U64 sideToMove() noexcept { return RANDOM_ARRAY[780]; }
 
    public:
-    friend class Board;
+    template <typename, typename>
+    friend class BasicBoard;
 };
 
 }  // namespace chess
@@ -1725,85 +1993,248 @@ enum class GameResultReason {
 // does not include the half-move clock or full move number.
 using PackedBoard = std::array<std::uint8_t, 24>;
 
-class Board {
-    using U64 = std::uint64_t;
-
+class CastlingRights {
    public:
-    class CastlingRights {
-       public:
-        enum class Side : uint8_t { KING_SIDE, QUEEN_SIDE };
+    enum class Side : uint8_t { KING_SIDE, QUEEN_SIDE };
 
-        constexpr void setCastlingRight(Color color, Side castle, File rook_file) {
-            rooks[color][static_cast<int>(castle)] = rook_file;
-        }
+    constexpr void setCastlingRight(Color color, Side castle, File rook_file) {
+        rooks[color][static_cast<int>(castle)] = rook_file;
+    }
 
-        constexpr void clear() { rooks[0][0] = rooks[0][1] = rooks[1][0] = rooks[1][1] = File::NO_FILE; }
+    constexpr void clear() { rooks[0][0] = rooks[0][1] = rooks[1][0] = rooks[1][1] = File::NO_FILE; }
 
-        constexpr int clear(Color color, Side castle) {
-            rooks[color][static_cast<int>(castle)] = File::NO_FILE;
-            return color * 2 + static_cast<int>(castle);
-        }
+    constexpr int clear(Color color, Side castle) {
+        rooks[color][static_cast<int>(castle)] = File::NO_FILE;
+        return color * 2 + static_cast<int>(castle);
+    }
 
-        constexpr void clear(Color color) { rooks[color][0] = rooks[color][1] = File::NO_FILE; }
+    constexpr void clear(Color color) { rooks[color][0] = rooks[color][1] = File::NO_FILE; }
 
-        constexpr bool has(Color color, Side castle) const {
-            return rooks[color][static_cast<int>(castle)] != File::NO_FILE;
-        }
+    constexpr bool has(Color color, Side castle) const {
+        return rooks[color][static_cast<int>(castle)] != File::NO_FILE;
+    }
 
-        constexpr bool has(Color color) const { return has(color, Side::KING_SIDE) || has(color, Side::QUEEN_SIDE); }
+    constexpr bool has(Color color) const { return has(color, Side::KING_SIDE) || has(color, Side::QUEEN_SIDE); }
 
-        constexpr File getRookFile(Color color, Side castle) const { return rooks[color][static_cast<int>(castle)]; }
+    constexpr File getRookFile(Color color, Side castle) const { return rooks[color][static_cast<int>(castle)]; }
 
-        constexpr int hashIndex() const {
-            return has(Color::WHITE, Side::KING_SIDE) + 2 * has(Color::WHITE, Side::QUEEN_SIDE) +
-                   4 * has(Color::BLACK, Side::KING_SIDE) + 8 * has(Color::BLACK, Side::QUEEN_SIDE);
-        }
+    constexpr int hashIndex() const {
+        return has(Color::WHITE, Side::KING_SIDE) + 2 * has(Color::WHITE, Side::QUEEN_SIDE) +
+               4 * has(Color::BLACK, Side::KING_SIDE) + 8 * has(Color::BLACK, Side::QUEEN_SIDE);
+    }
 
-        constexpr bool isEmpty() const { return !has(Color::WHITE) && !has(Color::BLACK); }
+    constexpr bool isEmpty() const { return !has(Color::WHITE) && !has(Color::BLACK); }
 
-        template <typename T>
-        static constexpr Side closestSide(T sq, T pred) {
-            return sq > pred ? Side::KING_SIDE : Side::QUEEN_SIDE;
-        }
+    template <typename T>
+    static constexpr Side closestSide(T sq, T pred) {
+        return sq > pred ? Side::KING_SIDE : Side::QUEEN_SIDE;
+    }
 
-       private:
-        std::array<std::array<File, 2>, 2> rooks;
-    };
+   private:
+    std::array<std::array<File, 2>, 2> rooks;
+};
+
+// The irreversible information of a position, saved on every move to unmake it.
+struct BoardState {
+    std::uint64_t hash;
+    CastlingRights castling;
+    Square enpassant;
+    uint8_t half_moves;
+    Piece captured_piece;
+
+    BoardState() = default;
+
+    BoardState(const std::uint64_t &hash, const CastlingRights &castling, const Square &enpassant,
+               const uint8_t &half_moves, const Piece &captured_piece)
+        : hash(hash),
+          castling(castling),
+          enpassant(enpassant),
+          half_moves(half_moves),
+          captured_piece(captured_piece) {}
+};
+
+/**
+ * @brief State stack with an inline capacity of N entries, never allocates.
+ * Making more than N moves (or null moves) in a row is undefined behavior.
+ * Copying only copies the entries in use.
+ * @tparam N
+ */
+template <std::size_t N>
+class FixedStateStack {
+   public:
+    FixedStateStack() = default;
+    FixedStateStack(const FixedStateStack &other) : size_(other.size_) { copy(other); }
+
+    FixedStateStack &operator=(const FixedStateStack &other) {
+        size_ = other.size_;
+        copy(other);
+        return *this;
+    }
+
+    template <typename... Args>
+    void emplace_back(Args &&...args) {
+        assert(size_ < N);
+        new (&storage_[size_++].state) BoardState(std::forward<Args>(args)...);
+    }
+
+    void pop_back() noexcept {
+        assert(size_ > 0);
+        size_--;
+    }
+
+    [[nodiscard]] const BoardState &back() const noexcept { return (*this)[size_ - 1]; }
+
+    [[nodiscard]] const BoardState &operator[](std::size_t i) const noexcept {
+        assert(i < size_);
+        return storage_[i].state;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    [[nodiscard]] static constexpr std::size_t capacity() noexcept { return N; }
+
+    void clear() noexcept { size_ = 0; }
 
    private:
-    struct State {
-        U64 hash;
-        CastlingRights castling;
-        Square enpassant;
-        uint8_t half_moves;
-        Piece captured_piece;
-
-        State(const U64 &hash, const CastlingRights &castling, const Square &enpassant, const uint8_t &half_moves,
-              const Piece &captured_piece)
-            : hash(hash),
-              castling(castling),
-              enpassant(enpassant),
-              half_moves(half_moves),
-              captured_piece(captured_piece) {}
+    static_assert(std::is_trivially_destructible_v<BoardState>);
+
+    // uninitialized storage, only the first size_ entries are alive
+    union Slot {
+        Slot() {}
+        BoardState state;
     };
 
+    void copy(const FixedStateStack &other) noexcept {
+        for (std::size_t i = 0; i < size_; i++) new (&storage_[i].state) BoardState(other[i]);
+    }
+
+    std::array<Slot, N> storage_;
+    std::size_t size_ = 0;
+};
+
+/**
+ * @brief State stack which lives in a caller provided buffer, e.g. one per search thread.
+ * Copies of the stack (and of a board using it) share the same buffer.
+ */
+class ExternalStateStack {
+   public:
+    ExternalStateStack() = default;
+    ExternalStateStack(BoardState *data, std::size_t capacity) noexcept : data_(data), capacity_(capacity) {}
+
+    template <typename... Args>
+    void emplace_back(Args &&...args) {
+        assert(size_ < capacity_);
+        data_[size_++] = BoardState(std::forward<Args>(args)...);
+    }
+
+    void pop_back() noexcept {
+        assert(size_ > 0);
+        size_--;
+    }
+
+    [[nodiscard]] const BoardState &back() const noexcept { return (*this)[size_ - 1]; }
+
+    [[nodiscard]] const BoardState &operator[](std::size_t i) const noexcept {
+        assert(i < size_);
+        return data_[i];
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    [[nodiscard]] std::size_t capacity() const noexcept { return capacity_; }
+
+    void clear() noexcept { size_ = 0; }
+
+   private:
+    BoardState *data_     = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t size_     = 0;
+};
+
+/**
+ * @brief State stack which stores nothing, for copy-make boards.
+ * Moves can't be unmade, copy the board before making a move instead.
+ * isRepetition() always returns false since there is no history.
+ */
+class NoStateStack {
+   public:
+    template <typename... Args>
+    void emplace_back(Args &&...) noexcept {}
+
+    [[nodiscard]] static constexpr std::size_t size() noexcept { return 0; }
+
+    void clear() noexcept {}
+};
+
+/**
+ * @brief The board, Derived can be set to a class deriving from BasicBoard<Derived> to hook into
+ * placePiece/removePiece (CRTP), the calls are resolved at compile time and can be inlined.
+ * With the default of void the board has no hooks and no vtable.
+ * @tparam Derived
+ * @tparam StateStack
+ */
+template <typename Derived, typename StateStack>
+class BasicBoard {
+    using U64 = std::uint64_t;
+
+   public:
+    using CastlingRights = chess::CastlingRights;
+
+   private:
+    using State = BoardState;
+
+    // the most derived board type, whose hooks are called
+    using Self = std::conditional_t<std::is_void_v<Derived>, BasicBoard, Derived>;
+
     enum class PrivateCtor { CREATE };
 
     // private constructor to avoid initialization
-    Board(PrivateCtor) {}
+    BasicBoard(PrivateCtor) {}
 
    public:
-    explicit Board(std::string_view fen = constants::STARTPOS, bool chess960 = false) {
-        prev_states_.reserve(256);
+    explicit BasicBoard(std::string_view fen = constants::STARTPOS, bool chess960 = false) {
+        if constexpr (std::is_same_v<StateStack, std::vector<BoardState>>) prev_states_.reserve(256);
         chess960_ = chess960;
         setFenInternal<true>(fen);
     }
 
-    virtual void setFen(std::string_view fen) { setFenInternal(fen); }
+    /**
+     * @brief Constructs a board which keeps its history in the given state stack,
+     * e.g. an ExternalStateStack over a caller provided buffer.
+     * @param states
+     * @param fen
+     * @param chess960
+     */
+    explicit BasicBoard(StateStack states, std::string_view fen = constants::STARTPOS, bool chess960 = false)
+        : prev_states_(std::move(states)) {
+        chess960_ = chess960;
+        setFenInternal<true>(fen);
+    }
 
-    static Board fromFen(std::string_view fen) { return Board(fen); }
-    static Board fromEpd(std::string_view epd) {
-        Board board;
+    /**
+     * @brief Copies the position of a board with a different state stack, the history is not copied.
+     * Converting to a CopyMakeBoard never allocates.
+     * @param other
+     */
+    template <typename OtherDerived, typename OtherStateStack,
+              typename = std::enable_if_t<!std::is_same_v<BasicBoard, BasicBoard<OtherDerived, OtherStateStack>>>>
+    explicit BasicBoard(const BasicBoard<OtherDerived, OtherStateStack> &other)
+        : pieces_bb_(other.pieces_bb_),
+          occ_bb_(other.occ_bb_),
+          board_(other.board_),
+          key_(other.key_),
+          cr_(other.cr_),
+          plies_(other.plies_),
+          stm_(other.stm_),
+          ep_sq_(other.ep_sq_),
+          hfm_(other.hfm_),
+          chess960_(other.chess960_),
+          original_fen_(other.original_fen_),
+          original_fen_size_(other.original_fen_size_) {}
+
+    void setFen(std::string_view fen) { setFenInternal(fen); }
+
+    static Self fromFen(std::string_view fen) { return Self(fen); }
+    static Self fromEpd(std::string_view epd) {
+        Self board;
         board.setEpd(epd);
         return board;
     }
@@ -1852,7 +2283,7 @@ class Board {
         auto fen = std::string(parts[0]) + " " + std::string(parts[1]) + " " + std::string(parts[2]) + " " +
                    std::string(parts[3]) + " " + std::to_string(hm) + " " + std::to_string(fm);
 
-        setFen(fen);
+        self().setFen(fen);
     }
 
     /**
@@ -1973,7 +2404,7 @@ class Board {
         ep_sq_ = Square::NO_SQ;
 
         if (capture) {
-            removePiece(captured, move.to());
+            self().removePiece(captured, move.to());
 
             hfm_ = 0;
             key_ ^= Zobrist::piece(captured, move.to());
@@ -2062,14 +2493,14 @@ class Board {
             const auto king = at(move.from());
             const auto rook = at(move.to());
 
-            removePiece(king, move.from());
-            removePiece(rook, move.to());
+            self().removePiece(king, move.from());
+            self().removePiece(rook, move.to());
 
             assert(king == Piece(PieceType::KING, stm_));
             assert(rook == Piece(PieceType::ROOK, stm_));
 
-            placePiece(king, kingTo);
-            placePiece(rook, rookTo);
+            self().placePiece(king, kingTo);
+            self().placePiece(rook, rookTo);
 
             key_ ^= Zobrist::piece(king, move.from()) ^ Zobrist::piece(king, kingTo);
             key_ ^= Zobrist::piece(rook, move.to()) ^ Zobrist::piece(rook, rookTo);
@@ -2077,8 +2508,8 @@ class Board {
             const auto piece_pawn = Piece(PieceType::PAWN, stm_);
             const auto piece_prom = Piece(move.promotionType(), stm_);
 
-            removePiece(piece_pawn, move.from());
-            placePiece(piece_prom, move.to());
+            self().removePiece(piece_pawn, move.from());
+            self().placePiece(piece_prom, move.to());
 
             key_ ^= Zobrist::piece(piece_pawn, move.from()) ^ Zobrist::piece(piece_prom, move.to());
         } else {
@@ -2087,8 +2518,8 @@ class Board {
 
             const auto piece = at(move.from());
 
-            removePiece(piece, move.from());
-            placePiece(piece, move.to());
+            self().removePiece(piece, move.from());
+            self().placePiece(piece, move.to());
 
             key_ ^= Zobrist::piece(piece, move.from()) ^ Zobrist::piece(piece, move.to());
         }
@@ -2098,7 +2529,7 @@ class Board {
 
             const auto piece = Piece(PieceType::PAWN, ~stm_);
 
-            removePiece(piece, move.to().ep_square());
+            self().removePiece(piece, move.to().ep_square());
 
             key_ ^= Zobrist::piece(piece, move.to().ep_square());
         }
@@ -2108,6 +2539,9 @@ class Board {
     }
 
     void unmakeMove(const Move move) {
+        static_assert(!std::is_same_v<StateStack, NoStateStack>,
+                      "a copy-make board keeps no history, copy the board before making the move instead");
+
         const auto prev = prev_states_.back();
         prev_states_.pop_back();
 
@@ -2128,14 +2562,14 @@ class Board {
             const auto rook = at(rook_from_sq);
             const auto king = at(king_to_sq);
 
-            removePiece(rook, rook_from_sq);
-            removePiece(king, king_to_sq);
+            self().removePiece(rook, rook_from_sq);
+            self().removePiece(king, king_to_sq);
 
             assert(king == Piece(PieceType::KING, stm_));
             assert(rook == Piece(PieceType::ROOK, stm_));
 
-            placePiece(king, move.from());
-            placePiece(rook, move.to());
+            self().placePiece(king, move.from());
+            self().placePiece(rook, move.to());
 
             key_ = prev.hash;
 
@@ -2149,12 +2583,12 @@ class Board {
             assert(piece.type() != PieceType::KING);
             assert(piece.type() != PieceType::NONE);
 
-            removePiece(piece, move.to());
-            placePiece(pawn, move.from());
+            self().removePiece(piece, move.to());
+            self().placePiece(pawn, move.from());
 
             if (prev.captured_piece != Piece::NONE) {
                 assert(at(move.to()) == Piece::NONE);
-                placePiece(prev.captured_piece, move.to());
+                self().placePiece(prev.captured_piece, move.to());
             }
 
             key_ = prev.hash;
@@ -2165,8 +2599,8 @@ class Board {
 
             const auto piece = at(move.to());
 
-            removePiece(piece, move.to());
-            placePiece(piece, move.from());
+            self().removePiece(piece, move.to());
+            self().placePiece(piece, move.from());
         }
 
         if (move.typeOf() == Move::ENPASSANT) {
@@ -2175,11 +2609,11 @@ class Board {
 
             assert(at(pawnTo) == Piece::NONE);
 
-            placePiece(pawn, pawnTo);
+            self().placePiece(pawn, pawnTo);
         } else if (prev.captured_piece != Piece::NONE) {
             assert(at(move.to()) == Piece::NONE);
 
-            placePiece(prev.captured_piece, move.to());
+            self().placePiece(prev.captured_piece, move.to());
         }
 
         key_ = prev.hash;
@@ -2204,6 +2638,9 @@ class Board {
      * @brief Unmake a null move. (Switches the side to move)
      */
     void unmakeNullMove() {
+        static_assert(!std::is_same_v<StateStack, NoStateStack>,
+                      "a copy-make board keeps no history, copy the board before making the move instead");
+
         const auto &prev = prev_states_.back();
 
         ep_sq_ = prev.enpassant;
@@ -2298,6 +2735,40 @@ class Board {
         return (at(move.to()) != Piece::NONE && move.typeOf() != Move::CASTLING) || move.typeOf() == Move::ENPASSANT;
     }
 
+    /**
+     * @brief Checks if a move follows the movement rules in the current position, it might still leave the own king
+     * in check. Any move can be passed, i.e. one from a transposition table.
+     * @param move
+     * @return
+     */
+    [[nodiscard]] bool isPseudoLegal(const Move move) const {
+        if (stm_ == Color::WHITE) return movegen::isPseudoLegal<Color::WHITE>(*this, move);
+        return movegen::isPseudoLegal<Color::BLACK>(*this, move);
+    }
+
+    /**
+     * @brief Checks if a pseudo legal move doesn't leave the own king in check.
+     * The move has to be pseudo legal, see isPseudoLegal() and movegen::pseudoLegalMoves.
+     * @param move
+     * @return
+     */
+    [[nodiscard]] bool isLegal(const Move move) const {
+        if (stm_ == Color::WHITE) return movegen::isLegal<Color::WHITE>(*this, move);
+        return movegen::isLegal<Color::BLACK>(*this, move);
+    }
+
+    /**
+     * @brief Checks if a legal move gives check, without making it.
+     * Direct and discovered checks are found from the attack tables, including castling, en passant
+     * and promotions.
+     * @param move
+     * @return
+     */
+    [[nodiscard]] bool givesCheck(const Move move) const {
+        if (stm_ == Color::WHITE) return movegen::givesCheck<Color::WHITE>(*this, move);
+        return movegen::givesCheck<Color::BLACK>(*this, move);
+    }
+
     /**
      * @brief Get the current zobrist hash key of the board
      * @return
@@ -2309,9 +2780,27 @@ class Board {
     [[nodiscard]] std::uint32_t halfMoveClock() const { return hfm_; }
     [[nodiscard]] std::uint32_t fullMoveNumber() const { return 1 + plies_ / 2; }
 
+    /**
+     * @brief Switches between standard chess and chess960 and parses the position again,
+     * so that the castling rights are read for the new variant.
+     * The last fen passed to setFen is used if it fits into 128 characters,
+     * otherwise (or after Compact::decode) the fen of the current position.
+     * @param is960
+     */
     void set960(bool is960) {
+        if (!original_fen_size_) {
+            // written with the castling notation of the previous variant, like the original fen
+            const auto fen = getFen();
+            chess960_      = is960;
+            self().setFen(fen);
+            return;
+        }
+
         chess960_ = is960;
-        if (!original_fen_.empty()) setFen(original_fen_);
+
+        // setFen overwrites the buffer
+        const auto fen = original_fen_;
+        self().setFen(std::string_view(fen.data(), original_fen_size_));
     }
 
     /**
@@ -2357,19 +2846,24 @@ class Board {
      * @return
      */
     [[nodiscard]] bool isRepetition(int count = 2) const {
-        uint8_t c = 0;
+        // copy-make boards have no history to look at
+        if constexpr (std::is_same_v<StateStack, NoStateStack>) {
+            return false;
+        } else {
+            uint8_t c = 0;
 
-        // We start the loop from the back and go forward in moves, at most to the
-        // last move which reset the half-move counter because repetitions cant
-        // be across half-moves.
-        const auto size = static_cast<int>(prev_states_.size());
+            // We start the loop from the back and go forward in moves, at most to the
+            // last move which reset the half-move counter because repetitions cant
+            // be across half-moves.
+            const auto size = static_cast<int>(prev_states_.size());
 
-        for (int i = size - 2; i >= 0 && i >= size - hfm_ - 1; i -= 2) {
-            if (prev_states_[i].hash == key_) c++;
-            if (c == count) return true;
-        }
+            for (int i = size - 2; i >= 0 && i >= size - hfm_ - 1; i -= 2) {
+                if (prev_states_[i].hash == key_) c++;
+                if (c == count) return true;
+            }
 
-        return false;
+            return false;
+        }
     }
 
     /**
@@ -2525,13 +3019,33 @@ class Board {
         return hash_key ^ ep_hash ^ stm_hash ^ castling_hash;
     }
 
-    friend std::ostream &operator<<(std::ostream &os, const Board &board);
+    friend std::ostream &operator<<(std::ostream &os, const BasicBoard &b) {
+        for (int i = 63; i >= 0; i -= 8) {
+            for (int j = 7; j >= 0; j--) {
+                os << " " << static_cast<std::string>(b.board_[i - j]);
+            }
+
+            os << " \n";
+        }
+
+        os << "\n\n";
+        os << "Side to move: " << static_cast<int>(b.stm_.internal()) << "\n";
+        os << "Castling rights: " << b.getCastleString() << "\n";
+        os << "Halfmoves: " << b.halfMoveClock() << "\n";
+        os << "Fullmoves: " << b.fullMoveNumber() << "\n";
+        os << "EP: " << b.ep_sq_.index() << "\n";
+        os << "Hash: " << b.key_ << "\n";
+
+        os << std::endl;
+
+        return os;
+    }
 
     /**
      * @brief Compresses the board into a PackedBoard.
      */
     class Compact {
-        friend class Board;
+        friend class BasicBoard;
         Compact() = default;
 
        public:
@@ -2540,7 +3054,7 @@ class Board {
          * @param board
          * @return
          */
-        static PackedBoard encode(const Board &board) { return encodeState(board); }
+        static PackedBoard encode(const BasicBoard &board) { return encodeState(board); }
 
         static PackedBoard encode(std::string_view fen, bool chess960 = false) { return encodeState(fen, chess960); }
 
@@ -2550,8 +3064,14 @@ class Board {
          * @param chess960 If the board is a chess960 position, set this to true
          * @return
          */
-        static Board decode(const PackedBoard &compressed, bool chess960 = false) {
-            Board board     = Board(PrivateCtor::CREATE);
+        static Self decode(const PackedBoard &compressed, bool chess960 = false) {
+            Self board = [] {
+                if constexpr (std::is_void_v<Derived>)
+                    return BasicBoard(PrivateCtor::CREATE);
+                else
+                    return Self();
+            }();
+
             board.chess960_ = chess960;
             decode(board, compressed);
             return board;
@@ -2578,7 +3098,7 @@ class Board {
          *
          * We will later deduce the square of the pieces from the occupancy bitboard.
          */
-        static PackedBoard encodeState(const Board &board) {
+        static PackedBoard encodeState(const BasicBoard &board) {
             PackedBoard packed{};
 
             packed[0] = board.occ().getBits() >> 56;
@@ -2611,7 +3131,7 @@ class Board {
         static PackedBoard encodeState(std::string_view fen, bool chess960 = false) {
             // fallback to slower method
             if (chess960) {
-                Board board = Board(fen, true);
+                BasicBoard board = BasicBoard(fen, true);
                 return encodeState(board);
             }
 
@@ -2685,7 +3205,7 @@ class Board {
             return packed;
         }
 
-        static void decode(Board &board, const PackedBoard &compressed) {
+        static void decode(BasicBoard &board, const PackedBoard &compressed) {
             Bitboard occupied = 0ull;
 
             for (int i = 0; i < 8; i++) {
@@ -2706,7 +3226,7 @@ class Board {
 
             board.cr_.clear();
             board.prev_states_.clear();
-            board.original_fen_.clear();
+            board.original_fen_size_ = 0;
 
             board.occ_bb_.fill(0ULL);
             board.pieces_bb_.fill(0ULL);
@@ -2719,7 +3239,7 @@ class Board {
                 const auto piece  = convertPiece(nibble);
 
                 if (piece != Piece::NONE) {
-                    board.placePiece(piece, sq);
+                    board.self().placePiece(piece, sq);
 
                     offset++;
                     continue;
@@ -2731,24 +3251,24 @@ class Board {
                     board.ep_sq_ = sq.ep_square();
                     // depending on the rank this is a white or black pawn
                     auto color = sq.rank() == Rank::RANK_4 ? Color::WHITE : Color::BLACK;
-                    board.placePiece(Piece(PieceType::PAWN, color), sq);
+                    board.self().placePiece(Piece(PieceType::PAWN, color), sq);
                 }
                 // castling rights for white
                 else if (nibble == 13) {
                     assert(white_castle_idx < 2);
                     white_castle[white_castle_idx++] = sq.file();
-                    board.placePiece(Piece(PieceType::ROOK, Color::WHITE), sq);
+                    board.self().placePiece(Piece(PieceType::ROOK, Color::WHITE), sq);
                 }
                 // castling rights for black
                 else if (nibble == 14) {
                     assert(black_castle_idx < 2);
                     black_castle[black_castle_idx++] = sq.file();
-                    board.placePiece(Piece(PieceType::ROOK, Color::BLACK), sq);
+                    board.self().placePiece(Piece(PieceType::ROOK, Color::BLACK), sq);
                 }
                 // black to move
                 else if (nibble == 15) {
                     board.stm_ = Color::BLACK;
-                    board.placePiece(Piece(PieceType::KING, Color::BLACK), sq);
+                    board.self().placePiece(Piece(PieceType::KING, Color::BLACK), sq);
                 }
 
                 offset++;
@@ -2818,11 +3338,15 @@ class Board {
     };
 
    protected:
-    virtual void placePiece(Piece piece, Square sq) { placePieceInternal(piece, sq); }
+    // Hooks, shadow these in Derived to keep track of incremental updates.
+    void placePiece(Piece piece, Square sq) { placePieceInternal(piece, sq); }
 
-    virtual void removePiece(Piece piece, Square sq) { removePieceInternal(piece, sq); }
+    void removePiece(Piece piece, Square sq) { removePieceInternal(piece, sq); }
 
-    std::vector<State> prev_states_;
+    Self &self() noexcept { return static_cast<Self &>(*this); }
+    const Self &self() const noexcept { return static_cast<const Self &>(*this); }
+
+    StateStack prev_states_;
 
     std::array<Bitboard, 6> pieces_bb_ = {};
     std::array<Bitboard, 2> occ_bb_    = {};
@@ -2872,8 +3396,6 @@ class Board {
 
     template <bool ctor = false>
     void setFenInternal(std::string_view fen) {
-        original_fen_ = fen;
-
         occ_bb_.fill(0ULL);
         pieces_bb_.fill(0ULL);
         board_.fill(Piece::NONE);
@@ -2881,6 +3403,10 @@ class Board {
         // find leading whitespaces and remove them
         while (fen[0] == ' ') fen.remove_prefix(1);
 
+        // no valid fen exceeds the buffer, longer ones aren't stored and set960 falls back to getFen()
+        original_fen_size_ = fen.size() <= original_fen_.size() ? fen.size() : 0;
+        fen.copy(original_fen_.data(), original_fen_size_);
+
         const auto params     = split_string_view<6>(fen);
         const auto position   = params[0].has_value() ? *params[0] : "";
         const auto move_right = params[1].has_value() ? *params[1] : "w";
@@ -2934,11 +3460,11 @@ class Board {
             } else {
                 auto p = Piece(std::string_view(&curr, 1));
 
-                // prevent warnings about virtual method bypassing virtual dispatch
+                // Derived isn't constructed yet, don't call its hooks
                 if constexpr (ctor) {
                     placePieceInternal(p, Square(square));
                 } else {
-                    placePiece(p, square);
+                    self().placePiece(p, square);
                 }
 
                 key_ ^= Zobrist::piece(p, Square(square));
@@ -2946,7 +3472,7 @@ class Board {
             }
         }
 
-        static const auto find_rook = [](const Board &board, CastlingRights::Side side, Color color) {
+        static const auto find_rook = [](const BasicBoard &board, CastlingRights::Side side, Color color) {
             const auto king_side = CastlingRights::Side::KING_SIDE;
             const auto king_sq   = board.kingSq(color);
             const auto sq_corner = Square(side == king_side ? Square::SQ_H1 : Square::SQ_A1).relative_square(color);
@@ -3052,31 +3578,20 @@ class Board {
     }
 
     // store the original fen string
-    // useful when setting up a frc position and the user called set960(true) afterwards
-    std::string original_fen_;
-};
-
-inline std::ostream &operator<<(std::ostream &os, const Board &b) {
-    for (int i = 63; i >= 0; i -= 8) {
-        for (int j = 7; j >= 0; j--) {
-            os << " " << static_cast<std::string>(b.board_[i - j]);
-        }
+    // useful when setting up a frc position and the user called set960(true) afterwards,
+    // kept inline so that copying a board doesn't allocate
+    std::array<char, 128> original_fen_;
+    std::uint8_t original_fen_size_ = 0;
 
-        os << " \n";
-    }
+    template <typename, typename>
+    friend class BasicBoard;
+};
 
-    os << "\n\n";
-    os << "Side to move: " << static_cast<int>(b.stm_.internal()) << "\n";
-    os << "Castling rights: " << b.getCastleString() << "\n";
-    os << "Halfmoves: " << b.halfMoveClock() << "\n";
-    os << "Fullmoves: " << b.fullMoveNumber() << "\n";
-    os << "EP: " << b.ep_sq_.index() << "\n";
-    os << "Hash: " << b.key_ << "\n";
+template <std::size_t N = 256>
+using FixedBoard = BasicBoard<void, FixedStateStack<N>>;
 
-    os << std::endl;
+using CopyMakeBoard = BasicBoard<void, NoStateStack>;
 
-    return os;
-}
 }  // namespace  chess
 
 namespace chess {
@@ -3128,12 +3643,43 @@ template <Color::underlying c>
 
 [[nodiscard]] inline Bitboard attacks::knight(Square sq) noexcept { return KnightAttacks[sq.index()]; }
 
+template <int shift>
+[[nodiscard]] inline constexpr attacks::U64 attacks::koggeStone(U64 gen, U64 empty, U64 not_wrap) noexcept {
+    constexpr auto step = [](U64 b, int s) { return s > 0 ? b << s : b >> -s; };
+
+    empty &= not_wrap;
+
+    gen |= empty & step(gen, shift);
+    empty &= step(empty, shift);
+    gen |= empty & step(gen, 2 * shift);
+    empty &= step(empty, 2 * shift);
+    gen |= empty & step(gen, 4 * shift);
+
+    return step(gen, shift) & not_wrap;
+}
+
 [[nodiscard]] inline Bitboard attacks::bishop(Square sq, Bitboard occupied) noexcept {
-    return BishopTable[sq.index()].attacks[BishopTable[sq.index()](occupied)];
+#if defined(CHESS_USE_KOGGE_STONE)
+    const U64 bb    = 1ULL << sq.index();
+    const U64 empty = ~occupied.getBits();
+
+    return koggeStone<9>(bb, empty, ~MASK_FILE[0].getBits()) | koggeStone<7>(bb, empty, ~MASK_FILE[7].getBits()) |
+           koggeStone<-7>(bb, empty, ~MASK_FILE[0].getBits()) | koggeStone<-9>(bb, empty, ~MASK_FILE[7].getBits());
+#else
+    return BishopTable(sq, occupied);
+#endif
 }
 
 [[nodiscard]] inline Bitboard attacks::rook(Square sq, Bitboard occupied) noexcept {
-    return RookTable[sq.index()].attacks[RookTable[sq.index()](occupied)];
+#if defined(CHESS_USE_KOGGE_STONE)
+    const U64 bb    = 1ULL << sq.index();
+    const U64 empty = ~occupied.getBits();
+
+    return koggeStone<8>(bb, empty, ~0ULL) | koggeStone<-8>(bb, empty, ~0ULL) |
+           koggeStone<1>(bb, empty, ~MASK_FILE[0].getBits()) | koggeStone<-1>(bb, empty, ~MASK_FILE[7].getBits());
+#else
+    return RookTable(sq, occupied);
+#endif
 }
 
 [[nodiscard]] inline Bitboard attacks::queen(Square sq, Bitboard occupied) noexcept {
@@ -3142,7 +3688,8 @@ template <Color::underlying c>
 
 [[nodiscard]] inline Bitboard attacks::king(Square sq) noexcept { return KingAttacks[sq.index()]; }
 
-[[nodiscard]] inline Bitboard attacks::attackers(const Board &board, Color color, Square square) noexcept {
+template <typename BoardT>
+[[nodiscard]] inline Bitboard attacks::attackers(const BoardT &board, Color color, Square square) noexcept {
     const auto queens   = board.pieces(PieceType::QUEEN, color);
     const auto occupied = board.occ();
 
@@ -3156,111 +3703,13 @@ template <Color::underlying c>
     return atks & occupied;
 }
 
-[[nodiscard]] inline Bitboard attacks::bishopAttacks(Square sq, Bitboard occupied) {
-    Bitboard attacks = 0ULL;
-
-    int r, f;
-
-    int br = sq.rank();
-    int bf = sq.file();
-
-    for (r = br + 1, f = bf + 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(f)); r++, f++) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (r = br - 1, f = bf + 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(f)); r--, f++) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (r = br + 1, f = bf - 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(f)); r++, f--) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (r = br - 1, f = bf - 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(f)); r--, f--) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    return attacks;
-}
-
-[[nodiscard]] inline Bitboard attacks::rookAttacks(Square sq, Bitboard occupied) {
-    Bitboard attacks = 0ULL;
-
-    int r, f;
-
-    int rr = sq.rank();
-    int rf = sq.file();
-
-    for (r = rr + 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(rf)); r++) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(rf)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (r = rr - 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(rf)); r--) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(rf)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (f = rf + 1; Square::is_valid(static_cast<Rank>(rr), static_cast<File>(f)); f++) {
-        auto s = Square(static_cast<Rank>(rr), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (f = rf - 1; Square::is_valid(static_cast<Rank>(rr), static_cast<File>(f)); f--) {
-        auto s = Square(static_cast<Rank>(rr), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    return attacks;
-}
-
-inline void attacks::initSliders(Square sq, Magic table[], U64 magic,
-                                 const std::function<Bitboard(Square, Bitboard)> &attacks) {
-    // The edges of the board are not considered for the attacks
-    // i.e. for the sq h7 edges will be a1-h1, a1-a8, a8-h8, ignoring the edge of the current square
-    const Bitboard edges = ((Bitboard(Rank::RANK_1) | Bitboard(Rank::RANK_8)) & ~Bitboard(sq.rank())) |
-                           ((Bitboard(File::FILE_A) | Bitboard(File::FILE_H)) & ~Bitboard(sq.file()));
-
-    U64 occ = 0ULL;
-
-    auto &table_sq = table[sq.index()];
-
-    table_sq.magic = magic;
-    table_sq.mask  = (attacks(sq, occ) & ~edges).getBits();
-    table_sq.shift = 64 - Bitboard(table_sq.mask).count();
-
-    if (sq < 64 - 1) {
-        table[sq.index() + 1].attacks = table_sq.attacks + (1ull << Bitboard(table_sq.mask).count());
-    }
-
-    do {
-        table_sq.attacks[table_sq(occ)] = attacks(sq, occ);
-        occ                             = (occ - table_sq.mask) & table_sq.mask;
-    } while (occ);
-}
-
-inline void attacks::initAttacks() {
-    BishopTable[0].attacks = BishopAttacks;
-    RookTable[0].attacks   = RookAttacks;
-
-    for (int i = 0; i < 64; i++) {
-        initSliders(static_cast<Square>(i), BishopTable, BishopMagics[i], bishopAttacks);
-        initSliders(static_cast<Square>(i), RookTable, RookMagics[i], rookAttacks);
-    }
-}
-}  // namespace chess
+inline void attacks::initAttacks() {
+#if !defined(CHESS_USE_KOGGE_STONE) && !defined(CHESS_CONSTEXPR_SLIDERS)
+    detail::initSliderTable<false>(BishopTable, BishopMagics);
+    detail::initSliderTable<true>(RookTable, RookMagics);
+#endif
+}
+}  // namespace chess
 
 
 
@@ -3285,8 +3734,8 @@ inline auto movegen::init_squares_between() {
     return squares_between_bb;
 }
 
-template <Color::underlying c>
-[[nodiscard]] inline std::pair<Bitboard, int> movegen::checkMask(const Board &board, Square sq) {
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline std::pair<Bitboard, int> movegen::checkMask(const BoardT &board, Square sq) {
     const auto opp_knight = board.pieces(PieceType::KNIGHT, ~c);
     const auto opp_bishop = board.pieces(PieceType::BISHOP, ~c);
     const auto opp_rook   = board.pieces(PieceType::ROOK, ~c);
@@ -3338,8 +3787,8 @@ template <Color::underlying c>
     return {mask, checks};
 }
 
-template <Color::underlying c>
-[[nodiscard]] inline Bitboard movegen::pinMaskRooks(const Board &board, Square sq, Bitboard occ_opp, Bitboard occ_us) {
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::pinMaskRooks(const BoardT &board, Square sq, Bitboard occ_opp, Bitboard occ_us) {
     const auto opp_rook  = board.pieces(PieceType::ROOK, ~c);
     const auto opp_queen = board.pieces(PieceType::QUEEN, ~c);
 
@@ -3356,8 +3805,8 @@ template <Color::underlying c>
     return pin_hv;
 }
 
-template <Color::underlying c>
-[[nodiscard]] inline Bitboard movegen::pinMaskBishops(const Board &board, Square sq, Bitboard occ_opp,
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::pinMaskBishops(const BoardT &board, Square sq, Bitboard occ_opp,
                                                       Bitboard occ_us) {
     const auto opp_bishop = board.pieces(PieceType::BISHOP, ~c);
     const auto opp_queen  = board.pieces(PieceType::QUEEN, ~c);
@@ -3375,8 +3824,8 @@ template <Color::underlying c>
     return pin_diag;
 }
 
-template <Color::underlying c>
-[[nodiscard]] inline Bitboard movegen::seenSquares(const Board &board, Bitboard enemy_empty) {
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::seenSquares(const BoardT &board, Bitboard enemy_empty) {
     auto king_sq          = board.kingSq(~c);
     Bitboard map_king_atk = attacks::king(king_sq) & enemy_empty;
 
@@ -3414,20 +3863,181 @@ template <Color::underlying c>
     return seen;
 }
 
-template <Color::underlying c, movegen::MoveGenType mt>
-inline void movegen::generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
-                                       Bitboard checkmask, Bitboard occ_opp) {
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline movegen::CheckInfo movegen::checkInfo(const BoardT &board) {
+    const auto king_sq = board.kingSq(~c);
+    const auto occ_us  = board.us(c);
+    const auto occ_opp = board.us(~c);
+    const auto occ_all = occ_us | occ_opp;
+    const auto queens  = board.pieces(PieceType::QUEEN, c);
+
+    CheckInfo info{};
+
+    info.king_sq                         = king_sq;
+    info.squares[int(PieceType::PAWN)]   = attacks::pawn(~c, king_sq);
+    info.squares[int(PieceType::KNIGHT)] = attacks::knight(king_sq);
+    info.squares[int(PieceType::BISHOP)] = attacks::bishop(king_sq, occ_all);
+    info.squares[int(PieceType::ROOK)]   = attacks::rook(king_sq, occ_all);
+    info.squares[int(PieceType::QUEEN)]  = info.squares[int(PieceType::BISHOP)] | info.squares[int(PieceType::ROOK)];
+
+    // Same as the pin masks, but with our own sliders behind exactly one of our pieces.
+    Bitboard rook_snipers   = attacks::rook(king_sq, occ_opp) & (board.pieces(PieceType::ROOK, c) | queens);
+    Bitboard bishop_snipers = attacks::bishop(king_sq, occ_opp) & (board.pieces(PieceType::BISHOP, c) | queens);
+
+    while (rook_snipers) {
+        const auto between = SQUARES_BETWEEN_BB[king_sq.index()][rook_snipers.pop()] & occ_us;
+        if (between.count() == 1) info.blockers_hv |= between;
+    }
+
+    while (bishop_snipers) {
+        const auto between = SQUARES_BETWEEN_BB[king_sq.index()][bishop_snipers.pop()] & occ_us;
+        if (between.count() == 1) info.blockers_d |= between;
+    }
+
+    return info;
+}
+
+[[nodiscard]] inline Bitboard movegen::discoveredCheckTargets(const CheckInfo &info, Square sq) {
+    // Everything except the line through the king and the blocker.
+    if (info.blockers_hv & Bitboard::fromSquare(sq)) return ~(attacks::rook(info.king_sq, 0) & attacks::rook(sq, 0));
+    if (info.blockers_d & Bitboard::fromSquare(sq)) return ~(attacks::bishop(info.king_sq, 0) & attacks::bishop(sq, 0));
+    return 0ull;
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::givesCheck(const BoardT &board, const CheckInfo &info, Move move) {
+    const auto from    = move.from();
+    const auto to      = move.to();
+    const auto from_bb = Bitboard::fromSquare(from);
+    const auto to_bb   = Bitboard::fromSquare(to);
+    const auto king_bb = Bitboard::fromSquare(info.king_sq);
+
+    if (move.typeOf() == Move::NORMAL) {
+        const auto pt = board.template at<PieceType>(from);
+        return bool((info.squares[int(pt)] | discoveredCheckTargets(info, from)) & to_bb);
+    }
+
+    if (move.typeOf() == Move::PROMOTION) {
+        if (discoveredCheckTargets(info, from) & to_bb) return true;
+
+        const auto occ = board.occ() ^ from_bb;
+
+        switch (move.promotionType().internal()) {
+            case PieceType::KNIGHT:
+                return bool(attacks::knight(to) & king_bb);
+            case PieceType::BISHOP:
+                return bool(attacks::bishop(to, occ) & king_bb);
+            case PieceType::ROOK:
+                return bool(attacks::rook(to, occ) & king_bb);
+            default:
+                return bool(attacks::queen(to, occ) & king_bb);
+        }
+    }
+
+    return givesCheckTwoPieces<c>(board, info.king_sq, move);
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::givesCheck(const BoardT &board, Move move) {
+    const auto king_sq = board.kingSq(~c);
+
+    if (move.typeOf() == Move::ENPASSANT || move.typeOf() == Move::CASTLING) {
+        return givesCheckTwoPieces<c>(board, king_sq, move);
+    }
+
+    const auto from    = move.from();
+    const auto to      = move.to();
+    const auto from_bb = Bitboard::fromSquare(from);
+    const auto to_bb   = Bitboard::fromSquare(to);
+    const auto occ     = board.occ() ^ from_bb;
+
+    const auto pt = move.typeOf() == Move::PROMOTION ? move.promotionType() : board.template at<PieceType>(from);
+
+    // Direct check, from the king's point of view.
+    switch (pt.internal()) {
+        case PieceType::PAWN:
+            if (attacks::pawn(~c, king_sq) & to_bb) return true;
+            break;
+        case PieceType::KNIGHT:
+            if (attacks::knight(king_sq) & to_bb) return true;
+            break;
+        case PieceType::BISHOP:
+            if (attacks::bishop(king_sq, occ) & to_bb) return true;
+            break;
+        case PieceType::ROOK:
+            if (attacks::rook(king_sq, occ) & to_bb) return true;
+            break;
+        case PieceType::QUEEN:
+            if (attacks::queen(king_sq, occ) & to_bb) return true;
+            break;
+        default:
+            break;
+    }
+
+    // Discovered check, only possible if the piece leaves a line to the king. None of our sliders
+    // sees the king before the move, so a slider seeing it now stands behind the moving piece.
+    const auto queens = board.pieces(PieceType::QUEEN, c);
+
+    Bitboard snipers = 0ull;
+
+    if (attacks::rook(king_sq, 0ull) & from_bb) {
+        snipers = attacks::rook(king_sq, occ) & (board.pieces(PieceType::ROOK, c) | queens);
+    } else if (attacks::bishop(king_sq, 0ull) & from_bb) {
+        snipers = attacks::bishop(king_sq, occ) & (board.pieces(PieceType::BISHOP, c) | queens);
+    }
+
+    snipers &= ~from_bb;
+
+    while (snipers) {
+        // still a check if the piece stays on the line
+        if (!(SQUARES_BETWEEN_BB[king_sq.index()][snipers.pop()] & to_bb)) return true;
+    }
+
+    return false;
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::givesCheckTwoPieces(const BoardT &board, Square king_sq, Move move) {
+    const auto from    = move.from();
+    const auto to      = move.to();
+    const auto from_bb = Bitboard::fromSquare(from);
+    const auto to_bb   = Bitboard::fromSquare(to);
+    const auto king_bb = Bitboard::fromSquare(king_sq);
+
+    // En passant and castling move two pieces, look at the king from the occupancy after the move.
+    const auto queens = board.pieces(PieceType::QUEEN, c);
+
+    auto occ     = board.occ();
+    auto bishops = board.pieces(PieceType::BISHOP, c) | queens;
+    auto rooks   = board.pieces(PieceType::ROOK, c) | queens;
+
+    if (move.typeOf() == Move::ENPASSANT) {
+        if (attacks::pawn(c, to) & king_bb) return true;
+
+        const auto captured = Bitboard::fromSquare(to + make_direction(Direction::SOUTH, c));
+
+        occ = (occ ^ from_bb ^ captured) | to_bb;
+    } else {
+        const bool king_side = to > from;
+        const auto king_to   = Bitboard::fromSquare(Square::castling_king_square(king_side, c));
+        const auto rook_to   = Bitboard::fromSquare(Square::castling_rook_square(king_side, c));
+
+        occ   = (occ ^ from_bb ^ to_bb) | king_to | rook_to;
+        rooks = (rooks ^ to_bb) | rook_to;
+    }
+
+    return bool((attacks::rook(king_sq, occ) & rooks) | (attacks::bishop(king_sq, occ) & bishops));
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline movegen::PawnTargets movegen::pawnTargets(const BoardT &board, Bitboard pin_d, Bitboard pin_hv,
+                                                             Bitboard checkmask, Bitboard occ_opp) {
     // flipped for black
 
-    constexpr auto UP         = make_direction(Direction::NORTH, c);
-    constexpr auto DOWN       = make_direction(Direction::SOUTH, c);
-    constexpr auto DOWN_LEFT  = make_direction(Direction::SOUTH_WEST, c);
-    constexpr auto DOWN_RIGHT = make_direction(Direction::SOUTH_EAST, c);
-    constexpr auto UP_LEFT    = make_direction(Direction::NORTH_WEST, c);
-    constexpr auto UP_RIGHT   = make_direction(Direction::NORTH_EAST, c);
+    constexpr auto UP       = make_direction(Direction::NORTH, c);
+    constexpr auto UP_LEFT  = make_direction(Direction::NORTH_WEST, c);
+    constexpr auto UP_RIGHT = make_direction(Direction::NORTH_EAST, c);
 
-    constexpr auto RANK_B_PROMO     = Rank::rank(Rank::RANK_7, c).bb();
-    constexpr auto RANK_PROMO       = Rank::rank(Rank::RANK_8, c).bb();
     constexpr auto DOUBLE_PUSH_RANK = Rank::rank(Rank::RANK_3, c).bb();
 
     const auto pawns = board.pieces(PieceType::PAWN, c);
@@ -3461,6 +4071,26 @@ inline void movegen::generatePawnMoves(const Board &board, Movelist &moves, Bitb
                             (attacks::shift<UP>(single_push_pinned & DOUBLE_PUSH_RANK) & ~board.occ())) &
                            checkmask;
 
+    return {l_pawns, r_pawns, single_push, double_push};
+}
+
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+inline void movegen::generatePawnMoves(const BoardT &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
+                                       Bitboard checkmask, Bitboard occ_opp) {
+    // flipped for black
+
+    constexpr auto DOWN       = make_direction(Direction::SOUTH, c);
+    constexpr auto DOWN_LEFT  = make_direction(Direction::SOUTH_WEST, c);
+    constexpr auto DOWN_RIGHT = make_direction(Direction::SOUTH_EAST, c);
+
+    constexpr auto RANK_B_PROMO = Rank::rank(Rank::RANK_7, c).bb();
+    constexpr auto RANK_PROMO   = Rank::rank(Rank::RANK_8, c).bb();
+
+    const auto pawns    = board.pieces(PieceType::PAWN, c);
+    const auto pawns_lr = pawns & ~pin_hv;
+
+    auto [l_pawns, r_pawns, single_push, double_push] = pawnTargets<c>(board, pin_d, pin_hv, checkmask, occ_opp);
+
     if (pawns & RANK_B_PROMO) {
         Bitboard promo_left  = l_pawns & RANK_PROMO;
         Bitboard promo_right = r_pawns & RANK_PROMO;
@@ -3534,8 +4164,46 @@ inline void movegen::generatePawnMoves(const Board &board, Movelist &moves, Bitb
     }
 }
 
-[[nodiscard]] inline std::array<Move, 2> movegen::generateEPMove(const Board &board, Bitboard checkmask, Bitboard pin_d,
-                                                                 Bitboard pawns_lr, Square ep, Color c) {
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+[[nodiscard]] inline int movegen::countPawnMoves(const BoardT &board, Bitboard pin_d, Bitboard pin_hv,
+                                                 Bitboard checkmask, Bitboard occ_opp) {
+    constexpr auto RANK_PROMO = Rank::rank(Rank::RANK_8, c).bb();
+
+    const auto [l_pawns, r_pawns, single_push, double_push] =
+        pawnTargets<c>(board, pin_d, pin_hv, checkmask, occ_opp);
+
+    int count = 0;
+
+    // Every promotion expands into four moves.
+    if constexpr (mt != MoveGenType::QUIET) {
+        count += ((l_pawns & ~RANK_PROMO).count() + (r_pawns & ~RANK_PROMO).count());
+        count += ((l_pawns & RANK_PROMO).count() + (r_pawns & RANK_PROMO).count()) * 4;
+    }
+
+    if constexpr (mt != MoveGenType::CAPTURE) {
+        count += (single_push & ~RANK_PROMO).count() + double_push.count();
+        count += (single_push & RANK_PROMO).count() * 4;
+    }
+
+    if constexpr (mt == MoveGenType::QUIET) return count;
+
+    const Square ep = board.enpassantSq();
+
+    if (ep != Square::NO_SQ) {
+        const auto pawns_lr = board.pieces(PieceType::PAWN, c) & ~pin_hv;
+
+        for (const auto &move : generateEPMove(board, checkmask, pin_d, pawns_lr, ep, c)) {
+            if (move != Move::NO_MOVE) count++;
+        }
+    }
+
+    return count;
+}
+
+template <typename BoardT>
+[[nodiscard]] inline std::array<Move, 2> movegen::generateEPMove(const BoardT &board, Bitboard checkmask,
+                                                                 Bitboard pin_d, Bitboard pawns_lr, Square ep,
+                                                                 Color c) {
     assert((ep.rank() == Rank::RANK_3 && board.sideToMove() == Color::BLACK) ||
            (ep.rank() == Rank::RANK_6 && board.sideToMove() == Color::WHITE));
 
@@ -3624,8 +4292,8 @@ inline void movegen::generatePawnMoves(const Board &board, Movelist &moves, Bitb
     return attacks::king(sq) & movable_square & ~seen;
 }
 
-template <Color::underlying c, movegen::MoveGenType mt>
-[[nodiscard]] inline Bitboard movegen::generateCastleMoves(const Board &board, Square sq, Bitboard seen,
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::generateCastleMoves(const BoardT &board, Square sq, Bitboard seen,
                                                            Bitboard pin_hv) {
     if constexpr (mt == MoveGenType::CAPTURE) return 0ull;
     if (!Square::back_rank(sq, c) || !board.castlingRights().has(c)) return 0ull;
@@ -3634,11 +4302,11 @@ template <Color::underlying c, movegen::MoveGenType mt>
 
     Bitboard moves = 0ull;
 
-    for (const auto side : {Board::CastlingRights::Side::KING_SIDE, Board::CastlingRights::Side::QUEEN_SIDE}) {
+    for (const auto side : {CastlingRights::Side::KING_SIDE, CastlingRights::Side::QUEEN_SIDE}) {
         if (!rights.has(c, side)) continue;
 
-        const auto end_king_sq = Square::castling_king_square(side == Board::CastlingRights::Side::KING_SIDE, c);
-        const auto end_rook_sq = Square::castling_rook_square(side == Board::CastlingRights::Side::KING_SIDE, c);
+        const auto end_king_sq = Square::castling_king_square(side == CastlingRights::Side::KING_SIDE, c);
+        const auto end_rook_sq = Square::castling_rook_square(side == CastlingRights::Side::KING_SIDE, c);
 
         const auto from_rook_sq = Square(rights.getRookFile(c, side), sq.rank());
 
@@ -3673,13 +4341,20 @@ inline void movegen::whileBitboardAdd(Movelist &movelist, Bitboard mask, T func)
     }
 }
 
-template <Color::underlying c, movegen::MoveGenType mt>
-inline void movegen::legalmoves(Movelist &movelist, const Board &board, int pieces) {
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+inline void movegen::legalmoves(Movelist &movelist, const BoardT &board, int pieces) {
     /*
      The size of the movelist might not
      be 0! This is done on purpose since it enables
      you to append new move types to any movelist.
     */
+    constexpr bool checks_only = mt == MoveGenType::CHECK || mt == MoveGenType::QUIET_CHECK;
+
+    // The generators below only distinguish between captures and quiets.
+    constexpr auto gen_type = mt == MoveGenType::QUIET_CHECK ? MoveGenType::QUIET
+                              : mt == MoveGenType::EVASION || mt == MoveGenType::CHECK ? MoveGenType::ALL
+                                                                                         : mt;
+
     auto king_sq = board.kingSq(c);
 
     Bitboard occ_us  = board.us(c);
@@ -3689,18 +4364,29 @@ inline void movegen::legalmoves(Movelist &movelist, const Board &board, int piec
     Bitboard opp_empty = ~occ_us;
 
     const auto [checkmask, checks] = checkMask<c>(board, king_sq);
-    const auto pin_hv              = pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
-    const auto pin_d               = pinMaskBishops<c>(board, king_sq, occ_opp, occ_us);
+
+    if (mt == MoveGenType::EVASION && checks == 0) return;
+
+    const auto pin_hv = pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
+    const auto pin_d  = pinMaskBishops<c>(board, king_sq, occ_opp, occ_us);
 
     assert(checks <= 2);
 
+    [[maybe_unused]] const auto info = checks_only ? checkInfo<c>(board) : CheckInfo{};
+
+    // Restricts the targets of a piece to the squares which give check.
+    const auto checking = [&](Square sq, Bitboard targets, PieceType pt) -> Bitboard {
+        if constexpr (checks_only) return targets & (info.squares[int(pt)] | discoveredCheckTargets(info, sq));
+        return targets;
+    };
+
     // Moves have to be on the checkmask
     Bitboard movable_square;
 
     // Slider, Knights and King moves can only go to enemy or empty squares.
-    if (mt == MoveGenType::ALL)
+    if (gen_type == MoveGenType::ALL)
         movable_square = opp_empty;
-    else if (mt == MoveGenType::CAPTURE)
+    else if (gen_type == MoveGenType::CAPTURE)
         movable_square = occ_opp;
     else  // QUIET moves
         movable_square = ~occ_all;
@@ -3708,15 +4394,17 @@ inline void movegen::legalmoves(Movelist &movelist, const Board &board, int piec
     if (pieces & PieceGenType::KING) {
         Bitboard seen = seenSquares<~c>(board, opp_empty);
 
-        whileBitboardAdd(movelist, Bitboard::fromSquare(king_sq),
-                         [&](Square sq) { return generateKingMoves(sq, seen, movable_square); });
+        // The king can only give a discovered check.
+        whileBitboardAdd(movelist, Bitboard::fromSquare(king_sq), [&](Square sq) {
+            return checking(sq, generateKingMoves(sq, seen, movable_square), PieceType::KING);
+        });
 
         if (checks == 0) {
-            Bitboard moves_bb = generateCastleMoves<c, mt>(board, king_sq, seen, pin_hv);
+            Bitboard moves_bb = generateCastleMoves<c, gen_type>(board, king_sq, seen, pin_hv);
 
             while (moves_bb) {
-                Square to = moves_bb.pop();
-                movelist.add(Move::make<Move::CASTLING>(king_sq, to));
+                const auto move = Move::make<Move::CASTLING>(king_sq, moves_bb.pop());
+                if (!checks_only || givesCheck<c>(board, info, move)) movelist.add(move);
             }
         }
     }
@@ -3728,43 +4416,58 @@ inline void movegen::legalmoves(Movelist &movelist, const Board &board, int piec
 
     // Add the moves to the movelist.
     if (pieces & PieceGenType::PAWN) {
-        generatePawnMoves<c, mt>(board, movelist, pin_d, pin_hv, checkmask, occ_opp);
+        if constexpr (checks_only) {
+            // Promotions and en passant are easier to check one by one.
+            Movelist pawn_moves;
+            generatePawnMoves<c, gen_type>(board, pawn_moves, pin_d, pin_hv, checkmask, occ_opp);
+
+            for (const auto &move : pawn_moves) {
+                if (givesCheck<c>(board, info, move)) movelist.add(move);
+            }
+        } else {
+            generatePawnMoves<c, gen_type>(board, movelist, pin_d, pin_hv, checkmask, occ_opp);
+        }
     }
 
     if (pieces & PieceGenType::KNIGHT) {
         // Prune knights that are pinned since these cannot move.
         Bitboard knights_mask = board.pieces(PieceType::KNIGHT, c) & ~(pin_d | pin_hv);
 
-        whileBitboardAdd(movelist, knights_mask, [&](Square sq) { return generateKnightMoves(sq) & movable_square; });
+        whileBitboardAdd(movelist, knights_mask, [&](Square sq) {
+            return checking(sq, generateKnightMoves(sq) & movable_square, PieceType::KNIGHT);
+        });
     }
 
     if (pieces & PieceGenType::BISHOP) {
         // Prune horizontally pinned bishops
         Bitboard bishops_mask = board.pieces(PieceType::BISHOP, c) & ~pin_hv;
 
-        whileBitboardAdd(movelist, bishops_mask,
-                         [&](Square sq) { return generateBishopMoves(sq, pin_d, occ_all) & movable_square; });
+        whileBitboardAdd(movelist, bishops_mask, [&](Square sq) {
+            return checking(sq, generateBishopMoves(sq, pin_d, occ_all) & movable_square, PieceType::BISHOP);
+        });
     }
 
     if (pieces & PieceGenType::ROOK) {
         //  Prune diagonally pinned rooks
         Bitboard rooks_mask = board.pieces(PieceType::ROOK, c) & ~pin_d;
 
-        whileBitboardAdd(movelist, rooks_mask,
-                         [&](Square sq) { return generateRookMoves(sq, pin_hv, occ_all) & movable_square; });
+        whileBitboardAdd(movelist, rooks_mask, [&](Square sq) {
+            return checking(sq, generateRookMoves(sq, pin_hv, occ_all) & movable_square, PieceType::ROOK);
+        });
     }
 
     if (pieces & PieceGenType::QUEEN) {
         // Prune double pinned queens
         Bitboard queens_mask = board.pieces(PieceType::QUEEN, c) & ~(pin_d & pin_hv);
 
-        whileBitboardAdd(movelist, queens_mask,
-                         [&](Square sq) { return generateQueenMoves(sq, pin_d, pin_hv, occ_all) & movable_square; });
+        whileBitboardAdd(movelist, queens_mask, [&](Square sq) {
+            return checking(sq, generateQueenMoves(sq, pin_d, pin_hv, occ_all) & movable_square, PieceType::QUEEN);
+        });
     }
 }
 
-template <movegen::MoveGenType mt>
-inline void movegen::legalmoves(Movelist &movelist, const Board &board, int pieces) {
+template <movegen::MoveGenType mt, typename BoardT>
+inline void movegen::legalmoves(Movelist &movelist, const BoardT &board, int pieces) {
     movelist.clear();
 
     if (board.sideToMove() == Color::WHITE)
@@ -3773,232 +4476,3222 @@ inline void movegen::legalmoves(Movelist &movelist, const Board &board, int piec
         legalmoves<Color::BLACK, mt>(movelist, board, pieces);
 }
 
-template <Color::underlying c>
-inline bool movegen::isEpSquareValid(const Board &board, Square ep) {
-    const auto stm = board.sideToMove();
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+inline int movegen::countLegalMoves(const BoardT &board, int pieces) {
+    // Mirrors legalmoves, but popcounts the targets instead of adding them.
+    static_assert(mt != MoveGenType::CHECK && mt != MoveGenType::QUIET_CHECK);
 
-    Bitboard occ_us  = board.us(stm);
-    Bitboard occ_opp = board.us(~stm);
-    auto king_sq     = board.kingSq(stm);
+    constexpr auto gen_type = mt == MoveGenType::EVASION ? MoveGenType::ALL : mt;
 
-    const auto [checkmask, checks] = movegen::checkMask<c>(board, king_sq);
-    const auto pin_hv              = movegen::pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
-    const auto pin_d               = movegen::pinMaskBishops<c>(board, king_sq, occ_opp, occ_us);
+    auto king_sq = board.kingSq(c);
 
-    const auto pawns    = board.pieces(PieceType::PAWN, stm);
-    const auto pawns_lr = pawns & ~pin_hv;
-    const auto m        = movegen::generateEPMove(board, checkmask, pin_d, pawns_lr, ep, stm);
-    bool found          = false;
+    Bitboard occ_us  = board.us(c);
+    Bitboard occ_opp = board.us(~c);
+    Bitboard occ_all = occ_us | occ_opp;
 
-    for (const auto &move : m) {
-        if (move != Move::NO_MOVE) {
-            found = true;
-            break;
-        }
-    }
+    Bitboard opp_empty = ~occ_us;
 
-    return found;
-}
+    const auto [checkmask, checks] = checkMask<c>(board, king_sq);
 
-inline const std::array<std::array<Bitboard, 64>, 64> movegen::SQUARES_BETWEEN_BB = [] {
-    attacks::initAttacks();
-    return movegen::init_squares_between();
-}();
+    if (mt == MoveGenType::EVASION && checks == 0) return 0;
 
-}  // namespace chess
+    const auto pin_hv              = pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
+    const auto pin_d               = pinMaskBishops<c>(board, king_sq, occ_opp, occ_us);
 
-#include <istream>
+    assert(checks <= 2);
 
-namespace chess::pgn {
+    Bitboard movable_square;
 
-namespace detail {
+    if (gen_type == MoveGenType::ALL)
+        movable_square = opp_empty;
+    else if (gen_type == MoveGenType::CAPTURE)
+        movable_square = occ_opp;
+    else  // QUIET moves
+        movable_square = ~occ_all;
 
-/**
- * @brief Private class
- */
-class StringBuffer {
-   public:
-    bool empty() const noexcept { return index_ == 0; }
+    int count = 0;
 
-    void clear() noexcept { index_ = 0; }
+    if (pieces & PieceGenType::KING) {
+        Bitboard seen = seenSquares<~c>(board, opp_empty);
 
-    std::string_view get() const noexcept { return std::string_view(buffer_.data(), index_); }
+        count += generateKingMoves(king_sq, seen, movable_square).count();
 
-    bool add(char c) {
-        if (index_ >= N) {
-            return false;
-        }
+        if (checks == 0) count += generateCastleMoves<c, gen_type>(board, king_sq, seen, pin_hv).count();
+    }
 
-        buffer_[index_] = c;
+    movable_square &= checkmask;
 
-        ++index_;
+    if (checks == 2) return count;
 
-        return true;
+    if (pieces & PieceGenType::PAWN) {
+        count += countPawnMoves<c, gen_type>(board, pin_d, pin_hv, checkmask, occ_opp);
     }
 
-   private:
-    // PGN String Tokens are limited to 255 characters
-    static constexpr int N = 255;
+    if (pieces & PieceGenType::KNIGHT) {
+        Bitboard knights_mask = board.pieces(PieceType::KNIGHT, c) & ~(pin_d | pin_hv);
 
-    std::array<char, N> buffer_ = {};
+        while (knights_mask) count += (generateKnightMoves(knights_mask.pop()) & movable_square).count();
+    }
 
-    std::size_t index_ = 0;
-};
+    if (pieces & PieceGenType::BISHOP) {
+        Bitboard bishops_mask = board.pieces(PieceType::BISHOP, c) & ~pin_hv;
 
-/**
- * @brief Private class
- * @tparam BUFFER_SIZE
- */
-template <std::size_t BUFFER_SIZE>
-class StreamBuffer {
-   private:
-    static constexpr std::size_t N = BUFFER_SIZE;
-    using BufferType               = std::array<char, N * N>;
+        while (bishops_mask) {
+            count += (generateBishopMoves(bishops_mask.pop(), pin_d, occ_all) & movable_square).count();
+        }
+    }
 
-   public:
-    StreamBuffer(std::istream &stream) : stream_(stream) {}
+    if (pieces & PieceGenType::ROOK) {
+        Bitboard rooks_mask = board.pieces(PieceType::ROOK, c) & ~pin_d;
 
-    // Get the current character, skip carriage returns
-    std::optional<char> some() {
-        while (true) {
-            if (buffer_index_ < bytes_read_) {
-                const auto c = buffer_[buffer_index_];
+        while (rooks_mask) count += (generateRookMoves(rooks_mask.pop(), pin_hv, occ_all) & movable_square).count();
+    }
 
-                if (c == '\r') {
-                    ++buffer_index_;
-                    continue;
-                }
+    if (pieces & PieceGenType::QUEEN) {
+        Bitboard queens_mask = board.pieces(PieceType::QUEEN, c) & ~(pin_d & pin_hv);
 
-                return c;
-            }
+        while (queens_mask) {
+            count += (generateQueenMoves(queens_mask.pop(), pin_d, pin_hv, occ_all) & movable_square).count();
+        }
+    }
 
-            if (!fill()) {
+    return count;
+}
+
+template <movegen::MoveGenType mt, typename BoardT>
+inline int movegen::countLegalMoves(const BoardT &board, int pieces) {
+    // Checking moves have to be looked at one by one anyway.
+    if constexpr (mt == MoveGenType::CHECK || mt == MoveGenType::QUIET_CHECK) {
+        Movelist moves;
+        legalmoves<mt>(moves, board, pieces);
+        return moves.size();
+    } else {
+        if (board.sideToMove() == Color::WHITE) return countLegalMoves<Color::WHITE, mt>(board, pieces);
+
+        return countLegalMoves<Color::BLACK, mt>(board, pieces);
+    }
+}
+
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+inline void movegen::pseudoLegalMoves(Movelist &movelist, const BoardT &board, int pieces) {
+    static_assert(mt == MoveGenType::ALL || mt == MoveGenType::CAPTURE || mt == MoveGenType::QUIET);
+
+    // Same as legalmoves, but without the check and pin masks.
+    auto king_sq = board.kingSq(c);
+
+    Bitboard occ_us  = board.us(c);
+    Bitboard occ_opp = board.us(~c);
+    Bitboard occ_all = occ_us | occ_opp;
+
+    Bitboard movable_square;
+
+    if (mt == MoveGenType::ALL)
+        movable_square = ~occ_us;
+    else if (mt == MoveGenType::CAPTURE)
+        movable_square = occ_opp;
+    else  // QUIET moves
+        movable_square = ~occ_all;
+
+    if (pieces & PieceGenType::KING) {
+        whileBitboardAdd(movelist, Bitboard::fromSquare(king_sq),
+                         [&](Square sq) { return attacks::king(sq) & movable_square; });
+
+        // Castling is rare enough to be checked for legality right away.
+        if (mt != MoveGenType::CAPTURE) {
+            Bitboard moves_bb = legalCastleMoves<c>(board, king_sq);
+
+            while (moves_bb) {
+                Square to = moves_bb.pop();
+                movelist.add(Move::make<Move::CASTLING>(king_sq, to));
+            }
+        }
+    }
+
+    if (pieces & PieceGenType::PAWN) {
+        generatePawnMoves<c, mt>(board, movelist, 0, 0, constants::DEFAULT_CHECKMASK, occ_opp);
+    }
+
+    if (pieces & PieceGenType::KNIGHT) {
+        whileBitboardAdd(movelist, board.pieces(PieceType::KNIGHT, c),
+                         [&](Square sq) { return attacks::knight(sq) & movable_square; });
+    }
+
+    if (pieces & PieceGenType::BISHOP) {
+        whileBitboardAdd(movelist, board.pieces(PieceType::BISHOP, c),
+                         [&](Square sq) { return attacks::bishop(sq, occ_all) & movable_square; });
+    }
+
+    if (pieces & PieceGenType::ROOK) {
+        whileBitboardAdd(movelist, board.pieces(PieceType::ROOK, c),
+                         [&](Square sq) { return attacks::rook(sq, occ_all) & movable_square; });
+    }
+
+    if (pieces & PieceGenType::QUEEN) {
+        whileBitboardAdd(movelist, board.pieces(PieceType::QUEEN, c),
+                         [&](Square sq) { return attacks::queen(sq, occ_all) & movable_square; });
+    }
+}
+
+template <movegen::MoveGenType mt, typename BoardT>
+inline void movegen::pseudoLegalMoves(Movelist &movelist, const BoardT &board, int pieces) {
+    movelist.clear();
+
+    if (board.sideToMove() == Color::WHITE)
+        pseudoLegalMoves<Color::WHITE, mt>(movelist, board, pieces);
+    else
+        pseudoLegalMoves<Color::BLACK, mt>(movelist, board, pieces);
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::legalCastleMoves(const BoardT &board, Square king_sq) {
+    if (!board.castlingRights().has(c) || board.isAttacked(king_sq, ~c)) return 0ull;
+
+    const auto occ_us  = board.us(c);
+    const auto occ_opp = board.us(~c);
+
+    const auto seen   = seenSquares<~c>(board, ~occ_us);
+    const auto pin_hv = pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
+
+    return generateCastleMoves<c, MoveGenType::ALL>(board, king_sq, seen, pin_hv);
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::isPseudoLegal(const BoardT &board, Move move) {
+    const auto from  = move.from();
+    const auto to    = move.to();
+    const auto piece = board.at(from);
+
+    // also rejects Move::NO_MOVE and Move::NULL_MOVE
+    if (from == to || piece == Piece::NONE || piece.color() != c) return false;
+
+    const auto type  = piece.type();
+    const auto to_bb = Bitboard::fromSquare(to);
+
+    if (move.typeOf() == Move::CASTLING) {
+        return type == PieceType::KING && (legalCastleMoves<c>(board, from) & to_bb);
+    }
+
+    if (board.us(c) & to_bb) return false;
+
+    if (type == PieceType::PAWN) {
+        constexpr auto UP          = make_direction(Direction::NORTH, c);
+        constexpr auto RANK_START  = Rank::rank(Rank::RANK_2, c).bb();
+        constexpr auto RANK_PROMO  = Rank::rank(Rank::RANK_8, c).bb();
+        const auto pawn_attacks    = attacks::pawn(c, from);
+        const auto is_promo_target = bool(to_bb & RANK_PROMO);
+
+        if (move.typeOf() == Move::ENPASSANT) return to == board.enpassantSq() && (pawn_attacks & to_bb);
+
+        // moves to the last rank have to be promotions and vice versa
+        if (is_promo_target != (move.typeOf() == Move::PROMOTION)) return false;
+
+        if (pawn_attacks & to_bb) return bool(board.us(~c) & to_bb);
+        if (board.occ() & to_bb) return false;
+        if (to == from + UP) return true;
+
+        return bool(Bitboard::fromSquare(from) & RANK_START) && to == from + UP + UP &&
+               !(board.occ() & Bitboard::fromSquare(from + UP));
+    }
+
+    if (move.typeOf() != Move::NORMAL) return false;
+
+    switch (type.internal()) {
+        case PieceType::KNIGHT:
+            return bool(attacks::knight(from) & to_bb);
+        case PieceType::BISHOP:
+            return bool(attacks::bishop(from, board.occ()) & to_bb);
+        case PieceType::ROOK:
+            return bool(attacks::rook(from, board.occ()) & to_bb);
+        case PieceType::QUEEN:
+            return bool(attacks::queen(from, board.occ()) & to_bb);
+        case PieceType::KING:
+            return bool(attacks::king(from) & to_bb);
+        default:
+            return false;
+    }
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::isLegal(const BoardT &board, Move move) {
+    const auto king_sq = board.kingSq(c);
+    const auto from    = move.from();
+    const auto to      = move.to();
+
+    if (move.typeOf() == Move::CASTLING) return bool(legalCastleMoves<c>(board, king_sq) & Bitboard::fromSquare(to));
+
+    if (from == king_sq) {
+        // Sliders have to see through the king, which is moving away.
+        const auto occ    = board.occ() ^ Bitboard::fromSquare(king_sq);
+        const auto queens = board.pieces(PieceType::QUEEN, ~c);
+
+        if (attacks::pawn(c, to) & board.pieces(PieceType::PAWN, ~c)) return false;
+        if (attacks::knight(to) & board.pieces(PieceType::KNIGHT, ~c)) return false;
+        if (attacks::king(to) & board.pieces(PieceType::KING, ~c)) return false;
+        if (attacks::bishop(to, occ) & (board.pieces(PieceType::BISHOP, ~c) | queens)) return false;
+        if (attacks::rook(to, occ) & (board.pieces(PieceType::ROOK, ~c) | queens)) return false;
+
+        return true;
+    }
+
+    // Cheaper than building the check and pin masks for a single move, look at the king from the occupancy after
+    // the move instead.
+    const auto captured = move.typeOf() == Move::ENPASSANT
+                              ? Bitboard::fromSquare(to + make_direction(Direction::SOUTH, c))
+                              : Bitboard::fromSquare(to);
+
+    const auto occ    = (board.occ() & ~(Bitboard::fromSquare(from) | captured)) | Bitboard::fromSquare(to);
+    const auto them   = board.us(~c) & ~captured;
+    const auto queens = board.pieces(PieceType::QUEEN, ~c);
+
+    if (attacks::pawn(c, king_sq) & board.pieces(PieceType::PAWN, ~c) & them) return false;
+    if (attacks::knight(king_sq) & board.pieces(PieceType::KNIGHT, ~c) & them) return false;
+    if (attacks::bishop(king_sq, occ) & (board.pieces(PieceType::BISHOP, ~c) | queens) & them) return false;
+    if (attacks::rook(king_sq, occ) & (board.pieces(PieceType::ROOK, ~c) | queens) & them) return false;
+
+    return true;
+}
+
+template <Color::underlying c, typename BoardT>
+inline bool movegen::isEpSquareValid(const BoardT &board, Square ep) {
+    const auto stm = board.sideToMove();
+
+    Bitboard occ_us  = board.us(stm);
+    Bitboard occ_opp = board.us(~stm);
+    auto king_sq     = board.kingSq(stm);
+
+    const auto [checkmask, checks] = movegen::checkMask<c>(board, king_sq);
+    const auto pin_hv              = movegen::pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
+    const auto pin_d               = movegen::pinMaskBishops<c>(board, king_sq, occ_opp, occ_us);
+
+    const auto pawns    = board.pieces(PieceType::PAWN, stm);
+    const auto pawns_lr = pawns & ~pin_hv;
+    const auto m        = movegen::generateEPMove(board, checkmask, pin_d, pawns_lr, ep, stm);
+    bool found          = false;
+
+    for (const auto &move : m) {
+        if (move != Move::NO_MOVE) {
+            found = true;
+            break;
+        }
+    }
+
+    return found;
+}
+
+inline const std::array<std::array<Bitboard, 64>, 64> movegen::SQUARES_BETWEEN_BB = [] {
+    attacks::initAttacks();
+    return movegen::init_squares_between();
+}();
+
+}  // namespace chess
+
+
+
+namespace chess {
+
+/**
+ * @brief Hands out the legal moves of a position one at a time, in stages:
+ * the hash move, captures, killers and finally quiets.
+ * A stage is only generated once the previous one is exhausted, so a cutoff on the hash move
+ * or on a capture never pays for the quiet move generation.
+ * The board has to be in the same position whenever next() is called.
+ * @tparam BoardT
+ */
+template <typename BoardT = Board>
+class MovePicker {
+   public:
+    enum class Stage : std::uint8_t { HASH, GEN_CAPTURES, CAPTURES, KILLERS, GEN_QUIETS, QUIETS, DONE };
+
+    /**
+     * @brief
+     * @param board
+     * @param hash_move can be any move, it is only returned if it is legal in this position
+     * @param killers quiet moves which caused a cutoff at the same ply, only returned if legal
+     * @param score_captures order the captures by MVV-LVA, otherwise in generation order
+     */
+    explicit MovePicker(const BoardT &board, Move hash_move = Move::NO_MOVE, std::array<Move, 2> killers = {},
+                        bool score_captures = true)
+        : board_(board), hash_move_(hash_move), killers_(killers), score_captures_(score_captures) {}
+
+    /**
+     * @brief Returns the next legal move or Move::NO_MOVE once all moves have been returned.
+     * No move is returned twice.
+     * @return
+     */
+    [[nodiscard]] Move next() {
+        switch (stage_) {
+            case Stage::HASH:
+                stage_ = Stage::GEN_CAPTURES;
+
+                if (hash_move_ != Move::NO_MOVE && isLegal(hash_move_)) return hash_move_;
+
+                [[fallthrough]];
+            case Stage::GEN_CAPTURES:
+                movegen::legalmoves<movegen::MoveGenType::CAPTURE>(moves_, board_);
+
+                if (score_captures_) {
+                    for (auto &move : moves_) move.setScore(mvvLva(move));
+                }
+
+                index_ = 0;
+                stage_ = Stage::CAPTURES;
+
+                [[fallthrough]];
+            case Stage::CAPTURES:
+                while (index_ < moves_.size()) {
+                    const auto move = score_captures_ ? pickBest() : moves_[index_++];
+                    if (move != hash_move_) return move;
+                }
+
+                index_ = 0;
+                stage_ = Stage::KILLERS;
+
+                [[fallthrough]];
+            case Stage::KILLERS:
+                while (index_ < int(killers_.size())) {
+                    const auto killer = killers_[index_++];
+
+                    if (killer == Move::NO_MOVE || killer == hash_move_) continue;
+                    if (index_ == 2 && killer == killers_[0]) continue;
+                    if (board_.isCapture(killer) || !isLegal(killer)) continue;
+
+                    return killer;
+                }
+
+                stage_ = Stage::GEN_QUIETS;
+
+                [[fallthrough]];
+            case Stage::GEN_QUIETS:
+                if (skip_quiets_) {
+                    stage_ = Stage::DONE;
+                    return Move::NO_MOVE;
+                }
+
+                movegen::legalmoves<movegen::MoveGenType::QUIET>(moves_, board_);
+
+                index_ = 0;
+                stage_ = Stage::QUIETS;
+
+                [[fallthrough]];
+            case Stage::QUIETS:
+                while (!skip_quiets_ && index_ < moves_.size()) {
+                    const auto move = moves_[index_++];
+                    if (move != hash_move_ && move != killers_[0] && move != killers_[1]) return move;
+                }
+
+                stage_ = Stage::DONE;
+
+                [[fallthrough]];
+            case Stage::DONE:
+                return Move::NO_MOVE;
+        }
+
+        return Move::NO_MOVE;
+    }
+
+    /**
+     * @brief Don't generate or return any more quiet moves, killers are still returned.
+     * Useful for late move pruning and quiescence search.
+     */
+    void skipQuiets() noexcept { skip_quiets_ = true; }
+
+    /**
+     * @brief The stage the next call to next() continues at.
+     * @return
+     */
+    [[nodiscard]] Stage stage() const noexcept { return stage_; }
+
+   private:
+    // most valuable victim, least valuable attacker
+    [[nodiscard]] std::int16_t mvvLva(Move move) const noexcept {
+        const auto attacker = board_.template at<PieceType>(move.from());
+        const auto victim =
+            move.typeOf() == Move::ENPASSANT ? PieceType(PieceType::PAWN) : board_.template at<PieceType>(move.to());
+
+        return static_cast<std::int16_t>(int(victim) * 8 - int(attacker));
+    }
+
+    // selection sort step, the remaining captures are usually cut off
+    [[nodiscard]] Move pickBest() noexcept {
+        auto best = index_;
+
+        for (auto i = index_ + 1; i < moves_.size(); i++) {
+            if (moves_[i].score() > moves_[best].score()) best = i;
+        }
+
+        std::swap(moves_[index_], moves_[best]);
+
+        return moves_[index_++];
+    }
+
+    [[nodiscard]] bool isLegal(Move move) const { return board_.isPseudoLegal(move) && board_.isLegal(move); }
+
+    const BoardT &board_;
+
+    Movelist moves_;
+    int index_ = 0;
+
+    Move hash_move_;
+    std::array<Move, 2> killers_;
+
+    Stage stage_ = Stage::HASH;
+
+    bool score_captures_;
+    bool skip_quiets_ = false;
+};
+
+}  // namespace chess
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+
+namespace chess {
+
+namespace detail {
+
+/**
+ * @brief Private class
+ * A range of task indices [begin, end) packed into a single atomic word.
+ * The owning worker pops from the front, idle workers steal from the back.
+ */
+class TaskRange {
+   public:
+    void reset(std::uint32_t begin, std::uint32_t end) noexcept { range_.store(pack(begin, end)); }
+
+    bool popFront(std::uint32_t &task) noexcept {
+        auto range = range_.load(std::memory_order_relaxed);
+
+        while (true) {
+            const auto begin = low(range), end = high(range);
+
+            if (begin >= end) return false;
+
+            if (range_.compare_exchange_weak(range, pack(begin + 1, end), std::memory_order_acq_rel)) {
+                task = begin;
+                return true;
+            }
+        }
+    }
+
+    bool popBack(std::uint32_t &task) noexcept {
+        auto range = range_.load(std::memory_order_relaxed);
+
+        while (true) {
+            const auto begin = low(range), end = high(range);
+
+            if (begin >= end) return false;
+
+            if (range_.compare_exchange_weak(range, pack(begin, end - 1), std::memory_order_acq_rel)) {
+                task = end - 1;
+                return true;
+            }
+        }
+    }
+
+   private:
+    static constexpr std::uint64_t pack(std::uint32_t begin, std::uint32_t end) noexcept {
+        return (static_cast<std::uint64_t>(end) << 32) | begin;
+    }
+
+    static constexpr std::uint32_t low(std::uint64_t range) noexcept { return static_cast<std::uint32_t>(range); }
+    static constexpr std::uint32_t high(std::uint64_t range) noexcept {
+        return static_cast<std::uint32_t>(range >> 32);
+    }
+
+    // keep every range on its own cache line, workers hammer their own range
+    alignas(64) std::atomic<std::uint64_t> range_{0};
+};
+
+}  // namespace detail
+
+/**
+ * @brief Lock-free transposition table for perft node counts, shared between threads.
+ * Node counts are limited to 56 bits. Every entry stores the key xor'ed with its data, a torn write from a concurrent
+ * store fails the verification and is treated as a miss.
+ */
+class PerftTable {
+   public:
+    struct Stats {
+        std::uint64_t probes = 0;
+        std::uint64_t hits   = 0;
+        // probes which found their slot taken by another position (or a torn entry)
+        std::uint64_t collisions = 0;
+
+        [[nodiscard]] double hitRate() const noexcept { return probes ? double(hits) / double(probes) : 0.0; }
+
+        Stats &operator+=(const Stats &other) noexcept {
+            probes += other.probes;
+            hits += other.hits;
+            collisions += other.collisions;
+            return *this;
+        }
+    };
+
+    /**
+     * @brief Allocates the largest power of two number of entries fitting into mb megabytes,
+     * at least one.
+     * @param mb
+     */
+    explicit PerftTable(std::size_t mb = 16) {
+        const auto bytes = mb * 1024 * 1024;
+
+        size_ = 1;
+        while (size_ * 2 * sizeof(Entry) <= bytes) size_ *= 2;
+
+        entries_ = std::make_unique<Entry[]>(size_);
+    }
+
+    /**
+     * @brief Empties the table and resets the statistics, not thread safe.
+     */
+    void clear() noexcept {
+        for (std::size_t i = 0; i < size_; i++) {
+            entries_[i].key.store(0, std::memory_order_relaxed);
+            entries_[i].data.store(0, std::memory_order_relaxed);
+        }
+
+        probes_.store(0, std::memory_order_relaxed);
+        hits_.store(0, std::memory_order_relaxed);
+        collisions_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of entries.
+     * @return
+     */
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+    /**
+     * @brief Statistics of all probes since construction or the last clear.
+     * @return
+     */
+    [[nodiscard]] Stats stats() const noexcept {
+        Stats stats;
+        stats.probes     = probes_.load(std::memory_order_relaxed);
+        stats.hits       = hits_.load(std::memory_order_relaxed);
+        stats.collisions = collisions_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    /**
+     * @brief Looks up the node count of a position at the given depth.
+     * Statistics are gathered in the caller's stats, see record().
+     * @param key
+     * @param depth
+     * @param nodes
+     * @param stats
+     * @return
+     */
+    bool probe(std::uint64_t key, int depth, std::uint64_t &nodes, Stats &stats) const noexcept {
+        const auto &entry = entries_[key & (size_ - 1)];
+
+        const auto data  = entry.data.load(std::memory_order_relaxed);
+        const auto check = entry.key.load(std::memory_order_relaxed) ^ data;
+
+        stats.probes++;
+
+        if (check != key) {
+            if (data != 0) stats.collisions++;
+            return false;
+        }
+
+        if (int(data & DEPTH_MASK) != depth) return false;
+
+        stats.hits++;
+        nodes = data >> DEPTH_BITS;
+        return true;
+    }
+
+    /**
+     * @brief Stores the node count of a position, always replaces the old entry.
+     * @param key
+     * @param depth
+     * @param nodes
+     */
+    void store(std::uint64_t key, int depth, std::uint64_t nodes) noexcept {
+        auto &entry = entries_[key & (size_ - 1)];
+
+        const auto data = (nodes << DEPTH_BITS) | (std::uint64_t(depth) & DEPTH_MASK);
+
+        entry.key.store(key ^ data, std::memory_order_relaxed);
+        entry.data.store(data, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Adds statistics gathered by probe() to the shared counters.
+     * @param stats
+     */
+    void record(const Stats &stats) noexcept {
+        probes_.fetch_add(stats.probes, std::memory_order_relaxed);
+        hits_.fetch_add(stats.hits, std::memory_order_relaxed);
+        collisions_.fetch_add(stats.collisions, std::memory_order_relaxed);
+    }
+
+   private:
+    static constexpr int DEPTH_BITS           = 8;
+    static constexpr std::uint64_t DEPTH_MASK = (1ull << DEPTH_BITS) - 1;
+
+    struct Entry {
+        std::atomic<std::uint64_t> key{0};
+        std::atomic<std::uint64_t> data{0};
+    };
+
+    std::unique_ptr<Entry[]> entries_;
+    std::size_t size_;
+
+    std::atomic<std::uint64_t> probes_{0};
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> collisions_{0};
+};
+
+class perft {
+   public:
+    struct Options {
+        // Number of worker threads, each worker owns one copy of the board.
+        int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+        // Number of plies which are expanded into tasks before they are distributed.
+        // 1 splits at the root, deeper splits give more (and smaller) tasks to balance.
+        int split_depth = 2;
+
+        // Optional table shared by all workers, node counts are hashed when set.
+        PerftTable *table = nullptr;
+    };
+
+    struct DivideEntry {
+        Move move;
+        std::uint64_t nodes;
+    };
+
+    struct Result {
+        std::uint64_t nodes = 0;
+
+        // node count for every legal root move, in move generation order
+        std::vector<DivideEntry> divide;
+    };
+
+    /**
+     * @brief Counts the leaf nodes of the legal move tree up to the given depth.
+     * Single threaded, the board is restored before returning.
+     * The last ply is bulk counted without making the moves.
+     * @param board
+     * @param depth
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static std::uint64_t count(BoardT &board, int depth) {
+        if (depth <= 0) return 1;
+        if (depth == 1) return movegen::countLegalMoves(board);
+
+        Movelist moves;
+        movegen::legalmoves(moves, board);
+
+        std::uint64_t nodes = 0;
+
+        for (const auto &move : moves) {
+            board.makeMove(move);
+            nodes += count(board, depth - 1);
+            board.unmakeMove(move);
+        }
+
+        return nodes;
+    }
+
+    /**
+     * @brief Counts the leaf nodes of the legal move tree up to the given depth,
+     * subtrees are looked up in and stored to the table. Keyed by Board::hash() and depth.
+     * @param board
+     * @param depth
+     * @param table
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static std::uint64_t count(BoardT &board, int depth, PerftTable &table) {
+        PerftTable::Stats stats;
+
+        const auto nodes = countHashed(board, depth, table, stats);
+
+        table.record(stats);
+
+        return nodes;
+    }
+
+    /**
+     * @brief Counts the leaf nodes for every legal root move ("divide"),
+     * using all hardware threads.
+     * @param board
+     * @param depth
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Result divide(const BoardT &board, int depth) {
+        return divide(board, depth, Options{});
+    }
+
+    /**
+     * @brief Counts the leaf nodes for every legal root move ("divide").
+     * The tree is split into tasks of split_depth plies which are scheduled
+     * on a work stealing pool of options.threads workers.
+     * @param board
+     * @param depth
+     * @param options
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Result divide(const BoardT &board, int depth, const Options &options) {
+        Result result;
+
+        if (depth <= 0) {
+            result.nodes = 1;
+            return result;
+        }
+
+        Movelist root_moves;
+        movegen::legalmoves(root_moves, board);
+
+        for (const auto &move : root_moves) result.divide.push_back({move, 0});
+
+        if (root_moves.empty()) return result;
+
+        // leave at least one ply for the workers
+        const auto split = std::clamp(options.split_depth, 1, std::clamp(depth - 1, 1, MAX_SPLIT_DEPTH));
+
+        Tasks tasks;
+
+        {
+            BoardT copy = board;
+            Move path[MAX_SPLIT_DEPTH];
+            splitTasks(copy, tasks, path, 0, split, 0);
+        }
+
+        const auto remaining = depth - split;
+        const auto n_tasks   = static_cast<std::uint32_t>(tasks.root.size());
+        const auto n_workers = std::min(static_cast<std::uint32_t>(std::max(options.threads, 1)), n_tasks);
+
+        // every root move ends the game before the split depth
+        if (n_tasks == 0) return result;
+
+        std::vector<std::uint64_t> task_nodes(n_tasks, 0);
+        std::vector<detail::TaskRange> ranges(n_workers);
+
+        // hand every worker a contiguous share, the rest is balanced by stealing
+        for (std::uint32_t i = 0; i < n_workers; i++) {
+            ranges[i].reset(n_tasks * i / n_workers, n_tasks * (i + 1) / n_workers);
+        }
+
+        const auto worker = [&](std::uint32_t id) {
+            BoardT local = board;
+
+            const auto run = [&](std::uint32_t task) {
+                const auto *path = &tasks.moves[std::size_t(task) * split];
+
+                for (int i = 0; i < split; i++) local.makeMove(path[i]);
+                task_nodes[task] =
+                    options.table ? count(local, remaining, *options.table) : count(local, remaining);
+                for (int i = split - 1; i >= 0; i--) local.unmakeMove(path[i]);
+            };
+
+            std::uint32_t task;
+
+            while (ranges[id].popFront(task)) run(task);
+
+            for (std::uint32_t i = 1; i < n_workers; i++) {
+                auto &victim = ranges[(id + i) % n_workers];
+                while (victim.popBack(task)) run(task);
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (std::uint32_t i = 1; i < n_workers; i++) threads.emplace_back(worker, i);
+
+        worker(0);
+
+        for (auto &thread : threads) thread.join();
+
+        for (std::uint32_t i = 0; i < n_tasks; i++) {
+            result.divide[tasks.root[i]].nodes += task_nodes[i];
+        }
+
+        for (const auto &entry : result.divide) result.nodes += entry.nodes;
+
+        return result;
+    }
+
+   private:
+    static constexpr int MAX_SPLIT_DEPTH = 8;
+
+    struct Tasks {
+        // moves of all task paths, stored back to back with split_depth moves each
+        std::vector<Move> moves;
+        // index of the root move every task belongs to
+        std::vector<std::uint32_t> root;
+    };
+
+    template <typename BoardT>
+    static std::uint64_t countHashed(BoardT &board, int depth, PerftTable &table, PerftTable::Stats &stats) {
+        // not worth a probe, counting is cheaper than the cache miss
+        if (depth <= 1) return count(board, depth);
+
+        std::uint64_t nodes = 0;
+
+        if (table.probe(board.hash(), depth, nodes, stats)) return nodes;
+
+        Movelist moves;
+        movegen::legalmoves(moves, board);
+
+        for (const auto &move : moves) {
+            board.makeMove(move);
+            nodes += countHashed(board, depth - 1, table, stats);
+            board.unmakeMove(move);
+        }
+
+        table.store(board.hash(), depth, nodes);
+
+        return nodes;
+    }
+
+    template <typename BoardT>
+    static void splitTasks(BoardT &board, Tasks &tasks, Move *path, int ply, int split, std::uint32_t root) {
+        if (ply == split) {
+            tasks.moves.insert(tasks.moves.end(), path, path + split);
+            tasks.root.push_back(root);
+            return;
+        }
+
+        Movelist moves;
+        movegen::legalmoves(moves, board);
+
+        for (int i = 0; i < moves.size(); i++) {
+            path[ply] = moves[i];
+
+            board.makeMove(moves[i]);
+            splitTasks(board, tasks, path, ply + 1, split, ply == 0 ? i : root);
+            board.unmakeMove(moves[i]);
+        }
+    }
+};
+
+}  // namespace chess
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <mutex>
+
+
+#include <sstream>
+
+
+namespace chess {
+class uci {
+   public:
+    // longest possible SAN (e.g. "Qa1xb2+" or "exd8=Q#") and LAN (e.g. "Qa1xb2+" or "e7xd8=Q#") strings
+    static constexpr std::size_t MAX_SAN_LENGTH = 8;
+    // longest possible UCI string, e.g. "e7e8q"
+    static constexpr std::size_t MAX_UCI_LENGTH = 5;
+
+    /**
+     * @brief Converts an internal move to a UCI string
+     * @param move
+     * @param chess960
+     * @return
+     */
+    [[nodiscard]] static std::string moveToUci(const Move &move, bool chess960 = false) noexcept(false) {
+        char buffer[MAX_UCI_LENGTH];
+        return std::string(buffer, moveToUci(move, buffer, chess960));
+    }
+
+    /**
+     * @brief Writes the UCI string of a move to out, which must have room for MAX_UCI_LENGTH characters.
+     * No terminating null character is written.
+     * @param move
+     * @param out
+     * @param chess960
+     * @return the number of characters written
+     */
+    static std::size_t moveToUci(const Move &move, char *out, bool chess960 = false) noexcept {
+        // Get the from and to squares
+        Square from_sq = move.from();
+        Square to_sq   = move.to();
+
+        // If the move is not a chess960 castling move and is a king moving more than one square,
+        // update the to square to be the correct square for a regular castling move
+        if (!chess960 && move.typeOf() == Move::CASTLING) {
+            to_sq = Square(to_sq > from_sq ? File::FILE_G : File::FILE_C, from_sq.rank());
+        }
+
+        char *end = writeSquare(to_sq, writeSquare(from_sq, out));
+
+        // If the move is a promotion, add the promoted piece
+        if (move.typeOf() == Move::PROMOTION) {
+            *end++ = static_cast<char>(std::tolower(pieceSymbol(move.promotionType())));
+        }
+
+        return static_cast<std::size_t>(end - out);
+    }
+
+    /**
+     * @brief Appends the UCI string of a move to out, doesn't allocate if out has enough capacity.
+     * @param move
+     * @param out
+     * @param chess960
+     */
+    static void moveToUci(const Move &move, std::string &out, bool chess960 = false) {
+        char buffer[MAX_UCI_LENGTH];
+        out.append(buffer, moveToUci(move, buffer, chess960));
+    }
+
+    /**
+     * @brief Converts a UCI string to an internal move.
+     * @param board
+     * @param uci
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Move uciToMove(const BoardT &board, std::string_view uci) noexcept(false) {
+        if (uci.length() < 4) {
+            return Move::NO_MOVE;
+        }
+
+        Square source = Square(uci.substr(0, 2));
+        Square target = Square(uci.substr(2, 2));
+
+        if (!source.is_valid() || !target.is_valid()) {
+            return Move::NO_MOVE;
+        }
+
+        auto pt = board.at(source).type();
+
+        // castling in chess960
+        if (board.chess960() && pt == PieceType::KING && board.at(target).type() == PieceType::ROOK &&
+            board.at(target).color() == board.sideToMove()) {
+            return Move::make<Move::CASTLING>(source, target);
+        }
+
+        // convert to king captures rook
+        // in chess960 the move should be sent as king captures rook already!
+        if (!board.chess960() && pt == PieceType::KING && Square::distance(target, source) == 2) {
+            target = Square(target > source ? File::FILE_H : File::FILE_A, source.rank());
+            return Move::make<Move::CASTLING>(source, target);
+        }
+
+        // en passant
+        if (pt == PieceType::PAWN && target == board.enpassantSq()) {
+            return Move::make<Move::ENPASSANT>(source, target);
+        }
+
+        // promotion
+        if (pt == PieceType::PAWN && uci.length() == 5 && Square::back_rank(target, ~board.sideToMove())) {
+            auto promotion = PieceType(uci.substr(4, 1));
+
+            if (promotion == PieceType::NONE || promotion == PieceType::KING || promotion == PieceType::PAWN) {
+                return Move::NO_MOVE;
+            }
+
+            return Move::make<Move::PROMOTION>(source, target, PieceType(uci.substr(4, 1)));
+        }
+
+        switch (uci.length()) {
+            case 4:
+                return Move::make<Move::NORMAL>(source, target);
+            default:
+                return Move::NO_MOVE;
+        }
+    }
+
+    /**
+     * @brief Why a SAN or UCI string couldn't be converted to a move.
+     */
+    enum class ParseError : std::uint8_t {
+        NONE,
+        // the string is empty
+        EMPTY,
+        // the string isn't a move in the expected notation
+        INVALID_FORMAT,
+        // the promotion piece is missing, not allowed or given for a move which doesn't promote
+        INVALID_PROMOTION,
+        // no legal move matches the string
+        ILLEGAL_MOVE,
+        // more than one legal move matches the string
+        AMBIGUOUS_MOVE
+    };
+
+    /**
+     * @brief Either a move or the reason why the string couldn't be parsed, like std::expected<Move, ParseError>.
+     * Never allocates.
+     */
+    class ParseResult {
+       public:
+        ParseResult(Move move) noexcept : move_(move) {}
+        ParseResult(ParseError error) noexcept : error_(error) {}
+
+        [[nodiscard]] bool hasValue() const noexcept { return error_ == ParseError::NONE; }
+        explicit operator bool() const noexcept { return hasValue(); }
+
+        /**
+         * @brief The parsed move, only valid if hasValue() is true.
+         * @return
+         */
+        [[nodiscard]] Move value() const noexcept {
+            assert(hasValue());
+            return move_;
+        }
+
+        [[nodiscard]] Move valueOr(Move fallback) const noexcept { return hasValue() ? move_ : fallback; }
+
+        [[nodiscard]] ParseError error() const noexcept { return error_; }
+
+        /**
+         * @brief A static description of the error.
+         * @return
+         */
+        [[nodiscard]] const char *message() const noexcept {
+            switch (error_) {
+                case ParseError::NONE:
+                    return "No error";
+                case ParseError::EMPTY:
+                    return "Empty move";
+                case ParseError::INVALID_FORMAT:
+                    return "Invalid move format";
+                case ParseError::INVALID_PROMOTION:
+                    return "Invalid promotion";
+                case ParseError::ILLEGAL_MOVE:
+                    return "Illegal move";
+                case ParseError::AMBIGUOUS_MOVE:
+                    return "Ambiguous move";
+                default:
+                    assert(false);
+                    return "Unknown error";
+            }
+        }
+
+       private:
+        Move move_        = Move::NO_MOVE;
+        ParseError error_ = ParseError::NONE;
+    };
+
+    /**
+     * @brief Converts a UCI string to a legal move, without throwing.
+     * Unlike uciToMove the move is checked for legality.
+     * @param board
+     * @param uci
+     * @return the move or ParseError::EMPTY, INVALID_FORMAT, INVALID_PROMOTION or ILLEGAL_MOVE
+     */
+    template <typename BoardT>
+    [[nodiscard]] static ParseResult tryUciToMove(const BoardT &board, std::string_view uci) noexcept {
+        if (uci.empty()) return ParseError::EMPTY;
+        if (!isUciMove(uci)) return ParseError::INVALID_FORMAT;
+
+        // a pawn reaching the last rank without a promotion piece
+        if (uci.size() == 4 && board.at(Square(uci.substr(0, 2))) == Piece(PieceType::PAWN, board.sideToMove()) &&
+            Square::back_rank(Square(uci.substr(2, 2)), ~board.sideToMove())) {
+            return ParseError::INVALID_PROMOTION;
+        }
+
+        const auto move = uciToMove(board, uci);
+
+        // a promotion piece for a move which doesn't promote
+        if (move == Move::NO_MOVE) return ParseError::INVALID_PROMOTION;
+
+        if (!board.isPseudoLegal(move) || !board.isLegal(move)) return ParseError::ILLEGAL_MOVE;
+
+        return move;
+    }
+
+    /**
+     * @brief Parse a san string and return the move or the reason it couldn't be parsed, without throwing
+     * and without building an error message. Works with CHESS_NO_EXCEPTIONS.
+     * @param board
+     * @param san
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static ParseResult tryParseSan(const BoardT &board, std::string_view san) noexcept {
+        Movelist moves;
+
+        return tryParseSan(board, san, moves);
+    }
+
+    /**
+     * @brief Parse a san string and return the move or the reason it couldn't be parsed, without throwing
+     * and without building an error message. Works with CHESS_NO_EXCEPTIONS.
+     * @param board
+     * @param san
+     * @param moves scratch space for the rare moves which aren't resolved from the attack tables
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static ParseResult tryParseSan(const BoardT &board, std::string_view san, Movelist &moves) noexcept {
+        if (san.empty()) return ParseError::EMPTY;
+
+        static constexpr auto pt_to_pgt = [](PieceType pt) { return 1 << (pt); };
+
+        SanMoveInformation info;
+
+        if (const auto error = parseSanInfo(san, info); error != ParseError::NONE) {
+            return error;
+        }
+
+        if (const auto move = parseSanDirect(board, info); move != Move::NO_MOVE) {
+            return move;
+        }
+
+        // a pawn reaching the last rank without a promotion piece
+        if (info.piece == PieceType::PAWN && info.promotion == PieceType::NONE &&
+            Square::back_rank(info.to, ~board.sideToMove())) {
+            return ParseError::INVALID_PROMOTION;
+        }
+
+        if (info.capture) {
+            movegen::legalmoves<movegen::MoveGenType::CAPTURE>(moves, board, pt_to_pgt(info.piece));
+        } else {
+            movegen::legalmoves<movegen::MoveGenType::QUIET>(moves, board, pt_to_pgt(info.piece));
+        }
+
+        if (info.castling_short || info.castling_long) {
+            for (const auto &move : moves) {
+                if (move.typeOf() == Move::CASTLING) {
+                    if ((info.castling_short && move.to() > move.from()) ||
+                        (info.castling_long && move.to() < move.from())) {
+                        return move;
+                    }
+                }
+            }
+
+            return ParseError::ILLEGAL_MOVE;
+        }
+
+        Move matchingMove = Move::NO_MOVE;
+        bool foundMatch   = false;
+
+        for (const auto &move : moves) {
+            // Skip all moves that are not to the correct square
+            // or are castling moves
+            if (move.to() != info.to || move.typeOf() == Move::CASTLING) {
+                continue;
+            }
+
+            // Handle promotion moves
+            if (info.promotion != PieceType::NONE) {
+                if (move.typeOf() != Move::PROMOTION || info.promotion != move.promotionType() ||
+                    move.from().file() != info.from_file) {
+                    continue;
+                }
+            }
+            // Handle en passant moves
+            else if (move.typeOf() == Move::ENPASSANT) {
+                if (move.from().file() != info.from_file) {
+                    continue;
+                }
+            }
+            // Handle moves with specific from square
+            else if (info.from != Square::NO_SQ) {
+                if (move.from() != info.from) {
+                    continue;
+                }
+            }
+            // Handle moves with partial from information (rank or file)
+            else if (info.from_rank != Rank::NO_RANK || info.from_file != File::NO_FILE) {
+                if ((info.from_file != File::NO_FILE && move.from().file() != info.from_file) ||
+                    (info.from_rank != Rank::NO_RANK && move.from().rank() != info.from_rank)) {
+                    continue;
+                }
+            }
+
+            // If we get here, the move matches our criteria
+            if (foundMatch) {
+                return ParseError::AMBIGUOUS_MOVE;
+            }
+
+            matchingMove = move;
+            foundMatch   = true;
+        }
+
+        if (!foundMatch) {
+            return ParseError::ILLEGAL_MOVE;
+        }
+
+        return matchingMove;
+    }
+
+    /**
+     * @brief Converts a move to a SAN string
+     * @param board
+     * @param move
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static std::string moveToSan(const BoardT &board, const Move &move) noexcept(false) {
+        char buffer[MAX_SAN_LENGTH];
+        return std::string(buffer, moveToSan(board, move, buffer));
+    }
+
+    /**
+     * @brief Writes the SAN string of a move to out, which must have room for MAX_SAN_LENGTH characters.
+     * No terminating null character is written and nothing is allocated.
+     * @param board
+     * @param move
+     * @param out
+     * @return the number of characters written
+     */
+    template <typename BoardT>
+    static std::size_t moveToSan(const BoardT &board, const Move &move, char *out) {
+        char *end = moveToRep<false>(board, move, out);
+        end       = writeCheckSymbol(board, move, end);
+        return static_cast<std::size_t>(end - out);
+    }
+
+    /**
+     * @brief Appends the SAN string of a move to out, doesn't allocate if out has enough capacity.
+     * @param board
+     * @param move
+     * @param out
+     */
+    template <typename BoardT>
+    static void moveToSan(const BoardT &board, const Move &move, std::string &out) {
+        char buffer[MAX_SAN_LENGTH];
+        out.append(buffer, moveToSan(board, move, buffer));
+    }
+
+    /**
+     * @brief Converts a move to a LAN string
+     * @param board
+     * @param move
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static std::string moveToLan(const BoardT &board, const Move &move) noexcept(false) {
+        char buffer[MAX_SAN_LENGTH];
+        return std::string(buffer, moveToLan(board, move, buffer));
+    }
+
+    /**
+     * @brief Writes the LAN string of a move to out, which must have room for MAX_SAN_LENGTH characters.
+     * No terminating null character is written and nothing is allocated.
+     * @param board
+     * @param move
+     * @param out
+     * @return the number of characters written
+     */
+    template <typename BoardT>
+    static std::size_t moveToLan(const BoardT &board, const Move &move, char *out) {
+        char *end = moveToRep<true>(board, move, out);
+        end       = writeCheckSymbol(board, move, end);
+        return static_cast<std::size_t>(end - out);
+    }
+
+    /**
+     * @brief Appends the LAN string of a move to out, doesn't allocate if out has enough capacity.
+     * @param board
+     * @param move
+     * @param out
+     */
+    template <typename BoardT>
+    static void moveToLan(const BoardT &board, const Move &move, std::string &out) {
+        char buffer[MAX_SAN_LENGTH];
+        out.append(buffer, moveToLan(board, move, buffer));
+    }
+
+    /**
+     * @brief Appends the SAN strings of a sequence of legal moves played from board to out,
+     * separated by separator. The position is copied once and advanced by each move,
+     * nothing is allocated if out has enough capacity.
+     * @param board
+     * @param moves any range of Move, e.g. a std::vector<Move> or a Movelist
+     * @param out
+     * @param separator
+     */
+    template <typename BoardT, typename Moves>
+    static void movesToSan(const BoardT &board, const Moves &moves, std::string &out, char separator = ' ') {
+        CopyMakeBoard position(board);
+        char buffer[MAX_SAN_LENGTH];
+        bool first = true;
+
+        for (const Move &move : moves) {
+            if (!first) out += separator;
+            first = false;
+
+            char *end        = moveToRep<false>(position, move, buffer);
+            const bool check = position.givesCheck(move);
+
+            position.makeMove(move);
+
+            if (check) end = writeMateOrCheck(position, end);
+
+            out.append(buffer, end);
+        }
+    }
+
+    class SanParseError : public std::exception {
+       public:
+        explicit SanParseError(const char *message) : msg_(message) {}
+
+        explicit SanParseError(const std::string &message) : msg_(message) {}
+
+        virtual ~SanParseError() noexcept {}
+
+        virtual const char *what() const noexcept { return msg_.c_str(); }
+
+       protected:
+        std::string msg_;
+    };
+
+    class AmbiguousMoveError : public std::exception {
+       public:
+        explicit AmbiguousMoveError(const char *message) : msg_(message) {}
+
+        explicit AmbiguousMoveError(const std::string &message) : msg_(message) {}
+
+        virtual ~AmbiguousMoveError() noexcept {}
+
+        virtual const char *what() const noexcept { return msg_.c_str(); }
+
+       protected:
+        std::string msg_;
+    };
+
+    /**
+     * @brief Parse a san string and return the move.
+     * This function will throw a SanParseError if the san string is invalid.
+     * @param board
+     * @param san
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Move parseSan(const BoardT &board, std::string_view san) noexcept(false) {
+        Movelist moves;
+
+        return parseSan(board, san, moves);
+    }
+
+    /**
+     * @brief Parse a san string and return the move.
+     * This function will throw a SanParseError if the san string is invalid.
+     * @param board
+     * @param san
+     * @param moves
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Move parseSan(const BoardT &board, std::string_view san, Movelist &moves) noexcept(false) {
+        const auto result = tryParseSan(board, san, moves);
+
+        if (result) return result.value();
+
+#ifndef CHESS_NO_EXCEPTIONS
+        // the message is only built for the rare invalid moves
+        switch (result.error()) {
+            case ParseError::EMPTY:
+                break;
+            case ParseError::INVALID_FORMAT:
+                throw SanParseError("Failed to parse san. At step 0: " + std::string(san));
+            case ParseError::INVALID_PROMOTION:
+                throw SanParseError("Failed to parse promotion, during san conversion." + std::string(san));
+            case ParseError::AMBIGUOUS_MOVE:
+                throw AmbiguousMoveError("Ambiguous san: " + std::string(san) + " in " + board.getFen());
+            default:
+                throw SanParseError("Failed to parse san. At step 3: " + std::string(san) + " " + board.getFen());
+        }
+#endif
+
+        return Move::NO_MOVE;
+    }
+
+    /**
+     * @brief Check if a string is a valid UCI move. Must also have the correct length.
+     * @param move
+     * @return
+     */
+    static bool isUciMove(std::string_view move) noexcept {
+        bool is_uci = false;
+
+        static constexpr auto is_digit     = [](char c) { return c >= '1' && c <= '8'; };
+        static constexpr auto is_file      = [](char c) { return c >= 'a' && c <= 'h'; };
+        static constexpr auto is_promotion = [](char c) { return c == 'n' || c == 'b' || c == 'r' || c == 'q'; };
+
+        // assert that the move is in uci format, [abcdefgh][1-8][abcdefgh][1-8][nbrq]
+        if (move.size() >= 4) {
+            is_uci = is_file(move[0]) && is_digit(move[1]) && is_file(move[2]) && is_digit(move[3]);
+        }
+
+        if (move.size() == 5) {
+            is_uci = is_uci && is_promotion(move[4]);
+        }
+
+        if (move.size() > 5) {
+            return false;
+        }
+
+        return is_uci;
+    }
+
+   private:
+    struct SanMoveInformation {
+        File from_file = File::NO_FILE;
+        Rank from_rank = Rank::NO_RANK;
+
+        PieceType promotion = PieceType::NONE;
+
+        Square from = Square::NO_SQ;
+        // a valid move always has a to square
+        Square to = Square::NO_SQ;
+
+        // a valid move always has a piece
+        PieceType piece = PieceType::NONE;
+
+        bool castling_short = false;
+        bool castling_long  = false;
+
+        bool capture = false;
+    };
+
+    // character classes of the SAN decoder, a character can belong to several classes
+    enum SanCharKind : std::uint8_t {
+        SAN_FILE      = 1 << 0,
+        SAN_RANK      = 1 << 1,
+        SAN_PIECE     = 1 << 2,
+        SAN_PROMOTION = 1 << 3,
+    };
+
+    struct SanChar {
+        std::uint8_t kind;
+        // the file or rank
+        std::uint8_t value;
+        // the piece type, kept apart since a lower case b is a file and a bishop
+        std::uint8_t piece;
+    };
+
+    static constexpr std::array<SanChar, 256> SAN_CHARS = []() constexpr {
+        std::array<SanChar, 256> table{};
+
+        for (int i = 0; i < 8; i++) {
+            table['a' + i] = {SAN_FILE, static_cast<std::uint8_t>(i), 0};
+            table['1' + i] = {SAN_RANK, static_cast<std::uint8_t>(i), 0};
+        }
+
+        constexpr std::string_view upper = "PNBRQK";
+        constexpr std::string_view lower = "pnbrqk";
+
+        for (std::size_t i = 0; i < upper.size(); i++) {
+            const bool promotion = i != 0 && i != 5;
+            const auto piece     = static_cast<std::uint8_t>(i);
+
+            table[static_cast<unsigned char>(upper[i])] = {
+                static_cast<std::uint8_t>(SAN_PIECE | (promotion ? SAN_PROMOTION : 0)), 0, piece};
+
+            // a lower case b is a file, except as promotion piece
+            auto &entry = table[static_cast<unsigned char>(lower[i])];
+            entry.kind |= (lower[i] != 'b' ? SAN_PIECE : 0) | (promotion ? SAN_PROMOTION : 0);
+            entry.piece = piece;
+        }
+
+        return table;
+    }();
+
+    [[nodiscard]] static SanChar sanChar(char c) noexcept { return SAN_CHARS[static_cast<unsigned char>(c)]; }
+
+    // Decodes the token from the back, where its structure is fixed: the destination square and an optional
+    // promotion come last, everything in front of them is an optional piece, origin hints and capture sign.
+    [[nodiscard]] static ParseError parseSanInfo(std::string_view san, SanMoveInformation &info) noexcept {
+        if (san.length() < 2) {
+            return ParseError::INVALID_FORMAT;
+        }
+
+        // anything after the move is ignored, like check and annotation symbols
+        if (san[0] == 'O' || san[0] == '0') {
+            const auto castle = san[0];
+
+            while (!san.empty() && san.back() != castle) {
+                san.remove_suffix(1);
+            }
+
+            info.piece          = PieceType::KING;
+            info.castling_short = san.length() == 3 && san[1] == '-';
+            info.castling_long  = san.length() == 5 && san[1] == '-' && san[3] == '-';
+
+            return info.castling_short || info.castling_long ? ParseError::NONE : ParseError::INVALID_FORMAT;
+        }
+
+        while (!san.empty() && san.back() != '=' && !(sanChar(san.back()).kind & (SAN_RANK | SAN_PROMOTION))) {
+            san.remove_suffix(1);
+        }
+
+        if (san.length() < 2) {
+            return ParseError::INVALID_FORMAT;
+        }
+
+        // promotion, the equal sign is optional
+        const bool equal_sign = san.back() == '=' || san[san.length() - 2] == '=';
+        const auto last       = sanChar(san.back());
+
+        // a lower case promotion piece needs the equal sign, "b8b" isn't a bishop promotion
+        const bool upper_case = san.back() >= 'A' && san.back() <= 'Z';
+
+        if ((last.kind & SAN_PROMOTION) && (equal_sign || upper_case)) {
+            info.promotion = PieceType(static_cast<PieceType::underlying>(last.piece));
+            san.remove_suffix(equal_sign ? 2 : 1);
+        } else if (equal_sign) {
+            return ParseError::INVALID_PROMOTION;
+        }
+
+        if (san.length() < 2) {
+            return ParseError::INVALID_FORMAT;
+        }
+
+        const auto file_to = sanChar(san[san.length() - 2]);
+        const auto rank_to = sanChar(san[san.length() - 1]);
+
+        if (!(file_to.kind & SAN_FILE) || !(rank_to.kind & SAN_RANK)) {
+            return ParseError::INVALID_FORMAT;
+        }
+
+        info.to = Square(File(file_to.value), Rank(rank_to.value));
+        san.remove_suffix(2);
+
+        info.piece = PieceType::PAWN;
+
+        if (!san.empty() && (sanChar(san[0]).kind & SAN_PIECE)) {
+            info.piece = PieceType(static_cast<PieceType::underlying>(sanChar(san[0]).piece));
+            san.remove_prefix(1);
+        }
+
+        if (!san.empty() && san.back() == 'x') {
+            info.capture = true;
+            san.remove_suffix(1);
+        }
+
+        // at most the file and the rank of the origin are left, in this order
+        if (!san.empty() && (sanChar(san[0]).kind & SAN_FILE)) {
+            info.from_file = File(sanChar(san[0]).value);
+            san.remove_prefix(1);
+        }
+
+        if (!san.empty() && (sanChar(san[0]).kind & SAN_RANK)) {
+            info.from_rank = Rank(sanChar(san[0]).value);
+            san.remove_prefix(1);
+        }
+
+        if (!san.empty()) {
+            return ParseError::INVALID_FORMAT;
+        }
+
+        if (info.promotion != PieceType::NONE && info.piece != PieceType::PAWN) {
+            return ParseError::INVALID_PROMOTION;
+        }
+
+        // pawn captures name the origin file, pawns never need the rank alone
+        if (info.piece == PieceType::PAWN && info.from_file == File::NO_FILE &&
+            (info.capture || info.from_rank != Rank::NO_RANK)) {
+            return ParseError::INVALID_FORMAT;
+        }
+
+        // pawns which are not capturing stay on the same file
+        if (info.piece == PieceType::PAWN && info.from_file == File::NO_FILE && !info.capture) {
+            info.from_file = info.to.file();
+        }
+
+        if (info.from_file != File::NO_FILE && info.from_rank != Rank::NO_RANK) {
+            info.from = Square(info.from_file, info.from_rank);
+        }
+
+        return ParseError::NONE;
+    }
+
+    // Finds the move among the pieces which attack the target square, which is much cheaper than generating
+    // the moves. The candidates are pseudo legal by construction, so only their legality is checked.
+    // Returns Move::NO_MOVE for invalid or ambiguous moves, the move generation handles and reports those.
+    template <typename BoardT>
+    [[nodiscard]] static Move parseSanDirect(const BoardT &board, const SanMoveInformation &info) {
+        const auto stm = board.sideToMove();
+
+        if (info.castling_short || info.castling_long) {
+            const auto side = info.castling_short ? CastlingRights::Side::KING_SIDE : CastlingRights::Side::QUEEN_SIDE;
+
+            if (!board.castlingRights().has(stm, side)) {
+                return Move::NO_MOVE;
+            }
+
+            const auto king_sq = board.kingSq(stm);
+            const auto rook_sq = Square(board.castlingRights().getRookFile(stm, side), king_sq.rank());
+            const auto move    = Move::make<Move::CASTLING>(king_sq, rook_sq);
+
+            return board.isLegal(move) ? move : Move::NO_MOVE;
+        }
+
+        const auto to_piece  = board.at(info.to);
+        const auto enpassant = info.piece == PieceType::PAWN && info.capture && info.to == board.enpassantSq();
+
+        // the capture sign has to match the board, like the generated captures and quiets
+        if (info.capture != (to_piece != Piece::NONE || enpassant)) {
+            return Move::NO_MOVE;
+        }
+
+        if (to_piece != Piece::NONE && to_piece.color() == stm) {
+            return Move::NO_MOVE;
+        }
+
+        Bitboard from = 0ULL;
+
+        switch (info.piece.internal()) {
+            case PieceType::PAWN: {
+                // a pawn promotes exactly when it reaches the last rank
+                if ((info.promotion != PieceType::NONE) != Square::back_rank(info.to, ~stm)) {
+                    return Move::NO_MOVE;
+                }
+
+                if (info.capture) {
+                    from = attacks::pawn(~stm, info.to);
+                    break;
+                }
+
+                // the single push origin, or the double push origin behind an empty square
+                const auto to     = Bitboard::fromSquare(info.to).getBits();
+                const auto single = stm == Color::WHITE ? to >> 8 : to << 8;
+                const auto twice  = stm == Color::WHITE ? single >> 8 : single << 8;
+                const auto start  = Bitboard(stm == Color::WHITE ? Rank::RANK_2 : Rank::RANK_7);
+
+                from = Bitboard(single);
+
+                if (!(board.occ() & Bitboard(single))) from |= Bitboard(twice) & start;
+                break;
+            }
+            case PieceType::KNIGHT:
+                from = attacks::knight(info.to);
+                break;
+            case PieceType::BISHOP:
+                from = attacks::bishop(info.to, board.occ());
+                break;
+            case PieceType::ROOK:
+                from = attacks::rook(info.to, board.occ());
+                break;
+            case PieceType::QUEEN:
+                from = attacks::queen(info.to, board.occ());
+                break;
+            case PieceType::KING:
+                from = attacks::king(info.to);
+                break;
+            default:
+                return Move::NO_MOVE;
+        }
+
+        from &= board.pieces(info.piece, stm);
+
+        if (info.from_file != File::NO_FILE) from &= Bitboard(info.from_file);
+        if (info.from_rank != Rank::NO_RANK) from &= Bitboard(info.from_rank);
+
+        Move match = Move::NO_MOVE;
+
+        while (from) {
+            const auto sq = Square(from.pop());
+
+            Move move;
+
+            if (info.promotion != PieceType::NONE) {
+                move = Move::make<Move::PROMOTION>(sq, info.to, info.promotion);
+            } else if (enpassant) {
+                move = Move::make<Move::ENPASSANT>(sq, info.to);
+            } else {
+                move = Move::make<Move::NORMAL>(sq, info.to);
+            }
+
+            if (!board.isLegal(move)) continue;
+
+            // ambiguous
+            if (match != Move::NO_MOVE) return Move::NO_MOVE;
+
+            match = move;
+        }
+
+        return match;
+    }
+
+    // writes the SAN (LAN = false) or LAN of a move without the check symbol to out,
+    // returns the end of the written characters
+    template <bool LAN = false, typename BoardT>
+    static char *moveToRep(const BoardT &board, const Move &move, char *out) {
+        if (move.typeOf() == Move::CASTLING) {
+            return writeCastling(move, out);
+        }
+
+        const PieceType pt   = board.at(move.from()).type();
+        const bool isCapture = board.at(move.to()) != Piece::NONE || move.typeOf() == Move::ENPASSANT;
+
+        assert(pt != PieceType::NONE);
+
+        if (pt != PieceType::PAWN) {
+            *out++ = pieceSymbol(pt);
+        }
+
+        if constexpr (LAN) {
+            out = writeSquare(move.from(), out);
+        } else {
+            if (pt == PieceType::PAWN) {
+                if (isCapture) *out++ = fileSymbol(move.from().file());
+            } else {
+                out = resolveAmbiguity(board, move, pt, out);
+            }
+        }
+
+        if (isCapture) {
+            *out++ = 'x';
+        }
+
+        out = writeSquare(move.to(), out);
+
+        if (move.typeOf() == Move::PROMOTION) {
+            *out++ = '=';
+            *out++ = pieceSymbol(move.promotionType());
+        }
+
+        return out;
+    }
+
+    static char *writeCastling(const Move &move, char *out) noexcept {
+        const std::string_view castling = move.to().file() > move.from().file() ? "O-O" : "O-O-O";
+        return std::copy(castling.begin(), castling.end(), out);
+    }
+
+    static char pieceSymbol(PieceType pieceType) noexcept { return "PNBRQK"[static_cast<int>(pieceType)]; }
+
+    static char fileSymbol(File file) noexcept { return static_cast<char>('a' + static_cast<int>(file)); }
+
+    static char rankSymbol(Rank rank) noexcept { return static_cast<char>('1' + static_cast<int>(rank)); }
+
+    static char *writeSquare(Square square, char *out) noexcept {
+        *out++ = fileSymbol(square.file());
+        *out++ = rankSymbol(square.rank());
+        return out;
+    }
+
+    template <typename BoardT>
+    static char *writeCheckSymbol(const BoardT &board, const Move &move, char *out) {
+        if (!board.givesCheck(move)) return out;
+
+        // only a check can be mate, the position after the move is copied without its history
+        CopyMakeBoard after(board);
+        after.makeMove(move);
+
+        return writeMateOrCheck(after, out);
+    }
+
+    // board is the position after a checking move
+    template <typename BoardT>
+    static char *writeMateOrCheck(const BoardT &board, char *out) {
+        *out++ = movegen::countLegalMoves(board) == 0 ? '#' : '+';
+        return out;
+    }
+
+    template <typename BoardT>
+    static char *resolveAmbiguity(const BoardT &board, const Move &move, PieceType pieceType, char *out) {
+        const auto to  = move.to();
+        const auto occ = board.occ();
+
+        // the other pieces of the same type which see the destination
+        Bitboard candidates = board.pieces(pieceType, board.sideToMove()) & ~Bitboard::fromSquare(move.from());
+
+        switch (pieceType.internal()) {
+            case PieceType::KNIGHT:
+                candidates &= attacks::knight(to);
+                break;
+            case PieceType::BISHOP:
+                candidates &= attacks::bishop(to, occ);
+                break;
+            case PieceType::ROOK:
+                candidates &= attacks::rook(to, occ);
+                break;
+            case PieceType::QUEEN:
+                candidates &= attacks::queen(to, occ);
+                break;
+            default:
+                return out;
+        }
+
+        // drop the pinned pieces which can't reach the destination, the legality check only runs
+        // when there is an ambiguity at all
+        Bitboard others = 0ull;
+
+        while (candidates) {
+            const auto from = candidates.pop();
+            if (board.isLegal(Move::make<Move::NORMAL>(from, to))) others.set(from);
+        }
+
+        if (!others) return out;
+
+        /*
+        First, if the moving pieces can be distinguished by their originating files, the originating
+        file letter of the moving piece is inserted immediately after the moving piece letter.
+
+        Second (when the first step fails), if the moving pieces can be distinguished by their
+        originating ranks, the originating rank digit of the moving piece is inserted immediately after
+        the moving piece letter.
+
+        Third (when both the first and the second steps fail), the two character square coordinate of
+        the originating square of the moving piece is inserted immediately after the moving piece
+        letter.
+        */
+
+        if (!(others & attacks::MASK_FILE[static_cast<int>(move.from().file())])) {
+            *out++ = fileSymbol(move.from().file());
+        } else if (!(others & attacks::MASK_RANK[static_cast<int>(move.from().rank())])) {
+            *out++ = rankSymbol(move.from().rank());
+        } else {
+            out = writeSquare(move.from(), out);
+        }
+
+        return out;
+    }
+};
+}  // namespace chess
+
+#if defined(__unix__) || defined(__unix) || defined(unix) || defined(__APPLE__) || defined(__MACH__)
+#    define CHESS_PGN_MMAP
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+/*
+ The tokenizer scans 32 (AVX2) or 16 (SSE2) bytes at a time when the target supports it,
+ define CHESS_PGN_NO_SIMD to always use the scalar loops.
+*/
+#if !defined(CHESS_PGN_NO_SIMD)
+#    if defined(__AVX2__)
+#        define CHESS_PGN_AVX2
+#        define CHESS_PGN_SSE2
+#    elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#        define CHESS_PGN_SSE2
+#    endif
+#endif
+
+/*
+ Define CHESS_PGN_ZLIB (link zlib) for pgn::GzipSource and CHESS_PGN_ZSTD (link libzstd) for pgn::ZstdSource,
+ the meson builds define them when the libraries are found.
+*/
+#if defined(CHESS_PGN_ZLIB)
+#    include <zlib.h>
+#endif
+
+#if defined(CHESS_PGN_ZSTD)
+#    include <zstd.h>
+#endif
+
+#if defined(CHESS_PGN_SSE2)
+#    include <immintrin.h>
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#    endif
+#endif
+
+namespace chess::pgn {
+
+/**
+ * @brief Chunked input of a StreamParser, the parser reads directly into its buffer through it.
+ * Derive from it to parse from other inputs, i.e. a socket or a decompressor.
+ */
+class InputSource {
+   public:
+    virtual ~InputSource() = default;
+
+    /**
+     * @brief Reads up to size bytes into buffer.
+     * @param buffer
+     * @param size
+     * @return the number of bytes read, 0 at the end of the input or on error
+     */
+    virtual std::size_t read(char *buffer, std::size_t size) = 0;
+};
+
+/**
+ * @brief Reads from a std::istream, used by StreamParser(std::istream &).
+ */
+class IstreamSource : public InputSource {
+   public:
+    explicit IstreamSource(std::istream &stream) : stream_(stream) {}
+
+    std::size_t read(char *buffer, std::size_t size) override {
+        stream_.read(buffer, static_cast<std::streamsize>(size));
+        return static_cast<std::size_t>(stream_.gcount());
+    }
+
+   private:
+    std::istream &stream_;
+};
+
+#if defined(CHESS_PGN_ZLIB)
+/**
+ * @brief Decompresses a gzip file (.pgn.gz) while it is parsed, uncompressed files are read as they are.
+ */
+class GzipSource : public InputSource {
+   public:
+    explicit GzipSource(const std::string &path) : file_(gzopen(path.c_str(), "rb")) {
+        if (file_) gzbuffer(file_, 1 << 17);
+    }
+
+    GzipSource(const GzipSource &)            = delete;
+    GzipSource &operator=(const GzipSource &) = delete;
+
+    ~GzipSource() override {
+        if (file_) gzclose(file_);
+    }
+
+    bool isOpen() const noexcept { return file_ != nullptr; }
+
+    /**
+     * @brief True if the input was corrupted or truncated, the parser saw it end early.
+     * @return
+     */
+    bool error() const noexcept { return error_; }
+
+    std::size_t read(char *buffer, std::size_t size) override {
+        if (!file_) return 0;
+
+        std::size_t total = 0;
+
+        // gzread takes an unsigned int
+        while (total < size) {
+            const auto chunk = static_cast<unsigned>(std::min<std::size_t>(size - total, 1u << 30));
+            const auto bytes = gzread(file_, buffer + total, chunk);
+
+            if (bytes <= 0) {
+                // a truncated file ends with Z_BUF_ERROR
+                int code = Z_OK;
+                gzerror(file_, &code);
+                error_ = bytes < 0 || code != Z_OK;
+                break;
+            }
+
+            total += static_cast<std::size_t>(bytes);
+        }
+
+        return total;
+    }
+
+   private:
+    gzFile file_;
+    bool error_ = false;
+};
+#endif
+
+#if defined(CHESS_PGN_ZSTD)
+/**
+ * @brief Decompresses a zstd file (.pgn.zst) while it is parsed, frames may be concatenated.
+ */
+class ZstdSource : public InputSource {
+   public:
+    explicit ZstdSource(const std::string &path)
+        : file_(std::fopen(path.c_str(), "rb")), context_(ZSTD_createDCtx()), input_(ZSTD_DStreamInSize()) {}
+
+    ZstdSource(const ZstdSource &)            = delete;
+    ZstdSource &operator=(const ZstdSource &) = delete;
+
+    ~ZstdSource() override {
+        if (file_) std::fclose(file_);
+        ZSTD_freeDCtx(context_);
+    }
+
+    bool isOpen() const noexcept { return file_ != nullptr && context_ != nullptr; }
+
+    /**
+     * @brief True if the input was corrupted or truncated, the parser saw it end early.
+     * @return
+     */
+    bool error() const noexcept { return error_; }
+
+    std::size_t read(char *buffer, std::size_t size) override {
+        if (!isOpen() || error_) return 0;
+
+        ZSTD_outBuffer out = {buffer, size, 0};
+
+        while (out.pos < out.size) {
+            if (in_.pos == in_.size) {
+                const auto bytes = std::fread(input_.data(), 1, input_.size(), file_);
+
+                if (bytes == 0) {
+                    // the last frame wasn't finished
+                    error_ = frame_left_ != 0;
+                    break;
+                }
+
+                in_ = {input_.data(), bytes, 0};
+            }
+
+            frame_left_ = ZSTD_decompressStream(context_, &out, &in_);
+
+            if (ZSTD_isError(frame_left_)) {
+                error_ = true;
+                break;
+            }
+        }
+
+        return out.pos;
+    }
+
+   private:
+    std::FILE *file_;
+    ZSTD_DCtx *context_;
+
+    std::vector<char> input_;
+    ZSTD_inBuffer in_ = {nullptr, 0, 0};
+
+    // 0 once a frame is complete
+    std::size_t frame_left_ = 0;
+    bool error_             = false;
+};
+#endif
+
+namespace detail {
+
+#if defined(CHESS_PGN_SSE2)
+inline int firstBit(std::uint32_t mask) noexcept {
+#    if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#    else
+    return __builtin_ctz(mask);
+#    endif
+}
+
+// bit i is set if first[i] is (In = true) or is not (In = false) one of Chars
+template <bool In, char... Chars>
+std::uint32_t blockMask16(const char *first) noexcept {
+    const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    auto match       = _mm_setzero_si128();
+
+    ((match = _mm_or_si128(match, _mm_cmpeq_epi8(block, _mm_set1_epi8(Chars)))), ...);
+
+    const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(match));
+
+    return In ? mask : ~mask & 0xFFFF;
+}
+#endif
+
+#if defined(CHESS_PGN_AVX2)
+template <bool In, char... Chars>
+std::uint32_t blockMask32(const char *first) noexcept {
+    const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    auto match       = _mm256_setzero_si256();
+
+    ((match = _mm256_or_si256(match, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(Chars)))), ...);
+
+    const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(match));
+
+    return In ? mask : ~mask;
+}
+#endif
+
+/**
+ * @brief Returns the first character in [first, last) which is (In = true) or is not (In = false)
+ * one of Chars, or last. With Blocks 16 or 32 bytes are compared at a time, which only pays off for long tokens.
+ * @tparam In
+ * @tparam Blocks
+ * @tparam Chars
+ */
+template <bool In, bool Blocks, char... Chars>
+const char *findFirst(const char *first, const char *last) noexcept {
+#if defined(CHESS_PGN_SSE2)
+    if constexpr (Blocks) {
+        // most comments and header values fit into the first block
+        if (last - first >= 16) {
+            if (const auto mask = blockMask16<In, Chars...>(first)) return first + firstBit(mask);
+            first += 16;
+        }
+
+#    if defined(CHESS_PGN_AVX2)
+        for (; last - first >= 32; first += 32) {
+            if (const auto mask = blockMask32<In, Chars...>(first)) return first + firstBit(mask);
+        }
+#    endif
+
+        for (; last - first >= 16; first += 16) {
+            if (const auto mask = blockMask16<In, Chars...>(first)) return first + firstBit(mask);
+        }
+    }
+#endif
+
+    for (; first != last; ++first) {
+        if (((*first == Chars) || ...) == In) break;
+    }
+
+    return first;
+}
+
+/**
+ * @brief Private class
+ * Matches the characters which are (In = true) or are not (In = false) one of Chars.
+ * @tparam In
+ * @tparam Blocks scan in blocks, for long tokens
+ * @tparam Chars
+ */
+template <bool In, bool Blocks, char... Chars>
+struct CharClass {
+    constexpr bool operator()(char c) const noexcept { return ((c == Chars) || ...) == In; }
+
+    // first matching character in [first, last), or last
+    static const char *find(const char *first, const char *last) noexcept {
+        return findFirst<In, Blocks, Chars...>(first, last);
+    }
+
+    // first character in [first, last) which doesn't match, or last
+    static const char *skip(const char *first, const char *last) noexcept {
+        return findFirst<!In, Blocks, Chars...>(first, last);
+    }
+};
+
+// short tokens, i.e. moves and whitespace
+template <char... Chars>
+using AnyOf = CharClass<true, false, Chars...>;
+
+template <char... Chars>
+using NoneOf = CharClass<false, false, Chars...>;
+
+// long tokens, i.e. comments, header values and variations
+template <char... Chars>
+using BlockAnyOf = CharClass<true, true, Chars...>;
+
+template <char... Chars>
+using BlockNoneOf = CharClass<false, true, Chars...>;
+
+/**
+ * @brief Private class
+ */
+class StringBuffer {
+   public:
+    bool empty() const noexcept { return index_ == 0; }
+
+    void clear() noexcept { index_ = 0; }
+
+    std::string_view get() const noexcept { return std::string_view(buffer_.data(), index_); }
+
+    bool add(char c) {
+        if (index_ >= N) {
+            return false;
+        }
+
+        buffer_[index_] = c;
+
+        ++index_;
+
+        return true;
+    }
+
+    bool copy(std::string_view str) {
+        if (index_ + str.size() > N) {
+            return false;
+        }
+
+        std::copy(str.begin(), str.end(), buffer_.begin() + index_);
+
+        index_ += str.size();
+
+        return true;
+    }
+
+   private:
+    // PGN String Tokens are limited to 255 characters
+    static constexpr int N = 255;
+
+    std::array<char, N> buffer_ = {};
+
+    std::size_t index_ = 0;
+};
+
+/**
+ * @brief Private class
+ * A token which is a view into the input as long as its parts are contiguous there,
+ * otherwise it is copied.
+ */
+class ViewBuffer {
+   public:
+    // PGN String Tokens are limited to 255 characters
+    explicit ViewBuffer(std::size_t max_size = 255) : max_size_(max_size) {}
+
+    bool empty() const noexcept { return view_.empty() && copy_.empty(); }
+
+    void clear() noexcept {
+        view_   = {};
+        copied_ = false;
+        copy_.clear();
+    }
+
+    std::string_view get() const noexcept { return copied_ ? std::string_view(copy_) : view_; }
+
+    bool add(char c) {
+        if (get().size() >= max_size_) {
+            return false;
+        }
+
+        toCopy();
+        copy_ += c;
+
+        return true;
+    }
+
+    bool copy(std::string_view str) {
+        if (get().size() + str.size() > max_size_) {
+            return false;
+        }
+
+        toCopy();
+        copy_.append(str);
+
+        return true;
+    }
+
+    // str has to outlive the token
+    bool append(std::string_view str) {
+        if (get().size() + str.size() > max_size_) {
+            return false;
+        }
+
+        if (!copied_) {
+            if (view_.empty()) {
+                view_ = str;
+                return true;
+            }
+
+            if (view_.data() + view_.size() == str.data()) {
+                view_ = std::string_view(view_.data(), view_.size() + str.size());
+                return true;
+            }
+
+            toCopy();
+        }
+
+        copy_.append(str);
+
+        return true;
+    }
+
+   private:
+    void toCopy() {
+        if (copied_) return;
+
+        copy_.assign(view_.data(), view_.size());
+        copied_ = true;
+    }
+
+    std::size_t max_size_;
+
+    std::string_view view_;
+
+    bool copied_ = false;
+    std::string copy_;
+};
+
+/**
+ * @brief Private class
+ * @tparam BUFFER_SIZE
+ */
+template <std::size_t BUFFER_SIZE>
+class StreamBuffer {
+   private:
+    static constexpr std::size_t N = BUFFER_SIZE;
+    using BufferType               = std::array<char, N * N>;
+
+   public:
+    // tokens are copied, the buffer is refilled while reading them
+    using Token = StringBuffer;
+
+    StreamBuffer(std::istream &stream) : istream_(stream), source_(&*istream_) {}
+
+    StreamBuffer(InputSource &source) : source_(&source) {}
+
+    // source_ may point to istream_
+    StreamBuffer(const StreamBuffer &)            = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    // Get the current character, skip carriage returns
+    std::optional<char> some() {
+        while (true) {
+            if (buffer_index_ < bytes_read_) {
+                const auto c = buffer_[buffer_index_];
+
+                if (c == '\r') {
+                    ++buffer_index_;
+                    continue;
+                }
+
+                return c;
+            }
+
+            if (!fill()) {
                 return std::nullopt;
             }
         }
     }
 
-    // Assume that the current character is already the opening_delim
-    bool skipUntil(char open_delim, char close_delim) {
-        int stack = 0;
+    bool fill() {
+        consumed_ += bytes_read_;
+        buffer_index_ = 0;
+
+        // a character which was read by peek() comes first
+        std::size_t peeked = 0;
+
+        if (peeked_) {
+            buffer_[0] = *peeked_;
+            peeked_.reset();
+            peeked = 1;
+        }
+
+        bytes_read_ = static_cast<std::streamsize>(peeked + source_->read(buffer_.data() + peeked, N * N - peeked));
+
+        return bytes_read_ > 0;
+    }
+
+    void advance() {
+        if (buffer_index_ >= bytes_read_) {
+            fill();
+        }
+
+        ++buffer_index_;
+    }
+
+    char peek() {
+        if (buffer_index_ + 1 >= bytes_read_) {
+            if (!peeked_) {
+                char c;
+                if (source_->read(&c, 1) == 0) return '\0';
+                peeked_ = c;
+            }
+
+            return *peeked_;
+        }
+
+        return buffer_[buffer_index_ + 1];
+    }
+
+    std::optional<char> current() {
+        if (buffer_index_ >= bytes_read_) {
+            return fill() ? std::optional<char>(buffer_[buffer_index_]) : std::nullopt;
+        }
+
+        return buffer_[buffer_index_];
+    }
+
+    // Skip the characters matched by the char class and carriage returns
+    template <bool In, bool Blocks, char... Chars>
+    void skipWhile(CharClass<In, Blocks, Chars...> predicate) {
+        while (auto c = some()) {
+            if (!predicate(*c)) {
+                break;
+            }
+
+            const auto first = buffer_.data() + buffer_index_;
+            buffer_index_    = predicate.skip(first, buffer_.data() + bytes_read_) - buffer_.data();
+        }
+    }
+
+    // Add characters to the token until one of Chars, the stop character is not consumed.
+    // Carriage returns are skipped. Returns false if the token is full.
+    template <typename Token, bool Blocks, char... Chars>
+    bool readUntil(Token &token, CharClass<true, Blocks, Chars...>) {
+        while (auto c = some()) {
+            if (((*c == Chars) || ...)) {
+                break;
+            }
+
+            const auto first = buffer_.data() + buffer_index_;
+            const auto last  = CharClass<true, Blocks, Chars..., '\r'>::find(first, buffer_.data() + bytes_read_);
+
+            if (!token.copy(std::string_view(first, last - first))) {
+                return false;
+            }
+
+            buffer_index_ = last - buffer_.data();
+        }
+
+        return true;
+    }
+
+    // Skip to the next line which starts with c, the current position counts as the start of a line
+    void skipToLine(char c) {
+        auto line_start = true;
+
+        while (auto curr = some()) {
+            if (line_start && *curr == c) {
+                return;
+            }
+
+            const auto first   = buffer_.data() + buffer_index_;
+            const auto newline = std::memchr(first, '\n', bytes_read_ - buffer_index_);
+
+            line_start    = newline != nullptr;
+            buffer_index_ = newline ? static_cast<const char *>(newline) - buffer_.data() + 1 : bytes_read_;
+        }
+    }
+
+    // Byte offset of the current character in the stream, relative to where reading started
+    std::uint64_t offset() const noexcept {
+        // the parser may advance once past the end of the input
+        return consumed_ + std::min(buffer_index_, bytes_read_);
+    }
+
+   private:
+    std::optional<IstreamSource> istream_;
+    InputSource *source_;
+    std::optional<char> peeked_;
+
+    BufferType buffer_;
+    std::streamsize bytes_read_   = 0;
+    std::streamsize buffer_index_ = 0;
+
+    // bytes of all previous fills
+    std::uint64_t consumed_ = 0;
+};
+
+/**
+ * @brief Private class
+ * Reads from memory which outlives the parser, tokens are views into it.
+ */
+class MemoryBuffer {
+   public:
+    using Token = ViewBuffer;
+
+    MemoryBuffer(std::string_view data) : data_(data.data()), size_(data.size()) {}
+
+    // Get the current character, skip carriage returns
+    std::optional<char> some() noexcept {
+        while (index_ < size_) {
+            const auto c = data_[index_];
+
+            if (c != '\r') {
+                return c;
+            }
+
+            ++index_;
+        }
+
+        return std::nullopt;
+    }
+
+    bool fill() const noexcept { return index_ < size_; }
+
+    void advance() noexcept { ++index_; }
+
+    char peek() const noexcept { return index_ + 1 < size_ ? data_[index_ + 1] : '\0'; }
+
+    std::optional<char> current() const noexcept {
+        return index_ < size_ ? std::optional<char>(data_[index_]) : std::nullopt;
+    }
+
+    // Same as StreamBuffer::skipWhile
+    template <bool In, bool Blocks, char... Chars>
+    void skipWhile(CharClass<In, Blocks, Chars...> predicate) {
+        while (true) {
+            index_ = predicate.skip(data_ + index_, data_ + size_) - data_;
+
+            if (index_ < size_ && data_[index_] == '\r') {
+                ++index_;
+                continue;
+            }
+
+            return;
+        }
+    }
+
+    // Same as StreamBuffer::readUntil, but the token is a view into the input
+    template <bool Blocks, char... Chars>
+    bool readUntil(ViewBuffer &token, CharClass<true, Blocks, Chars...>) {
+        while (true) {
+            const auto start = index_;
+
+            index_ = CharClass<true, Blocks, Chars..., '\r'>::find(data_ + index_, data_ + size_) - data_;
+
+            if (!token.append(std::string_view(data_ + start, index_ - start))) {
+                return false;
+            }
+
+            if (index_ < size_ && data_[index_] == '\r') {
+                ++index_;
+                continue;
+            }
+
+            return true;
+        }
+    }
+
+    std::uint64_t offset() const noexcept { return std::min(index_, size_); }
+
+    // Same as StreamBuffer::skipToLine
+    void skipToLine(char c) {
+        while (index_ < size_ && data_[index_] == '\r') ++index_;
+
+        while (index_ < size_ && data_[index_] != c) {
+            const auto newline = std::memchr(data_ + index_, '\n', size_ - index_);
+
+            index_ = newline ? static_cast<const char *>(newline) - data_ + 1 : size_;
+
+            while (index_ < size_ && data_[index_] == '\r') ++index_;
+        }
+    }
+
+   private:
+    const char *data_;
+    std::size_t size_;
+    std::size_t index_ = 0;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Visitor interface for parsing PGN files
+ */
+class Visitor {
+   public:
+    virtual ~Visitor() {};
+
+    /**
+     * @brief When true, the current PGN will be skipped and only
+     * endPgn will be called, this will also reset the skip flag to false.
+     * Has to be called after startPgn.
+     * @param skip
+     */
+    void skipPgn(bool skip) { skip_ = skip; }
+    bool skip() { return skip_; }
+
+    /**
+     * @brief When true, the moves of all following games are skipped without parsing them,
+     * by jumping to the next line which starts with '['. Only startPgn, header, startMoves and
+     * endPgn are called. Games have to be separated by a newline and a comment must not contain
+     * a line which starts with '['.
+     * @param headers_only
+     */
+    void headersOnly(bool headers_only) { headers_only_ = headers_only; }
+    bool headersOnly() const { return headers_only_; }
+
+    /**
+     * @brief When true, comments are skipped without copying them and move is called with an
+     * empty comment. A comment in a game without moves isn't passed to move("", comment) then.
+     * @param skip_comments
+     */
+    void skipComments(bool skip_comments) { skip_comments_ = skip_comments; }
+    bool skipComments() const { return skip_comments_; }
+
+    /**
+     * @brief When true, variations are parsed instead of skipped. startVariation and endVariation are
+     * called around the moves of a variation, which is an alternative to the last move passed to move().
+     * @param variations
+     */
+    void variations(bool variations) { variations_ = variations; }
+    bool variations() const { return variations_; }
+
+    /**
+     * @brief Called when a new PGN starts
+     */
+    virtual void startPgn() = 0;
+
+    /**
+     * @brief Called for each header
+     * @param key
+     * @param value
+     */
+    virtual void header(std::string_view key, std::string_view value) = 0;
+
+    /**
+     * @brief Called before the first move of a game
+     */
+    virtual void startMoves() = 0;
+
+    /**
+     * @brief Called for each move of a game
+     * @param move
+     * @param comment
+     */
+    virtual void move(std::string_view move, std::string_view comment) = 0;
+
+    /**
+     * @brief Called when a game ends
+     */
+    virtual void endPgn() = 0;
+
+    /**
+     * @brief Called before the first move of a variation, only if variations(true) was set
+     */
+    virtual void startVariation() {}
+
+    /**
+     * @brief Called after the last move of a variation, only if variations(true) was set
+     */
+    virtual void endVariation() {}
+
+    /**
+     * @brief Called after move() for every numeric annotation glyph of the move, i.e. 1 for $1
+     * @param nag
+     */
+    virtual void nag(int) {}
+
+   private:
+    bool skip_          = false;
+    bool headers_only_  = false;
+    bool skip_comments_ = false;
+    bool variations_    = false;
+};
+
+/**
+ * @brief Visitor which replays the games on a board and passes every move, decoded from SAN, together with
+ * the board after the move to replay(). A FEN header sets up the start position and a Variant header
+ * containing 960 enables Chess960. Derived classes which override startPgn or header have to call the
+ * ReplayVisitor versions. A game with a move which can't be decoded or isn't legal is skipped from there on,
+ * see invalid().
+ * @tparam BoardT
+ */
+template <typename BoardT = Board>
+class ReplayVisitor : public Visitor {
+   public:
+    /**
+     * @brief Called for each move of a game
+     * @param move the decoded move
+     * @param board the position after the move
+     * @param comment
+     */
+    virtual void replay(Move move, const BoardT &board, std::string_view comment) = 0;
+
+    void startPgn() override {
+        if (board_.chess960()) board_.set960(false);
+        board_.setFen(constants::STARTPOS);
+
+        invalid_ = false;
+    }
+
+    void header(std::string_view key, std::string_view value) override {
+        if (key == "FEN") {
+            board_.setFen(value);
+        } else if (key == "Variant" && value.find("960") != std::string_view::npos) {
+            board_.set960(true);
+        }
+    }
+
+    void startMoves() override {}
+
+    void move(std::string_view san, std::string_view comment) final {
+        const auto move = uci::tryParseSan(board_, san, moves_).valueOr(Move::NO_MOVE);
+
+        if (move == Move::NO_MOVE) {
+            invalid_ = true;
+            skipPgn(true);
+            return;
+        }
+
+        board_.makeMove(move);
+
+        replay(move, board_, comment);
+    }
+
+    void endPgn() override {}
+
+    /**
+     * @brief The board of the current game
+     * @return
+     */
+    [[nodiscard]] const BoardT &board() const noexcept { return board_; }
+
+    /**
+     * @brief True if the current game had a move which couldn't be decoded, replay() wasn't called
+     * for it and the following moves.
+     * @return
+     */
+    [[nodiscard]] bool invalid() const noexcept { return invalid_; }
+
+   private:
+    BoardT board_;
+
+    // reused by the san decoding
+    Movelist moves_;
+
+    bool invalid_ = false;
+};
+
+/**
+ * @brief Engine output found in a move comment, fields which aren't in the comment are empty.
+ * The score is from the point of view the comment was written in, cutechess and fastchess use the
+ * side which made the move, [%eval] uses white.
+ */
+struct Annotation {
+    // centipawns
+    std::optional<int> score;
+
+    // moves until mate, negative if the side is getting mated
+    std::optional<int> mate;
+
+    std::optional<int> depth;
+
+    // time spent on the move
+    std::optional<std::chrono::milliseconds> time;
+
+    // time left on the clock after the move
+    std::optional<std::chrono::milliseconds> clock;
+
+    [[nodiscard]] bool empty() const noexcept { return !score && !mate && !depth && !time && !clock; }
+};
+
+namespace detail {
+
+/**
+ * @brief Private class
+ * Reads the numbers of an annotation comment, nothing is allocated.
+ */
+class AnnotationReader {
+   public:
+    explicit AnnotationReader(std::string_view str) noexcept : pos_(str.data()), end_(str.data() + str.size()) {}
+
+    [[nodiscard]] char peek() const noexcept { return pos_ < end_ ? *pos_ : '\0'; }
+
+    bool consume(char c) noexcept {
+        if (peek() != c) return false;
+
+        ++pos_;
+        return true;
+    }
+
+    bool consume(std::string_view str) noexcept {
+        if (std::size_t(end_ - pos_) < str.size() || std::string_view(pos_, str.size()) != str) return false;
+
+        pos_ += str.size();
+        return true;
+    }
+
+    void skipSpaces() noexcept {
+        while (peek() == ' ') ++pos_;
+    }
+
+    // -1 for '-', otherwise 1, a '+' is skipped
+    int sign() noexcept {
+        if (consume('-')) return -1;
+
+        consume('+');
+        return 1;
+    }
+
+    std::optional<std::int64_t> number() noexcept {
+        if (!isDigit(peek())) return std::nullopt;
+
+        std::int64_t value = 0;
+
+        for (int digits = 0; isDigit(peek()); ++pos_) {
+            // long numbers aren't engine output, don't let them overflow
+            if (++digits <= 15) value = value * 10 + (*pos_ - '0');
+        }
+
+        return value;
+    }
+
+    /**
+     * @brief A decimal number scaled by 10^Decimals, further decimals are dropped, i.e. "0.357" is 35
+     * for Decimals = 2.
+     * @tparam Decimals
+     * @return
+     */
+    template <int Decimals>
+    std::optional<std::int64_t> decimal() noexcept {
+        auto value = number();
+
+        if (!value) return std::nullopt;
+
+        int decimals = 0;
+
+        if (consume('.')) {
+            for (; isDigit(peek()); ++pos_) {
+                if (decimals < Decimals) {
+                    *value = *value * 10 + (*pos_ - '0');
+                    decimals++;
+                }
+            }
+        }
+
+        for (; decimals < Decimals; decimals++) *value *= 10;
+
+        return value;
+    }
+
+    // [[h:]m:]s[.fraction]
+    std::optional<std::chrono::milliseconds> clock() noexcept {
+        std::int64_t seconds = 0;
+
+        for (int parts = 0; parts < 2; parts++) {
+            const auto start = pos_;
+            const auto value = number();
+
+            if (!value) return std::nullopt;
+
+            if (!consume(':')) {
+                pos_ = start;
+                break;
+            }
+
+            seconds = (seconds + *value) * 60;
+        }
+
+        const auto ms = decimal<3>();
+
+        if (!ms) return std::nullopt;
+
+        return std::chrono::milliseconds(seconds * 1000 + *ms);
+    }
+
+   private:
+    static bool isDigit(char c) noexcept { return c >= '0' && c <= '9'; }
+
+    const char *pos_;
+    const char *end_;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Decodes the engine output of a move comment without allocating. Understands the cutechess and
+ * fastchess format {+0.35/18 1.2s} or {-M5/30 0.1s} at the start of the comment and the
+ * [%eval 0.35], [%eval #-3], [%eval 0.35,18], [%clk 0:01:02.5] and [%emt 0:00:05] commands anywhere in it.
+ * @param comment
+ * @return
+ */
+inline Annotation parseAnnotation(std::string_view comment) noexcept {
+    Annotation annotation;
+
+    // score or mate, followed by the depth
+    {
+        detail::AnnotationReader reader(comment);
+        reader.skipSpaces();
+
+        const auto sign = reader.sign();
+
+        std::optional<int> score, mate;
+
+        if (reader.consume('M') || reader.consume('#')) {
+            if (const auto moves = reader.number()) mate = sign * int(*moves);
+        } else if (const auto centipawns = reader.decimal<2>()) {
+            score = sign * int(*centipawns);
+        }
+
+        const auto depth = reader.consume('/') ? reader.number() : std::nullopt;
+
+        // the depth tells it apart from a comment which just starts with a number
+        if ((score || mate) && depth) {
+            annotation.score = score;
+            annotation.mate  = mate;
+            annotation.depth = int(*depth);
+
+            reader.skipSpaces();
+
+            if (const auto time = reader.decimal<3>()) {
+                if (reader.consume("ms")) {
+                    annotation.time = std::chrono::milliseconds(*time / 1000);
+                } else if (reader.consume('s')) {
+                    annotation.time = std::chrono::milliseconds(*time);
+                }
+            }
+        }
+    }
+
+    for (auto pos = comment.find("[%"); pos != std::string_view::npos; pos = comment.find("[%", pos + 2)) {
+        detail::AnnotationReader reader(comment.substr(pos + 2));
 
-        while (true) {
-            const auto ret = some();
-            advance();
+        if (reader.consume("eval ")) {
+            reader.skipSpaces();
 
-            if (!ret.has_value()) {
-                return false;
+            if (reader.consume('#')) {
+                const auto sign = reader.sign();
+                if (const auto moves = reader.number()) annotation.mate = sign * int(*moves);
+            } else {
+                const auto sign = reader.sign();
+                if (const auto centipawns = reader.decimal<2>()) annotation.score = sign * int(*centipawns);
             }
 
-            if (*ret == open_delim) {
-                ++stack;
-            } else if (*ret == close_delim) {
-                if (stack == 0) {
-                    // Mismatched closing delimiter
-                    return false;
-                } else {
-                    --stack;
-                    if (stack == 0) {
-                        // Matching closing delimiter found
-                        return true;
-                    }
-                }
+            if (reader.consume(',')) {
+                if (const auto depth = reader.number()) annotation.depth = int(*depth);
             }
+        } else if (reader.consume("clk ")) {
+            reader.skipSpaces();
+            annotation.clock = reader.clock();
+        } else if (reader.consume("emt ")) {
+            reader.skipSpaces();
+            annotation.time = reader.clock();
         }
+    }
 
-        // If we reach this point, there are unmatched opening delimiters
-        return false;
+    return annotation;
+}
+
+/**
+ * @brief Visitor which decodes the engine output of every move comment with parseAnnotation and passes
+ * it to annotatedMove().
+ */
+class AnnotationVisitor : public Visitor {
+   public:
+    /**
+     * @brief Called for each move of a game
+     * @param move
+     * @param annotation empty if the comment has no engine output
+     * @param comment
+     */
+    virtual void annotatedMove(std::string_view move, const Annotation &annotation, std::string_view comment) = 0;
+
+    void move(std::string_view move, std::string_view comment) final {
+        annotatedMove(move, parseAnnotation(comment), comment);
     }
+};
 
-    bool fill() {
-        buffer_index_ = 0;
+/**
+ * @brief The moves of a game with all variations as a tree. The nodes are stored in one vector and
+ * refer to each other by index, comments and NAGs of all nodes share one buffer each.
+ */
+class GameTree {
+   public:
+    static constexpr std::uint32_t NONE = 0xFFFFFFFF;
 
-        stream_.read(buffer_.data(), N * N);
-        bytes_read_ = stream_.gcount();
+    struct Node {
+        // Move::NO_MOVE for the root
+        Move move = Move::NO_MOVE;
 
-        return bytes_read_ > 0;
+        std::uint32_t parent = NONE;
+
+        // the first child continues the line, the other children are its variations
+        std::uint32_t first_child  = NONE;
+        std::uint32_t next_sibling = NONE;
+
+        std::uint32_t comment_offset = 0;
+        std::uint32_t comment_size   = 0;
+
+        std::uint32_t nag_offset = 0;
+        std::uint32_t nag_count  = 0;
+    };
+
+    GameTree() { clear(); }
+
+    /**
+     * @brief Removes all nodes but the root.
+     * @param fen the start position
+     */
+    void clear(std::string_view fen = constants::STARTPOS) {
+        nodes_.assign(1, Node{});
+        comments_.clear();
+        nags_.clear();
+        fen_.assign(fen.data(), fen.size());
     }
 
-    void advance() {
-        if (buffer_index_ >= bytes_read_) {
-            fill();
-        }
+    /**
+     * @brief Appends a move to the children of parent.
+     * @param parent
+     * @param move
+     * @return the index of the new node
+     */
+    std::uint32_t add(std::uint32_t parent, Move move) {
+        const auto index = static_cast<std::uint32_t>(nodes_.size());
 
-        ++buffer_index_;
+        Node node;
+        node.move   = move;
+        node.parent = parent;
+
+        nodes_.push_back(node);
+
+        auto *slot = &nodes_[parent].first_child;
+        while (*slot != NONE) slot = &nodes_[*slot].next_sibling;
+        *slot = index;
+
+        return index;
     }
 
-    char peek() {
-        if (buffer_index_ + 1 >= bytes_read_) {
-            return stream_.peek();
-        }
+    // comments and nags have to be added to the last node, they are stored contiguously
+    void addComment(std::uint32_t node, std::string_view comment) {
+        if (comment.empty()) return;
 
-        return buffer_[buffer_index_ + 1];
+        auto &n = nodes_[node];
+
+        if (n.comment_size == 0) n.comment_offset = static_cast<std::uint32_t>(comments_.size());
+
+        comments_.append(comment);
+        n.comment_size += static_cast<std::uint32_t>(comment.size());
     }
 
-    std::optional<char> current() {
-        if (buffer_index_ >= bytes_read_) {
-            return fill() ? std::optional<char>(buffer_[buffer_index_]) : std::nullopt;
+    void addNag(std::uint32_t node, int nag) {
+        auto &n = nodes_[node];
+
+        if (n.nag_count == 0) n.nag_offset = static_cast<std::uint32_t>(nags_.size());
+
+        nags_.push_back(static_cast<std::uint8_t>(nag));
+        n.nag_count++;
+    }
+
+    [[nodiscard]] std::uint32_t root() const noexcept { return 0; }
+
+    [[nodiscard]] std::size_t size() const noexcept { return nodes_.size(); }
+
+    [[nodiscard]] const Node &operator[](std::uint32_t node) const { return nodes_[node]; }
+
+    [[nodiscard]] std::string_view comment(std::uint32_t node) const {
+        return std::string_view(comments_).substr(nodes_[node].comment_offset, nodes_[node].comment_size);
+    }
+
+    [[nodiscard]] int nag(std::uint32_t node, std::uint32_t i) const { return nags_[nodes_[node].nag_offset + i]; }
+
+    /**
+     * @brief The FEN of the position before the first move.
+     * @return
+     */
+    [[nodiscard]] const std::string &fen() const noexcept { return fen_; }
+
+    /**
+     * @brief The moves from the root along the first children.
+     * @return
+     */
+    [[nodiscard]] std::vector<Move> mainLine() const {
+        std::vector<Move> moves;
+
+        for (auto node = nodes_[0].first_child; node != NONE; node = nodes_[node].first_child) {
+            moves.push_back(nodes_[node].move);
         }
 
-        return buffer_[buffer_index_];
+        return moves;
     }
 
    private:
-    std::istream &stream_;
-    BufferType buffer_;
-    std::streamsize bytes_read_   = 0;
-    std::streamsize buffer_index_ = 0;
+    std::vector<Node> nodes_;
+    std::string comments_;
+    std::vector<std::uint8_t> nags_;
+    std::string fen_;
 };
 
-}  // namespace detail
-
 /**
- * @brief Visitor interface for parsing PGN files
+ * @brief Visitor which builds a GameTree of every game, including its variations, comments and NAGs.
+ * variations(true) is set by the constructor. Moves are decoded from SAN like ReplayVisitor does, a line
+ * with a move which can't be decoded or isn't legal is cut off there, see invalid(). Derived classes
+ * which override startPgn or header have to call the GameTreeVisitor versions, the tree of the game
+ * is complete in endPgn. The tree is reused for the next game.
+ * @tparam BoardT has to support unmakeMove
  */
-class Visitor {
+template <typename BoardT = Board>
+class GameTreeVisitor : public Visitor {
    public:
-    virtual ~Visitor() {};
+    GameTreeVisitor() { variations(true); }
 
-    /**
-     * @brief When true, the current PGN will be skipped and only
-     * endPgn will be called, this will also reset the skip flag to false.
-     * Has to be called after startPgn.
-     * @param skip
-     */
-    void skipPgn(bool skip) { skip_ = skip; }
-    bool skip() { return skip_; }
+    void startPgn() override {
+        if (board_.chess960()) board_.set960(false);
+        board_.setFen(constants::STARTPOS);
 
-    /**
-     * @brief Called when a new PGN starts
-     */
-    virtual void startPgn() = 0;
+        tree_.clear();
 
-    /**
-     * @brief Called for each header
-     * @param key
-     * @param value
-     */
-    virtual void header(std::string_view key, std::string_view value) = 0;
+        node_    = tree_.root();
+        depth_   = 0;
+        invalid_ = false;
+        cut_     = -1;
+    }
 
-    /**
-     * @brief Called before the first move of a game
-     */
-    virtual void startMoves() = 0;
+    void header(std::string_view key, std::string_view value) override {
+        if (key == "FEN") {
+            board_.setFen(value);
+            tree_.clear(value);
+        } else if (key == "Variant" && value.find("960") != std::string_view::npos) {
+            board_.set960(true);
+        }
+    }
+
+    void startMoves() override {}
+
+    void move(std::string_view san, std::string_view comment) final {
+        if (cut_ >= 0) return;
+
+        // a game without moves, but with a comment
+        if (san.empty()) {
+            tree_.addComment(node_, comment);
+            return;
+        }
+
+        const auto move = uci::tryParseSan(board_, san, moves_).valueOr(Move::NO_MOVE);
+
+        if (move == Move::NO_MOVE) {
+            invalid_ = true;
+            cut_     = depth_;
+            return;
+        }
+
+        board_.makeMove(move);
+
+        node_ = tree_.add(node_, move);
+        tree_.addComment(node_, comment);
+    }
+
+    void nag(int nag) final {
+        if (cut_ < 0 && node_ != tree_.root()) tree_.addNag(node_, nag);
+    }
+
+    void startVariation() final {
+        // the variation replaces the last move, remember where the line continues
+        const auto line = node_;
+
+        if (cut_ < 0 && node_ == tree_.root()) {
+            // nothing to be an alternative to
+            invalid_ = true;
+            cut_     = depth_ + 1;
+        } else if (cut_ < 0) {
+            board_.unmakeMove(tree_[node_].move);
+            node_ = tree_[node_].parent;
+        }
+
+        if (stack_.size() <= std::size_t(depth_)) stack_.emplace_back();
+        stack_[depth_] = {line, node_};
+
+        depth_++;
+    }
+
+    void endVariation() final {
+        if (depth_ == 0) return;
+
+        if (cut_ == depth_) cut_ = -1;
+
+        depth_--;
+
+        const auto [line, start] = stack_[depth_];
+
+        // back to where the variation started, then replay the move it was an alternative to
+        while (node_ != start) {
+            board_.unmakeMove(tree_[node_].move);
+            node_ = tree_[node_].parent;
+        }
+
+        if (line != start) board_.makeMove(tree_[line].move);
+
+        node_ = line;
+    }
+
+    void endPgn() override {}
 
     /**
-     * @brief Called for each move of a game
-     * @param move
-     * @param comment
+     * @brief The tree of the current game
+     * @return
      */
-    virtual void move(std::string_view move, std::string_view comment) = 0;
+    [[nodiscard]] const GameTree &tree() const noexcept { return tree_; }
 
     /**
-     * @brief Called when a game ends
+     * @brief True if a line of the current game had a move which couldn't be decoded, the line ends
+     * before it.
+     * @return
      */
-    virtual void endPgn() = 0;
+    [[nodiscard]] bool invalid() const noexcept { return invalid_; }
 
    private:
-    bool skip_ = false;
+    BoardT board_;
+    GameTree tree_;
+
+    std::uint32_t node_ = 0;
+
+    // for each open variation the node the line continues with and the node the variation starts from,
+    // the board is restored by unmaking the moves of the variation instead of keeping a copy
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> stack_;
+    int depth_ = 0;
+
+    // moves are ignored until the variation at this depth ends, -1 if the line is valid
+    int cut_ = -1;
+
+    bool invalid_ = false;
+
+    // reused by the san decoding
+    Movelist moves_;
 };
 
 class StreamParserError {
@@ -4023,6 +7716,8 @@ class StreamParserError {
         switch (code_) {
             case None:
                 return "No error";
+            case ExceededMaxStringLength:
+                return "Exceeded max string length";
             case InvalidHeaderMissingClosingBracket:
                 return "Invalid header: missing closing bracket";
             case InvalidHeaderMissingClosingQuote:
@@ -4046,18 +7741,95 @@ class StreamParserError {
     Code code_;
 };
 
-template <std::size_t BUFFER_SIZE =
-#if defined(__APPLE__) || defined(__MACH__)
-              256
-#elif defined(__unix__) || defined(__unix) || defined(unix)
-              1024
+/**
+ * @brief Memory maps a file for the MappedParser. On platforms without mmap the file is read into memory.
+ */
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string &path) {
+#if defined(CHESS_PGN_MMAP)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd == -1) {
+            return;
+        }
+
+        struct stat st;
+
+        if (::fstat(fd, &st) == 0) {
+            size_ = static_cast<std::size_t>(st.st_size);
+            open_ = true;
+
+            if (size_ > 0) {
+                void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (data == MAP_FAILED) {
+                    size_ = 0;
+                    open_ = false;
+                } else {
+                    data_ = static_cast<const char *>(data);
+                    ::madvise(data, size_, MADV_SEQUENTIAL);
+                }
+            }
+        }
+
+        ::close(fd);
 #else
-              256
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file.is_open()) {
+            return;
+        }
+
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        open_ = true;
 #endif
-          >
-class StreamParser {
+    }
+
+    ~MappedFile() {
+#if defined(CHESS_PGN_MMAP)
+        if (data_) ::munmap(const_cast<char *>(data_), size_);
+#endif
+    }
+
+    MappedFile(const MappedFile &)            = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const noexcept { return open_; }
+
+    std::string_view data() const noexcept { return std::string_view(data_, size_); }
+
+   private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+    bool open_        = false;
+
+#if !defined(CHESS_PGN_MMAP)
+    std::string buffer_;
+#endif
+};
+
+namespace detail {
+
+/**
+ * @brief Private class, the parsing shared by StreamParser and MappedParser
+ * @tparam Buffer
+ */
+template <typename Buffer>
+class Parser {
    public:
-    StreamParser(std::istream &stream) : stream_buffer(stream) {}
+    template <typename Input>
+    explicit Parser(Input &&input) : stream_buffer(std::forward<Input>(input)) {}
+
+    /**
+     * @brief Byte offset of the current character in the input, in Visitor::startPgn this
+     * is the opening bracket of the first header.
+     * @return
+     */
+    std::uint64_t offset() const noexcept { return stream_buffer.offset(); }
 
     StreamParserError readGames(Visitor &vis) {
         visitor = &vis;
@@ -4082,7 +7854,11 @@ class StreamParser {
                 }
 
             } else if (in_body) {
-                processBody();
+                if (visitor->headersOnly()) {
+                    skipBody();
+                } else {
+                    processBody();
+                }
 
                 if (error != StreamParserError::None) {
                     return error;
@@ -4114,11 +7890,17 @@ class StreamParser {
 
     void callVisitorMoveFunction() {
         if (!move.empty()) {
-            if (!visitor->skip()) visitor->move(move.get(), comment);
+            if (!visitor->skip()) {
+                visitor->move(move.get(), comment.get());
+
+                for (std::size_t i = 0; i < nag_count; i++) visitor->nag(nags[i]);
+            }
 
             move.clear();
             comment.clear();
         }
+
+        nag_count = 0;
     }
 
     void processHeader() {
@@ -4130,17 +7912,9 @@ class StreamParser {
                 case '[':
                     stream_buffer.advance();
 
-                    while (auto k = stream_buffer.some()) {
-                        if (is_space(*k)) {
-                            break;
-                        } else {
-                            if (!header.first.add(*k)) {
-                                error = StreamParserError::ExceededMaxStringLength;
-                                return;
-                            }
-
-                            stream_buffer.advance();
-                        }
+                    if (!stream_buffer.readUntil(header.first, is_space)) {
+                        error = StreamParserError::ExceededMaxStringLength;
+                        return;
                     }
 
                     stream_buffer.advance();
@@ -4171,14 +7945,18 @@ class StreamParser {
                             error = StreamParserError::InvalidHeaderMissingClosingQuote;
                             return;
                         } else {
-                            backslash = false;
+                            // an escaped quote or the characters up to the next special one
+                            const auto added = *k == '"' ? header.second.add(*k)
+                                                         : stream_buffer.readUntil(header.second, is_header_special);
 
-                            if (!header.second.add(*k)) {
+                            if (!added) {
                                 error = StreamParserError::ExceededMaxStringLength;
                                 return;
                             }
 
-                            stream_buffer.advance();
+                            if (*k == '"') stream_buffer.advance();
+
+                            backslash = false;
                         }
                     }
 
@@ -4208,11 +7986,41 @@ class StreamParser {
                     in_header = false;
                     in_body   = true;
 
-                    if (!visitor->skip()) visitor->startMoves();
+                    if (!visitor->skip()) visitor->startMoves();
+
+                    return;
+            }
+        }
+    }
+
+    // reads the numeric annotation glyph at the current '$', it is passed to the visitor after the move
+    void readNag() {
+        stream_buffer.advance();
+
+        int value = 0;
+
+        for (auto c = stream_buffer.current(); c && is_digit(*c); c = stream_buffer.current()) {
+            value = std::min(value * 10 + (*c - '0'), 255);
+            stream_buffer.advance();
+        }
+
+        if (nag_count < nags.size()) nags[nag_count++] = static_cast<std::uint8_t>(value);
+
+        // garbage after the number, but not the end of a variation
+        stream_buffer.skipWhile(NoneOf<' ', '\t', '\n', '\r', '(', ')', '{'>{});
+    }
 
-                    return;
-            }
+    // reads the comment at the current '{' into comment, unless the visitor skips comments
+    void readComment() {
+        stream_buffer.advance();
+
+        if (visitor->skipComments()) {
+            stream_buffer.skipWhile(is_not_comment_end);
+        } else {
+            stream_buffer.readUntil(comment, is_comment_end);
         }
+
+        stream_buffer.advance();
     }
 
     void processBody() {
@@ -4236,22 +8044,11 @@ class StreamParser {
             } else if (*c == '{') {
                 has_comment = true;
 
-                // reading comment
-                stream_buffer.advance();
-
-                while (auto k = stream_buffer.some()) {
-                    stream_buffer.advance();
-
-                    if (*k == '}') {
-                        break;
-                    }
-
-                    comment += *k;
-                }
+                readComment();
 
                 // the game has no moves, but a comment followed by a game termination
-                if (!visitor->skip()) {
-                    visitor->move("", comment);
+                if (!visitor->skip() && !visitor->skipComments()) {
+                    visitor->move("", comment.get());
 
                     comment.clear();
                 }
@@ -4271,14 +8068,7 @@ class StreamParser {
             return;
         }
 
-        while (auto c = stream_buffer.some()) {
-            if (is_space(*c)) {
-                stream_buffer.advance();
-                continue;
-            }
-
-            break;
-        }
+        stream_buffer.skipWhile(is_space);
 
         while (auto cd = stream_buffer.some()) {
             // Pgn are build up in the following way.
@@ -4295,31 +8085,13 @@ class StreamParser {
             }
 
             // skip move number digits
-            while (auto c = stream_buffer.some()) {
-                if (is_space(*c) || is_digit(*c)) {
-                    stream_buffer.advance();
-                } else {
-                    break;
-                }
-            }
+            stream_buffer.skipWhile(is_space_or_digit);
 
             // skip dots
-            while (auto c = stream_buffer.some()) {
-                if (*c == '.') {
-                    stream_buffer.advance();
-                } else {
-                    break;
-                }
-            }
+            stream_buffer.skipWhile(AnyOf<'.'>{});
 
             // skip spaces
-            while (auto c = stream_buffer.some()) {
-                if (is_space(*c)) {
-                    stream_buffer.advance();
-                } else {
-                    break;
-                }
-            }
+            stream_buffer.skipWhile(is_space);
 
             // parse move
             if (parseMove()) {
@@ -4327,13 +8099,7 @@ class StreamParser {
             }
 
             // skip spaces
-            while (auto c = stream_buffer.some()) {
-                if (is_space(*c)) {
-                    stream_buffer.advance();
-                } else {
-                    break;
-                }
-            }
+            stream_buffer.skipWhile(is_space);
 
             // game termination
             auto curr = stream_buffer.current();
@@ -4405,19 +8171,22 @@ class StreamParser {
         }
     }
 
-    bool parseMove() {
-        // reading move
-        while (auto c = stream_buffer.some()) {
-            if (is_space(*c)) {
-                break;
-            }
+    // the next game starts at the next line with a '['
+    void skipBody() {
+        stream_buffer.skipToLine('[');
 
-            if (!move.add(*c)) {
-                error = StreamParserError::ExceededMaxStringLength;
-                return true;
-            }
+        onEnd();
+        dont_advance_after_body = true;
+    }
 
-            stream_buffer.advance();
+    bool parseMove() {
+        // reading move, a variation may end right after it
+        const auto read = visitor->variations() ? stream_buffer.readUntil(move, is_move_end)
+                                                : stream_buffer.readUntil(move, is_space);
+
+        if (!read) {
+            error = StreamParserError::ExceededMaxStringLength;
+            return true;
         }
 
         return parseMoveAppendix();
@@ -4434,44 +8203,40 @@ class StreamParser {
 
             switch (*curr) {
                 case '{': {
-                    // reading comment
-                    stream_buffer.advance();
-
-                    while (auto c = stream_buffer.some()) {
+                    readComment();
+                    break;
+                }
+                case '(': {
+                    if (visitor->variations()) {
+                        callVisitorMoveFunction();
                         stream_buffer.advance();
 
-                        if (*c == '}') {
-                            break;
-                        }
-
-                        comment += *c;
+                        variation_depth++;
+                        if (!visitor->skip()) visitor->startVariation();
+                    } else {
+                        skipUntil<'(', ')'>();
                     }
 
                     break;
                 }
-                case '(': {
-                    stream_buffer.skipUntil('(', ')');
-                    break;
-                }
-                case '$': {
-                    while (auto c = stream_buffer.some()) {
-                        if (is_space(*c)) {
-                            break;
-                        }
+                case ')': {
+                    // only reached by variations(true) or an unmatched parenthesis
+                    callVisitorMoveFunction();
+                    stream_buffer.advance();
 
-                        stream_buffer.advance();
+                    if (variation_depth > 0) {
+                        variation_depth--;
+                        if (!visitor->skip()) visitor->endVariation();
                     }
 
                     break;
                 }
+                case '$': {
+                    readNag();
+                    break;
+                }
                 case ' ': {
-                    while (auto c = stream_buffer.some()) {
-                        if (!is_space(*c)) {
-                            break;
-                        }
-
-                        stream_buffer.advance();
-                    }
+                    stream_buffer.skipWhile(is_space);
 
                     break;
                 }
@@ -4482,8 +8247,49 @@ class StreamParser {
         }
     }
 
+    // Assume that the current character is already the opening_delim
+    template <char open_delim, char close_delim>
+    bool skipUntil() {
+        int stack = 0;
+
+        while (true) {
+            if (stack > 0) stream_buffer.skipWhile(BlockNoneOf<open_delim, close_delim>{});
+
+            const auto ret = stream_buffer.some();
+            stream_buffer.advance();
+
+            if (!ret.has_value()) {
+                return false;
+            }
+
+            if (*ret == open_delim) {
+                ++stack;
+            } else if (*ret == close_delim) {
+                if (stack == 0) {
+                    // Mismatched closing delimiter
+                    return false;
+                } else {
+                    --stack;
+                    if (stack == 0) {
+                        // Matching closing delimiter found
+                        return true;
+                    }
+                }
+            }
+        }
+
+        // If we reach this point, there are unmatched opening delimiters
+        return false;
+    }
+
     void onEnd() {
         callVisitorMoveFunction();
+
+        // unterminated variations
+        for (; variation_depth > 0; variation_depth--) {
+            if (!visitor->skip()) visitor->endVariation();
+        }
+
         visitor->endPgn();
         visitor->skipPgn(false);
 
@@ -4492,19 +8298,7 @@ class StreamParser {
         pgn_end = true;
     }
 
-    bool is_space(const char c) noexcept {
-        switch (c) {
-            case ' ':
-            case '\t':
-            case '\n':
-            case '\r':
-                return true;
-            default:
-                return false;
-        }
-    }
-
-    bool is_digit(const char c) noexcept {
+    static bool is_digit(const char c) noexcept {
         switch (c) {
             case '0':
             case '1':
@@ -4522,573 +8316,536 @@ class StreamParser {
         }
     }
 
-    detail::StreamBuffer<BUFFER_SIZE> stream_buffer;
-
-    Visitor *visitor = nullptr;
-
-    // one time allocations
-    std::pair<detail::StringBuffer, detail::StringBuffer> header = {detail::StringBuffer{}, detail::StringBuffer{}};
-
-    detail::StringBuffer move = {};
-    std::string comment       = {};
-
-    // State
-
-    StreamParserError error = StreamParserError::None;
-
-    bool in_header = true;
-    bool in_body   = false;
-
-    bool pgn_end = true;
-
-    bool dont_advance_after_body = false;
-};
-}  // namespace chess::pgn
+    // character classes which the buffers scan for a block at a time
+    static constexpr AnyOf<' ', '\t', '\n', '\r'> is_space{};
 
-#include <sstream>
+    static constexpr NoneOf<' ', '\t', '\n', '\r'> is_not_space{};
 
+    static constexpr AnyOf<' ', '\t', '\n', '\r', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9'> is_space_or_digit{};
 
-namespace chess {
-class uci {
-   public:
-    /**
-     * @brief Converts an internal move to a UCI string
-     * @param move
-     * @param chess960
-     * @return
-     */
-    [[nodiscard]] static std::string moveToUci(const Move &move, bool chess960 = false) noexcept(false) {
-        // Get the from and to squares
-        Square from_sq = move.from();
-        Square to_sq   = move.to();
+    static constexpr AnyOf<' ', '\t', '\n', '\r', '(', ')', '{'> is_move_end{};
 
-        // If the move is not a chess960 castling move and is a king moving more than one square,
-        // update the to square to be the correct square for a regular castling move
-        if (!chess960 && move.typeOf() == Move::CASTLING) {
-            to_sq = Square(to_sq > from_sq ? File::FILE_G : File::FILE_C, from_sq.rank());
-        }
+    static constexpr BlockAnyOf<'\\', '"', '\n'> is_header_special{};
 
-        std::stringstream ss;
+    static constexpr BlockAnyOf<'}'> is_comment_end{};
 
-        // Add the from and to squares to the string stream
-        ss << from_sq;
-        ss << to_sq;
+    static constexpr BlockNoneOf<'}'> is_not_comment_end{};
 
-        // If the move is a promotion, add the promoted piece to the string stream
-        if (move.typeOf() == Move::PROMOTION) {
-            ss << static_cast<std::string>(move.promotionType());
-        }
+    Buffer stream_buffer;
 
-        return ss.str();
-    }
+    Visitor *visitor = nullptr;
 
-    /**
-     * @brief Converts a UCI string to an internal move.
-     * @param board
-     * @param uci
-     * @return
-     */
-    [[nodiscard]] static Move uciToMove(const Board &board, const std::string &uci) noexcept(false) {
-        if (uci.length() < 4) {
-            return Move::NO_MOVE;
-        }
+    // one time allocations
+    using Token = typename Buffer::Token;
 
-        Square source = Square(uci.substr(0, 2));
-        Square target = Square(uci.substr(2, 2));
+    std::pair<Token, Token> header = {Token{}, Token{}};
 
-        if (!source.is_valid() || !target.is_valid()) {
-            return Move::NO_MOVE;
-        }
+    Token move         = Token{};
+    ViewBuffer comment = ViewBuffer{std::string::npos};
 
-        auto pt = board.at(source).type();
+    // numeric annotation glyphs of the current move
+    std::array<std::uint8_t, 8> nags = {};
+    std::size_t nag_count            = 0;
 
-        // castling in chess960
-        if (board.chess960() && pt == PieceType::KING && board.at(target).type() == PieceType::ROOK &&
-            board.at(target).color() == board.sideToMove()) {
-            return Move::make<Move::CASTLING>(source, target);
-        }
+    // State
 
-        // convert to king captures rook
-        // in chess960 the move should be sent as king captures rook already!
-        if (!board.chess960() && pt == PieceType::KING && Square::distance(target, source) == 2) {
-            target = Square(target > source ? File::FILE_H : File::FILE_A, source.rank());
-            return Move::make<Move::CASTLING>(source, target);
-        }
+    StreamParserError error = StreamParserError::None;
 
-        // en passant
-        if (pt == PieceType::PAWN && target == board.enpassantSq()) {
-            return Move::make<Move::ENPASSANT>(source, target);
-        }
+    bool in_header = true;
+    bool in_body   = false;
 
-        // promotion
-        if (pt == PieceType::PAWN && uci.length() == 5 && Square::back_rank(target, ~board.sideToMove())) {
-            auto promotion = PieceType(uci.substr(4, 1));
+    bool pgn_end = true;
 
-            if (promotion == PieceType::NONE || promotion == PieceType::KING || promotion == PieceType::PAWN) {
-                return Move::NO_MOVE;
-            }
+    bool dont_advance_after_body = false;
 
-            return Move::make<Move::PROMOTION>(source, target, PieceType(uci.substr(4, 1)));
-        }
+    int variation_depth = 0;
+};
 
-        switch (uci.length()) {
-            case 4:
-                return Move::make<Move::NORMAL>(source, target);
-            default:
-                return Move::NO_MOVE;
-        }
-    }
+}  // namespace detail
 
-    /**
-     * @brief Converts a move to a SAN string
-     * @param board
-     * @param move
-     * @return
-     */
-    [[nodiscard]] static std::string moveToSan(const Board &board, const Move &move) noexcept(false) {
-        std::string san;
-        moveToRep<false>(board, move, san);
-        return san;
-    }
+template <std::size_t BUFFER_SIZE =
+#if defined(__APPLE__) || defined(__MACH__)
+              256
+#elif defined(__unix__) || defined(__unix) || defined(unix)
+              1024
+#else
+              256
+#endif
+          >
+class StreamParser : public detail::Parser<detail::StreamBuffer<BUFFER_SIZE>> {
+   public:
+    StreamParser(std::istream &stream) : detail::Parser<detail::StreamBuffer<BUFFER_SIZE>>(stream) {}
 
     /**
-     * @brief Converts a move to a LAN string
-     * @param board
-     * @param move
-     * @return
+     * @brief Parses from a custom input, i.e. a GzipSource or ZstdSource.
+     * The source must outlive the parser.
+     * @param source
      */
-    [[nodiscard]] static std::string moveToLan(const Board &board, const Move &move) noexcept(false) {
-        std::string lan;
-        moveToRep<true>(board, move, lan);
-        return lan;
-    }
-
-    class SanParseError : public std::exception {
-       public:
-        explicit SanParseError(const char *message) : msg_(message) {}
-
-        explicit SanParseError(const std::string &message) : msg_(message) {}
+    StreamParser(InputSource &source) : detail::Parser<detail::StreamBuffer<BUFFER_SIZE>>(source) {}
+};
 
-        virtual ~SanParseError() noexcept {}
+/**
+ * @brief Parses PGNs from memory without copying them, i.e. a MappedFile.
+ * The views passed to the visitor point into the input, unless a token had to be unescaped
+ * or contained carriage returns, and stay valid as long as the input does.
+ */
+class MappedParser : public detail::Parser<detail::MemoryBuffer> {
+   public:
+    explicit MappedParser(const MappedFile &file) : detail::Parser<detail::MemoryBuffer>(file.data()) {}
 
-        virtual const char *what() const noexcept { return msg_.c_str(); }
+    MappedParser(const char *data, std::size_t size)
+        : detail::Parser<detail::MemoryBuffer>(std::string_view(data, size)) {}
+};
 
-       protected:
-        std::string msg_;
-    };
+/**
+ * @brief Parses PGNs from memory on several threads. The input is split into shards at game boundaries,
+ * a blank line followed by "[Event", every shard is parsed by a MappedParser with its own visitor.
+ * A game which doesn't start with an Event tag is parsed together with the game before it.
+ */
+class ParallelParser {
+   public:
+    struct Options {
+        // Number of worker threads for readGamesOrdered, readGames uses one thread per visitor.
+        int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
 
-    class AmbiguousMoveError : public std::exception {
-       public:
-        explicit AmbiguousMoveError(const char *message) : msg_(message) {}
+        // The input is split into threads * shards_per_thread shards which are handed out in file order,
+        // more shards balance uneven games better.
+        int shards_per_thread = 4;
+    };
 
-        explicit AmbiguousMoveError(const std::string &message) : msg_(message) {}
+    explicit ParallelParser(const MappedFile &file) : ParallelParser(file, Options{}) {}
 
-        virtual ~AmbiguousMoveError() noexcept {}
+    ParallelParser(const MappedFile &file, const Options &options) : data_(file.data()), options_(options) {}
 
-        virtual const char *what() const noexcept { return msg_.c_str(); }
+    ParallelParser(const char *data, std::size_t size) : ParallelParser(data, size, Options{}) {}
 
-       protected:
-        std::string msg_;
-    };
+    ParallelParser(const char *data, std::size_t size, const Options &options)
+        : data_(data, size), options_(options) {}
 
     /**
-     * @brief Parse a san string and return the move.
-     * This function will throw a SanParseError if the san string is invalid.
-     * @param board
-     * @param san
-     * @return
+     * @brief Parses all games with one thread per visitor. A visitor is only used by its own thread,
+     * it sees whole games in file order, but the games of one shard are not followed by the next shard.
+     * @tparam VisitorT derived from Visitor
+     * @param visitors
+     * @return the error of the first shard (in file order) which failed
      */
-    [[nodiscard]] static Move parseSan(const Board &board, std::string_view san) noexcept(false) {
-        Movelist moves;
+    template <typename VisitorT>
+    StreamParserError readGames(std::vector<VisitorT> &visitors) {
+        if (visitors.empty()) return StreamParserError::None;
 
-        return parseSan(board, san, moves);
+        const auto shards = split(data_, visitors.size() * std::max(options_.shards_per_thread, 1));
+
+        return run(shards, visitors.size(), [&](std::size_t id, std::size_t shard) {
+            return MappedParser(shards[shard].data(), shards[shard].size()).readGames(visitors[id]);
+        });
     }
 
     /**
-     * @brief Parse a san string and return the move.
-     * This function will throw a SanParseError if the san string is invalid.
-     * @param board
-     * @param san
-     * @param moves
-     * @return
+     * @brief Parses every shard with a new visitor from make_visitor() on options.threads workers and
+     * passes the finished visitors to merge() in file order. merge() is never called concurrently,
+     * but from whichever worker completed the missing shard. Finished shards wait for their
+     * predecessors, so their visitors should only hold the results which have to be merged.
+     * @tparam Factory returns a VisitorT by value, VisitorT must be movable
+     * @tparam Merge called with a VisitorT &
+     * @param make_visitor
+     * @param merge
+     * @return the error of the first shard (in file order) which failed, its visitor and all later ones
+     * are still merged
      */
-    [[nodiscard]] static Move parseSan(const Board &board, std::string_view san, Movelist &moves) noexcept(false) {
-        if (san.empty()) {
-            return Move::NO_MOVE;
-        }
-
-        static constexpr auto pt_to_pgt = [](PieceType pt) { return 1 << (pt); };
-        const SanMoveInformation info   = parseSanInfo(san);
-
-        if (info.capture) {
-            movegen::legalmoves<movegen::MoveGenType::CAPTURE>(moves, board, pt_to_pgt(info.piece));
-        } else {
-            movegen::legalmoves<movegen::MoveGenType::QUIET>(moves, board, pt_to_pgt(info.piece));
-        }
+    template <typename Factory, typename Merge>
+    StreamParserError readGamesOrdered(Factory make_visitor, Merge merge) {
+        using VisitorT = decltype(make_visitor());
 
-        if (info.castling_short || info.castling_long) {
-            for (const auto &move : moves) {
-                if (move.typeOf() == Move::CASTLING) {
-                    if ((info.castling_short && move.to() > move.from()) ||
-                        (info.castling_long && move.to() < move.from())) {
-                        return move;
-                    }
-                }
-            }
+        const auto threads = static_cast<std::size_t>(std::max(options_.threads, 1));
+        const auto shards  = split(data_, threads * std::max(options_.shards_per_thread, 1));
 
-#ifndef CHESS_NO_EXCEPTIONS
-            throw SanParseError("Failed to parse san. At step 2: " + std::string(san) + " " + board.getFen());
-#endif
-        }
+        std::vector<std::optional<VisitorT>> done(shards.size());
+        std::size_t next = 0;
+        std::mutex mutex;
 
-        Move matchingMove = Move::NO_MOVE;
-        bool foundMatch   = false;
+        return run(shards, threads, [&](std::size_t, std::size_t shard) {
+            auto visitor = make_visitor();
+            const auto error =
+                MappedParser(shards[shard].data(), shards[shard].size()).readGames(visitor);
 
-        for (const auto &move : moves) {
-            // Skip all moves that are not to the correct square
-            // or are castling moves
-            if (move.to() != info.to || move.typeOf() == Move::CASTLING) {
-                continue;
-            }
+            const std::lock_guard<std::mutex> lock(mutex);
 
-            // Handle promotion moves
-            if (info.promotion != PieceType::NONE) {
-                if (move.typeOf() != Move::PROMOTION || info.promotion != move.promotionType() ||
-                    move.from().file() != info.from_file) {
-                    continue;
-                }
-            }
-            // Handle en passant moves
-            else if (move.typeOf() == Move::ENPASSANT) {
-                if (move.from().file() != info.from_file) {
-                    continue;
-                }
-            }
-            // Handle moves with specific from square
-            else if (info.from != Square::NO_SQ) {
-                if (move.from() != info.from) {
-                    continue;
-                }
-            }
-            // Handle moves with partial from information (rank or file)
-            else if (info.from_rank != Rank::NO_RANK || info.from_file != File::NO_FILE) {
-                if ((info.from_file != File::NO_FILE && move.from().file() != info.from_file) ||
-                    (info.from_rank != Rank::NO_RANK && move.from().rank() != info.from_rank)) {
-                    continue;
-                }
-            }
+            done[shard].emplace(std::move(visitor));
 
-            // If we get here, the move matches our criteria
-            if (foundMatch) {
-#ifndef CHESS_NO_EXCEPTIONS
-                throw AmbiguousMoveError("Ambiguous san: " + std::string(san) + " in " + board.getFen());
-#endif
+            for (; next < shards.size() && done[next]; next++) {
+                merge(*done[next]);
+                done[next].reset();
             }
 
-            matchingMove = move;
-            foundMatch   = true;
-        }
-
-        if (!foundMatch) {
-#ifndef CHESS_NO_EXCEPTIONS
-            throw SanParseError("Failed to parse san. At step 3: " + std::string(san) + " " + board.getFen());
-#endif
-        }
-
-        return matchingMove;
+            return error;
+        });
     }
 
     /**
-     * @brief Check if a string is a valid UCI move. Must also have the correct length.
-     * @param move
+     * @brief Splits the input into at most n shards of about the same size, which start at game boundaries.
+     * The shards are adjacent and cover the whole input.
+     * @param data
+     * @param n
      * @return
      */
-    static bool isUciMove(const std::string &move) noexcept {
-        bool is_uci = false;
+    static std::vector<std::string_view> split(std::string_view data, std::size_t n) {
+        std::vector<std::string_view> shards;
 
-        static constexpr auto is_digit     = [](char c) { return c >= '1' && c <= '8'; };
-        static constexpr auto is_file      = [](char c) { return c >= 'a' && c <= 'h'; };
-        static constexpr auto is_promotion = [](char c) { return c == 'n' || c == 'b' || c == 'r' || c == 'q'; };
+        std::size_t start = 0;
 
-        // assert that the move is in uci format, [abcdefgh][1-8][abcdefgh][1-8][nbrq]
-        if (move.size() >= 4) {
-            is_uci = is_file(move[0]) && is_digit(move[1]) && is_file(move[2]) && is_digit(move[3]);
-        }
+        for (std::size_t i = 1; i < n && start < data.size(); i++) {
+            const auto end = nextGame(data, std::max(start + 1, data.size() / n * i));
 
-        if (move.size() == 5) {
-            is_uci = is_uci && is_promotion(move[4]);
-        }
+            if (end >= data.size()) break;
 
-        if (move.size() > 5) {
-            return false;
+            shards.push_back(data.substr(start, end - start));
+            start = end;
         }
 
-        return is_uci;
+        if (start < data.size()) shards.push_back(data.substr(start));
+
+        return shards;
     }
 
    private:
-    struct SanMoveInformation {
-        File from_file = File::NO_FILE;
-        Rank from_rank = Rank::NO_RANK;
-
-        PieceType promotion = PieceType::NONE;
+    // start of the first "[Event" after a blank line at or behind pos, or data.size()
+    static std::size_t nextGame(std::string_view data, std::size_t pos) {
+        constexpr std::string_view event = "\n[Event";
 
-        Square from = Square::NO_SQ;
-        // a valid move always has a to square
-        Square to = Square::NO_SQ;
-
-        // a valid move always has a piece
-        PieceType piece = PieceType::NONE;
-
-        bool castling_short = false;
-        bool castling_long  = false;
+        // the newline may be the one of the blank line itself
+        pos = pos > 0 ? pos - 1 : 0;
 
-        bool capture = false;
-    };
+        while ((pos = data.find(event, pos)) != std::string_view::npos) {
+            // walk back over the blank line, which may end with a carriage return
+            auto line = pos;
+            if (line > 0 && data[line - 1] == '\r') line--;
+            if (line > 0 && data[line - 1] == '\n') return pos + 1;
 
-    [[nodiscard]] static SanMoveInformation parseSanInfo(std::string_view san) noexcept(false) {
-#ifndef CHESS_NO_EXCEPTIONS
-        if (san.length() < 2) {
-            throw SanParseError("Failed to parse san. At step 0: " + std::string(san));
+            pos++;
         }
-#endif
-        constexpr auto parse_castle = [](std::string_view &san, SanMoveInformation &info, char castling_char) {
-            info.piece = PieceType::KING;
 
-            san.remove_prefix(3);
+        return data.size();
+    }
+
+    // parse(worker, shard) is called for every shard, shards are handed out in file order
+    template <typename Parse>
+    static StreamParserError run(const std::vector<std::string_view> &shards, std::size_t threads, Parse parse) {
+        if (shards.empty()) return StreamParserError::NotEnoughData;
 
-            info.castling_short = san.length() == 0 || (san.length() >= 1 && san[0] != '-');
-            info.castling_long  = san.length() >= 2 && san[0] == '-' && san[1] == castling_char;
+        std::vector<StreamParserError> errors(shards.size());
+        std::atomic<std::size_t> next_shard{0};
 
-            assert((info.castling_short && !info.castling_long) || (!info.castling_short && info.castling_long) ||
-                   (!info.castling_short && !info.castling_long));
+        const auto worker = [&](std::size_t id) {
+            for (auto shard = next_shard++; shard < shards.size(); shard = next_shard++) {
+                errors[shard] = parse(id, shard);
+            }
         };
 
-        static constexpr auto isRank = [](char c) { return c >= '1' && c <= '8'; };
-        static constexpr auto isFile = [](char c) { return c >= 'a' && c <= 'h'; };
-        static constexpr auto sw     = [](const char &c) { return std::string_view(&c, 1); };
+        std::vector<std::thread> workers;
 
-        SanMoveInformation info;
+        for (std::size_t i = 1; i < std::min(threads, shards.size()); i++) workers.emplace_back(worker, i);
 
-        // set to 1 to skip piece type offset
-        std::size_t index = 1;
+        worker(0);
 
-        if (san[0] == 'O' || san[0] == '0') {
-            parse_castle(san, info, san[0]);
-            return info;
-        } else if (isFile(san[0])) {
-            index--;
-            info.piece = PieceType::PAWN;
-        } else {
-            info.piece = PieceType(san);
+        for (auto &thread : workers) thread.join();
+
+        for (const auto &error : errors) {
+            if (error) return error;
         }
 
-        File file_to = File::NO_FILE;
-        Rank rank_to = Rank::NO_RANK;
+        return StreamParserError::None;
+    }
 
-        // check if san starts with a file, if so it will be start file
-        if (index < san.size() && isFile(san[index])) {
-            info.from_file = File(sw(san[index]));
-            index++;
-        }
+    std::string_view data_;
+    Options options_;
+};
 
-        // check if san starts with a rank, if so it will be start rank
-        if (index < san.size() && isRank(san[index])) {
-            info.from_rank = Rank(sw(san[index]));
-            index++;
-        }
+/**
+ * @brief Byte offset, length and selected header values of every game in a PGN file. The index is built in one
+ * pass, can be saved next to the PGN and lets single games or ranges be parsed without reading the games
+ * before them. Game i spans [offset(i), offset(i + 1)), including the blank lines which follow it.
+ */
+class GameIndex {
+   public:
+    /**
+     * @brief Indexes every game read from the stream. Offsets are relative to the position of the stream
+     * when build is called, which should be the start of the file.
+     * @param stream
+     * @param headers values of these header keys are stored for every game, i.e. "White" and "Result"
+     * @param headers_only skip the movetext instead of tokenizing it, see Visitor::headersOnly
+     * @return
+     */
+    StreamParserError build(std::istream &stream, const std::vector<std::string> &headers = {},
+                            bool headers_only = false) {
+        StreamParser parser(stream);
+        return index(parser, headers, headers_only);
+    }
 
-        // skip capture sign
-        if (index < san.size() && san[index] == 'x') {
-            info.capture = true;
-            index++;
-        }
+    StreamParserError build(const MappedFile &file, const std::vector<std::string> &headers = {},
+                            bool headers_only = false) {
+        MappedParser parser(file);
+        return index(parser, headers, headers_only);
+    }
 
-        // to file
-        if (index < san.size() && isFile(san[index])) {
-            file_to = File(sw(san[index]));
-            index++;
+    /**
+     * @brief Writes the index to a file, integers are stored in little endian.
+     * @param path
+     * @return false if the file couldn't be written or a header key is longer than 255 characters
+     */
+    bool save(const std::string &path) const {
+        for (const auto &key : keys_) {
+            if (key.size() > MAX_KEY) return false;
         }
 
-        // to rank
-        if (index < san.size() && isRank(san[index])) {
-            rank_to = Rank(sw(san[index]));
-            index++;
-        }
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
 
-        // promotion
-        if (index < san.size() && san[index] == '=') {
-            index++;
-            info.promotion = PieceType(sw(san[index]));
+        if (!file.is_open()) return false;
 
-#ifndef CHESS_NO_EXCEPTIONS
-            if (info.promotion == PieceType::KING || info.promotion == PieceType::PAWN ||
-                info.promotion == PieceType::NONE)
-                throw SanParseError("Failed to parse promotion, during san conversion." + std::string(san));
-#endif
+        file.write(MAGIC, sizeof(MAGIC));
+        write(file, VERSION, 4);
+        write(file, size(), 8);
+        write(file, keys_.size(), 4);
 
-            index++;
+        for (const auto &key : keys_) {
+            write(file, key.size(), 4);
+            file.write(key.data(), key.size());
         }
 
-        // for simple moves like Nf3, e4, etc. all the information is contained
-        // in the from file and rank. Thus we need to move it to the to file and rank.
-        if (file_to == File::NO_FILE && rank_to == Rank::NO_RANK) {
-            file_to = info.from_file;
-            rank_to = info.from_rank;
+        for (const auto offset : offsets_) write(file, offset, 8);
 
-            info.from_file = File::NO_FILE;
-            info.from_rank = Rank::NO_RANK;
-        }
+        for (std::size_t i = 0; i + 1 < values_.size(); i++) write(file, values_[i + 1] - values_[i], 2);
 
-        // pawns which are not capturing stay on the same file
-        if (info.piece == PieceType::PAWN && info.from_file == File::NO_FILE && !info.capture) {
-            info.from_file = file_to;
-        }
+        file.write(strings_.data(), strings_.size());
 
-        info.to = Square(file_to, rank_to);
+        return bool(file);
+    }
 
-        if (info.from_file != File::NO_FILE && info.from_rank != Rank::NO_RANK) {
-            info.from = Square(info.from_file, info.from_rank);
-        }
+    /**
+     * @brief Reads an index written by save(), the current index is replaced.
+     * @param path
+     * @return false if the file couldn't be read or isn't an index, the index is empty then
+     */
+    bool load(const std::string &path) {
+        clear();
 
-        return info;
-    }
+        std::ifstream file(path, std::ios::binary);
 
-    template <bool LAN = false>
-    static void moveToRep(Board board, const Move &move, std::string &str) {
-        if (handleCastling(move, str)) {
-            board.makeMove(move);
-            if (board.inCheck()) appendCheckSymbol(board, str);
-            return;
-        }
+        if (!file.is_open()) return false;
 
-        const PieceType pt   = board.at(move.from()).type();
-        const bool isCapture = board.at(move.to()) != Piece::NONE || move.typeOf() == Move::ENPASSANT;
+        char magic[sizeof(MAGIC)];
+        std::uint64_t version = 0, games = 0, keys = 0;
 
-        assert(pt != PieceType::NONE);
+        if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+        if (!read(file, version, 4) || version != VERSION) return false;
+        if (!read(file, games, 8) || !read(file, keys, 4)) return false;
 
-        if (pt != PieceType::PAWN) {
-            appendPieceSymbol(pt, str);
+        for (std::uint64_t i = 0; i < keys; i++) {
+            std::uint64_t length = 0;
+            // checked before allocating, a corrupt length could ask for gigabytes
+            if (!read(file, length, 4) || length > MAX_KEY) return fail();
+
+            std::string key(length, '\0');
+            if (!file.read(key.data(), length)) return fail();
+
+            keys_.push_back(std::move(key));
         }
 
-        if constexpr (LAN) {
-            appendSquare(move.from(), str);
-        } else {
-            if (pt == PieceType::PAWN) {
-                str += isCapture ? static_cast<std::string>(move.from().file()) : "";
-            } else {
-                resolveAmbiguity(board, move, pt, str);
-            }
+        // don't trust the counts for the allocations, a truncated file just fails on the first missing read
+        for (std::uint64_t i = 0; i < games + 1; i++) {
+            std::uint64_t offset = 0;
+            if (!read(file, offset, 8)) return fail();
+            offsets_.push_back(offset);
         }
 
-        if (isCapture) {
-            str += 'x';
+        for (std::uint64_t i = 0; i < games * keys; i++) {
+            std::uint64_t length = 0;
+            if (!read(file, length, 2)) return fail();
+            values_.push_back(values_.back() + length);
         }
 
-        appendSquare(move.to(), str);
+        strings_.resize(values_.back());
 
-        if (move.typeOf() == Move::PROMOTION) appendPromotion(move, str);
+        if (!file.read(strings_.data(), strings_.size())) return fail();
 
-        board.makeMove(move);
+        return true;
+    }
 
-        if (board.inCheck()) appendCheckSymbol(board, str);
+    void clear() noexcept {
+        keys_.clear();
+        offsets_.clear();
+        values_.assign(1, 0);
+        strings_.clear();
     }
 
-    static bool handleCastling(const Move &move, std::string &str) {
-        if (move.typeOf() != Move::CASTLING) return false;
+    /**
+     * @brief Number of indexed games.
+     * @return
+     */
+    [[nodiscard]] std::size_t size() const noexcept { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
 
-        str = (move.to().file() > move.from().file()) ? "O-O" : "O-O-O";
-        return true;
-    }
+    /**
+     * @brief Byte offset of the first header of a game.
+     * @param game
+     * @return
+     */
+    [[nodiscard]] std::uint64_t offset(std::size_t game) const { return offsets_[game]; }
 
-    static void appendPieceSymbol(PieceType pieceType, std::string &str) {
-        str += std::toupper(static_cast<std::string>(pieceType)[0]);
-    }
+    [[nodiscard]] std::uint64_t length(std::size_t game) const { return offsets_[game + 1] - offsets_[game]; }
 
-    static void appendSquare(Square square, std::string &str) {
-        str += static_cast<std::string>(square.file());
-        str += static_cast<std::string>(square.rank());
-    }
+    /**
+     * @brief The header keys whose values are stored.
+     * @return
+     */
+    [[nodiscard]] const std::vector<std::string> &keys() const noexcept { return keys_; }
+
+    /**
+     * @brief Value of a stored header, the view points into the index.
+     * @param game
+     * @param key
+     * @return an empty view if the game has no such header or the key wasn't selected when building the index
+     */
+    [[nodiscard]] std::string_view header(std::size_t game, std::string_view key) const {
+        const auto it = std::find(keys_.begin(), keys_.end(), key);
 
-    static void appendPromotion(const Move &move, std::string &str) {
-        str += '=';
-        str += std::toupper(static_cast<std::string>(move.promotionType())[0]);
+        if (it == keys_.end()) return {};
+
+        const auto i = game * keys_.size() + std::distance(keys_.begin(), it);
+
+        return std::string_view(strings_).substr(values_[i], values_[i + 1] - values_[i]);
     }
 
-    static void appendCheckSymbol(Board &board, std::string &str) {
-        const auto gameState = board.isGameOver().second;
-        str += (gameState == GameResult::LOSE) ? '#' : '+';
+    /**
+     * @brief Parses count games starting at first from the file the index was built from.
+     * Only these games are read, count is clamped to the number of games left.
+     * @param stream
+     * @param vis
+     * @param first
+     * @param count
+     * @return
+     */
+    StreamParserError readGames(std::istream &stream, Visitor &vis, std::size_t first, std::size_t count = 1) const {
+        if (first >= size()) return StreamParserError::NotEnoughData;
+
+        const auto last = std::min(size(), first + std::min(count, size() - first));
+
+        std::string games(offsets_[last] - offsets_[first], '\0');
+
+        stream.clear();
+        stream.seekg(static_cast<std::streamoff>(offsets_[first]));
+        stream.read(games.data(), static_cast<std::streamsize>(games.size()));
+        games.resize(static_cast<std::size_t>(stream.gcount()));
+
+        return MappedParser(games.data(), games.size()).readGames(vis);
     }
 
-    static void resolveAmbiguity(const Board &board, const Move &move, PieceType pieceType, std::string &str) {
-        Movelist moves;
-        movegen::legalmoves(moves, board, 1 << pieceType);
+    StreamParserError readGames(const MappedFile &file, Visitor &vis, std::size_t first,
+                                std::size_t count = 1) const {
+        if (first >= size() || offsets_[first] >= file.data().size()) return StreamParserError::NotEnoughData;
 
-        bool needFile         = false;
-        bool needRank         = false;
-        bool hasAmbiguousMove = false;
+        const auto last = std::min(size(), first + std::min(count, size() - first));
 
-        for (const auto &m : moves) {
-            if (m != move && m.to() == move.to()) {
-                hasAmbiguousMove = true;
+        const auto games = file.data().substr(offsets_[first], offsets_[last] - offsets_[first]);
 
-                /*
-                First, if the moving pieces can be distinguished by their originating files, the originating
-                file letter of the moving piece is inserted immediately after the moving piece letter.
+        return MappedParser(games.data(), games.size()).readGames(vis);
+    }
 
-                Second (when the first step fails), if the moving pieces can be distinguished by their
-                originating ranks, the originating rank digit of the moving piece is inserted immediately after
-                the moving piece letter.
+   private:
+    static constexpr char MAGIC[4]         = {'P', 'G', 'N', 'I'};
+    static constexpr std::uint64_t VERSION = 1;
+
+    // header keys are short, an index with longer ones is rejected
+    static constexpr std::size_t MAX_KEY = 0xFF;
+    // longer header values are truncated to fit their 16 bit length
+    static constexpr std::size_t MAX_VALUE = 0xFFFF;
+
+    template <typename ParserT>
+    StreamParserError index(ParserT &parser, const std::vector<std::string> &headers, bool headers_only) {
+        class Builder : public Visitor {
+           public:
+            Builder(GameIndex &index, const ParserT &parser) : index_(index), parser_(parser) {
+                values_.resize(index.keys_.size());
+            }
 
-                Third (when both the first and the second steps fail), the two character square coordinate of
-                the originating square of the moving piece is inserted immediately after the moving piece
-                letter.
-                */
+            void startPgn() override {
+                index_.offsets_.push_back(parser_.offset());
+                for (auto &value : values_) value.clear();
+            }
 
-                if (isIdentifiableByType(moves, move, move.from().file())) {
-                    needFile = true;
-                    break;
-                }
+            void header(std::string_view key, std::string_view value) override {
+                const auto it = std::find(index_.keys_.begin(), index_.keys_.end(), key);
+                if (it != index_.keys_.end()) values_[std::distance(index_.keys_.begin(), it)] = value;
+            }
 
-                if (isIdentifiableByType(moves, move, move.from().rank())) {
-                    needRank = true;
-                    break;
+            void startMoves() override { skipPgn(true); }
+
+            void move(std::string_view, std::string_view) override {}
+
+            void endPgn() override {
+                for (const auto &value : values_) {
+                    const auto length = std::min(value.size(), MAX_VALUE);
+
+                    index_.strings_.append(value, 0, length);
+                    index_.values_.push_back(index_.values_.back() + length);
                 }
             }
-        }
 
-        if (needFile) str += static_cast<std::string>(move.from().file());
-        if (needRank) str += static_cast<std::string>(move.from().rank());
+           private:
+            GameIndex &index_;
+            const ParserT &parser_;
 
-        // we weren't able to disambiguate the move by either file or rank, so we need to use both
-        if (hasAmbiguousMove && !needFile && !needRank) {
-            appendSquare(move.from(), str);
-        }
+            std::vector<std::string> values_;
+        };
+
+        clear();
+        keys_ = headers;
+
+        Builder builder(*this, parser);
+        builder.headersOnly(headers_only);
+
+        const auto error = parser.readGames(builder);
+
+        if (offsets_.empty()) return error;
+
+        // a game cut short by an error has no endPgn
+        while (values_.size() < offsets_.size() * keys_.size() + 1) values_.push_back(values_.back());
+
+        offsets_.push_back(parser.offset());
+
+        return error;
     }
 
-    template <typename CoordinateType>
-    static bool isIdentifiableByType(const Movelist &moves, const Move move, CoordinateType type) {
-        static_assert(std::is_same_v<CoordinateType, File> || std::is_same_v<CoordinateType, Rank>,
-                      "CoordinateType must be either File or Rank");
+    bool fail() {
+        clear();
+        return false;
+    }
 
-        for (const auto &m : moves) {
-            if (m == move || m.to() != move.to()) {
-                continue;
-            }
+    static void write(std::ostream &stream, std::uint64_t value, int bytes) {
+        char buffer[8];
+        for (int i = 0; i < bytes; i++) buffer[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        stream.write(buffer, bytes);
+    }
 
-            // file
-            if constexpr (std::is_same_v<CoordinateType, File>) {
-                if (type == m.from().file()) return false;
-            }
-            // rank
-            else {
-                if (type == m.from().rank()) return false;
-            }
-        }
+    static bool read(std::istream &stream, std::uint64_t &value, int bytes) {
+        unsigned char buffer[8];
+        if (!stream.read(reinterpret_cast<char *>(buffer), bytes)) return false;
+
+        value = 0;
+        for (int i = 0; i < bytes; i++) value |= std::uint64_t(buffer[i]) << (8 * i);
 
         return true;
     }
+
+    std::vector<std::string> keys_;
+
+    // game i starts at offsets_[i], the last entry is the end of the input
+    std::vector<std::uint64_t> offsets_;
+
+    // value of key k in game i is strings_[values_[i * keys + k], values_[i * keys + k + 1])
+    std::vector<std::uint64_t> values_ = {0};
+    std::string strings_;
 };
-}  // namespace chess
+}  // namespace chess::pgn
 
 #endif
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <functional>
 #include <utility>
 
 #include "attacks_fwd.hpp"
@@ -58,12 +57,43 @@ template <Color::underlying c>
 
 [[nodiscard]] inline Bitboard attacks::knight(Square sq) noexcept { return KnightAttacks[sq.index()]; }
 
+template <int shift>
+[[nodiscard]] inline constexpr attacks::U64 attacks::koggeStone(U64 gen, U64 empty, U64 not_wrap) noexcept {
+    constexpr auto step = [](U64 b, int s) { return s > 0 ? b << s : b >> -s; };
+
+    empty &= not_wrap;
+
+    gen |= empty & step(gen, shift);
+    empty &= step(empty, shift);
+    gen |= empty & step(gen, 2 * shift);
+    empty &= step(empty, 2 * shift);
+    gen |= empty & step(gen, 4 * shift);
+
+    return step(gen, shift) & not_wrap;
+}
+
 [[nodiscard]] inline Bitboard attacks::bishop(Square sq, Bitboard occupied) noexcept {
-    return BishopTable[sq.index()].attacks[BishopTable[sq.index()](occupied)];
+#if defined(CHESS_USE_KOGGE_STONE)
+    const U64 bb    = 1ULL << sq.index();
+    const U64 empty = ~occupied.getBits();
+
+    return koggeStone<9>(bb, empty, ~MASK_FILE[0].getBits()) | koggeStone<7>(bb, empty, ~MASK_FILE[7].getBits()) |
+           koggeStone<-7>(bb, empty, ~MASK_FILE[0].getBits()) | koggeStone<-9>(bb, empty, ~MASK_FILE[7].getBits());
+#else
+    return BishopTable(sq, occupied);
+#endif
 }
 
 [[nodiscard]] inline Bitboard attacks::rook(Square sq, Bitboard occupied) noexcept {
-    return RookTable[sq.index()].attacks[RookTable[sq.index()](occupied)];
+#if defined(CHESS_USE_KOGGE_STONE)
+    const U64 bb    = 1ULL << sq.index();
+    const U64 empty = ~occupied.getBits();
+
+    return koggeStone<8>(bb, empty, ~0ULL) | koggeStone<-8>(bb, empty, ~0ULL) |
+           koggeStone<1>(bb, empty, ~MASK_FILE[0].getBits()) | koggeStone<-1>(bb, empty, ~MASK_FILE[7].getBits());
+#else
+    return RookTable(sq, occupied);
+#endif
 }
 
 [[nodiscard]] inline Bitboard attacks::queen(Square sq, Bitboard occupied) noexcept {
@@ -72,7 +102,8 @@ template <Color::underlying c>
 
 [[nodiscard]] inline Bitboard attacks::king(Square sq) noexcept { return KingAttacks[sq.index()]; }
 
-[[nodiscard]] inline Bitboard attacks::attackers(const Board &board, Color color, Square square) noexcept {
+template <typename BoardT>
+[[nodiscard]] inline Bitboard attacks::attackers(const BoardT &board, Color color, Square square) noexcept {
     const auto queens   = board.pieces(PieceType::QUEEN, color);
     const auto occupied = board.occ();
 
@@ -86,108 +117,10 @@ template <Color::underlying c>
     return atks & occupied;
 }
 
-[[nodiscard]] inline Bitboard attacks::bishopAttacks(Square sq, Bitboard occupied) {
-    Bitboard attacks = 0ULL;
-
-    int r, f;
-
-    int br = sq.rank();
-    int bf = sq.file();
-
-    for (r = br + 1, f = bf + 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(f)); r++, f++) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (r = br - 1, f = bf + 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(f)); r--, f++) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (r = br + 1, f = bf - 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(f)); r++, f--) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (r = br - 1, f = bf - 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(f)); r--, f--) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    return attacks;
-}
-
-[[nodiscard]] inline Bitboard attacks::rookAttacks(Square sq, Bitboard occupied) {
-    Bitboard attacks = 0ULL;
-
-    int r, f;
-
-    int rr = sq.rank();
-    int rf = sq.file();
-
-    for (r = rr + 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(rf)); r++) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(rf)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (r = rr - 1; Square::is_valid(static_cast<Rank>(r), static_cast<File>(rf)); r--) {
-        auto s = Square(static_cast<Rank>(r), static_cast<File>(rf)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (f = rf + 1; Square::is_valid(static_cast<Rank>(rr), static_cast<File>(f)); f++) {
-        auto s = Square(static_cast<Rank>(rr), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    for (f = rf - 1; Square::is_valid(static_cast<Rank>(rr), static_cast<File>(f)); f--) {
-        auto s = Square(static_cast<Rank>(rr), static_cast<File>(f)).index();
-        attacks.set(s);
-        if (occupied.check(s)) break;
-    }
-
-    return attacks;
-}
-
-inline void attacks::initSliders(Square sq, Magic table[], U64 magic,
-                                 const std::function<Bitboard(Square, Bitboard)> &attacks) {
-    // The edges of the board are not considered for the attacks
-    // i.e. for the sq h7 edges will be a1-h1, a1-a8, a8-h8, ignoring the edge of the current square
-    const Bitboard edges = ((Bitboard(Rank::RANK_1) | Bitboard(Rank::RANK_8)) & ~Bitboard(sq.rank())) |
-                           ((Bitboard(File::FILE_A) | Bitboard(File::FILE_H)) & ~Bitboard(sq.file()));
-
-    U64 occ = 0ULL;
-
-    auto &table_sq = table[sq.index()];
-
-    table_sq.magic = magic;
-    table_sq.mask  = (attacks(sq, occ) & ~edges).getBits();
-    table_sq.shift = 64 - Bitboard(table_sq.mask).count();
-
-    if (sq < 64 - 1) {
-        table[sq.index() + 1].attacks = table_sq.attacks + (1ull << Bitboard(table_sq.mask).count());
-    }
-
-    do {
-        table_sq.attacks[table_sq(occ)] = attacks(sq, occ);
-        occ                             = (occ - table_sq.mask) & table_sq.mask;
-    } while (occ);
-}
-
 inline void attacks::initAttacks() {
-    BishopTable[0].attacks = BishopAttacks;
-    RookTable[0].attacks   = RookAttacks;
-
-    for (int i = 0; i < 64; i++) {
-        initSliders(static_cast<Square>(i), BishopTable, BishopMagics[i], bishopAttacks);
-        initSliders(static_cast<Square>(i), RookTable, RookMagics[i], rookAttacks);
-    }
+#if !defined(CHESS_USE_KOGGE_STONE) && !defined(CHESS_CONSTEXPR_SLIDERS)
+    detail::initSliderTable<false>(BishopTable, BishopMagics);
+    detail::initSliderTable<true>(RookTable, RookMagics);
+#endif
 }
 }  // namespace chess
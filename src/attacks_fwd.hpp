@@ -1,34 +1,196 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 
+/*
+ The slider attacks are looked up with fancy magic bitboards by default.
+ Define one of these to select another backend at compile time:
+ CHESS_USE_PEXT          index the same tables with the BMI2 pext instruction, needs -mbmi2 or -march=native
+ CHESS_USE_KOGGE_STONE   branchless kogge-stone fills, no tables and no initialization
+
+ The tables are filled at startup, define CHESS_CONSTEXPR_SLIDERS to generate them at compile time instead.
+ This removes the startup initialization but costs a few seconds of compile time in every translation unit
+ which includes the library, clang may additionally need a higher -fconstexpr-steps.
+*/
+#if defined(CHESS_USE_PEXT) && defined(CHESS_USE_KOGGE_STONE)
+#    error "CHESS_USE_PEXT and CHESS_USE_KOGGE_STONE are mutually exclusive"
+#endif
+
+#if defined(CHESS_CONSTEXPR_SLIDERS)
+#    if defined(CHESS_USE_KOGGE_STONE)
+#        error "CHESS_CONSTEXPR_SLIDERS has no effect with CHESS_USE_KOGGE_STONE, which uses no tables"
+#    endif
+#    if defined(_MSC_VER)
+#        error "CHESS_CONSTEXPR_SLIDERS is not supported on MSVC"
+#    endif
+#endif
+
+#if defined(CHESS_USE_PEXT)
+#    if !defined(__BMI2__) && !defined(_MSC_VER)
+#        error "CHESS_USE_PEXT requires BMI2, compile with -mbmi2 or -march=native"
+#    endif
+#    include <immintrin.h>
+#endif
+
 #include "bitboard.hpp"
 #include "board_fwd.hpp"
 #include "color.hpp"
 #include "coords.hpp"
 
 namespace chess {
-class attacks {
-    using U64 = std::uint64_t;
-    struct Magic {
-        U64 mask;
-        U64 magic;
-        Bitboard *attacks;
-        U64 shift;
+namespace detail {
+struct SliderMagic {
+    std::uint64_t mask;
+    std::uint64_t magic;
+    std::uint64_t shift;
+    // index of the first attack of this square in SliderTable::attacks
+    std::uint32_t offset;
 
-        U64 operator()(Bitboard b) const { return (((b & mask)).getBits() * magic) >> shift; }
-    };
+    [[nodiscard]] std::uint64_t operator()(Bitboard b) const noexcept {
+#if defined(CHESS_USE_PEXT)
+        return _pext_u64(b.getBits(), mask);
+#else
+        return (((b & mask)).getBits() * magic) >> shift;
+#endif
+    }
+};
+
+template <std::size_t N>
+struct SliderTable {
+    SliderMagic magics[64];
+    std::uint64_t attacks[N];
+
+    [[nodiscard]] Bitboard operator()(Square sq, Bitboard occupied) const noexcept {
+        const auto &magic = magics[sq.index()];
+        return attacks[magic.offset + magic(occupied)];
+    }
+};
+
+// The rays from every square to the edge of the board.
+// Rook directions first: north, east, south, west, then north east, north west, south west, south east.
+struct SliderRays {
+    std::uint64_t rays[8][64];
+};
+
+[[nodiscard]] constexpr SliderRays sliderRays() noexcept {
+    constexpr int steps[8][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+
+    SliderRays rays{};
+
+    for (int d = 0; d < 8; d++) {
+        for (int sq = 0; sq < 64; sq++) {
+            int r = sq / 8 + steps[d][0];
+            int f = sq % 8 + steps[d][1];
+
+            for (; r >= 0 && r < 8 && f >= 0 && f < 8; r += steps[d][0], f += steps[d][1]) {
+                rays.rays[d][sq] |= 1ULL << (r * 8 + f);
+            }
+        }
+    }
 
-    // Slow function to calculate bishop attacks
-    [[nodiscard]] static Bitboard bishopAttacks(Square sq, Bitboard occupied);
+    return rays;
+}
 
-    // Slow function to calculate rook attacks
-    [[nodiscard]] static Bitboard rookAttacks(Square sq, Bitboard occupied);
+inline constexpr SliderRays SLIDER_RAYS = sliderRays();
 
-    // Initializes the magic bitboard tables for sliding pieces
-    static void initSliders(Square sq, Magic table[], U64 magic,
-                            const std::function<Bitboard(Square, Bitboard)> &attacks);
+// Attacks along one ray, the first blocker is included.
+template <int direction>
+[[nodiscard]]
+#if !defined(_MSC_VER)
+constexpr
+#endif
+    std::uint64_t rayAttacks(int sq, std::uint64_t occupied) noexcept {
+    // north, east, north east and north west point towards higher squares
+    constexpr bool up = direction == 0 || direction == 1 || direction == 4 || direction == 5;
+
+    const auto ray      = SLIDER_RAYS.rays[direction][sq];
+    const auto blockers = ray & occupied;
+
+    if (!blockers) return ray;
+
+#if defined(_MSC_VER)
+    const int blocker = up ? Bitboard(blockers).lsb() : Bitboard(blockers).msb();
+#else
+    // cheaper to evaluate than Bitboard::lsb(), keeps CHESS_CONSTEXPR_SLIDERS well within the constexpr limits
+    const int blocker = up ? __builtin_ctzll(blockers) : 63 ^ __builtin_clzll(blockers);
+#endif
+
+    return ray ^ SLIDER_RAYS.rays[direction][blocker];
+}
+
+// Attacks of a rook or bishop, the first blocker on every ray is included.
+template <bool rook>
+[[nodiscard]]
+#if !defined(_MSC_VER)
+constexpr
+#endif
+    std::uint64_t sliderAttacks(int sq, std::uint64_t occupied) noexcept {
+    if constexpr (rook) {
+        return rayAttacks<0>(sq, occupied) | rayAttacks<1>(sq, occupied) | rayAttacks<2>(sq, occupied) |
+               rayAttacks<3>(sq, occupied);
+    } else {
+        return rayAttacks<4>(sq, occupied) | rayAttacks<5>(sq, occupied) | rayAttacks<6>(sq, occupied) |
+               rayAttacks<7>(sq, occupied);
+    }
+}
+
+// Fills the magics and attacks of a rook or bishop table, at startup or at compile time.
+template <bool rook, std::size_t N>
+#if !defined(_MSC_VER)
+constexpr
+#endif
+    void initSliderTable(SliderTable<N> &table, const std::uint64_t (&magics)[64]) noexcept {
+    std::uint32_t offset = 0;
+
+    for (int sq = 0; sq < 64; sq++) {
+        // The edges of the board are not considered for the attacks
+        // i.e. for the sq h7 edges will be a1-h1, a1-a8, a8-h8, ignoring the edge of the current square
+        const std::uint64_t rank  = 0xffULL << (sq & 56);
+        const std::uint64_t file  = 0x0101010101010101ULL << (sq & 7);
+        const std::uint64_t edges = (0xff000000000000ffULL & ~rank) | (0x8181818181818181ULL & ~file);
+
+        auto &magic = table.magics[sq];
+
+        magic.mask   = sliderAttacks<rook>(sq, 0ULL) & ~edges;
+        magic.magic  = magics[sq];
+        magic.shift  = 64 - Bitboard(magic.mask).count();
+        magic.offset = offset;
+
+        // enumerates all subsets of the mask in ascending order, which is also the order of their pext index
+        std::uint64_t occ = 0ULL;
+        [[maybe_unused]] std::uint64_t subset = 0;
+
+        do {
+#if defined(CHESS_USE_PEXT)
+            const auto index = subset++;
+#else
+            const auto index = (occ * magic.magic) >> magic.shift;
+#endif
+            table.attacks[offset + index] = sliderAttacks<rook>(sq, occ);
+            occ                           = (occ - magic.mask) & magic.mask;
+        } while (occ);
+
+        offset += 1U << (64 - magic.shift);
+    }
+}
+
+template <bool rook, std::size_t N>
+[[nodiscard]] constexpr SliderTable<N> sliderTable(const std::uint64_t (&magics)[64]) noexcept {
+    SliderTable<N> table{};
+    initSliderTable<rook>(table, magics);
+    return table;
+}
+}  // namespace detail
+
+class attacks {
+    using U64 = std::uint64_t;
+
+    // Fills from gen in the direction of shift until a blocker is hit, the blocker is included.
+    // not_wrap are the squares which can be reached with a single step, i.e. no file A for an eastward shift.
+    template <int shift>
+    [[nodiscard]] static constexpr U64 koggeStone(U64 gen, U64 empty, U64 not_wrap) noexcept;
 
     // clang-format off
     // pre-calculated lookup table for pawn attacks
@@ -141,11 +303,13 @@ class attacks {
         0xa010109502200ULL,    0x4a02012000ULL,       0x500201010098b028ULL, 0x8040002811040900ULL,
         0x28000010020204ULL,   0x6000020202d0240ULL,  0x8918844842082200ULL, 0x4010011029020020ULL};
 
-    static inline Bitboard RookAttacks[0x19000]  = {};
-    static inline Bitboard BishopAttacks[0x1480] = {};
-
-    static inline Magic RookTable[64]   = {};
-    static inline Magic BishopTable[64] = {};
+#if defined(CHESS_CONSTEXPR_SLIDERS)
+    static constexpr detail::SliderTable<0x19000> RookTable = detail::sliderTable<true, 0x19000>(RookMagics);
+    static constexpr detail::SliderTable<0x1480> BishopTable = detail::sliderTable<false, 0x1480>(BishopMagics);
+#elif !defined(CHESS_USE_KOGGE_STONE)
+    static inline detail::SliderTable<0x19000> RookTable = {};
+    static inline detail::SliderTable<0x1480> BishopTable = {};
+#endif
 
    public:
     static constexpr Bitboard MASK_RANK[8] = {0xff,         0xff00,         0xff0000,         0xff000000,
@@ -236,10 +400,12 @@ class attacks {
      * @param square
      * @return
      */
-    [[nodiscard]] static Bitboard attackers(const Board &board, Color color, Square square) noexcept;
+    template <typename BoardT>
+    [[nodiscard]] static Bitboard attackers(const BoardT &board, Color color, Square square) noexcept;
 
     /**
-     * @brief [Internal Usage] Initializes the attacks for the bishop and rook. Called once at startup.
+     * @brief [Internal Usage] Initializes the attacks for the bishop and rook. Called once at startup,
+     * does nothing if the tables are generated at compile time.
      */
     static inline void initAttacks();
 };
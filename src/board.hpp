@@ -4,9 +4,12 @@
 #include <cassert>
 #include <cctype>
 #include <cstdint>
+#include <new>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "attacks_fwd.hpp"
@@ -36,85 +39,248 @@ enum class GameResultReason {
 // does not include the half-move clock or full move number.
 using PackedBoard = std::array<std::uint8_t, 24>;
 
-class Board {
-    using U64 = std::uint64_t;
-
+class CastlingRights {
    public:
-    class CastlingRights {
-       public:
-        enum class Side : uint8_t { KING_SIDE, QUEEN_SIDE };
+    enum class Side : uint8_t { KING_SIDE, QUEEN_SIDE };
 
-        constexpr void setCastlingRight(Color color, Side castle, File rook_file) {
-            rooks[color][static_cast<int>(castle)] = rook_file;
-        }
+    constexpr void setCastlingRight(Color color, Side castle, File rook_file) {
+        rooks[color][static_cast<int>(castle)] = rook_file;
+    }
 
-        constexpr void clear() { rooks[0][0] = rooks[0][1] = rooks[1][0] = rooks[1][1] = File::NO_FILE; }
+    constexpr void clear() { rooks[0][0] = rooks[0][1] = rooks[1][0] = rooks[1][1] = File::NO_FILE; }
 
-        constexpr int clear(Color color, Side castle) {
-            rooks[color][static_cast<int>(castle)] = File::NO_FILE;
-            return color * 2 + static_cast<int>(castle);
-        }
+    constexpr int clear(Color color, Side castle) {
+        rooks[color][static_cast<int>(castle)] = File::NO_FILE;
+        return color * 2 + static_cast<int>(castle);
+    }
 
-        constexpr void clear(Color color) { rooks[color][0] = rooks[color][1] = File::NO_FILE; }
+    constexpr void clear(Color color) { rooks[color][0] = rooks[color][1] = File::NO_FILE; }
 
-        constexpr bool has(Color color, Side castle) const {
-            return rooks[color][static_cast<int>(castle)] != File::NO_FILE;
-        }
+    constexpr bool has(Color color, Side castle) const {
+        return rooks[color][static_cast<int>(castle)] != File::NO_FILE;
+    }
 
-        constexpr bool has(Color color) const { return has(color, Side::KING_SIDE) || has(color, Side::QUEEN_SIDE); }
+    constexpr bool has(Color color) const { return has(color, Side::KING_SIDE) || has(color, Side::QUEEN_SIDE); }
 
-        constexpr File getRookFile(Color color, Side castle) const { return rooks[color][static_cast<int>(castle)]; }
+    constexpr File getRookFile(Color color, Side castle) const { return rooks[color][static_cast<int>(castle)]; }
 
-        constexpr int hashIndex() const {
-            return has(Color::WHITE, Side::KING_SIDE) + 2 * has(Color::WHITE, Side::QUEEN_SIDE) +
-                   4 * has(Color::BLACK, Side::KING_SIDE) + 8 * has(Color::BLACK, Side::QUEEN_SIDE);
-        }
+    constexpr int hashIndex() const {
+        return has(Color::WHITE, Side::KING_SIDE) + 2 * has(Color::WHITE, Side::QUEEN_SIDE) +
+               4 * has(Color::BLACK, Side::KING_SIDE) + 8 * has(Color::BLACK, Side::QUEEN_SIDE);
+    }
 
-        constexpr bool isEmpty() const { return !has(Color::WHITE) && !has(Color::BLACK); }
+    constexpr bool isEmpty() const { return !has(Color::WHITE) && !has(Color::BLACK); }
 
-        template <typename T>
-        static constexpr Side closestSide(T sq, T pred) {
-            return sq > pred ? Side::KING_SIDE : Side::QUEEN_SIDE;
-        }
+    template <typename T>
+    static constexpr Side closestSide(T sq, T pred) {
+        return sq > pred ? Side::KING_SIDE : Side::QUEEN_SIDE;
+    }
 
-       private:
-        std::array<std::array<File, 2>, 2> rooks;
-    };
+   private:
+    std::array<std::array<File, 2>, 2> rooks;
+};
+
+// The irreversible information of a position, saved on every move to unmake it.
+struct BoardState {
+    std::uint64_t hash;
+    CastlingRights castling;
+    Square enpassant;
+    uint8_t half_moves;
+    Piece captured_piece;
+
+    BoardState() = default;
+
+    BoardState(const std::uint64_t &hash, const CastlingRights &castling, const Square &enpassant,
+               const uint8_t &half_moves, const Piece &captured_piece)
+        : hash(hash),
+          castling(castling),
+          enpassant(enpassant),
+          half_moves(half_moves),
+          captured_piece(captured_piece) {}
+};
+
+/**
+ * @brief State stack with an inline capacity of N entries, never allocates.
+ * Making more than N moves (or null moves) in a row is undefined behavior.
+ * Copying only copies the entries in use.
+ * @tparam N
+ */
+template <std::size_t N>
+class FixedStateStack {
+   public:
+    FixedStateStack() = default;
+    FixedStateStack(const FixedStateStack &other) : size_(other.size_) { copy(other); }
+
+    FixedStateStack &operator=(const FixedStateStack &other) {
+        size_ = other.size_;
+        copy(other);
+        return *this;
+    }
+
+    template <typename... Args>
+    void emplace_back(Args &&...args) {
+        assert(size_ < N);
+        new (&storage_[size_++].state) BoardState(std::forward<Args>(args)...);
+    }
+
+    void pop_back() noexcept {
+        assert(size_ > 0);
+        size_--;
+    }
+
+    [[nodiscard]] const BoardState &back() const noexcept { return (*this)[size_ - 1]; }
+
+    [[nodiscard]] const BoardState &operator[](std::size_t i) const noexcept {
+        assert(i < size_);
+        return storage_[i].state;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    [[nodiscard]] static constexpr std::size_t capacity() noexcept { return N; }
+
+    void clear() noexcept { size_ = 0; }
 
    private:
-    struct State {
-        U64 hash;
-        CastlingRights castling;
-        Square enpassant;
-        uint8_t half_moves;
-        Piece captured_piece;
-
-        State(const U64 &hash, const CastlingRights &castling, const Square &enpassant, const uint8_t &half_moves,
-              const Piece &captured_piece)
-            : hash(hash),
-              castling(castling),
-              enpassant(enpassant),
-              half_moves(half_moves),
-              captured_piece(captured_piece) {}
+    static_assert(std::is_trivially_destructible_v<BoardState>);
+
+    // uninitialized storage, only the first size_ entries are alive
+    union Slot {
+        Slot() {}
+        BoardState state;
     };
 
+    void copy(const FixedStateStack &other) noexcept {
+        for (std::size_t i = 0; i < size_; i++) new (&storage_[i].state) BoardState(other[i]);
+    }
+
+    std::array<Slot, N> storage_;
+    std::size_t size_ = 0;
+};
+
+/**
+ * @brief State stack which lives in a caller provided buffer, e.g. one per search thread.
+ * Copies of the stack (and of a board using it) share the same buffer.
+ */
+class ExternalStateStack {
+   public:
+    ExternalStateStack() = default;
+    ExternalStateStack(BoardState *data, std::size_t capacity) noexcept : data_(data), capacity_(capacity) {}
+
+    template <typename... Args>
+    void emplace_back(Args &&...args) {
+        assert(size_ < capacity_);
+        data_[size_++] = BoardState(std::forward<Args>(args)...);
+    }
+
+    void pop_back() noexcept {
+        assert(size_ > 0);
+        size_--;
+    }
+
+    [[nodiscard]] const BoardState &back() const noexcept { return (*this)[size_ - 1]; }
+
+    [[nodiscard]] const BoardState &operator[](std::size_t i) const noexcept {
+        assert(i < size_);
+        return data_[i];
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    [[nodiscard]] std::size_t capacity() const noexcept { return capacity_; }
+
+    void clear() noexcept { size_ = 0; }
+
+   private:
+    BoardState *data_     = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t size_     = 0;
+};
+
+/**
+ * @brief State stack which stores nothing, for copy-make boards.
+ * Moves can't be unmade, copy the board before making a move instead.
+ * isRepetition() always returns false since there is no history.
+ */
+class NoStateStack {
+   public:
+    template <typename... Args>
+    void emplace_back(Args &&...) noexcept {}
+
+    [[nodiscard]] static constexpr std::size_t size() noexcept { return 0; }
+
+    void clear() noexcept {}
+};
+
+/**
+ * @brief The board, Derived can be set to a class deriving from BasicBoard<Derived> to hook into
+ * placePiece/removePiece (CRTP), the calls are resolved at compile time and can be inlined.
+ * With the default of void the board has no hooks and no vtable.
+ * @tparam Derived
+ * @tparam StateStack
+ */
+template <typename Derived, typename StateStack>
+class BasicBoard {
+    using U64 = std::uint64_t;
+
+   public:
+    using CastlingRights = chess::CastlingRights;
+
+   private:
+    using State = BoardState;
+
+    // the most derived board type, whose hooks are called
+    using Self = std::conditional_t<std::is_void_v<Derived>, BasicBoard, Derived>;
+
     enum class PrivateCtor { CREATE };
 
     // private constructor to avoid initialization
-    Board(PrivateCtor) {}
+    BasicBoard(PrivateCtor) {}
 
    public:
-    explicit Board(std::string_view fen = constants::STARTPOS, bool chess960 = false) {
-        prev_states_.reserve(256);
+    explicit BasicBoard(std::string_view fen = constants::STARTPOS, bool chess960 = false) {
+        if constexpr (std::is_same_v<StateStack, std::vector<BoardState>>) prev_states_.reserve(256);
         chess960_ = chess960;
         setFenInternal<true>(fen);
     }
 
-    virtual void setFen(std::string_view fen) { setFenInternal(fen); }
+    /**
+     * @brief Constructs a board which keeps its history in the given state stack,
+     * e.g. an ExternalStateStack over a caller provided buffer.
+     * @param states
+     * @param fen
+     * @param chess960
+     */
+    explicit BasicBoard(StateStack states, std::string_view fen = constants::STARTPOS, bool chess960 = false)
+        : prev_states_(std::move(states)) {
+        chess960_ = chess960;
+        setFenInternal<true>(fen);
+    }
 
-    static Board fromFen(std::string_view fen) { return Board(fen); }
-    static Board fromEpd(std::string_view epd) {
-        Board board;
+    /**
+     * @brief Copies the position of a board with a different state stack, the history is not copied.
+     * Converting to a CopyMakeBoard never allocates.
+     * @param other
+     */
+    template <typename OtherDerived, typename OtherStateStack,
+              typename = std::enable_if_t<!std::is_same_v<BasicBoard, BasicBoard<OtherDerived, OtherStateStack>>>>
+    explicit BasicBoard(const BasicBoard<OtherDerived, OtherStateStack> &other)
+        : pieces_bb_(other.pieces_bb_),
+          occ_bb_(other.occ_bb_),
+          board_(other.board_),
+          key_(other.key_),
+          cr_(other.cr_),
+          plies_(other.plies_),
+          stm_(other.stm_),
+          ep_sq_(other.ep_sq_),
+          hfm_(other.hfm_),
+          chess960_(other.chess960_),
+          original_fen_(other.original_fen_),
+          original_fen_size_(other.original_fen_size_) {}
+
+    void setFen(std::string_view fen) { setFenInternal(fen); }
+
+    static Self fromFen(std::string_view fen) { return Self(fen); }
+    static Self fromEpd(std::string_view epd) {
+        Self board;
         board.setEpd(epd);
         return board;
     }
@@ -163,7 +329,7 @@ class Board {
         auto fen = std::string(parts[0]) + " " + std::string(parts[1]) + " " + std::string(parts[2]) + " " +
                    std::string(parts[3]) + " " + std::to_string(hm) + " " + std::to_string(fm);
 
-        setFen(fen);
+        self().setFen(fen);
     }
 
     /**
@@ -284,7 +450,7 @@ class Board {
         ep_sq_ = Square::NO_SQ;
 
         if (capture) {
-            removePiece(captured, move.to());
+            self().removePiece(captured, move.to());
 
             hfm_ = 0;
             key_ ^= Zobrist::piece(captured, move.to());
@@ -373,14 +539,14 @@ class Board {
             const auto king = at(move.from());
             const auto rook = at(move.to());
 
-            removePiece(king, move.from());
-            removePiece(rook, move.to());
+            self().removePiece(king, move.from());
+            self().removePiece(rook, move.to());
 
             assert(king == Piece(PieceType::KING, stm_));
             assert(rook == Piece(PieceType::ROOK, stm_));
 
-            placePiece(king, kingTo);
-            placePiece(rook, rookTo);
+            self().placePiece(king, kingTo);
+            self().placePiece(rook, rookTo);
 
             key_ ^= Zobrist::piece(king, move.from()) ^ Zobrist::piece(king, kingTo);
             key_ ^= Zobrist::piece(rook, move.to()) ^ Zobrist::piece(rook, rookTo);
@@ -388,8 +554,8 @@ class Board {
             const auto piece_pawn = Piece(PieceType::PAWN, stm_);
             const auto piece_prom = Piece(move.promotionType(), stm_);
 
-            removePiece(piece_pawn, move.from());
-            placePiece(piece_prom, move.to());
+            self().removePiece(piece_pawn, move.from());
+            self().placePiece(piece_prom, move.to());
 
             key_ ^= Zobrist::piece(piece_pawn, move.from()) ^ Zobrist::piece(piece_prom, move.to());
         } else {
@@ -398,8 +564,8 @@ class Board {
 
             const auto piece = at(move.from());
 
-            removePiece(piece, move.from());
-            placePiece(piece, move.to());
+            self().removePiece(piece, move.from());
+            self().placePiece(piece, move.to());
 
             key_ ^= Zobrist::piece(piece, move.from()) ^ Zobrist::piece(piece, move.to());
         }
@@ -409,7 +575,7 @@ class Board {
 
             const auto piece = Piece(PieceType::PAWN, ~stm_);
 
-            removePiece(piece, move.to().ep_square());
+            self().removePiece(piece, move.to().ep_square());
 
             key_ ^= Zobrist::piece(piece, move.to().ep_square());
         }
@@ -419,6 +585,9 @@ class Board {
     }
 
     void unmakeMove(const Move move) {
+        static_assert(!std::is_same_v<StateStack, NoStateStack>,
+                      "a copy-make board keeps no history, copy the board before making the move instead");
+
         const auto prev = prev_states_.back();
         prev_states_.pop_back();
 
@@ -439,14 +608,14 @@ class Board {
             const auto rook = at(rook_from_sq);
             const auto king = at(king_to_sq);
 
-            removePiece(rook, rook_from_sq);
-            removePiece(king, king_to_sq);
+            self().removePiece(rook, rook_from_sq);
+            self().removePiece(king, king_to_sq);
 
             assert(king == Piece(PieceType::KING, stm_));
             assert(rook == Piece(PieceType::ROOK, stm_));
 
-            placePiece(king, move.from());
-            placePiece(rook, move.to());
+            self().placePiece(king, move.from());
+            self().placePiece(rook, move.to());
 
             key_ = prev.hash;
 
@@ -460,12 +629,12 @@ class Board {
             assert(piece.type() != PieceType::KING);
             assert(piece.type() != PieceType::NONE);
 
-            removePiece(piece, move.to());
-            placePiece(pawn, move.from());
+            self().removePiece(piece, move.to());
+            self().placePiece(pawn, move.from());
 
             if (prev.captured_piece != Piece::NONE) {
                 assert(at(move.to()) == Piece::NONE);
-                placePiece(prev.captured_piece, move.to());
+                self().placePiece(prev.captured_piece, move.to());
             }
 
             key_ = prev.hash;
@@ -476,8 +645,8 @@ class Board {
 
             const auto piece = at(move.to());
 
-            removePiece(piece, move.to());
-            placePiece(piece, move.from());
+            self().removePiece(piece, move.to());
+            self().placePiece(piece, move.from());
         }
 
         if (move.typeOf() == Move::ENPASSANT) {
@@ -486,11 +655,11 @@ class Board {
 
             assert(at(pawnTo) == Piece::NONE);
 
-            placePiece(pawn, pawnTo);
+            self().placePiece(pawn, pawnTo);
         } else if (prev.captured_piece != Piece::NONE) {
             assert(at(move.to()) == Piece::NONE);
 
-            placePiece(prev.captured_piece, move.to());
+            self().placePiece(prev.captured_piece, move.to());
         }
 
         key_ = prev.hash;
@@ -515,6 +684,9 @@ class Board {
      * @brief Unmake a null move. (Switches the side to move)
      */
     void unmakeNullMove() {
+        static_assert(!std::is_same_v<StateStack, NoStateStack>,
+                      "a copy-make board keeps no history, copy the board before making the move instead");
+
         const auto &prev = prev_states_.back();
 
         ep_sq_ = prev.enpassant;
@@ -609,6 +781,40 @@ class Board {
         return (at(move.to()) != Piece::NONE && move.typeOf() != Move::CASTLING) || move.typeOf() == Move::ENPASSANT;
     }
 
+    /**
+     * @brief Checks if a move follows the movement rules in the current position, it might still leave the own king
+     * in check. Any move can be passed, i.e. one from a transposition table.
+     * @param move
+     * @return
+     */
+    [[nodiscard]] bool isPseudoLegal(const Move move) const {
+        if (stm_ == Color::WHITE) return movegen::isPseudoLegal<Color::WHITE>(*this, move);
+        return movegen::isPseudoLegal<Color::BLACK>(*this, move);
+    }
+
+    /**
+     * @brief Checks if a pseudo legal move doesn't leave the own king in check.
+     * The move has to be pseudo legal, see isPseudoLegal() and movegen::pseudoLegalMoves.
+     * @param move
+     * @return
+     */
+    [[nodiscard]] bool isLegal(const Move move) const {
+        if (stm_ == Color::WHITE) return movegen::isLegal<Color::WHITE>(*this, move);
+        return movegen::isLegal<Color::BLACK>(*this, move);
+    }
+
+    /**
+     * @brief Checks if a legal move gives check, without making it.
+     * Direct and discovered checks are found from the attack tables, including castling, en passant
+     * and promotions.
+     * @param move
+     * @return
+     */
+    [[nodiscard]] bool givesCheck(const Move move) const {
+        if (stm_ == Color::WHITE) return movegen::givesCheck<Color::WHITE>(*this, move);
+        return movegen::givesCheck<Color::BLACK>(*this, move);
+    }
+
     /**
      * @brief Get the current zobrist hash key of the board
      * @return
@@ -620,9 +826,27 @@ class Board {
     [[nodiscard]] std::uint32_t halfMoveClock() const { return hfm_; }
     [[nodiscard]] std::uint32_t fullMoveNumber() const { return 1 + plies_ / 2; }
 
+    /**
+     * @brief Switches between standard chess and chess960 and parses the position again,
+     * so that the castling rights are read for the new variant.
+     * The last fen passed to setFen is used if it fits into 128 characters,
+     * otherwise (or after Compact::decode) the fen of the current position.
+     * @param is960
+     */
     void set960(bool is960) {
+        if (!original_fen_size_) {
+            // written with the castling notation of the previous variant, like the original fen
+            const auto fen = getFen();
+            chess960_      = is960;
+            self().setFen(fen);
+            return;
+        }
+
         chess960_ = is960;
-        if (!original_fen_.empty()) setFen(original_fen_);
+
+        // setFen overwrites the buffer
+        const auto fen = original_fen_;
+        self().setFen(std::string_view(fen.data(), original_fen_size_));
     }
 
     /**
@@ -668,19 +892,24 @@ class Board {
      * @return
      */
     [[nodiscard]] bool isRepetition(int count = 2) const {
-        uint8_t c = 0;
+        // copy-make boards have no history to look at
+        if constexpr (std::is_same_v<StateStack, NoStateStack>) {
+            return false;
+        } else {
+            uint8_t c = 0;
 
-        // We start the loop from the back and go forward in moves, at most to the
-        // last move which reset the half-move counter because repetitions cant
-        // be across half-moves.
-        const auto size = static_cast<int>(prev_states_.size());
+            // We start the loop from the back and go forward in moves, at most to the
+            // last move which reset the half-move counter because repetitions cant
+            // be across half-moves.
+            const auto size = static_cast<int>(prev_states_.size());
 
-        for (int i = size - 2; i >= 0 && i >= size - hfm_ - 1; i -= 2) {
-            if (prev_states_[i].hash == key_) c++;
-            if (c == count) return true;
-        }
+            for (int i = size - 2; i >= 0 && i >= size - hfm_ - 1; i -= 2) {
+                if (prev_states_[i].hash == key_) c++;
+                if (c == count) return true;
+            }
 
-        return false;
+            return false;
+        }
     }
 
     /**
@@ -836,13 +1065,33 @@ class Board {
         return hash_key ^ ep_hash ^ stm_hash ^ castling_hash;
     }
 
-    friend std::ostream &operator<<(std::ostream &os, const Board &board);
+    friend std::ostream &operator<<(std::ostream &os, const BasicBoard &b) {
+        for (int i = 63; i >= 0; i -= 8) {
+            for (int j = 7; j >= 0; j--) {
+                os << " " << static_cast<std::string>(b.board_[i - j]);
+            }
+
+            os << " \n";
+        }
+
+        os << "\n\n";
+        os << "Side to move: " << static_cast<int>(b.stm_.internal()) << "\n";
+        os << "Castling rights: " << b.getCastleString() << "\n";
+        os << "Halfmoves: " << b.halfMoveClock() << "\n";
+        os << "Fullmoves: " << b.fullMoveNumber() << "\n";
+        os << "EP: " << b.ep_sq_.index() << "\n";
+        os << "Hash: " << b.key_ << "\n";
+
+        os << std::endl;
+
+        return os;
+    }
 
     /**
      * @brief Compresses the board into a PackedBoard.
      */
     class Compact {
-        friend class Board;
+        friend class BasicBoard;
         Compact() = default;
 
        public:
@@ -851,7 +1100,7 @@ class Board {
          * @param board
          * @return
          */
-        static PackedBoard encode(const Board &board) { return encodeState(board); }
+        static PackedBoard encode(const BasicBoard &board) { return encodeState(board); }
 
         static PackedBoard encode(std::string_view fen, bool chess960 = false) { return encodeState(fen, chess960); }
 
@@ -861,8 +1110,14 @@ class Board {
          * @param chess960 If the board is a chess960 position, set this to true
          * @return
          */
-        static Board decode(const PackedBoard &compressed, bool chess960 = false) {
-            Board board     = Board(PrivateCtor::CREATE);
+        static Self decode(const PackedBoard &compressed, bool chess960 = false) {
+            Self board = [] {
+                if constexpr (std::is_void_v<Derived>)
+                    return BasicBoard(PrivateCtor::CREATE);
+                else
+                    return Self();
+            }();
+
             board.chess960_ = chess960;
             decode(board, compressed);
             return board;
@@ -889,7 +1144,7 @@ class Board {
          *
          * We will later deduce the square of the pieces from the occupancy bitboard.
          */
-        static PackedBoard encodeState(const Board &board) {
+        static PackedBoard encodeState(const BasicBoard &board) {
             PackedBoard packed{};
 
             packed[0] = board.occ().getBits() >> 56;
@@ -922,7 +1177,7 @@ class Board {
         static PackedBoard encodeState(std::string_view fen, bool chess960 = false) {
             // fallback to slower method
             if (chess960) {
-                Board board = Board(fen, true);
+                BasicBoard board = BasicBoard(fen, true);
                 return encodeState(board);
             }
 
@@ -996,7 +1251,7 @@ class Board {
             return packed;
         }
 
-        static void decode(Board &board, const PackedBoard &compressed) {
+        static void decode(BasicBoard &board, const PackedBoard &compressed) {
             Bitboard occupied = 0ull;
 
             for (int i = 0; i < 8; i++) {
@@ -1017,7 +1272,7 @@ class Board {
 
             board.cr_.clear();
             board.prev_states_.clear();
-            board.original_fen_.clear();
+            board.original_fen_size_ = 0;
 
             board.occ_bb_.fill(0ULL);
             board.pieces_bb_.fill(0ULL);
@@ -1030,7 +1285,7 @@ class Board {
                 const auto piece  = convertPiece(nibble);
 
                 if (piece != Piece::NONE) {
-                    board.placePiece(piece, sq);
+                    board.self().placePiece(piece, sq);
 
                     offset++;
                     continue;
@@ -1042,24 +1297,24 @@ class Board {
                     board.ep_sq_ = sq.ep_square();
                     // depending on the rank this is a white or black pawn
                     auto color = sq.rank() == Rank::RANK_4 ? Color::WHITE : Color::BLACK;
-                    board.placePiece(Piece(PieceType::PAWN, color), sq);
+                    board.self().placePiece(Piece(PieceType::PAWN, color), sq);
                 }
                 // castling rights for white
                 else if (nibble == 13) {
                     assert(white_castle_idx < 2);
                     white_castle[white_castle_idx++] = sq.file();
-                    board.placePiece(Piece(PieceType::ROOK, Color::WHITE), sq);
+                    board.self().placePiece(Piece(PieceType::ROOK, Color::WHITE), sq);
                 }
                 // castling rights for black
                 else if (nibble == 14) {
                     assert(black_castle_idx < 2);
                     black_castle[black_castle_idx++] = sq.file();
-                    board.placePiece(Piece(PieceType::ROOK, Color::BLACK), sq);
+                    board.self().placePiece(Piece(PieceType::ROOK, Color::BLACK), sq);
                 }
                 // black to move
                 else if (nibble == 15) {
                     board.stm_ = Color::BLACK;
-                    board.placePiece(Piece(PieceType::KING, Color::BLACK), sq);
+                    board.self().placePiece(Piece(PieceType::KING, Color::BLACK), sq);
                 }
 
                 offset++;
@@ -1129,11 +1384,15 @@ class Board {
     };
 
    protected:
-    virtual void placePiece(Piece piece, Square sq) { placePieceInternal(piece, sq); }
+    // Hooks, shadow these in Derived to keep track of incremental updates.
+    void placePiece(Piece piece, Square sq) { placePieceInternal(piece, sq); }
+
+    void removePiece(Piece piece, Square sq) { removePieceInternal(piece, sq); }
 
-    virtual void removePiece(Piece piece, Square sq) { removePieceInternal(piece, sq); }
+    Self &self() noexcept { return static_cast<Self &>(*this); }
+    const Self &self() const noexcept { return static_cast<const Self &>(*this); }
 
-    std::vector<State> prev_states_;
+    StateStack prev_states_;
 
     std::array<Bitboard, 6> pieces_bb_ = {};
     std::array<Bitboard, 2> occ_bb_    = {};
@@ -1183,8 +1442,6 @@ class Board {
 
     template <bool ctor = false>
     void setFenInternal(std::string_view fen) {
-        original_fen_ = fen;
-
         occ_bb_.fill(0ULL);
         pieces_bb_.fill(0ULL);
         board_.fill(Piece::NONE);
@@ -1192,6 +1449,10 @@ class Board {
         // find leading whitespaces and remove them
         while (fen[0] == ' ') fen.remove_prefix(1);
 
+        // no valid fen exceeds the buffer, longer ones aren't stored and set960 falls back to getFen()
+        original_fen_size_ = fen.size() <= original_fen_.size() ? fen.size() : 0;
+        fen.copy(original_fen_.data(), original_fen_size_);
+
         const auto params     = split_string_view<6>(fen);
         const auto position   = params[0].has_value() ? *params[0] : "";
         const auto move_right = params[1].has_value() ? *params[1] : "w";
@@ -1245,11 +1506,11 @@ class Board {
             } else {
                 auto p = Piece(std::string_view(&curr, 1));
 
-                // prevent warnings about virtual method bypassing virtual dispatch
+                // Derived isn't constructed yet, don't call its hooks
                 if constexpr (ctor) {
                     placePieceInternal(p, Square(square));
                 } else {
-                    placePiece(p, square);
+                    self().placePiece(p, square);
                 }
 
                 key_ ^= Zobrist::piece(p, Square(square));
@@ -1257,7 +1518,7 @@ class Board {
             }
         }
 
-        static const auto find_rook = [](const Board &board, CastlingRights::Side side, Color color) {
+        static const auto find_rook = [](const BasicBoard &board, CastlingRights::Side side, Color color) {
             const auto king_side = CastlingRights::Side::KING_SIDE;
             const auto king_sq   = board.kingSq(color);
             const auto sq_corner = Square(side == king_side ? Square::SQ_H1 : Square::SQ_A1).relative_square(color);
@@ -1363,29 +1624,18 @@ class Board {
     }
 
     // store the original fen string
-    // useful when setting up a frc position and the user called set960(true) afterwards
-    std::string original_fen_;
-};
+    // useful when setting up a frc position and the user called set960(true) afterwards,
+    // kept inline so that copying a board doesn't allocate
+    std::array<char, 128> original_fen_;
+    std::uint8_t original_fen_size_ = 0;
 
-inline std::ostream &operator<<(std::ostream &os, const Board &b) {
-    for (int i = 63; i >= 0; i -= 8) {
-        for (int j = 7; j >= 0; j--) {
-            os << " " << static_cast<std::string>(b.board_[i - j]);
-        }
-
-        os << " \n";
-    }
+    template <typename, typename>
+    friend class BasicBoard;
+};
 
-    os << "\n\n";
-    os << "Side to move: " << static_cast<int>(b.stm_.internal()) << "\n";
-    os << "Castling rights: " << b.getCastleString() << "\n";
-    os << "Halfmoves: " << b.halfMoveClock() << "\n";
-    os << "Fullmoves: " << b.fullMoveNumber() << "\n";
-    os << "EP: " << b.ep_sq_.index() << "\n";
-    os << "Hash: " << b.key_ << "\n";
+template <std::size_t N = 256>
+using FixedBoard = BasicBoard<void, FixedStateStack<N>>;
 
-    os << std::endl;
+using CopyMakeBoard = BasicBoard<void, NoStateStack>;
 
-    return os;
-}
 }  // namespace  chess
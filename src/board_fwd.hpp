@@ -1,5 +1,12 @@
 #pragma once
 
+#include <vector>
+
 namespace chess {
-class Board;
+struct BoardState;
+
+template <typename Derived = void, typename StateStack = std::vector<BoardState>>
+class BasicBoard;
+
+using Board = BasicBoard<>;
 }  // namespace chess
@@ -43,6 +43,8 @@ VERSION: 0.8.7
 #include "movegen.hpp"
 #include "movegen_fwd.hpp"
 #include "movelist.hpp"
+#include "movepicker.hpp"
+#include "perft.hpp"
 #include "pgn.hpp"
 #include "piece.hpp"
 #include "uci.hpp"
@@ -29,8 +29,8 @@ inline auto movegen::init_squares_between() {
     return squares_between_bb;
 }
 
-template <Color::underlying c>
-[[nodiscard]] inline std::pair<Bitboard, int> movegen::checkMask(const Board &board, Square sq) {
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline std::pair<Bitboard, int> movegen::checkMask(const BoardT &board, Square sq) {
     const auto opp_knight = board.pieces(PieceType::KNIGHT, ~c);
     const auto opp_bishop = board.pieces(PieceType::BISHOP, ~c);
     const auto opp_rook   = board.pieces(PieceType::ROOK, ~c);
@@ -82,8 +82,8 @@ template <Color::underlying c>
     return {mask, checks};
 }
 
-template <Color::underlying c>
-[[nodiscard]] inline Bitboard movegen::pinMaskRooks(const Board &board, Square sq, Bitboard occ_opp, Bitboard occ_us) {
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::pinMaskRooks(const BoardT &board, Square sq, Bitboard occ_opp, Bitboard occ_us) {
     const auto opp_rook  = board.pieces(PieceType::ROOK, ~c);
     const auto opp_queen = board.pieces(PieceType::QUEEN, ~c);
 
@@ -100,8 +100,8 @@ template <Color::underlying c>
     return pin_hv;
 }
 
-template <Color::underlying c>
-[[nodiscard]] inline Bitboard movegen::pinMaskBishops(const Board &board, Square sq, Bitboard occ_opp,
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::pinMaskBishops(const BoardT &board, Square sq, Bitboard occ_opp,
                                                       Bitboard occ_us) {
     const auto opp_bishop = board.pieces(PieceType::BISHOP, ~c);
     const auto opp_queen  = board.pieces(PieceType::QUEEN, ~c);
@@ -119,8 +119,8 @@ template <Color::underlying c>
     return pin_diag;
 }
 
-template <Color::underlying c>
-[[nodiscard]] inline Bitboard movegen::seenSquares(const Board &board, Bitboard enemy_empty) {
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::seenSquares(const BoardT &board, Bitboard enemy_empty) {
     auto king_sq          = board.kingSq(~c);
     Bitboard map_king_atk = attacks::king(king_sq) & enemy_empty;
 
@@ -158,20 +158,181 @@ template <Color::underlying c>
     return seen;
 }
 
-template <Color::underlying c, movegen::MoveGenType mt>
-inline void movegen::generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
-                                       Bitboard checkmask, Bitboard occ_opp) {
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline movegen::CheckInfo movegen::checkInfo(const BoardT &board) {
+    const auto king_sq = board.kingSq(~c);
+    const auto occ_us  = board.us(c);
+    const auto occ_opp = board.us(~c);
+    const auto occ_all = occ_us | occ_opp;
+    const auto queens  = board.pieces(PieceType::QUEEN, c);
+
+    CheckInfo info{};
+
+    info.king_sq                         = king_sq;
+    info.squares[int(PieceType::PAWN)]   = attacks::pawn(~c, king_sq);
+    info.squares[int(PieceType::KNIGHT)] = attacks::knight(king_sq);
+    info.squares[int(PieceType::BISHOP)] = attacks::bishop(king_sq, occ_all);
+    info.squares[int(PieceType::ROOK)]   = attacks::rook(king_sq, occ_all);
+    info.squares[int(PieceType::QUEEN)]  = info.squares[int(PieceType::BISHOP)] | info.squares[int(PieceType::ROOK)];
+
+    // Same as the pin masks, but with our own sliders behind exactly one of our pieces.
+    Bitboard rook_snipers   = attacks::rook(king_sq, occ_opp) & (board.pieces(PieceType::ROOK, c) | queens);
+    Bitboard bishop_snipers = attacks::bishop(king_sq, occ_opp) & (board.pieces(PieceType::BISHOP, c) | queens);
+
+    while (rook_snipers) {
+        const auto between = SQUARES_BETWEEN_BB[king_sq.index()][rook_snipers.pop()] & occ_us;
+        if (between.count() == 1) info.blockers_hv |= between;
+    }
+
+    while (bishop_snipers) {
+        const auto between = SQUARES_BETWEEN_BB[king_sq.index()][bishop_snipers.pop()] & occ_us;
+        if (between.count() == 1) info.blockers_d |= between;
+    }
+
+    return info;
+}
+
+[[nodiscard]] inline Bitboard movegen::discoveredCheckTargets(const CheckInfo &info, Square sq) {
+    // Everything except the line through the king and the blocker.
+    if (info.blockers_hv & Bitboard::fromSquare(sq)) return ~(attacks::rook(info.king_sq, 0) & attacks::rook(sq, 0));
+    if (info.blockers_d & Bitboard::fromSquare(sq)) return ~(attacks::bishop(info.king_sq, 0) & attacks::bishop(sq, 0));
+    return 0ull;
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::givesCheck(const BoardT &board, const CheckInfo &info, Move move) {
+    const auto from    = move.from();
+    const auto to      = move.to();
+    const auto from_bb = Bitboard::fromSquare(from);
+    const auto to_bb   = Bitboard::fromSquare(to);
+    const auto king_bb = Bitboard::fromSquare(info.king_sq);
+
+    if (move.typeOf() == Move::NORMAL) {
+        const auto pt = board.template at<PieceType>(from);
+        return bool((info.squares[int(pt)] | discoveredCheckTargets(info, from)) & to_bb);
+    }
+
+    if (move.typeOf() == Move::PROMOTION) {
+        if (discoveredCheckTargets(info, from) & to_bb) return true;
+
+        const auto occ = board.occ() ^ from_bb;
+
+        switch (move.promotionType().internal()) {
+            case PieceType::KNIGHT:
+                return bool(attacks::knight(to) & king_bb);
+            case PieceType::BISHOP:
+                return bool(attacks::bishop(to, occ) & king_bb);
+            case PieceType::ROOK:
+                return bool(attacks::rook(to, occ) & king_bb);
+            default:
+                return bool(attacks::queen(to, occ) & king_bb);
+        }
+    }
+
+    return givesCheckTwoPieces<c>(board, info.king_sq, move);
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::givesCheck(const BoardT &board, Move move) {
+    const auto king_sq = board.kingSq(~c);
+
+    if (move.typeOf() == Move::ENPASSANT || move.typeOf() == Move::CASTLING) {
+        return givesCheckTwoPieces<c>(board, king_sq, move);
+    }
+
+    const auto from    = move.from();
+    const auto to      = move.to();
+    const auto from_bb = Bitboard::fromSquare(from);
+    const auto to_bb   = Bitboard::fromSquare(to);
+    const auto occ     = board.occ() ^ from_bb;
+
+    const auto pt = move.typeOf() == Move::PROMOTION ? move.promotionType() : board.template at<PieceType>(from);
+
+    // Direct check, from the king's point of view.
+    switch (pt.internal()) {
+        case PieceType::PAWN:
+            if (attacks::pawn(~c, king_sq) & to_bb) return true;
+            break;
+        case PieceType::KNIGHT:
+            if (attacks::knight(king_sq) & to_bb) return true;
+            break;
+        case PieceType::BISHOP:
+            if (attacks::bishop(king_sq, occ) & to_bb) return true;
+            break;
+        case PieceType::ROOK:
+            if (attacks::rook(king_sq, occ) & to_bb) return true;
+            break;
+        case PieceType::QUEEN:
+            if (attacks::queen(king_sq, occ) & to_bb) return true;
+            break;
+        default:
+            break;
+    }
+
+    // Discovered check, only possible if the piece leaves a line to the king. None of our sliders
+    // sees the king before the move, so a slider seeing it now stands behind the moving piece.
+    const auto queens = board.pieces(PieceType::QUEEN, c);
+
+    Bitboard snipers = 0ull;
+
+    if (attacks::rook(king_sq, 0ull) & from_bb) {
+        snipers = attacks::rook(king_sq, occ) & (board.pieces(PieceType::ROOK, c) | queens);
+    } else if (attacks::bishop(king_sq, 0ull) & from_bb) {
+        snipers = attacks::bishop(king_sq, occ) & (board.pieces(PieceType::BISHOP, c) | queens);
+    }
+
+    snipers &= ~from_bb;
+
+    while (snipers) {
+        // still a check if the piece stays on the line
+        if (!(SQUARES_BETWEEN_BB[king_sq.index()][snipers.pop()] & to_bb)) return true;
+    }
+
+    return false;
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::givesCheckTwoPieces(const BoardT &board, Square king_sq, Move move) {
+    const auto from    = move.from();
+    const auto to      = move.to();
+    const auto from_bb = Bitboard::fromSquare(from);
+    const auto to_bb   = Bitboard::fromSquare(to);
+    const auto king_bb = Bitboard::fromSquare(king_sq);
+
+    // En passant and castling move two pieces, look at the king from the occupancy after the move.
+    const auto queens = board.pieces(PieceType::QUEEN, c);
+
+    auto occ     = board.occ();
+    auto bishops = board.pieces(PieceType::BISHOP, c) | queens;
+    auto rooks   = board.pieces(PieceType::ROOK, c) | queens;
+
+    if (move.typeOf() == Move::ENPASSANT) {
+        if (attacks::pawn(c, to) & king_bb) return true;
+
+        const auto captured = Bitboard::fromSquare(to + make_direction(Direction::SOUTH, c));
+
+        occ = (occ ^ from_bb ^ captured) | to_bb;
+    } else {
+        const bool king_side = to > from;
+        const auto king_to   = Bitboard::fromSquare(Square::castling_king_square(king_side, c));
+        const auto rook_to   = Bitboard::fromSquare(Square::castling_rook_square(king_side, c));
+
+        occ   = (occ ^ from_bb ^ to_bb) | king_to | rook_to;
+        rooks = (rooks ^ to_bb) | rook_to;
+    }
+
+    return bool((attacks::rook(king_sq, occ) & rooks) | (attacks::bishop(king_sq, occ) & bishops));
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline movegen::PawnTargets movegen::pawnTargets(const BoardT &board, Bitboard pin_d, Bitboard pin_hv,
+                                                             Bitboard checkmask, Bitboard occ_opp) {
     // flipped for black
 
-    constexpr auto UP         = make_direction(Direction::NORTH, c);
-    constexpr auto DOWN       = make_direction(Direction::SOUTH, c);
-    constexpr auto DOWN_LEFT  = make_direction(Direction::SOUTH_WEST, c);
-    constexpr auto DOWN_RIGHT = make_direction(Direction::SOUTH_EAST, c);
-    constexpr auto UP_LEFT    = make_direction(Direction::NORTH_WEST, c);
-    constexpr auto UP_RIGHT   = make_direction(Direction::NORTH_EAST, c);
+    constexpr auto UP       = make_direction(Direction::NORTH, c);
+    constexpr auto UP_LEFT  = make_direction(Direction::NORTH_WEST, c);
+    constexpr auto UP_RIGHT = make_direction(Direction::NORTH_EAST, c);
 
-    constexpr auto RANK_B_PROMO     = Rank::rank(Rank::RANK_7, c).bb();
-    constexpr auto RANK_PROMO       = Rank::rank(Rank::RANK_8, c).bb();
     constexpr auto DOUBLE_PUSH_RANK = Rank::rank(Rank::RANK_3, c).bb();
 
     const auto pawns = board.pieces(PieceType::PAWN, c);
@@ -205,6 +366,26 @@ inline void movegen::generatePawnMoves(const Board &board, Movelist &moves, Bitb
                             (attacks::shift<UP>(single_push_pinned & DOUBLE_PUSH_RANK) & ~board.occ())) &
                            checkmask;
 
+    return {l_pawns, r_pawns, single_push, double_push};
+}
+
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+inline void movegen::generatePawnMoves(const BoardT &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
+                                       Bitboard checkmask, Bitboard occ_opp) {
+    // flipped for black
+
+    constexpr auto DOWN       = make_direction(Direction::SOUTH, c);
+    constexpr auto DOWN_LEFT  = make_direction(Direction::SOUTH_WEST, c);
+    constexpr auto DOWN_RIGHT = make_direction(Direction::SOUTH_EAST, c);
+
+    constexpr auto RANK_B_PROMO = Rank::rank(Rank::RANK_7, c).bb();
+    constexpr auto RANK_PROMO   = Rank::rank(Rank::RANK_8, c).bb();
+
+    const auto pawns    = board.pieces(PieceType::PAWN, c);
+    const auto pawns_lr = pawns & ~pin_hv;
+
+    auto [l_pawns, r_pawns, single_push, double_push] = pawnTargets<c>(board, pin_d, pin_hv, checkmask, occ_opp);
+
     if (pawns & RANK_B_PROMO) {
         Bitboard promo_left  = l_pawns & RANK_PROMO;
         Bitboard promo_right = r_pawns & RANK_PROMO;
@@ -278,8 +459,46 @@ inline void movegen::generatePawnMoves(const Board &board, Movelist &moves, Bitb
     }
 }
 
-[[nodiscard]] inline std::array<Move, 2> movegen::generateEPMove(const Board &board, Bitboard checkmask, Bitboard pin_d,
-                                                                 Bitboard pawns_lr, Square ep, Color c) {
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+[[nodiscard]] inline int movegen::countPawnMoves(const BoardT &board, Bitboard pin_d, Bitboard pin_hv,
+                                                 Bitboard checkmask, Bitboard occ_opp) {
+    constexpr auto RANK_PROMO = Rank::rank(Rank::RANK_8, c).bb();
+
+    const auto [l_pawns, r_pawns, single_push, double_push] =
+        pawnTargets<c>(board, pin_d, pin_hv, checkmask, occ_opp);
+
+    int count = 0;
+
+    // Every promotion expands into four moves.
+    if constexpr (mt != MoveGenType::QUIET) {
+        count += ((l_pawns & ~RANK_PROMO).count() + (r_pawns & ~RANK_PROMO).count());
+        count += ((l_pawns & RANK_PROMO).count() + (r_pawns & RANK_PROMO).count()) * 4;
+    }
+
+    if constexpr (mt != MoveGenType::CAPTURE) {
+        count += (single_push & ~RANK_PROMO).count() + double_push.count();
+        count += (single_push & RANK_PROMO).count() * 4;
+    }
+
+    if constexpr (mt == MoveGenType::QUIET) return count;
+
+    const Square ep = board.enpassantSq();
+
+    if (ep != Square::NO_SQ) {
+        const auto pawns_lr = board.pieces(PieceType::PAWN, c) & ~pin_hv;
+
+        for (const auto &move : generateEPMove(board, checkmask, pin_d, pawns_lr, ep, c)) {
+            if (move != Move::NO_MOVE) count++;
+        }
+    }
+
+    return count;
+}
+
+template <typename BoardT>
+[[nodiscard]] inline std::array<Move, 2> movegen::generateEPMove(const BoardT &board, Bitboard checkmask,
+                                                                 Bitboard pin_d, Bitboard pawns_lr, Square ep,
+                                                                 Color c) {
     assert((ep.rank() == Rank::RANK_3 && board.sideToMove() == Color::BLACK) ||
            (ep.rank() == Rank::RANK_6 && board.sideToMove() == Color::WHITE));
 
@@ -368,8 +587,8 @@ inline void movegen::generatePawnMoves(const Board &board, Movelist &moves, Bitb
     return attacks::king(sq) & movable_square & ~seen;
 }
 
-template <Color::underlying c, movegen::MoveGenType mt>
-[[nodiscard]] inline Bitboard movegen::generateCastleMoves(const Board &board, Square sq, Bitboard seen,
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::generateCastleMoves(const BoardT &board, Square sq, Bitboard seen,
                                                            Bitboard pin_hv) {
     if constexpr (mt == MoveGenType::CAPTURE) return 0ull;
     if (!Square::back_rank(sq, c) || !board.castlingRights().has(c)) return 0ull;
@@ -378,11 +597,11 @@ template <Color::underlying c, movegen::MoveGenType mt>
 
     Bitboard moves = 0ull;
 
-    for (const auto side : {Board::CastlingRights::Side::KING_SIDE, Board::CastlingRights::Side::QUEEN_SIDE}) {
+    for (const auto side : {CastlingRights::Side::KING_SIDE, CastlingRights::Side::QUEEN_SIDE}) {
         if (!rights.has(c, side)) continue;
 
-        const auto end_king_sq = Square::castling_king_square(side == Board::CastlingRights::Side::KING_SIDE, c);
-        const auto end_rook_sq = Square::castling_rook_square(side == Board::CastlingRights::Side::KING_SIDE, c);
+        const auto end_king_sq = Square::castling_king_square(side == CastlingRights::Side::KING_SIDE, c);
+        const auto end_rook_sq = Square::castling_rook_square(side == CastlingRights::Side::KING_SIDE, c);
 
         const auto from_rook_sq = Square(rights.getRookFile(c, side), sq.rank());
 
@@ -417,13 +636,20 @@ inline void movegen::whileBitboardAdd(Movelist &movelist, Bitboard mask, T func)
     }
 }
 
-template <Color::underlying c, movegen::MoveGenType mt>
-inline void movegen::legalmoves(Movelist &movelist, const Board &board, int pieces) {
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+inline void movegen::legalmoves(Movelist &movelist, const BoardT &board, int pieces) {
     /*
      The size of the movelist might not
      be 0! This is done on purpose since it enables
      you to append new move types to any movelist.
     */
+    constexpr bool checks_only = mt == MoveGenType::CHECK || mt == MoveGenType::QUIET_CHECK;
+
+    // The generators below only distinguish between captures and quiets.
+    constexpr auto gen_type = mt == MoveGenType::QUIET_CHECK ? MoveGenType::QUIET
+                              : mt == MoveGenType::EVASION || mt == MoveGenType::CHECK ? MoveGenType::ALL
+                                                                                         : mt;
+
     auto king_sq = board.kingSq(c);
 
     Bitboard occ_us  = board.us(c);
@@ -433,18 +659,29 @@ inline void movegen::legalmoves(Movelist &movelist, const Board &board, int piec
     Bitboard opp_empty = ~occ_us;
 
     const auto [checkmask, checks] = checkMask<c>(board, king_sq);
-    const auto pin_hv              = pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
-    const auto pin_d               = pinMaskBishops<c>(board, king_sq, occ_opp, occ_us);
+
+    if (mt == MoveGenType::EVASION && checks == 0) return;
+
+    const auto pin_hv = pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
+    const auto pin_d  = pinMaskBishops<c>(board, king_sq, occ_opp, occ_us);
 
     assert(checks <= 2);
 
+    [[maybe_unused]] const auto info = checks_only ? checkInfo<c>(board) : CheckInfo{};
+
+    // Restricts the targets of a piece to the squares which give check.
+    const auto checking = [&](Square sq, Bitboard targets, PieceType pt) -> Bitboard {
+        if constexpr (checks_only) return targets & (info.squares[int(pt)] | discoveredCheckTargets(info, sq));
+        return targets;
+    };
+
     // Moves have to be on the checkmask
     Bitboard movable_square;
 
     // Slider, Knights and King moves can only go to enemy or empty squares.
-    if (mt == MoveGenType::ALL)
+    if (gen_type == MoveGenType::ALL)
         movable_square = opp_empty;
-    else if (mt == MoveGenType::CAPTURE)
+    else if (gen_type == MoveGenType::CAPTURE)
         movable_square = occ_opp;
     else  // QUIET moves
         movable_square = ~occ_all;
@@ -452,15 +689,17 @@ inline void movegen::legalmoves(Movelist &movelist, const Board &board, int piec
     if (pieces & PieceGenType::KING) {
         Bitboard seen = seenSquares<~c>(board, opp_empty);
 
-        whileBitboardAdd(movelist, Bitboard::fromSquare(king_sq),
-                         [&](Square sq) { return generateKingMoves(sq, seen, movable_square); });
+        // The king can only give a discovered check.
+        whileBitboardAdd(movelist, Bitboard::fromSquare(king_sq), [&](Square sq) {
+            return checking(sq, generateKingMoves(sq, seen, movable_square), PieceType::KING);
+        });
 
         if (checks == 0) {
-            Bitboard moves_bb = generateCastleMoves<c, mt>(board, king_sq, seen, pin_hv);
+            Bitboard moves_bb = generateCastleMoves<c, gen_type>(board, king_sq, seen, pin_hv);
 
             while (moves_bb) {
-                Square to = moves_bb.pop();
-                movelist.add(Move::make<Move::CASTLING>(king_sq, to));
+                const auto move = Move::make<Move::CASTLING>(king_sq, moves_bb.pop());
+                if (!checks_only || givesCheck<c>(board, info, move)) movelist.add(move);
             }
         }
     }
@@ -472,43 +711,58 @@ inline void movegen::legalmoves(Movelist &movelist, const Board &board, int piec
 
     // Add the moves to the movelist.
     if (pieces & PieceGenType::PAWN) {
-        generatePawnMoves<c, mt>(board, movelist, pin_d, pin_hv, checkmask, occ_opp);
+        if constexpr (checks_only) {
+            // Promotions and en passant are easier to check one by one.
+            Movelist pawn_moves;
+            generatePawnMoves<c, gen_type>(board, pawn_moves, pin_d, pin_hv, checkmask, occ_opp);
+
+            for (const auto &move : pawn_moves) {
+                if (givesCheck<c>(board, info, move)) movelist.add(move);
+            }
+        } else {
+            generatePawnMoves<c, gen_type>(board, movelist, pin_d, pin_hv, checkmask, occ_opp);
+        }
     }
 
     if (pieces & PieceGenType::KNIGHT) {
         // Prune knights that are pinned since these cannot move.
         Bitboard knights_mask = board.pieces(PieceType::KNIGHT, c) & ~(pin_d | pin_hv);
 
-        whileBitboardAdd(movelist, knights_mask, [&](Square sq) { return generateKnightMoves(sq) & movable_square; });
+        whileBitboardAdd(movelist, knights_mask, [&](Square sq) {
+            return checking(sq, generateKnightMoves(sq) & movable_square, PieceType::KNIGHT);
+        });
     }
 
     if (pieces & PieceGenType::BISHOP) {
         // Prune horizontally pinned bishops
         Bitboard bishops_mask = board.pieces(PieceType::BISHOP, c) & ~pin_hv;
 
-        whileBitboardAdd(movelist, bishops_mask,
-                         [&](Square sq) { return generateBishopMoves(sq, pin_d, occ_all) & movable_square; });
+        whileBitboardAdd(movelist, bishops_mask, [&](Square sq) {
+            return checking(sq, generateBishopMoves(sq, pin_d, occ_all) & movable_square, PieceType::BISHOP);
+        });
     }
 
     if (pieces & PieceGenType::ROOK) {
         //  Prune diagonally pinned rooks
         Bitboard rooks_mask = board.pieces(PieceType::ROOK, c) & ~pin_d;
 
-        whileBitboardAdd(movelist, rooks_mask,
-                         [&](Square sq) { return generateRookMoves(sq, pin_hv, occ_all) & movable_square; });
+        whileBitboardAdd(movelist, rooks_mask, [&](Square sq) {
+            return checking(sq, generateRookMoves(sq, pin_hv, occ_all) & movable_square, PieceType::ROOK);
+        });
     }
 
     if (pieces & PieceGenType::QUEEN) {
         // Prune double pinned queens
         Bitboard queens_mask = board.pieces(PieceType::QUEEN, c) & ~(pin_d & pin_hv);
 
-        whileBitboardAdd(movelist, queens_mask,
-                         [&](Square sq) { return generateQueenMoves(sq, pin_d, pin_hv, occ_all) & movable_square; });
+        whileBitboardAdd(movelist, queens_mask, [&](Square sq) {
+            return checking(sq, generateQueenMoves(sq, pin_d, pin_hv, occ_all) & movable_square, PieceType::QUEEN);
+        });
     }
 }
 
-template <movegen::MoveGenType mt>
-inline void movegen::legalmoves(Movelist &movelist, const Board &board, int pieces) {
+template <movegen::MoveGenType mt, typename BoardT>
+inline void movegen::legalmoves(Movelist &movelist, const BoardT &board, int pieces) {
     movelist.clear();
 
     if (board.sideToMove() == Color::WHITE)
@@ -517,8 +771,283 @@ inline void movegen::legalmoves(Movelist &movelist, const Board &board, int piec
         legalmoves<Color::BLACK, mt>(movelist, board, pieces);
 }
 
-template <Color::underlying c>
-inline bool movegen::isEpSquareValid(const Board &board, Square ep) {
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+inline int movegen::countLegalMoves(const BoardT &board, int pieces) {
+    // Mirrors legalmoves, but popcounts the targets instead of adding them.
+    static_assert(mt != MoveGenType::CHECK && mt != MoveGenType::QUIET_CHECK);
+
+    constexpr auto gen_type = mt == MoveGenType::EVASION ? MoveGenType::ALL : mt;
+
+    auto king_sq = board.kingSq(c);
+
+    Bitboard occ_us  = board.us(c);
+    Bitboard occ_opp = board.us(~c);
+    Bitboard occ_all = occ_us | occ_opp;
+
+    Bitboard opp_empty = ~occ_us;
+
+    const auto [checkmask, checks] = checkMask<c>(board, king_sq);
+
+    if (mt == MoveGenType::EVASION && checks == 0) return 0;
+
+    const auto pin_hv              = pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
+    const auto pin_d               = pinMaskBishops<c>(board, king_sq, occ_opp, occ_us);
+
+    assert(checks <= 2);
+
+    Bitboard movable_square;
+
+    if (gen_type == MoveGenType::ALL)
+        movable_square = opp_empty;
+    else if (gen_type == MoveGenType::CAPTURE)
+        movable_square = occ_opp;
+    else  // QUIET moves
+        movable_square = ~occ_all;
+
+    int count = 0;
+
+    if (pieces & PieceGenType::KING) {
+        Bitboard seen = seenSquares<~c>(board, opp_empty);
+
+        count += generateKingMoves(king_sq, seen, movable_square).count();
+
+        if (checks == 0) count += generateCastleMoves<c, gen_type>(board, king_sq, seen, pin_hv).count();
+    }
+
+    movable_square &= checkmask;
+
+    if (checks == 2) return count;
+
+    if (pieces & PieceGenType::PAWN) {
+        count += countPawnMoves<c, gen_type>(board, pin_d, pin_hv, checkmask, occ_opp);
+    }
+
+    if (pieces & PieceGenType::KNIGHT) {
+        Bitboard knights_mask = board.pieces(PieceType::KNIGHT, c) & ~(pin_d | pin_hv);
+
+        while (knights_mask) count += (generateKnightMoves(knights_mask.pop()) & movable_square).count();
+    }
+
+    if (pieces & PieceGenType::BISHOP) {
+        Bitboard bishops_mask = board.pieces(PieceType::BISHOP, c) & ~pin_hv;
+
+        while (bishops_mask) {
+            count += (generateBishopMoves(bishops_mask.pop(), pin_d, occ_all) & movable_square).count();
+        }
+    }
+
+    if (pieces & PieceGenType::ROOK) {
+        Bitboard rooks_mask = board.pieces(PieceType::ROOK, c) & ~pin_d;
+
+        while (rooks_mask) count += (generateRookMoves(rooks_mask.pop(), pin_hv, occ_all) & movable_square).count();
+    }
+
+    if (pieces & PieceGenType::QUEEN) {
+        Bitboard queens_mask = board.pieces(PieceType::QUEEN, c) & ~(pin_d & pin_hv);
+
+        while (queens_mask) {
+            count += (generateQueenMoves(queens_mask.pop(), pin_d, pin_hv, occ_all) & movable_square).count();
+        }
+    }
+
+    return count;
+}
+
+template <movegen::MoveGenType mt, typename BoardT>
+inline int movegen::countLegalMoves(const BoardT &board, int pieces) {
+    // Checking moves have to be looked at one by one anyway.
+    if constexpr (mt == MoveGenType::CHECK || mt == MoveGenType::QUIET_CHECK) {
+        Movelist moves;
+        legalmoves<mt>(moves, board, pieces);
+        return moves.size();
+    } else {
+        if (board.sideToMove() == Color::WHITE) return countLegalMoves<Color::WHITE, mt>(board, pieces);
+
+        return countLegalMoves<Color::BLACK, mt>(board, pieces);
+    }
+}
+
+template <Color::underlying c, movegen::MoveGenType mt, typename BoardT>
+inline void movegen::pseudoLegalMoves(Movelist &movelist, const BoardT &board, int pieces) {
+    static_assert(mt == MoveGenType::ALL || mt == MoveGenType::CAPTURE || mt == MoveGenType::QUIET);
+
+    // Same as legalmoves, but without the check and pin masks.
+    auto king_sq = board.kingSq(c);
+
+    Bitboard occ_us  = board.us(c);
+    Bitboard occ_opp = board.us(~c);
+    Bitboard occ_all = occ_us | occ_opp;
+
+    Bitboard movable_square;
+
+    if (mt == MoveGenType::ALL)
+        movable_square = ~occ_us;
+    else if (mt == MoveGenType::CAPTURE)
+        movable_square = occ_opp;
+    else  // QUIET moves
+        movable_square = ~occ_all;
+
+    if (pieces & PieceGenType::KING) {
+        whileBitboardAdd(movelist, Bitboard::fromSquare(king_sq),
+                         [&](Square sq) { return attacks::king(sq) & movable_square; });
+
+        // Castling is rare enough to be checked for legality right away.
+        if (mt != MoveGenType::CAPTURE) {
+            Bitboard moves_bb = legalCastleMoves<c>(board, king_sq);
+
+            while (moves_bb) {
+                Square to = moves_bb.pop();
+                movelist.add(Move::make<Move::CASTLING>(king_sq, to));
+            }
+        }
+    }
+
+    if (pieces & PieceGenType::PAWN) {
+        generatePawnMoves<c, mt>(board, movelist, 0, 0, constants::DEFAULT_CHECKMASK, occ_opp);
+    }
+
+    if (pieces & PieceGenType::KNIGHT) {
+        whileBitboardAdd(movelist, board.pieces(PieceType::KNIGHT, c),
+                         [&](Square sq) { return attacks::knight(sq) & movable_square; });
+    }
+
+    if (pieces & PieceGenType::BISHOP) {
+        whileBitboardAdd(movelist, board.pieces(PieceType::BISHOP, c),
+                         [&](Square sq) { return attacks::bishop(sq, occ_all) & movable_square; });
+    }
+
+    if (pieces & PieceGenType::ROOK) {
+        whileBitboardAdd(movelist, board.pieces(PieceType::ROOK, c),
+                         [&](Square sq) { return attacks::rook(sq, occ_all) & movable_square; });
+    }
+
+    if (pieces & PieceGenType::QUEEN) {
+        whileBitboardAdd(movelist, board.pieces(PieceType::QUEEN, c),
+                         [&](Square sq) { return attacks::queen(sq, occ_all) & movable_square; });
+    }
+}
+
+template <movegen::MoveGenType mt, typename BoardT>
+inline void movegen::pseudoLegalMoves(Movelist &movelist, const BoardT &board, int pieces) {
+    movelist.clear();
+
+    if (board.sideToMove() == Color::WHITE)
+        pseudoLegalMoves<Color::WHITE, mt>(movelist, board, pieces);
+    else
+        pseudoLegalMoves<Color::BLACK, mt>(movelist, board, pieces);
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline Bitboard movegen::legalCastleMoves(const BoardT &board, Square king_sq) {
+    if (!board.castlingRights().has(c) || board.isAttacked(king_sq, ~c)) return 0ull;
+
+    const auto occ_us  = board.us(c);
+    const auto occ_opp = board.us(~c);
+
+    const auto seen   = seenSquares<~c>(board, ~occ_us);
+    const auto pin_hv = pinMaskRooks<c>(board, king_sq, occ_opp, occ_us);
+
+    return generateCastleMoves<c, MoveGenType::ALL>(board, king_sq, seen, pin_hv);
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::isPseudoLegal(const BoardT &board, Move move) {
+    const auto from  = move.from();
+    const auto to    = move.to();
+    const auto piece = board.at(from);
+
+    // also rejects Move::NO_MOVE and Move::NULL_MOVE
+    if (from == to || piece == Piece::NONE || piece.color() != c) return false;
+
+    const auto type  = piece.type();
+    const auto to_bb = Bitboard::fromSquare(to);
+
+    if (move.typeOf() == Move::CASTLING) {
+        return type == PieceType::KING && (legalCastleMoves<c>(board, from) & to_bb);
+    }
+
+    if (board.us(c) & to_bb) return false;
+
+    if (type == PieceType::PAWN) {
+        constexpr auto UP          = make_direction(Direction::NORTH, c);
+        constexpr auto RANK_START  = Rank::rank(Rank::RANK_2, c).bb();
+        constexpr auto RANK_PROMO  = Rank::rank(Rank::RANK_8, c).bb();
+        const auto pawn_attacks    = attacks::pawn(c, from);
+        const auto is_promo_target = bool(to_bb & RANK_PROMO);
+
+        if (move.typeOf() == Move::ENPASSANT) return to == board.enpassantSq() && (pawn_attacks & to_bb);
+
+        // moves to the last rank have to be promotions and vice versa
+        if (is_promo_target != (move.typeOf() == Move::PROMOTION)) return false;
+
+        if (pawn_attacks & to_bb) return bool(board.us(~c) & to_bb);
+        if (board.occ() & to_bb) return false;
+        if (to == from + UP) return true;
+
+        return bool(Bitboard::fromSquare(from) & RANK_START) && to == from + UP + UP &&
+               !(board.occ() & Bitboard::fromSquare(from + UP));
+    }
+
+    if (move.typeOf() != Move::NORMAL) return false;
+
+    switch (type.internal()) {
+        case PieceType::KNIGHT:
+            return bool(attacks::knight(from) & to_bb);
+        case PieceType::BISHOP:
+            return bool(attacks::bishop(from, board.occ()) & to_bb);
+        case PieceType::ROOK:
+            return bool(attacks::rook(from, board.occ()) & to_bb);
+        case PieceType::QUEEN:
+            return bool(attacks::queen(from, board.occ()) & to_bb);
+        case PieceType::KING:
+            return bool(attacks::king(from) & to_bb);
+        default:
+            return false;
+    }
+}
+
+template <Color::underlying c, typename BoardT>
+[[nodiscard]] inline bool movegen::isLegal(const BoardT &board, Move move) {
+    const auto king_sq = board.kingSq(c);
+    const auto from    = move.from();
+    const auto to      = move.to();
+
+    if (move.typeOf() == Move::CASTLING) return bool(legalCastleMoves<c>(board, king_sq) & Bitboard::fromSquare(to));
+
+    if (from == king_sq) {
+        // Sliders have to see through the king, which is moving away.
+        const auto occ    = board.occ() ^ Bitboard::fromSquare(king_sq);
+        const auto queens = board.pieces(PieceType::QUEEN, ~c);
+
+        if (attacks::pawn(c, to) & board.pieces(PieceType::PAWN, ~c)) return false;
+        if (attacks::knight(to) & board.pieces(PieceType::KNIGHT, ~c)) return false;
+        if (attacks::king(to) & board.pieces(PieceType::KING, ~c)) return false;
+        if (attacks::bishop(to, occ) & (board.pieces(PieceType::BISHOP, ~c) | queens)) return false;
+        if (attacks::rook(to, occ) & (board.pieces(PieceType::ROOK, ~c) | queens)) return false;
+
+        return true;
+    }
+
+    // Cheaper than building the check and pin masks for a single move, look at the king from the occupancy after
+    // the move instead.
+    const auto captured = move.typeOf() == Move::ENPASSANT
+                              ? Bitboard::fromSquare(to + make_direction(Direction::SOUTH, c))
+                              : Bitboard::fromSquare(to);
+
+    const auto occ    = (board.occ() & ~(Bitboard::fromSquare(from) | captured)) | Bitboard::fromSquare(to);
+    const auto them   = board.us(~c) & ~captured;
+    const auto queens = board.pieces(PieceType::QUEEN, ~c);
+
+    if (attacks::pawn(c, king_sq) & board.pieces(PieceType::PAWN, ~c) & them) return false;
+    if (attacks::knight(king_sq) & board.pieces(PieceType::KNIGHT, ~c) & them) return false;
+    if (attacks::bishop(king_sq, occ) & (board.pieces(PieceType::BISHOP, ~c) | queens) & them) return false;
+    if (attacks::rook(king_sq, occ) & (board.pieces(PieceType::ROOK, ~c) | queens) & them) return false;
+
+    return true;
+}
+
+template <Color::underlying c, typename BoardT>
+inline bool movegen::isEpSquareValid(const BoardT &board, Square ep) {
     const auto stm = board.sideToMove();
 
     Bitboard occ_us  = board.us(stm);
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <utility>
 
+#include "board_fwd.hpp"
 #include "movelist.hpp"
 
 namespace chess {
@@ -16,11 +17,14 @@ enum PieceGenType {
     KING   = 32,
 };
 
-class Board;
-
 class movegen {
    public:
-    enum class MoveGenType : std::uint8_t { ALL, CAPTURE, QUIET };
+    /**
+     * @brief ALL, CAPTURE and QUIET split the legal moves by whether they capture.
+     * EVASION generates all legal moves if the side to move is in check and none otherwise.
+     * CHECK generates the legal moves which give check, QUIET_CHECK only the non capturing ones.
+     */
+    enum class MoveGenType : std::uint8_t { ALL, CAPTURE, QUIET, EVASION, CHECK, QUIET_CHECK };
 
     /**
      * @brief Generates all legal moves for a position.
@@ -29,38 +33,112 @@ class movegen {
      * @param board
      * @param pieces
      */
-    template <MoveGenType mt = MoveGenType::ALL>
-    void static legalmoves(Movelist &movelist, const Board &board,
+    template <MoveGenType mt = MoveGenType::ALL, typename BoardT>
+    void static legalmoves(Movelist &movelist, const BoardT &board,
                            int pieces = PieceGenType::PAWN | PieceGenType::KNIGHT | PieceGenType::BISHOP |
                                         PieceGenType::ROOK | PieceGenType::QUEEN | PieceGenType::KING);
 
+    /**
+     * @brief Counts the legal moves for a position without generating them.
+     * Equal to the size of the movelist legalmoves would produce, but only
+     * popcounts the destination bitboards.
+     * @tparam mt
+     * @param board
+     * @param pieces
+     * @return
+     */
+    template <MoveGenType mt = MoveGenType::ALL, typename BoardT>
+    [[nodiscard]] static int countLegalMoves(const BoardT &board,
+                                             int pieces = PieceGenType::PAWN | PieceGenType::KNIGHT |
+                                                          PieceGenType::BISHOP | PieceGenType::ROOK |
+                                                          PieceGenType::QUEEN | PieceGenType::KING);
+
+    /**
+     * @brief Generates all pseudo legal moves for a position, these can leave the own king in check.
+     * Castling moves are only generated if they are legal. Only supports ALL, CAPTURE and QUIET.
+     * Filter the moves with Board::isLegal before playing them.
+     * @tparam mt
+     * @param movelist
+     * @param board
+     * @param pieces
+     */
+    template <MoveGenType mt = MoveGenType::ALL, typename BoardT>
+    static void pseudoLegalMoves(Movelist &movelist, const BoardT &board,
+                                 int pieces = PieceGenType::PAWN | PieceGenType::KNIGHT | PieceGenType::BISHOP |
+                                              PieceGenType::ROOK | PieceGenType::QUEEN | PieceGenType::KING);
+
    private:
     static auto init_squares_between();
     static const std::array<std::array<Bitboard, 64>, 64> SQUARES_BETWEEN_BB;
 
     // Generate the checkmask. Returns a bitboard where the attacker path between the king and enemy piece is set.
-    template <Color::underlying c>
-    [[nodiscard]] static std::pair<Bitboard, int> checkMask(const Board &board, Square sq);
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static std::pair<Bitboard, int> checkMask(const BoardT &board, Square sq);
 
     // Generate the pin mask for horizontal and vertical pins. Returns a bitboard where the ray between the king and the
     // pinner is set.
-    template <Color::underlying c>
-    [[nodiscard]] static Bitboard pinMaskRooks(const Board &board, Square sq, Bitboard occ_enemy, Bitboard occ_us);
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static Bitboard pinMaskRooks(const BoardT &board, Square sq, Bitboard occ_enemy, Bitboard occ_us);
 
     // Generate the pin mask for diagonal pins. Returns a bitboard where the ray between the king and the pinner is set.
-    template <Color::underlying c>
-    [[nodiscard]] static Bitboard pinMaskBishops(const Board &board, Square sq, Bitboard occ_enemy, Bitboard occ_us);
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static Bitboard pinMaskBishops(const BoardT &board, Square sq, Bitboard occ_enemy, Bitboard occ_us);
 
     // Returns the squares that are attacked by the enemy
-    template <Color::underlying c>
-    [[nodiscard]] static Bitboard seenSquares(const Board &board, Bitboard enemy_empty);
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static Bitboard seenSquares(const BoardT &board, Bitboard enemy_empty);
+
+    struct CheckInfo {
+        // the enemy king
+        Square king_sq;
+        // squares from which each piece type gives a direct check
+        std::array<Bitboard, 6> squares;
+        // own pieces which give a discovered check when leaving the line to the king
+        Bitboard blockers_hv;
+        Bitboard blockers_d;
+    };
+
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static CheckInfo checkInfo(const BoardT &board);
+
+    // Returns the targets of a piece on sq which uncover a check.
+    [[nodiscard]] static Bitboard discoveredCheckTargets(const CheckInfo &info, Square sq);
+
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool givesCheck(const BoardT &board, const CheckInfo &info, Move move);
+
+    // Same as above without a precomputed CheckInfo, for a single move.
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool givesCheck(const BoardT &board, Move move);
+
+    // Handles en passant and castling, which move two pieces.
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool givesCheckTwoPieces(const BoardT &board, Square king_sq, Move move);
+
+    struct PawnTargets {
+        Bitboard left;
+        Bitboard right;
+        Bitboard single_push;
+        Bitboard double_push;
+    };
+
+    // Returns the target squares of all legal pawn captures and pushes, en passant excluded.
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static PawnTargets pawnTargets(const BoardT &board, Bitboard pin_d, Bitboard pin_hv,
+                                                 Bitboard checkmask, Bitboard occ_enemy);
 
     // Generate pawn moves.
-    template <Color::underlying c, MoveGenType mt>
-    static void generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    static void generatePawnMoves(const BoardT &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
                                   Bitboard checkmask, Bitboard occ_enemy);
 
-    [[nodiscard]] static std::array<Move, 2> generateEPMove(const Board &board, Bitboard checkmask, Bitboard pin_d,
+    // Count pawn moves.
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    [[nodiscard]] static int countPawnMoves(const BoardT &board, Bitboard pin_d, Bitboard pin_hv, Bitboard checkmask,
+                                            Bitboard occ_enemy);
+
+    template <typename BoardT>
+    [[nodiscard]] static std::array<Move, 2> generateEPMove(const BoardT &board, Bitboard checkmask, Bitboard pin_d,
                                                             Bitboard pawns_lr, Square ep, Color c);
 
     [[nodiscard]] static Bitboard generateKnightMoves(Square sq);
@@ -73,19 +151,36 @@ class movegen {
 
     [[nodiscard]] static Bitboard generateKingMoves(Square sq, Bitboard seen, Bitboard movable_square);
 
-    template <Color::underlying c, MoveGenType mt>
-    [[nodiscard]] static Bitboard generateCastleMoves(const Board &board, Square sq, Bitboard seen, Bitboard pinHV);
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    [[nodiscard]] static Bitboard generateCastleMoves(const BoardT &board, Square sq, Bitboard seen, Bitboard pinHV);
 
     template <typename T>
     static void whileBitboardAdd(Movelist &movelist, Bitboard mask, T func);
 
-    template <Color::underlying c, MoveGenType mt>
-    static void legalmoves(Movelist &movelist, const Board &board, int pieces);
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    static void legalmoves(Movelist &movelist, const BoardT &board, int pieces);
+
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    [[nodiscard]] static int countLegalMoves(const BoardT &board, int pieces);
+
+    template <Color::underlying c, MoveGenType mt, typename BoardT>
+    static void pseudoLegalMoves(Movelist &movelist, const BoardT &board, int pieces);
+
+    // Returns the rook squares of all legal castling moves.
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static Bitboard legalCastleMoves(const BoardT &board, Square king_sq);
+
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool isPseudoLegal(const BoardT &board, Move move);
+
+    template <Color::underlying c, typename BoardT>
+    [[nodiscard]] static bool isLegal(const BoardT &board, Move move);
 
-    template <Color::underlying c>
-    static bool isEpSquareValid(const Board &board, Square ep);
+    template <Color::underlying c, typename BoardT>
+    static bool isEpSquareValid(const BoardT &board, Square ep);
 
-    friend class Board;
+    template <typename, typename>
+    friend class BasicBoard;
 };
 
 }  // namespace chess
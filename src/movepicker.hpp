@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "board.hpp"
+#include "move.hpp"
+#include "movegen.hpp"
+#include "movelist.hpp"
+
+namespace chess {
+
+/**
+ * @brief Hands out the legal moves of a position one at a time, in stages:
+ * the hash move, captures, killers and finally quiets.
+ * A stage is only generated once the previous one is exhausted, so a cutoff on the hash move
+ * or on a capture never pays for the quiet move generation.
+ * The board has to be in the same position whenever next() is called.
+ * @tparam BoardT
+ */
+template <typename BoardT = Board>
+class MovePicker {
+   public:
+    enum class Stage : std::uint8_t { HASH, GEN_CAPTURES, CAPTURES, KILLERS, GEN_QUIETS, QUIETS, DONE };
+
+    /**
+     * @brief
+     * @param board
+     * @param hash_move can be any move, it is only returned if it is legal in this position
+     * @param killers quiet moves which caused a cutoff at the same ply, only returned if legal
+     * @param score_captures order the captures by MVV-LVA, otherwise in generation order
+     */
+    explicit MovePicker(const BoardT &board, Move hash_move = Move::NO_MOVE, std::array<Move, 2> killers = {},
+                        bool score_captures = true)
+        : board_(board), hash_move_(hash_move), killers_(killers), score_captures_(score_captures) {}
+
+    /**
+     * @brief Returns the next legal move or Move::NO_MOVE once all moves have been returned.
+     * No move is returned twice.
+     * @return
+     */
+    [[nodiscard]] Move next() {
+        switch (stage_) {
+            case Stage::HASH:
+                stage_ = Stage::GEN_CAPTURES;
+
+                if (hash_move_ != Move::NO_MOVE && isLegal(hash_move_)) return hash_move_;
+
+                [[fallthrough]];
+            case Stage::GEN_CAPTURES:
+                movegen::legalmoves<movegen::MoveGenType::CAPTURE>(moves_, board_);
+
+                if (score_captures_) {
+                    for (auto &move : moves_) move.setScore(mvvLva(move));
+                }
+
+                index_ = 0;
+                stage_ = Stage::CAPTURES;
+
+                [[fallthrough]];
+            case Stage::CAPTURES:
+                while (index_ < moves_.size()) {
+                    const auto move = score_captures_ ? pickBest() : moves_[index_++];
+                    if (move != hash_move_) return move;
+                }
+
+                index_ = 0;
+                stage_ = Stage::KILLERS;
+
+                [[fallthrough]];
+            case Stage::KILLERS:
+                while (index_ < int(killers_.size())) {
+                    const auto killer = killers_[index_++];
+
+                    if (killer == Move::NO_MOVE || killer == hash_move_) continue;
+                    if (index_ == 2 && killer == killers_[0]) continue;
+                    if (board_.isCapture(killer) || !isLegal(killer)) continue;
+
+                    return killer;
+                }
+
+                stage_ = Stage::GEN_QUIETS;
+
+                [[fallthrough]];
+            case Stage::GEN_QUIETS:
+                if (skip_quiets_) {
+                    stage_ = Stage::DONE;
+                    return Move::NO_MOVE;
+                }
+
+                movegen::legalmoves<movegen::MoveGenType::QUIET>(moves_, board_);
+
+                index_ = 0;
+                stage_ = Stage::QUIETS;
+
+                [[fallthrough]];
+            case Stage::QUIETS:
+                while (!skip_quiets_ && index_ < moves_.size()) {
+                    const auto move = moves_[index_++];
+                    if (move != hash_move_ && move != killers_[0] && move != killers_[1]) return move;
+                }
+
+                stage_ = Stage::DONE;
+
+                [[fallthrough]];
+            case Stage::DONE:
+                return Move::NO_MOVE;
+        }
+
+        return Move::NO_MOVE;
+    }
+
+    /**
+     * @brief Don't generate or return any more quiet moves, killers are still returned.
+     * Useful for late move pruning and quiescence search.
+     */
+    void skipQuiets() noexcept { skip_quiets_ = true; }
+
+    /**
+     * @brief The stage the next call to next() continues at.
+     * @return
+     */
+    [[nodiscard]] Stage stage() const noexcept { return stage_; }
+
+   private:
+    // most valuable victim, least valuable attacker
+    [[nodiscard]] std::int16_t mvvLva(Move move) const noexcept {
+        const auto attacker = board_.template at<PieceType>(move.from());
+        const auto victim =
+            move.typeOf() == Move::ENPASSANT ? PieceType(PieceType::PAWN) : board_.template at<PieceType>(move.to());
+
+        return static_cast<std::int16_t>(int(victim) * 8 - int(attacker));
+    }
+
+    // selection sort step, the remaining captures are usually cut off
+    [[nodiscard]] Move pickBest() noexcept {
+        auto best = index_;
+
+        for (auto i = index_ + 1; i < moves_.size(); i++) {
+            if (moves_[i].score() > moves_[best].score()) best = i;
+        }
+
+        std::swap(moves_[index_], moves_[best]);
+
+        return moves_[index_++];
+    }
+
+    [[nodiscard]] bool isLegal(Move move) const { return board_.isPseudoLegal(move) && board_.isLegal(move); }
+
+    const BoardT &board_;
+
+    Movelist moves_;
+    int index_ = 0;
+
+    Move hash_move_;
+    std::array<Move, 2> killers_;
+
+    Stage stage_ = Stage::HASH;
+
+    bool score_captures_;
+    bool skip_quiets_ = false;
+};
+
+}  // namespace chess
@@ -0,0 +1,443 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "move.hpp"
+#include "movegen.hpp"
+#include "movelist.hpp"
+
+namespace chess {
+
+namespace detail {
+
+/**
+ * @brief Private class
+ * A range of task indices [begin, end) packed into a single atomic word.
+ * The owning worker pops from the front, idle workers steal from the back.
+ */
+class TaskRange {
+   public:
+    void reset(std::uint32_t begin, std::uint32_t end) noexcept { range_.store(pack(begin, end)); }
+
+    bool popFront(std::uint32_t &task) noexcept {
+        auto range = range_.load(std::memory_order_relaxed);
+
+        while (true) {
+            const auto begin = low(range), end = high(range);
+
+            if (begin >= end) return false;
+
+            if (range_.compare_exchange_weak(range, pack(begin + 1, end), std::memory_order_acq_rel)) {
+                task = begin;
+                return true;
+            }
+        }
+    }
+
+    bool popBack(std::uint32_t &task) noexcept {
+        auto range = range_.load(std::memory_order_relaxed);
+
+        while (true) {
+            const auto begin = low(range), end = high(range);
+
+            if (begin >= end) return false;
+
+            if (range_.compare_exchange_weak(range, pack(begin, end - 1), std::memory_order_acq_rel)) {
+                task = end - 1;
+                return true;
+            }
+        }
+    }
+
+   private:
+    static constexpr std::uint64_t pack(std::uint32_t begin, std::uint32_t end) noexcept {
+        return (static_cast<std::uint64_t>(end) << 32) | begin;
+    }
+
+    static constexpr std::uint32_t low(std::uint64_t range) noexcept { return static_cast<std::uint32_t>(range); }
+    static constexpr std::uint32_t high(std::uint64_t range) noexcept {
+        return static_cast<std::uint32_t>(range >> 32);
+    }
+
+    // keep every range on its own cache line, workers hammer their own range
+    alignas(64) std::atomic<std::uint64_t> range_{0};
+};
+
+}  // namespace detail
+
+/**
+ * @brief Lock-free transposition table for perft node counts, shared between threads.
+ * Node counts are limited to 56 bits. Every entry stores the key xor'ed with its data, a torn write from a concurrent
+ * store fails the verification and is treated as a miss.
+ */
+class PerftTable {
+   public:
+    struct Stats {
+        std::uint64_t probes = 0;
+        std::uint64_t hits   = 0;
+        // probes which found their slot taken by another position (or a torn entry)
+        std::uint64_t collisions = 0;
+
+        [[nodiscard]] double hitRate() const noexcept { return probes ? double(hits) / double(probes) : 0.0; }
+
+        Stats &operator+=(const Stats &other) noexcept {
+            probes += other.probes;
+            hits += other.hits;
+            collisions += other.collisions;
+            return *this;
+        }
+    };
+
+    /**
+     * @brief Allocates the largest power of two number of entries fitting into mb megabytes,
+     * at least one.
+     * @param mb
+     */
+    explicit PerftTable(std::size_t mb = 16) {
+        const auto bytes = mb * 1024 * 1024;
+
+        size_ = 1;
+        while (size_ * 2 * sizeof(Entry) <= bytes) size_ *= 2;
+
+        entries_ = std::make_unique<Entry[]>(size_);
+    }
+
+    /**
+     * @brief Empties the table and resets the statistics, not thread safe.
+     */
+    void clear() noexcept {
+        for (std::size_t i = 0; i < size_; i++) {
+            entries_[i].key.store(0, std::memory_order_relaxed);
+            entries_[i].data.store(0, std::memory_order_relaxed);
+        }
+
+        probes_.store(0, std::memory_order_relaxed);
+        hits_.store(0, std::memory_order_relaxed);
+        collisions_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of entries.
+     * @return
+     */
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+    /**
+     * @brief Statistics of all probes since construction or the last clear.
+     * @return
+     */
+    [[nodiscard]] Stats stats() const noexcept {
+        Stats stats;
+        stats.probes     = probes_.load(std::memory_order_relaxed);
+        stats.hits       = hits_.load(std::memory_order_relaxed);
+        stats.collisions = collisions_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    /**
+     * @brief Looks up the node count of a position at the given depth.
+     * Statistics are gathered in the caller's stats, see record().
+     * @param key
+     * @param depth
+     * @param nodes
+     * @param stats
+     * @return
+     */
+    bool probe(std::uint64_t key, int depth, std::uint64_t &nodes, Stats &stats) const noexcept {
+        const auto &entry = entries_[key & (size_ - 1)];
+
+        const auto data  = entry.data.load(std::memory_order_relaxed);
+        const auto check = entry.key.load(std::memory_order_relaxed) ^ data;
+
+        stats.probes++;
+
+        if (check != key) {
+            if (data != 0) stats.collisions++;
+            return false;
+        }
+
+        if (int(data & DEPTH_MASK) != depth) return false;
+
+        stats.hits++;
+        nodes = data >> DEPTH_BITS;
+        return true;
+    }
+
+    /**
+     * @brief Stores the node count of a position, always replaces the old entry.
+     * @param key
+     * @param depth
+     * @param nodes
+     */
+    void store(std::uint64_t key, int depth, std::uint64_t nodes) noexcept {
+        auto &entry = entries_[key & (size_ - 1)];
+
+        const auto data = (nodes << DEPTH_BITS) | (std::uint64_t(depth) & DEPTH_MASK);
+
+        entry.key.store(key ^ data, std::memory_order_relaxed);
+        entry.data.store(data, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Adds statistics gathered by probe() to the shared counters.
+     * @param stats
+     */
+    void record(const Stats &stats) noexcept {
+        probes_.fetch_add(stats.probes, std::memory_order_relaxed);
+        hits_.fetch_add(stats.hits, std::memory_order_relaxed);
+        collisions_.fetch_add(stats.collisions, std::memory_order_relaxed);
+    }
+
+   private:
+    static constexpr int DEPTH_BITS           = 8;
+    static constexpr std::uint64_t DEPTH_MASK = (1ull << DEPTH_BITS) - 1;
+
+    struct Entry {
+        std::atomic<std::uint64_t> key{0};
+        std::atomic<std::uint64_t> data{0};
+    };
+
+    std::unique_ptr<Entry[]> entries_;
+    std::size_t size_;
+
+    std::atomic<std::uint64_t> probes_{0};
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> collisions_{0};
+};
+
+class perft {
+   public:
+    struct Options {
+        // Number of worker threads, each worker owns one copy of the board.
+        int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+        // Number of plies which are expanded into tasks before they are distributed.
+        // 1 splits at the root, deeper splits give more (and smaller) tasks to balance.
+        int split_depth = 2;
+
+        // Optional table shared by all workers, node counts are hashed when set.
+        PerftTable *table = nullptr;
+    };
+
+    struct DivideEntry {
+        Move move;
+        std::uint64_t nodes;
+    };
+
+    struct Result {
+        std::uint64_t nodes = 0;
+
+        // node count for every legal root move, in move generation order
+        std::vector<DivideEntry> divide;
+    };
+
+    /**
+     * @brief Counts the leaf nodes of the legal move tree up to the given depth.
+     * Single threaded, the board is restored before returning.
+     * The last ply is bulk counted without making the moves.
+     * @param board
+     * @param depth
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static std::uint64_t count(BoardT &board, int depth) {
+        if (depth <= 0) return 1;
+        if (depth == 1) return movegen::countLegalMoves(board);
+
+        Movelist moves;
+        movegen::legalmoves(moves, board);
+
+        std::uint64_t nodes = 0;
+
+        for (const auto &move : moves) {
+            board.makeMove(move);
+            nodes += count(board, depth - 1);
+            board.unmakeMove(move);
+        }
+
+        return nodes;
+    }
+
+    /**
+     * @brief Counts the leaf nodes of the legal move tree up to the given depth,
+     * subtrees are looked up in and stored to the table. Keyed by Board::hash() and depth.
+     * @param board
+     * @param depth
+     * @param table
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static std::uint64_t count(BoardT &board, int depth, PerftTable &table) {
+        PerftTable::Stats stats;
+
+        const auto nodes = countHashed(board, depth, table, stats);
+
+        table.record(stats);
+
+        return nodes;
+    }
+
+    /**
+     * @brief Counts the leaf nodes for every legal root move ("divide"),
+     * using all hardware threads.
+     * @param board
+     * @param depth
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Result divide(const BoardT &board, int depth) {
+        return divide(board, depth, Options{});
+    }
+
+    /**
+     * @brief Counts the leaf nodes for every legal root move ("divide").
+     * The tree is split into tasks of split_depth plies which are scheduled
+     * on a work stealing pool of options.threads workers.
+     * @param board
+     * @param depth
+     * @param options
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Result divide(const BoardT &board, int depth, const Options &options) {
+        Result result;
+
+        if (depth <= 0) {
+            result.nodes = 1;
+            return result;
+        }
+
+        Movelist root_moves;
+        movegen::legalmoves(root_moves, board);
+
+        for (const auto &move : root_moves) result.divide.push_back({move, 0});
+
+        if (root_moves.empty()) return result;
+
+        // leave at least one ply for the workers
+        const auto split = std::clamp(options.split_depth, 1, std::clamp(depth - 1, 1, MAX_SPLIT_DEPTH));
+
+        Tasks tasks;
+
+        {
+            BoardT copy = board;
+            Move path[MAX_SPLIT_DEPTH];
+            splitTasks(copy, tasks, path, 0, split, 0);
+        }
+
+        const auto remaining = depth - split;
+        const auto n_tasks   = static_cast<std::uint32_t>(tasks.root.size());
+        const auto n_workers = std::min(static_cast<std::uint32_t>(std::max(options.threads, 1)), n_tasks);
+
+        // every root move ends the game before the split depth
+        if (n_tasks == 0) return result;
+
+        std::vector<std::uint64_t> task_nodes(n_tasks, 0);
+        std::vector<detail::TaskRange> ranges(n_workers);
+
+        // hand every worker a contiguous share, the rest is balanced by stealing
+        for (std::uint32_t i = 0; i < n_workers; i++) {
+            ranges[i].reset(n_tasks * i / n_workers, n_tasks * (i + 1) / n_workers);
+        }
+
+        const auto worker = [&](std::uint32_t id) {
+            BoardT local = board;
+
+            const auto run = [&](std::uint32_t task) {
+                const auto *path = &tasks.moves[std::size_t(task) * split];
+
+                for (int i = 0; i < split; i++) local.makeMove(path[i]);
+                task_nodes[task] =
+                    options.table ? count(local, remaining, *options.table) : count(local, remaining);
+                for (int i = split - 1; i >= 0; i--) local.unmakeMove(path[i]);
+            };
+
+            std::uint32_t task;
+
+            while (ranges[id].popFront(task)) run(task);
+
+            for (std::uint32_t i = 1; i < n_workers; i++) {
+                auto &victim = ranges[(id + i) % n_workers];
+                while (victim.popBack(task)) run(task);
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (std::uint32_t i = 1; i < n_workers; i++) threads.emplace_back(worker, i);
+
+        worker(0);
+
+        for (auto &thread : threads) thread.join();
+
+        for (std::uint32_t i = 0; i < n_tasks; i++) {
+            result.divide[tasks.root[i]].nodes += task_nodes[i];
+        }
+
+        for (const auto &entry : result.divide) result.nodes += entry.nodes;
+
+        return result;
+    }
+
+   private:
+    static constexpr int MAX_SPLIT_DEPTH = 8;
+
+    struct Tasks {
+        // moves of all task paths, stored back to back with split_depth moves each
+        std::vector<Move> moves;
+        // index of the root move every task belongs to
+        std::vector<std::uint32_t> root;
+    };
+
+    template <typename BoardT>
+    static std::uint64_t countHashed(BoardT &board, int depth, PerftTable &table, PerftTable::Stats &stats) {
+        // not worth a probe, counting is cheaper than the cache miss
+        if (depth <= 1) return count(board, depth);
+
+        std::uint64_t nodes = 0;
+
+        if (table.probe(board.hash(), depth, nodes, stats)) return nodes;
+
+        Movelist moves;
+        movegen::legalmoves(moves, board);
+
+        for (const auto &move : moves) {
+            board.makeMove(move);
+            nodes += countHashed(board, depth - 1, table, stats);
+            board.unmakeMove(move);
+        }
+
+        table.store(board.hash(), depth, nodes);
+
+        return nodes;
+    }
+
+    template <typename BoardT>
+    static void splitTasks(BoardT &board, Tasks &tasks, Move *path, int ply, int split, std::uint32_t root) {
+        if (ply == split) {
+            tasks.moves.insert(tasks.moves.end(), path, path + split);
+            tasks.root.push_back(root);
+            return;
+        }
+
+        Movelist moves;
+        movegen::legalmoves(moves, board);
+
+        for (int i = 0; i < moves.size(); i++) {
+            path[ply] = moves[i];
+
+            board.makeMove(moves[i]);
+            splitTasks(board, tasks, path, ply + 1, split, ply == 0 ? i : root);
+            board.unmakeMove(moves[i]);
+        }
+    }
+};
+
+}  // namespace chess
@@ -1,15 +1,339 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <istream>
+#include <iterator>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "constants.hpp"
+#include "move.hpp"
+#include "movelist.hpp"
+#include "uci.hpp"
+
+#if defined(__unix__) || defined(__unix) || defined(unix) || defined(__APPLE__) || defined(__MACH__)
+#    define CHESS_PGN_MMAP
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+/*
+ The tokenizer scans 32 (AVX2) or 16 (SSE2) bytes at a time when the target supports it,
+ define CHESS_PGN_NO_SIMD to always use the scalar loops.
+*/
+#if !defined(CHESS_PGN_NO_SIMD)
+#    if defined(__AVX2__)
+#        define CHESS_PGN_AVX2
+#        define CHESS_PGN_SSE2
+#    elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#        define CHESS_PGN_SSE2
+#    endif
+#endif
+
+/*
+ Define CHESS_PGN_ZLIB (link zlib) for pgn::GzipSource and CHESS_PGN_ZSTD (link libzstd) for pgn::ZstdSource,
+ the meson builds define them when the libraries are found.
+*/
+#if defined(CHESS_PGN_ZLIB)
+#    include <zlib.h>
+#endif
+
+#if defined(CHESS_PGN_ZSTD)
+#    include <zstd.h>
+#endif
+
+#if defined(CHESS_PGN_SSE2)
+#    include <immintrin.h>
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#    endif
+#endif
 
 namespace chess::pgn {
 
+/**
+ * @brief Chunked input of a StreamParser, the parser reads directly into its buffer through it.
+ * Derive from it to parse from other inputs, i.e. a socket or a decompressor.
+ */
+class InputSource {
+   public:
+    virtual ~InputSource() = default;
+
+    /**
+     * @brief Reads up to size bytes into buffer.
+     * @param buffer
+     * @param size
+     * @return the number of bytes read, 0 at the end of the input or on error
+     */
+    virtual std::size_t read(char *buffer, std::size_t size) = 0;
+};
+
+/**
+ * @brief Reads from a std::istream, used by StreamParser(std::istream &).
+ */
+class IstreamSource : public InputSource {
+   public:
+    explicit IstreamSource(std::istream &stream) : stream_(stream) {}
+
+    std::size_t read(char *buffer, std::size_t size) override {
+        stream_.read(buffer, static_cast<std::streamsize>(size));
+        return static_cast<std::size_t>(stream_.gcount());
+    }
+
+   private:
+    std::istream &stream_;
+};
+
+#if defined(CHESS_PGN_ZLIB)
+/**
+ * @brief Decompresses a gzip file (.pgn.gz) while it is parsed, uncompressed files are read as they are.
+ */
+class GzipSource : public InputSource {
+   public:
+    explicit GzipSource(const std::string &path) : file_(gzopen(path.c_str(), "rb")) {
+        if (file_) gzbuffer(file_, 1 << 17);
+    }
+
+    GzipSource(const GzipSource &)            = delete;
+    GzipSource &operator=(const GzipSource &) = delete;
+
+    ~GzipSource() override {
+        if (file_) gzclose(file_);
+    }
+
+    bool isOpen() const noexcept { return file_ != nullptr; }
+
+    /**
+     * @brief True if the input was corrupted or truncated, the parser saw it end early.
+     * @return
+     */
+    bool error() const noexcept { return error_; }
+
+    std::size_t read(char *buffer, std::size_t size) override {
+        if (!file_) return 0;
+
+        std::size_t total = 0;
+
+        // gzread takes an unsigned int
+        while (total < size) {
+            const auto chunk = static_cast<unsigned>(std::min<std::size_t>(size - total, 1u << 30));
+            const auto bytes = gzread(file_, buffer + total, chunk);
+
+            if (bytes <= 0) {
+                // a truncated file ends with Z_BUF_ERROR
+                int code = Z_OK;
+                gzerror(file_, &code);
+                error_ = bytes < 0 || code != Z_OK;
+                break;
+            }
+
+            total += static_cast<std::size_t>(bytes);
+        }
+
+        return total;
+    }
+
+   private:
+    gzFile file_;
+    bool error_ = false;
+};
+#endif
+
+#if defined(CHESS_PGN_ZSTD)
+/**
+ * @brief Decompresses a zstd file (.pgn.zst) while it is parsed, frames may be concatenated.
+ */
+class ZstdSource : public InputSource {
+   public:
+    explicit ZstdSource(const std::string &path)
+        : file_(std::fopen(path.c_str(), "rb")), context_(ZSTD_createDCtx()), input_(ZSTD_DStreamInSize()) {}
+
+    ZstdSource(const ZstdSource &)            = delete;
+    ZstdSource &operator=(const ZstdSource &) = delete;
+
+    ~ZstdSource() override {
+        if (file_) std::fclose(file_);
+        ZSTD_freeDCtx(context_);
+    }
+
+    bool isOpen() const noexcept { return file_ != nullptr && context_ != nullptr; }
+
+    /**
+     * @brief True if the input was corrupted or truncated, the parser saw it end early.
+     * @return
+     */
+    bool error() const noexcept { return error_; }
+
+    std::size_t read(char *buffer, std::size_t size) override {
+        if (!isOpen() || error_) return 0;
+
+        ZSTD_outBuffer out = {buffer, size, 0};
+
+        while (out.pos < out.size) {
+            if (in_.pos == in_.size) {
+                const auto bytes = std::fread(input_.data(), 1, input_.size(), file_);
+
+                if (bytes == 0) {
+                    // the last frame wasn't finished
+                    error_ = frame_left_ != 0;
+                    break;
+                }
+
+                in_ = {input_.data(), bytes, 0};
+            }
+
+            frame_left_ = ZSTD_decompressStream(context_, &out, &in_);
+
+            if (ZSTD_isError(frame_left_)) {
+                error_ = true;
+                break;
+            }
+        }
+
+        return out.pos;
+    }
+
+   private:
+    std::FILE *file_;
+    ZSTD_DCtx *context_;
+
+    std::vector<char> input_;
+    ZSTD_inBuffer in_ = {nullptr, 0, 0};
+
+    // 0 once a frame is complete
+    std::size_t frame_left_ = 0;
+    bool error_             = false;
+};
+#endif
+
 namespace detail {
 
+#if defined(CHESS_PGN_SSE2)
+inline int firstBit(std::uint32_t mask) noexcept {
+#    if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#    else
+    return __builtin_ctz(mask);
+#    endif
+}
+
+// bit i is set if first[i] is (In = true) or is not (In = false) one of Chars
+template <bool In, char... Chars>
+std::uint32_t blockMask16(const char *first) noexcept {
+    const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    auto match       = _mm_setzero_si128();
+
+    ((match = _mm_or_si128(match, _mm_cmpeq_epi8(block, _mm_set1_epi8(Chars)))), ...);
+
+    const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(match));
+
+    return In ? mask : ~mask & 0xFFFF;
+}
+#endif
+
+#if defined(CHESS_PGN_AVX2)
+template <bool In, char... Chars>
+std::uint32_t blockMask32(const char *first) noexcept {
+    const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    auto match       = _mm256_setzero_si256();
+
+    ((match = _mm256_or_si256(match, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(Chars)))), ...);
+
+    const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(match));
+
+    return In ? mask : ~mask;
+}
+#endif
+
+/**
+ * @brief Returns the first character in [first, last) which is (In = true) or is not (In = false)
+ * one of Chars, or last. With Blocks 16 or 32 bytes are compared at a time, which only pays off for long tokens.
+ * @tparam In
+ * @tparam Blocks
+ * @tparam Chars
+ */
+template <bool In, bool Blocks, char... Chars>
+const char *findFirst(const char *first, const char *last) noexcept {
+#if defined(CHESS_PGN_SSE2)
+    if constexpr (Blocks) {
+        // most comments and header values fit into the first block
+        if (last - first >= 16) {
+            if (const auto mask = blockMask16<In, Chars...>(first)) return first + firstBit(mask);
+            first += 16;
+        }
+
+#    if defined(CHESS_PGN_AVX2)
+        for (; last - first >= 32; first += 32) {
+            if (const auto mask = blockMask32<In, Chars...>(first)) return first + firstBit(mask);
+        }
+#    endif
+
+        for (; last - first >= 16; first += 16) {
+            if (const auto mask = blockMask16<In, Chars...>(first)) return first + firstBit(mask);
+        }
+    }
+#endif
+
+    for (; first != last; ++first) {
+        if (((*first == Chars) || ...) == In) break;
+    }
+
+    return first;
+}
+
+/**
+ * @brief Private class
+ * Matches the characters which are (In = true) or are not (In = false) one of Chars.
+ * @tparam In
+ * @tparam Blocks scan in blocks, for long tokens
+ * @tparam Chars
+ */
+template <bool In, bool Blocks, char... Chars>
+struct CharClass {
+    constexpr bool operator()(char c) const noexcept { return ((c == Chars) || ...) == In; }
+
+    // first matching character in [first, last), or last
+    static const char *find(const char *first, const char *last) noexcept {
+        return findFirst<In, Blocks, Chars...>(first, last);
+    }
+
+    // first character in [first, last) which doesn't match, or last
+    static const char *skip(const char *first, const char *last) noexcept {
+        return findFirst<!In, Blocks, Chars...>(first, last);
+    }
+};
+
+// short tokens, i.e. moves and whitespace
+template <char... Chars>
+using AnyOf = CharClass<true, false, Chars...>;
+
+template <char... Chars>
+using NoneOf = CharClass<false, false, Chars...>;
+
+// long tokens, i.e. comments, header values and variations
+template <char... Chars>
+using BlockAnyOf = CharClass<true, true, Chars...>;
+
+template <char... Chars>
+using BlockNoneOf = CharClass<false, true, Chars...>;
+
 /**
  * @brief Private class
  */
@@ -33,6 +357,18 @@ class StringBuffer {
         return true;
     }
 
+    bool copy(std::string_view str) {
+        if (index_ + str.size() > N) {
+            return false;
+        }
+
+        std::copy(str.begin(), str.end(), buffer_.begin() + index_);
+
+        index_ += str.size();
+
+        return true;
+    }
+
    private:
     // PGN String Tokens are limited to 255 characters
     static constexpr int N = 255;
@@ -42,6 +378,89 @@ class StringBuffer {
     std::size_t index_ = 0;
 };
 
+/**
+ * @brief Private class
+ * A token which is a view into the input as long as its parts are contiguous there,
+ * otherwise it is copied.
+ */
+class ViewBuffer {
+   public:
+    // PGN String Tokens are limited to 255 characters
+    explicit ViewBuffer(std::size_t max_size = 255) : max_size_(max_size) {}
+
+    bool empty() const noexcept { return view_.empty() && copy_.empty(); }
+
+    void clear() noexcept {
+        view_   = {};
+        copied_ = false;
+        copy_.clear();
+    }
+
+    std::string_view get() const noexcept { return copied_ ? std::string_view(copy_) : view_; }
+
+    bool add(char c) {
+        if (get().size() >= max_size_) {
+            return false;
+        }
+
+        toCopy();
+        copy_ += c;
+
+        return true;
+    }
+
+    bool copy(std::string_view str) {
+        if (get().size() + str.size() > max_size_) {
+            return false;
+        }
+
+        toCopy();
+        copy_.append(str);
+
+        return true;
+    }
+
+    // str has to outlive the token
+    bool append(std::string_view str) {
+        if (get().size() + str.size() > max_size_) {
+            return false;
+        }
+
+        if (!copied_) {
+            if (view_.empty()) {
+                view_ = str;
+                return true;
+            }
+
+            if (view_.data() + view_.size() == str.data()) {
+                view_ = std::string_view(view_.data(), view_.size() + str.size());
+                return true;
+            }
+
+            toCopy();
+        }
+
+        copy_.append(str);
+
+        return true;
+    }
+
+   private:
+    void toCopy() {
+        if (copied_) return;
+
+        copy_.assign(view_.data(), view_.size());
+        copied_ = true;
+    }
+
+    std::size_t max_size_;
+
+    std::string_view view_;
+
+    bool copied_ = false;
+    std::string copy_;
+};
+
 /**
  * @brief Private class
  * @tparam BUFFER_SIZE
@@ -53,7 +472,16 @@ class StreamBuffer {
     using BufferType               = std::array<char, N * N>;
 
    public:
-    StreamBuffer(std::istream &stream) : stream_(stream) {}
+    // tokens are copied, the buffer is refilled while reading them
+    using Token = StringBuffer;
+
+    StreamBuffer(std::istream &stream) : istream_(stream), source_(&*istream_) {}
+
+    StreamBuffer(InputSource &source) : source_(&source) {}
+
+    // source_ may point to istream_
+    StreamBuffer(const StreamBuffer &)            = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
 
     // Get the current character, skip carriage returns
     std::optional<char> some() {
@@ -75,43 +503,20 @@ class StreamBuffer {
         }
     }
 
-    // Assume that the current character is already the opening_delim
-    bool skipUntil(char open_delim, char close_delim) {
-        int stack = 0;
-
-        while (true) {
-            const auto ret = some();
-            advance();
+    bool fill() {
+        consumed_ += bytes_read_;
+        buffer_index_ = 0;
 
-            if (!ret.has_value()) {
-                return false;
-            }
+        // a character which was read by peek() comes first
+        std::size_t peeked = 0;
 
-            if (*ret == open_delim) {
-                ++stack;
-            } else if (*ret == close_delim) {
-                if (stack == 0) {
-                    // Mismatched closing delimiter
-                    return false;
-                } else {
-                    --stack;
-                    if (stack == 0) {
-                        // Matching closing delimiter found
-                        return true;
-                    }
-                }
-            }
+        if (peeked_) {
+            buffer_[0] = *peeked_;
+            peeked_.reset();
+            peeked = 1;
         }
 
-        // If we reach this point, there are unmatched opening delimiters
-        return false;
-    }
-
-    bool fill() {
-        buffer_index_ = 0;
-
-        stream_.read(buffer_.data(), N * N);
-        bytes_read_ = stream_.gcount();
+        bytes_read_ = static_cast<std::streamsize>(peeked + source_->read(buffer_.data() + peeked, N * N - peeked));
 
         return bytes_read_ > 0;
     }
@@ -126,7 +531,13 @@ class StreamBuffer {
 
     char peek() {
         if (buffer_index_ + 1 >= bytes_read_) {
-            return stream_.peek();
+            if (!peeked_) {
+                char c;
+                if (source_->read(&c, 1) == 0) return '\0';
+                peeked_ = c;
+            }
+
+            return *peeked_;
         }
 
         return buffer_[buffer_index_ + 1];
@@ -140,34 +551,216 @@ class StreamBuffer {
         return buffer_[buffer_index_];
     }
 
+    // Skip the characters matched by the char class and carriage returns
+    template <bool In, bool Blocks, char... Chars>
+    void skipWhile(CharClass<In, Blocks, Chars...> predicate) {
+        while (auto c = some()) {
+            if (!predicate(*c)) {
+                break;
+            }
+
+            const auto first = buffer_.data() + buffer_index_;
+            buffer_index_    = predicate.skip(first, buffer_.data() + bytes_read_) - buffer_.data();
+        }
+    }
+
+    // Add characters to the token until one of Chars, the stop character is not consumed.
+    // Carriage returns are skipped. Returns false if the token is full.
+    template <typename Token, bool Blocks, char... Chars>
+    bool readUntil(Token &token, CharClass<true, Blocks, Chars...>) {
+        while (auto c = some()) {
+            if (((*c == Chars) || ...)) {
+                break;
+            }
+
+            const auto first = buffer_.data() + buffer_index_;
+            const auto last  = CharClass<true, Blocks, Chars..., '\r'>::find(first, buffer_.data() + bytes_read_);
+
+            if (!token.copy(std::string_view(first, last - first))) {
+                return false;
+            }
+
+            buffer_index_ = last - buffer_.data();
+        }
+
+        return true;
+    }
+
+    // Skip to the next line which starts with c, the current position counts as the start of a line
+    void skipToLine(char c) {
+        auto line_start = true;
+
+        while (auto curr = some()) {
+            if (line_start && *curr == c) {
+                return;
+            }
+
+            const auto first   = buffer_.data() + buffer_index_;
+            const auto newline = std::memchr(first, '\n', bytes_read_ - buffer_index_);
+
+            line_start    = newline != nullptr;
+            buffer_index_ = newline ? static_cast<const char *>(newline) - buffer_.data() + 1 : bytes_read_;
+        }
+    }
+
+    // Byte offset of the current character in the stream, relative to where reading started
+    std::uint64_t offset() const noexcept {
+        // the parser may advance once past the end of the input
+        return consumed_ + std::min(buffer_index_, bytes_read_);
+    }
+
    private:
-    std::istream &stream_;
+    std::optional<IstreamSource> istream_;
+    InputSource *source_;
+    std::optional<char> peeked_;
+
     BufferType buffer_;
     std::streamsize bytes_read_   = 0;
     std::streamsize buffer_index_ = 0;
-};
 
-}  // namespace detail
+    // bytes of all previous fills
+    std::uint64_t consumed_ = 0;
+};
 
 /**
- * @brief Visitor interface for parsing PGN files
+ * @brief Private class
+ * Reads from memory which outlives the parser, tokens are views into it.
  */
-class Visitor {
+class MemoryBuffer {
    public:
-    virtual ~Visitor() {};
+    using Token = ViewBuffer;
 
-    /**
-     * @brief When true, the current PGN will be skipped and only
-     * endPgn will be called, this will also reset the skip flag to false.
-     * Has to be called after startPgn.
-     * @param skip
-     */
-    void skipPgn(bool skip) { skip_ = skip; }
-    bool skip() { return skip_; }
+    MemoryBuffer(std::string_view data) : data_(data.data()), size_(data.size()) {}
 
-    /**
-     * @brief Called when a new PGN starts
-     */
+    // Get the current character, skip carriage returns
+    std::optional<char> some() noexcept {
+        while (index_ < size_) {
+            const auto c = data_[index_];
+
+            if (c != '\r') {
+                return c;
+            }
+
+            ++index_;
+        }
+
+        return std::nullopt;
+    }
+
+    bool fill() const noexcept { return index_ < size_; }
+
+    void advance() noexcept { ++index_; }
+
+    char peek() const noexcept { return index_ + 1 < size_ ? data_[index_ + 1] : '\0'; }
+
+    std::optional<char> current() const noexcept {
+        return index_ < size_ ? std::optional<char>(data_[index_]) : std::nullopt;
+    }
+
+    // Same as StreamBuffer::skipWhile
+    template <bool In, bool Blocks, char... Chars>
+    void skipWhile(CharClass<In, Blocks, Chars...> predicate) {
+        while (true) {
+            index_ = predicate.skip(data_ + index_, data_ + size_) - data_;
+
+            if (index_ < size_ && data_[index_] == '\r') {
+                ++index_;
+                continue;
+            }
+
+            return;
+        }
+    }
+
+    // Same as StreamBuffer::readUntil, but the token is a view into the input
+    template <bool Blocks, char... Chars>
+    bool readUntil(ViewBuffer &token, CharClass<true, Blocks, Chars...>) {
+        while (true) {
+            const auto start = index_;
+
+            index_ = CharClass<true, Blocks, Chars..., '\r'>::find(data_ + index_, data_ + size_) - data_;
+
+            if (!token.append(std::string_view(data_ + start, index_ - start))) {
+                return false;
+            }
+
+            if (index_ < size_ && data_[index_] == '\r') {
+                ++index_;
+                continue;
+            }
+
+            return true;
+        }
+    }
+
+    std::uint64_t offset() const noexcept { return std::min(index_, size_); }
+
+    // Same as StreamBuffer::skipToLine
+    void skipToLine(char c) {
+        while (index_ < size_ && data_[index_] == '\r') ++index_;
+
+        while (index_ < size_ && data_[index_] != c) {
+            const auto newline = std::memchr(data_ + index_, '\n', size_ - index_);
+
+            index_ = newline ? static_cast<const char *>(newline) - data_ + 1 : size_;
+
+            while (index_ < size_ && data_[index_] == '\r') ++index_;
+        }
+    }
+
+   private:
+    const char *data_;
+    std::size_t size_;
+    std::size_t index_ = 0;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Visitor interface for parsing PGN files
+ */
+class Visitor {
+   public:
+    virtual ~Visitor() {};
+
+    /**
+     * @brief When true, the current PGN will be skipped and only
+     * endPgn will be called, this will also reset the skip flag to false.
+     * Has to be called after startPgn.
+     * @param skip
+     */
+    void skipPgn(bool skip) { skip_ = skip; }
+    bool skip() { return skip_; }
+
+    /**
+     * @brief When true, the moves of all following games are skipped without parsing them,
+     * by jumping to the next line which starts with '['. Only startPgn, header, startMoves and
+     * endPgn are called. Games have to be separated by a newline and a comment must not contain
+     * a line which starts with '['.
+     * @param headers_only
+     */
+    void headersOnly(bool headers_only) { headers_only_ = headers_only; }
+    bool headersOnly() const { return headers_only_; }
+
+    /**
+     * @brief When true, comments are skipped without copying them and move is called with an
+     * empty comment. A comment in a game without moves isn't passed to move("", comment) then.
+     * @param skip_comments
+     */
+    void skipComments(bool skip_comments) { skip_comments_ = skip_comments; }
+    bool skipComments() const { return skip_comments_; }
+
+    /**
+     * @brief When true, variations are parsed instead of skipped. startVariation and endVariation are
+     * called around the moves of a variation, which is an alternative to the last move passed to move().
+     * @param variations
+     */
+    void variations(bool variations) { variations_ = variations; }
+    bool variations() const { return variations_; }
+
+    /**
+     * @brief Called when a new PGN starts
+     */
     virtual void startPgn() = 0;
 
     /**
@@ -194,550 +787,1739 @@ class Visitor {
      */
     virtual void endPgn() = 0;
 
+    /**
+     * @brief Called before the first move of a variation, only if variations(true) was set
+     */
+    virtual void startVariation() {}
+
+    /**
+     * @brief Called after the last move of a variation, only if variations(true) was set
+     */
+    virtual void endVariation() {}
+
+    /**
+     * @brief Called after move() for every numeric annotation glyph of the move, i.e. 1 for $1
+     * @param nag
+     */
+    virtual void nag(int) {}
+
    private:
-    bool skip_ = false;
+    bool skip_          = false;
+    bool headers_only_  = false;
+    bool skip_comments_ = false;
+    bool variations_    = false;
 };
 
-class StreamParserError {
+/**
+ * @brief Visitor which replays the games on a board and passes every move, decoded from SAN, together with
+ * the board after the move to replay(). A FEN header sets up the start position and a Variant header
+ * containing 960 enables Chess960. Derived classes which override startPgn or header have to call the
+ * ReplayVisitor versions. A game with a move which can't be decoded or isn't legal is skipped from there on,
+ * see invalid().
+ * @tparam BoardT
+ */
+template <typename BoardT = Board>
+class ReplayVisitor : public Visitor {
    public:
-    enum Code {
-        None,
-        ExceededMaxStringLength,
-        InvalidHeaderMissingClosingBracket,
-        InvalidHeaderMissingClosingQuote,
-        NotEnoughData
-    };
+    /**
+     * @brief Called for each move of a game
+     * @param move the decoded move
+     * @param board the position after the move
+     * @param comment
+     */
+    virtual void replay(Move move, const BoardT &board, std::string_view comment) = 0;
 
-    StreamParserError() : code_(None) {}
+    void startPgn() override {
+        if (board_.chess960()) board_.set960(false);
+        board_.setFen(constants::STARTPOS);
 
-    StreamParserError(Code code) : code_(code) {}
+        invalid_ = false;
+    }
 
-    Code code() const { return code_; }
+    void header(std::string_view key, std::string_view value) override {
+        if (key == "FEN") {
+            board_.setFen(value);
+        } else if (key == "Variant" && value.find("960") != std::string_view::npos) {
+            board_.set960(true);
+        }
+    }
 
-    bool hasError() const { return code_ != None; }
+    void startMoves() override {}
 
-    std::string message() const {
-        switch (code_) {
-            case None:
-                return "No error";
-            case InvalidHeaderMissingClosingBracket:
-                return "Invalid header: missing closing bracket";
-            case InvalidHeaderMissingClosingQuote:
-                return "Invalid header: missing closing quote";
-            case NotEnoughData:
-                return "Not enough data";
-            default:
-                assert(false);
-                return "Unknown error";
+    void move(std::string_view san, std::string_view comment) final {
+        const auto move = uci::tryParseSan(board_, san, moves_).valueOr(Move::NO_MOVE);
+
+        if (move == Move::NO_MOVE) {
+            invalid_ = true;
+            skipPgn(true);
+            return;
         }
+
+        board_.makeMove(move);
+
+        replay(move, board_, comment);
     }
 
-    bool operator==(Code code) const { return code_ == code; }
-    bool operator!=(Code code) const { return code_ != code; }
-    bool operator==(const StreamParserError &other) const { return code_ == other.code_; }
-    bool operator!=(const StreamParserError &other) const { return code_ != other.code_; }
+    void endPgn() override {}
 
-    operator bool() const { return code_ != None; }
+    /**
+     * @brief The board of the current game
+     * @return
+     */
+    [[nodiscard]] const BoardT &board() const noexcept { return board_; }
+
+    /**
+     * @brief True if the current game had a move which couldn't be decoded, replay() wasn't called
+     * for it and the following moves.
+     * @return
+     */
+    [[nodiscard]] bool invalid() const noexcept { return invalid_; }
 
    private:
-    Code code_;
+    BoardT board_;
+
+    // reused by the san decoding
+    Movelist moves_;
+
+    bool invalid_ = false;
 };
 
-template <std::size_t BUFFER_SIZE =
-#if defined(__APPLE__) || defined(__MACH__)
-              256
-#elif defined(__unix__) || defined(__unix) || defined(unix)
-              1024
-#else
-              256
-#endif
-          >
-class StreamParser {
-   public:
-    StreamParser(std::istream &stream) : stream_buffer(stream) {}
+/**
+ * @brief Engine output found in a move comment, fields which aren't in the comment are empty.
+ * The score is from the point of view the comment was written in, cutechess and fastchess use the
+ * side which made the move, [%eval] uses white.
+ */
+struct Annotation {
+    // centipawns
+    std::optional<int> score;
 
-    StreamParserError readGames(Visitor &vis) {
-        visitor = &vis;
+    // moves until mate, negative if the side is getting mated
+    std::optional<int> mate;
 
-        if (!stream_buffer.fill()) {
-            return StreamParserError::NotEnoughData;
-        }
+    std::optional<int> depth;
 
-        while (auto c = stream_buffer.some()) {
-            if (in_header) {
-                visitor->skipPgn(false);
+    // time spent on the move
+    std::optional<std::chrono::milliseconds> time;
 
-                if (*c == '[') {
-                    visitor->startPgn();
-                    pgn_end = false;
+    // time left on the clock after the move
+    std::optional<std::chrono::milliseconds> clock;
 
-                    processHeader();
+    [[nodiscard]] bool empty() const noexcept { return !score && !mate && !depth && !time && !clock; }
+};
 
-                    if (error != StreamParserError::None) {
-                        return error;
-                    }
-                }
+namespace detail {
 
-            } else if (in_body) {
-                processBody();
+/**
+ * @brief Private class
+ * Reads the numbers of an annotation comment, nothing is allocated.
+ */
+class AnnotationReader {
+   public:
+    explicit AnnotationReader(std::string_view str) noexcept : pos_(str.data()), end_(str.data() + str.size()) {}
 
-                if (error != StreamParserError::None) {
-                    return error;
-                }
-            }
+    [[nodiscard]] char peek() const noexcept { return pos_ < end_ ? *pos_ : '\0'; }
 
-            if (!dont_advance_after_body) stream_buffer.advance();
-            dont_advance_after_body = false;
-        }
+    bool consume(char c) noexcept {
+        if (peek() != c) return false;
 
-        if (!pgn_end) {
-            onEnd();
-        }
+        ++pos_;
+        return true;
+    }
 
-        return error;
+    bool consume(std::string_view str) noexcept {
+        if (std::size_t(end_ - pos_) < str.size() || std::string_view(pos_, str.size()) != str) return false;
+
+        pos_ += str.size();
+        return true;
     }
 
-   private:
-    void reset_trackers() {
-        header.first.clear();
-        header.second.clear();
+    void skipSpaces() noexcept {
+        while (peek() == ' ') ++pos_;
+    }
 
-        move.clear();
-        comment.clear();
+    // -1 for '-', otherwise 1, a '+' is skipped
+    int sign() noexcept {
+        if (consume('-')) return -1;
 
-        in_header = true;
-        in_body   = false;
+        consume('+');
+        return 1;
     }
 
-    void callVisitorMoveFunction() {
-        if (!move.empty()) {
-            if (!visitor->skip()) visitor->move(move.get(), comment);
+    std::optional<std::int64_t> number() noexcept {
+        if (!isDigit(peek())) return std::nullopt;
 
-            move.clear();
-            comment.clear();
+        std::int64_t value = 0;
+
+        for (int digits = 0; isDigit(peek()); ++pos_) {
+            // long numbers aren't engine output, don't let them overflow
+            if (++digits <= 15) value = value * 10 + (*pos_ - '0');
         }
+
+        return value;
     }
 
-    void processHeader() {
-        bool backslash = false;
+    /**
+     * @brief A decimal number scaled by 10^Decimals, further decimals are dropped, i.e. "0.357" is 35
+     * for Decimals = 2.
+     * @tparam Decimals
+     * @return
+     */
+    template <int Decimals>
+    std::optional<std::int64_t> decimal() noexcept {
+        auto value = number();
 
-        while (auto c = stream_buffer.some()) {
-            switch (*c) {
-                // tag start
-                case '[':
-                    stream_buffer.advance();
+        if (!value) return std::nullopt;
 
-                    while (auto k = stream_buffer.some()) {
-                        if (is_space(*k)) {
-                            break;
-                        } else {
-                            if (!header.first.add(*k)) {
-                                error = StreamParserError::ExceededMaxStringLength;
-                                return;
-                            }
+        int decimals = 0;
 
-                            stream_buffer.advance();
-                        }
-                    }
+        if (consume('.')) {
+            for (; isDigit(peek()); ++pos_) {
+                if (decimals < Decimals) {
+                    *value = *value * 10 + (*pos_ - '0');
+                    decimals++;
+                }
+            }
+        }
 
-                    stream_buffer.advance();
-                    break;
-                case '"':
-                    stream_buffer.advance();
+        for (; decimals < Decimals; decimals++) *value *= 10;
 
-                    while (auto k = stream_buffer.some()) {
-                        if (*k == '\\') {
-                            backslash = true;
-                            // don't add backslash to header, is this really correct?
-                            stream_buffer.advance();
-                        } else if (*k == '"' && !backslash) {
-                            stream_buffer.advance();
+        return value;
+    }
 
-                            // we should be now at ]
-                            if (stream_buffer.current().value_or('\0') != ']') {
-                                error = StreamParserError::InvalidHeaderMissingClosingBracket;
-                                return;
-                            }
+    // [[h:]m:]s[.fraction]
+    std::optional<std::chrono::milliseconds> clock() noexcept {
+        std::int64_t seconds = 0;
 
-                            stream_buffer.advance();
+        for (int parts = 0; parts < 2; parts++) {
+            const auto start = pos_;
+            const auto value = number();
 
-                            break;
-                        } else if (*k == '\n') {
-                            // we missed the closing quote and read until the newline character
-                            // this is an invalid pgn, let's throw an error
-                            error = StreamParserError::InvalidHeaderMissingClosingQuote;
-                            return;
-                        } else {
-                            backslash = false;
+            if (!value) return std::nullopt;
 
-                            if (!header.second.add(*k)) {
-                                error = StreamParserError::ExceededMaxStringLength;
-                                return;
-                            }
+            if (!consume(':')) {
+                pos_ = start;
+                break;
+            }
 
-                            stream_buffer.advance();
-                        }
-                    }
+            seconds = (seconds + *value) * 60;
+        }
+
+        const auto ms = decimal<3>();
+
+        if (!ms) return std::nullopt;
+
+        return std::chrono::milliseconds(seconds * 1000 + *ms);
+    }
+
+   private:
+    static bool isDigit(char c) noexcept { return c >= '0' && c <= '9'; }
+
+    const char *pos_;
+    const char *end_;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Decodes the engine output of a move comment without allocating. Understands the cutechess and
+ * fastchess format {+0.35/18 1.2s} or {-M5/30 0.1s} at the start of the comment and the
+ * [%eval 0.35], [%eval #-3], [%eval 0.35,18], [%clk 0:01:02.5] and [%emt 0:00:05] commands anywhere in it.
+ * @param comment
+ * @return
+ */
+inline Annotation parseAnnotation(std::string_view comment) noexcept {
+    Annotation annotation;
+
+    // score or mate, followed by the depth
+    {
+        detail::AnnotationReader reader(comment);
+        reader.skipSpaces();
+
+        const auto sign = reader.sign();
+
+        std::optional<int> score, mate;
+
+        if (reader.consume('M') || reader.consume('#')) {
+            if (const auto moves = reader.number()) mate = sign * int(*moves);
+        } else if (const auto centipawns = reader.decimal<2>()) {
+            score = sign * int(*centipawns);
+        }
+
+        const auto depth = reader.consume('/') ? reader.number() : std::nullopt;
+
+        // the depth tells it apart from a comment which just starts with a number
+        if ((score || mate) && depth) {
+            annotation.score = score;
+            annotation.mate  = mate;
+            annotation.depth = int(*depth);
+
+            reader.skipSpaces();
+
+            if (const auto time = reader.decimal<3>()) {
+                if (reader.consume("ms")) {
+                    annotation.time = std::chrono::milliseconds(*time / 1000);
+                } else if (reader.consume('s')) {
+                    annotation.time = std::chrono::milliseconds(*time);
+                }
+            }
+        }
+    }
+
+    for (auto pos = comment.find("[%"); pos != std::string_view::npos; pos = comment.find("[%", pos + 2)) {
+        detail::AnnotationReader reader(comment.substr(pos + 2));
+
+        if (reader.consume("eval ")) {
+            reader.skipSpaces();
+
+            if (reader.consume('#')) {
+                const auto sign = reader.sign();
+                if (const auto moves = reader.number()) annotation.mate = sign * int(*moves);
+            } else {
+                const auto sign = reader.sign();
+                if (const auto centipawns = reader.decimal<2>()) annotation.score = sign * int(*centipawns);
+            }
+
+            if (reader.consume(',')) {
+                if (const auto depth = reader.number()) annotation.depth = int(*depth);
+            }
+        } else if (reader.consume("clk ")) {
+            reader.skipSpaces();
+            annotation.clock = reader.clock();
+        } else if (reader.consume("emt ")) {
+            reader.skipSpaces();
+            annotation.time = reader.clock();
+        }
+    }
+
+    return annotation;
+}
+
+/**
+ * @brief Visitor which decodes the engine output of every move comment with parseAnnotation and passes
+ * it to annotatedMove().
+ */
+class AnnotationVisitor : public Visitor {
+   public:
+    /**
+     * @brief Called for each move of a game
+     * @param move
+     * @param annotation empty if the comment has no engine output
+     * @param comment
+     */
+    virtual void annotatedMove(std::string_view move, const Annotation &annotation, std::string_view comment) = 0;
+
+    void move(std::string_view move, std::string_view comment) final {
+        annotatedMove(move, parseAnnotation(comment), comment);
+    }
+};
+
+/**
+ * @brief The moves of a game with all variations as a tree. The nodes are stored in one vector and
+ * refer to each other by index, comments and NAGs of all nodes share one buffer each.
+ */
+class GameTree {
+   public:
+    static constexpr std::uint32_t NONE = 0xFFFFFFFF;
+
+    struct Node {
+        // Move::NO_MOVE for the root
+        Move move = Move::NO_MOVE;
+
+        std::uint32_t parent = NONE;
+
+        // the first child continues the line, the other children are its variations
+        std::uint32_t first_child  = NONE;
+        std::uint32_t next_sibling = NONE;
+
+        std::uint32_t comment_offset = 0;
+        std::uint32_t comment_size   = 0;
+
+        std::uint32_t nag_offset = 0;
+        std::uint32_t nag_count  = 0;
+    };
+
+    GameTree() { clear(); }
+
+    /**
+     * @brief Removes all nodes but the root.
+     * @param fen the start position
+     */
+    void clear(std::string_view fen = constants::STARTPOS) {
+        nodes_.assign(1, Node{});
+        comments_.clear();
+        nags_.clear();
+        fen_.assign(fen.data(), fen.size());
+    }
+
+    /**
+     * @brief Appends a move to the children of parent.
+     * @param parent
+     * @param move
+     * @return the index of the new node
+     */
+    std::uint32_t add(std::uint32_t parent, Move move) {
+        const auto index = static_cast<std::uint32_t>(nodes_.size());
+
+        Node node;
+        node.move   = move;
+        node.parent = parent;
+
+        nodes_.push_back(node);
+
+        auto *slot = &nodes_[parent].first_child;
+        while (*slot != NONE) slot = &nodes_[*slot].next_sibling;
+        *slot = index;
+
+        return index;
+    }
+
+    // comments and nags have to be added to the last node, they are stored contiguously
+    void addComment(std::uint32_t node, std::string_view comment) {
+        if (comment.empty()) return;
+
+        auto &n = nodes_[node];
+
+        if (n.comment_size == 0) n.comment_offset = static_cast<std::uint32_t>(comments_.size());
+
+        comments_.append(comment);
+        n.comment_size += static_cast<std::uint32_t>(comment.size());
+    }
+
+    void addNag(std::uint32_t node, int nag) {
+        auto &n = nodes_[node];
+
+        if (n.nag_count == 0) n.nag_offset = static_cast<std::uint32_t>(nags_.size());
+
+        nags_.push_back(static_cast<std::uint8_t>(nag));
+        n.nag_count++;
+    }
+
+    [[nodiscard]] std::uint32_t root() const noexcept { return 0; }
+
+    [[nodiscard]] std::size_t size() const noexcept { return nodes_.size(); }
+
+    [[nodiscard]] const Node &operator[](std::uint32_t node) const { return nodes_[node]; }
+
+    [[nodiscard]] std::string_view comment(std::uint32_t node) const {
+        return std::string_view(comments_).substr(nodes_[node].comment_offset, nodes_[node].comment_size);
+    }
+
+    [[nodiscard]] int nag(std::uint32_t node, std::uint32_t i) const { return nags_[nodes_[node].nag_offset + i]; }
+
+    /**
+     * @brief The FEN of the position before the first move.
+     * @return
+     */
+    [[nodiscard]] const std::string &fen() const noexcept { return fen_; }
+
+    /**
+     * @brief The moves from the root along the first children.
+     * @return
+     */
+    [[nodiscard]] std::vector<Move> mainLine() const {
+        std::vector<Move> moves;
+
+        for (auto node = nodes_[0].first_child; node != NONE; node = nodes_[node].first_child) {
+            moves.push_back(nodes_[node].move);
+        }
+
+        return moves;
+    }
+
+   private:
+    std::vector<Node> nodes_;
+    std::string comments_;
+    std::vector<std::uint8_t> nags_;
+    std::string fen_;
+};
+
+/**
+ * @brief Visitor which builds a GameTree of every game, including its variations, comments and NAGs.
+ * variations(true) is set by the constructor. Moves are decoded from SAN like ReplayVisitor does, a line
+ * with a move which can't be decoded or isn't legal is cut off there, see invalid(). Derived classes
+ * which override startPgn or header have to call the GameTreeVisitor versions, the tree of the game
+ * is complete in endPgn. The tree is reused for the next game.
+ * @tparam BoardT has to support unmakeMove
+ */
+template <typename BoardT = Board>
+class GameTreeVisitor : public Visitor {
+   public:
+    GameTreeVisitor() { variations(true); }
+
+    void startPgn() override {
+        if (board_.chess960()) board_.set960(false);
+        board_.setFen(constants::STARTPOS);
+
+        tree_.clear();
+
+        node_    = tree_.root();
+        depth_   = 0;
+        invalid_ = false;
+        cut_     = -1;
+    }
+
+    void header(std::string_view key, std::string_view value) override {
+        if (key == "FEN") {
+            board_.setFen(value);
+            tree_.clear(value);
+        } else if (key == "Variant" && value.find("960") != std::string_view::npos) {
+            board_.set960(true);
+        }
+    }
+
+    void startMoves() override {}
+
+    void move(std::string_view san, std::string_view comment) final {
+        if (cut_ >= 0) return;
+
+        // a game without moves, but with a comment
+        if (san.empty()) {
+            tree_.addComment(node_, comment);
+            return;
+        }
+
+        const auto move = uci::tryParseSan(board_, san, moves_).valueOr(Move::NO_MOVE);
+
+        if (move == Move::NO_MOVE) {
+            invalid_ = true;
+            cut_     = depth_;
+            return;
+        }
+
+        board_.makeMove(move);
+
+        node_ = tree_.add(node_, move);
+        tree_.addComment(node_, comment);
+    }
+
+    void nag(int nag) final {
+        if (cut_ < 0 && node_ != tree_.root()) tree_.addNag(node_, nag);
+    }
+
+    void startVariation() final {
+        // the variation replaces the last move, remember where the line continues
+        const auto line = node_;
+
+        if (cut_ < 0 && node_ == tree_.root()) {
+            // nothing to be an alternative to
+            invalid_ = true;
+            cut_     = depth_ + 1;
+        } else if (cut_ < 0) {
+            board_.unmakeMove(tree_[node_].move);
+            node_ = tree_[node_].parent;
+        }
+
+        if (stack_.size() <= std::size_t(depth_)) stack_.emplace_back();
+        stack_[depth_] = {line, node_};
+
+        depth_++;
+    }
+
+    void endVariation() final {
+        if (depth_ == 0) return;
+
+        if (cut_ == depth_) cut_ = -1;
+
+        depth_--;
+
+        const auto [line, start] = stack_[depth_];
+
+        // back to where the variation started, then replay the move it was an alternative to
+        while (node_ != start) {
+            board_.unmakeMove(tree_[node_].move);
+            node_ = tree_[node_].parent;
+        }
+
+        if (line != start) board_.makeMove(tree_[line].move);
+
+        node_ = line;
+    }
+
+    void endPgn() override {}
+
+    /**
+     * @brief The tree of the current game
+     * @return
+     */
+    [[nodiscard]] const GameTree &tree() const noexcept { return tree_; }
+
+    /**
+     * @brief True if a line of the current game had a move which couldn't be decoded, the line ends
+     * before it.
+     * @return
+     */
+    [[nodiscard]] bool invalid() const noexcept { return invalid_; }
+
+   private:
+    BoardT board_;
+    GameTree tree_;
+
+    std::uint32_t node_ = 0;
+
+    // for each open variation the node the line continues with and the node the variation starts from,
+    // the board is restored by unmaking the moves of the variation instead of keeping a copy
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> stack_;
+    int depth_ = 0;
+
+    // moves are ignored until the variation at this depth ends, -1 if the line is valid
+    int cut_ = -1;
+
+    bool invalid_ = false;
+
+    // reused by the san decoding
+    Movelist moves_;
+};
+
+class StreamParserError {
+   public:
+    enum Code {
+        None,
+        ExceededMaxStringLength,
+        InvalidHeaderMissingClosingBracket,
+        InvalidHeaderMissingClosingQuote,
+        NotEnoughData
+    };
+
+    StreamParserError() : code_(None) {}
+
+    StreamParserError(Code code) : code_(code) {}
+
+    Code code() const { return code_; }
+
+    bool hasError() const { return code_ != None; }
+
+    std::string message() const {
+        switch (code_) {
+            case None:
+                return "No error";
+            case ExceededMaxStringLength:
+                return "Exceeded max string length";
+            case InvalidHeaderMissingClosingBracket:
+                return "Invalid header: missing closing bracket";
+            case InvalidHeaderMissingClosingQuote:
+                return "Invalid header: missing closing quote";
+            case NotEnoughData:
+                return "Not enough data";
+            default:
+                assert(false);
+                return "Unknown error";
+        }
+    }
+
+    bool operator==(Code code) const { return code_ == code; }
+    bool operator!=(Code code) const { return code_ != code; }
+    bool operator==(const StreamParserError &other) const { return code_ == other.code_; }
+    bool operator!=(const StreamParserError &other) const { return code_ != other.code_; }
+
+    operator bool() const { return code_ != None; }
+
+   private:
+    Code code_;
+};
+
+/**
+ * @brief Memory maps a file for the MappedParser. On platforms without mmap the file is read into memory.
+ */
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string &path) {
+#if defined(CHESS_PGN_MMAP)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd == -1) {
+            return;
+        }
+
+        struct stat st;
+
+        if (::fstat(fd, &st) == 0) {
+            size_ = static_cast<std::size_t>(st.st_size);
+            open_ = true;
+
+            if (size_ > 0) {
+                void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (data == MAP_FAILED) {
+                    size_ = 0;
+                    open_ = false;
+                } else {
+                    data_ = static_cast<const char *>(data);
+                    ::madvise(data, size_, MADV_SEQUENTIAL);
+                }
+            }
+        }
+
+        ::close(fd);
+#else
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file.is_open()) {
+            return;
+        }
+
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        open_ = true;
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(CHESS_PGN_MMAP)
+        if (data_) ::munmap(const_cast<char *>(data_), size_);
+#endif
+    }
+
+    MappedFile(const MappedFile &)            = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const noexcept { return open_; }
+
+    std::string_view data() const noexcept { return std::string_view(data_, size_); }
+
+   private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+    bool open_        = false;
+
+#if !defined(CHESS_PGN_MMAP)
+    std::string buffer_;
+#endif
+};
+
+namespace detail {
+
+/**
+ * @brief Private class, the parsing shared by StreamParser and MappedParser
+ * @tparam Buffer
+ */
+template <typename Buffer>
+class Parser {
+   public:
+    template <typename Input>
+    explicit Parser(Input &&input) : stream_buffer(std::forward<Input>(input)) {}
+
+    /**
+     * @brief Byte offset of the current character in the input, in Visitor::startPgn this
+     * is the opening bracket of the first header.
+     * @return
+     */
+    std::uint64_t offset() const noexcept { return stream_buffer.offset(); }
+
+    StreamParserError readGames(Visitor &vis) {
+        visitor = &vis;
+
+        if (!stream_buffer.fill()) {
+            return StreamParserError::NotEnoughData;
+        }
+
+        while (auto c = stream_buffer.some()) {
+            if (in_header) {
+                visitor->skipPgn(false);
+
+                if (*c == '[') {
+                    visitor->startPgn();
+                    pgn_end = false;
+
+                    processHeader();
+
+                    if (error != StreamParserError::None) {
+                        return error;
+                    }
+                }
+
+            } else if (in_body) {
+                if (visitor->headersOnly()) {
+                    skipBody();
+                } else {
+                    processBody();
+                }
+
+                if (error != StreamParserError::None) {
+                    return error;
+                }
+            }
+
+            if (!dont_advance_after_body) stream_buffer.advance();
+            dont_advance_after_body = false;
+        }
+
+        if (!pgn_end) {
+            onEnd();
+        }
+
+        return error;
+    }
+
+   private:
+    void reset_trackers() {
+        header.first.clear();
+        header.second.clear();
+
+        move.clear();
+        comment.clear();
+
+        in_header = true;
+        in_body   = false;
+    }
+
+    void callVisitorMoveFunction() {
+        if (!move.empty()) {
+            if (!visitor->skip()) {
+                visitor->move(move.get(), comment.get());
+
+                for (std::size_t i = 0; i < nag_count; i++) visitor->nag(nags[i]);
+            }
+
+            move.clear();
+            comment.clear();
+        }
+
+        nag_count = 0;
+    }
+
+    void processHeader() {
+        bool backslash = false;
+
+        while (auto c = stream_buffer.some()) {
+            switch (*c) {
+                // tag start
+                case '[':
+                    stream_buffer.advance();
+
+                    if (!stream_buffer.readUntil(header.first, is_space)) {
+                        error = StreamParserError::ExceededMaxStringLength;
+                        return;
+                    }
+
+                    stream_buffer.advance();
+                    break;
+                case '"':
+                    stream_buffer.advance();
+
+                    while (auto k = stream_buffer.some()) {
+                        if (*k == '\\') {
+                            backslash = true;
+                            // don't add backslash to header, is this really correct?
+                            stream_buffer.advance();
+                        } else if (*k == '"' && !backslash) {
+                            stream_buffer.advance();
+
+                            // we should be now at ]
+                            if (stream_buffer.current().value_or('\0') != ']') {
+                                error = StreamParserError::InvalidHeaderMissingClosingBracket;
+                                return;
+                            }
+
+                            stream_buffer.advance();
+
+                            break;
+                        } else if (*k == '\n') {
+                            // we missed the closing quote and read until the newline character
+                            // this is an invalid pgn, let's throw an error
+                            error = StreamParserError::InvalidHeaderMissingClosingQuote;
+                            return;
+                        } else {
+                            // an escaped quote or the characters up to the next special one
+                            const auto added = *k == '"' ? header.second.add(*k)
+                                                         : stream_buffer.readUntil(header.second, is_header_special);
+
+                            if (!added) {
+                                error = StreamParserError::ExceededMaxStringLength;
+                                return;
+                            }
+
+                            if (*k == '"') stream_buffer.advance();
+
+                            backslash = false;
+                        }
+                    }
+
+                    // manually skip carriage return, otherwise we would be in the body
+                    // ideally we should completely skip all carriage returns and newlines to avoid this
+                    if (stream_buffer.current() == '\r') {
+                        stream_buffer.advance();
+                    }
+
+                    if (!visitor->skip()) visitor->header(header.first.get(), header.second.get());
+
+                    header.first.clear();
+                    header.second.clear();
+
+                    stream_buffer.advance();
+                    break;
+                case '\n':
+                    in_header = false;
+                    in_body   = true;
+
+                    if (!visitor->skip()) visitor->startMoves();
+
+                    return;
+                default:
+                    // this should normally not happen
+                    // lets just go into the body, will this always be save?
+                    in_header = false;
+                    in_body   = true;
+
+                    if (!visitor->skip()) visitor->startMoves();
+
+                    return;
+            }
+        }
+    }
+
+    // reads the numeric annotation glyph at the current '$', it is passed to the visitor after the move
+    void readNag() {
+        stream_buffer.advance();
+
+        int value = 0;
+
+        for (auto c = stream_buffer.current(); c && is_digit(*c); c = stream_buffer.current()) {
+            value = std::min(value * 10 + (*c - '0'), 255);
+            stream_buffer.advance();
+        }
+
+        if (nag_count < nags.size()) nags[nag_count++] = static_cast<std::uint8_t>(value);
+
+        // garbage after the number, but not the end of a variation
+        stream_buffer.skipWhile(NoneOf<' ', '\t', '\n', '\r', '(', ')', '{'>{});
+    }
+
+    // reads the comment at the current '{' into comment, unless the visitor skips comments
+    void readComment() {
+        stream_buffer.advance();
+
+        if (visitor->skipComments()) {
+            stream_buffer.skipWhile(is_not_comment_end);
+        } else {
+            stream_buffer.readUntil(comment, is_comment_end);
+        }
+
+        stream_buffer.advance();
+    }
+
+    void processBody() {
+        auto is_termination_symbol = false;
+        auto has_comment           = false;
+
+    start:
+        /*
+        Skip first move number or game termination
+        Also skip - * / to fix games
+        which directly start with a game termination
+        this https://github.com/Disservin/chess-library/issues/68
+        */
+
+        while (auto c = stream_buffer.some()) {
+            if (*c == ' ' || is_digit(*c)) {
+                stream_buffer.advance();
+            } else if (*c == '-' || *c == '*' || c == '/') {
+                is_termination_symbol = true;
+                stream_buffer.advance();
+            } else if (*c == '{') {
+                has_comment = true;
+
+                readComment();
+
+                // the game has no moves, but a comment followed by a game termination
+                if (!visitor->skip() && !visitor->skipComments()) {
+                    visitor->move("", comment.get());
+
+                    comment.clear();
+                }
+            } else {
+                break;
+            }
+        }
+
+        // we need to reparse the termination symbol
+        if (has_comment && !is_termination_symbol) {
+            goto start;
+        }
+
+        // game had no moves, so we can skip it and call endPgn
+        if (is_termination_symbol) {
+            onEnd();
+            return;
+        }
+
+        stream_buffer.skipWhile(is_space);
+
+        while (auto cd = stream_buffer.some()) {
+            // Pgn are build up in the following way.
+            // {move_number} {move} {comment} {move} {comment} {move_number} ...
+            // So we need to skip the move_number then start reading the move, then save the comment
+            // then read the second move in the group. After that a move_number will follow again.
+
+            // [ is unexpected here, it probably is a new pgn and the current one is finished
+            if (*cd == '[') {
+                onEnd();
+                dont_advance_after_body = true;
+                // break;
+                break;
+            }
+
+            // skip move number digits
+            stream_buffer.skipWhile(is_space_or_digit);
+
+            // skip dots
+            stream_buffer.skipWhile(AnyOf<'.'>{});
+
+            // skip spaces
+            stream_buffer.skipWhile(is_space);
+
+            // parse move
+            if (parseMove()) {
+                break;
+            }
+
+            // skip spaces
+            stream_buffer.skipWhile(is_space);
+
+            // game termination
+            auto curr = stream_buffer.current();
+
+            if (!curr.has_value()) {
+                onEnd();
+                break;
+            }
+
+            // game termination
+            if (*curr == '*') {
+                onEnd();
+                stream_buffer.advance();
+
+                break;
+            }
+
+            const auto peek = stream_buffer.peek();
+
+            if (*curr == '1') {
+                if (peek == '-') {
+                    stream_buffer.advance();
+                    stream_buffer.advance();
+
+                    onEnd();
+                    break;
+                } else if (peek == '/') {
+                    for (size_t i = 0; i <= 6; ++i) {
+                        stream_buffer.advance();
+                    }
+
+                    onEnd();
+                    break;
+                }
+            }
+
+            // might be 0-1 (game termination) or 0-0-0/0-0 (castling)
+            if (*curr == '0' && stream_buffer.peek() == '-') {
+                stream_buffer.advance();
+                stream_buffer.advance();
+
+                const auto c = stream_buffer.current();
+                if (!c.has_value()) {
+                    onEnd();
+
+                    break;
+                }
+
+                // game termination
+                if (*c == '1') {
+                    onEnd();
+                    stream_buffer.advance();
+
+                    break;
+                }
+                // castling
+                else {
+                    if (!move.add('0') || !move.add('-')) {
+                        error = StreamParserError::ExceededMaxStringLength;
+                        return;
+                    }
 
-                    // manually skip carriage return, otherwise we would be in the body
-                    // ideally we should completely skip all carriage returns and newlines to avoid this
-                    if (stream_buffer.current() == '\r') {
+                    if (parseMove()) {
                         stream_buffer.advance();
+                        break;
                     }
+                }
+            }
+        }
+    }
 
-                    if (!visitor->skip()) visitor->header(header.first.get(), header.second.get());
+    // the next game starts at the next line with a '['
+    void skipBody() {
+        stream_buffer.skipToLine('[');
 
-                    header.first.clear();
-                    header.second.clear();
+        onEnd();
+        dont_advance_after_body = true;
+    }
 
-                    stream_buffer.advance();
+    bool parseMove() {
+        // reading move, a variation may end right after it
+        const auto read = visitor->variations() ? stream_buffer.readUntil(move, is_move_end)
+                                                : stream_buffer.readUntil(move, is_space);
+
+        if (!read) {
+            error = StreamParserError::ExceededMaxStringLength;
+            return true;
+        }
+
+        return parseMoveAppendix();
+    }
+
+    bool parseMoveAppendix() {
+        while (true) {
+            auto curr = stream_buffer.current();
+
+            if (!curr.has_value()) {
+                onEnd();
+                return true;
+            }
+
+            switch (*curr) {
+                case '{': {
+                    readComment();
                     break;
-                case '\n':
-                    in_header = false;
-                    in_body   = true;
+                }
+                case '(': {
+                    if (visitor->variations()) {
+                        callVisitorMoveFunction();
+                        stream_buffer.advance();
 
-                    if (!visitor->skip()) visitor->startMoves();
+                        variation_depth++;
+                        if (!visitor->skip()) visitor->startVariation();
+                    } else {
+                        skipUntil<'(', ')'>();
+                    }
 
-                    return;
+                    break;
+                }
+                case ')': {
+                    // only reached by variations(true) or an unmatched parenthesis
+                    callVisitorMoveFunction();
+                    stream_buffer.advance();
+
+                    if (variation_depth > 0) {
+                        variation_depth--;
+                        if (!visitor->skip()) visitor->endVariation();
+                    }
+
+                    break;
+                }
+                case '$': {
+                    readNag();
+                    break;
+                }
+                case ' ': {
+                    stream_buffer.skipWhile(is_space);
+
+                    break;
+                }
                 default:
-                    // this should normally not happen
-                    // lets just go into the body, will this always be save?
-                    in_header = false;
-                    in_body   = true;
+                    callVisitorMoveFunction();
+                    return false;
+            }
+        }
+    }
+
+    // Assume that the current character is already the opening_delim
+    template <char open_delim, char close_delim>
+    bool skipUntil() {
+        int stack = 0;
+
+        while (true) {
+            if (stack > 0) stream_buffer.skipWhile(BlockNoneOf<open_delim, close_delim>{});
+
+            const auto ret = stream_buffer.some();
+            stream_buffer.advance();
+
+            if (!ret.has_value()) {
+                return false;
+            }
+
+            if (*ret == open_delim) {
+                ++stack;
+            } else if (*ret == close_delim) {
+                if (stack == 0) {
+                    // Mismatched closing delimiter
+                    return false;
+                } else {
+                    --stack;
+                    if (stack == 0) {
+                        // Matching closing delimiter found
+                        return true;
+                    }
+                }
+            }
+        }
+
+        // If we reach this point, there are unmatched opening delimiters
+        return false;
+    }
+
+    void onEnd() {
+        callVisitorMoveFunction();
+
+        // unterminated variations
+        for (; variation_depth > 0; variation_depth--) {
+            if (!visitor->skip()) visitor->endVariation();
+        }
+
+        visitor->endPgn();
+        visitor->skipPgn(false);
+
+        reset_trackers();
+
+        pgn_end = true;
+    }
+
+    static bool is_digit(const char c) noexcept {
+        switch (c) {
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // character classes which the buffers scan for a block at a time
+    static constexpr AnyOf<' ', '\t', '\n', '\r'> is_space{};
+
+    static constexpr NoneOf<' ', '\t', '\n', '\r'> is_not_space{};
+
+    static constexpr AnyOf<' ', '\t', '\n', '\r', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9'> is_space_or_digit{};
+
+    static constexpr AnyOf<' ', '\t', '\n', '\r', '(', ')', '{'> is_move_end{};
+
+    static constexpr BlockAnyOf<'\\', '"', '\n'> is_header_special{};
+
+    static constexpr BlockAnyOf<'}'> is_comment_end{};
+
+    static constexpr BlockNoneOf<'}'> is_not_comment_end{};
+
+    Buffer stream_buffer;
+
+    Visitor *visitor = nullptr;
+
+    // one time allocations
+    using Token = typename Buffer::Token;
+
+    std::pair<Token, Token> header = {Token{}, Token{}};
+
+    Token move         = Token{};
+    ViewBuffer comment = ViewBuffer{std::string::npos};
+
+    // numeric annotation glyphs of the current move
+    std::array<std::uint8_t, 8> nags = {};
+    std::size_t nag_count            = 0;
+
+    // State
+
+    StreamParserError error = StreamParserError::None;
+
+    bool in_header = true;
+    bool in_body   = false;
+
+    bool pgn_end = true;
+
+    bool dont_advance_after_body = false;
+
+    int variation_depth = 0;
+};
+
+}  // namespace detail
+
+template <std::size_t BUFFER_SIZE =
+#if defined(__APPLE__) || defined(__MACH__)
+              256
+#elif defined(__unix__) || defined(__unix) || defined(unix)
+              1024
+#else
+              256
+#endif
+          >
+class StreamParser : public detail::Parser<detail::StreamBuffer<BUFFER_SIZE>> {
+   public:
+    StreamParser(std::istream &stream) : detail::Parser<detail::StreamBuffer<BUFFER_SIZE>>(stream) {}
+
+    /**
+     * @brief Parses from a custom input, i.e. a GzipSource or ZstdSource.
+     * The source must outlive the parser.
+     * @param source
+     */
+    StreamParser(InputSource &source) : detail::Parser<detail::StreamBuffer<BUFFER_SIZE>>(source) {}
+};
+
+/**
+ * @brief Parses PGNs from memory without copying them, i.e. a MappedFile.
+ * The views passed to the visitor point into the input, unless a token had to be unescaped
+ * or contained carriage returns, and stay valid as long as the input does.
+ */
+class MappedParser : public detail::Parser<detail::MemoryBuffer> {
+   public:
+    explicit MappedParser(const MappedFile &file) : detail::Parser<detail::MemoryBuffer>(file.data()) {}
+
+    MappedParser(const char *data, std::size_t size)
+        : detail::Parser<detail::MemoryBuffer>(std::string_view(data, size)) {}
+};
+
+/**
+ * @brief Parses PGNs from memory on several threads. The input is split into shards at game boundaries,
+ * a blank line followed by "[Event", every shard is parsed by a MappedParser with its own visitor.
+ * A game which doesn't start with an Event tag is parsed together with the game before it.
+ */
+class ParallelParser {
+   public:
+    struct Options {
+        // Number of worker threads for readGamesOrdered, readGames uses one thread per visitor.
+        int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+        // The input is split into threads * shards_per_thread shards which are handed out in file order,
+        // more shards balance uneven games better.
+        int shards_per_thread = 4;
+    };
+
+    explicit ParallelParser(const MappedFile &file) : ParallelParser(file, Options{}) {}
+
+    ParallelParser(const MappedFile &file, const Options &options) : data_(file.data()), options_(options) {}
+
+    ParallelParser(const char *data, std::size_t size) : ParallelParser(data, size, Options{}) {}
+
+    ParallelParser(const char *data, std::size_t size, const Options &options)
+        : data_(data, size), options_(options) {}
+
+    /**
+     * @brief Parses all games with one thread per visitor. A visitor is only used by its own thread,
+     * it sees whole games in file order, but the games of one shard are not followed by the next shard.
+     * @tparam VisitorT derived from Visitor
+     * @param visitors
+     * @return the error of the first shard (in file order) which failed
+     */
+    template <typename VisitorT>
+    StreamParserError readGames(std::vector<VisitorT> &visitors) {
+        if (visitors.empty()) return StreamParserError::None;
+
+        const auto shards = split(data_, visitors.size() * std::max(options_.shards_per_thread, 1));
+
+        return run(shards, visitors.size(), [&](std::size_t id, std::size_t shard) {
+            return MappedParser(shards[shard].data(), shards[shard].size()).readGames(visitors[id]);
+        });
+    }
+
+    /**
+     * @brief Parses every shard with a new visitor from make_visitor() on options.threads workers and
+     * passes the finished visitors to merge() in file order. merge() is never called concurrently,
+     * but from whichever worker completed the missing shard. Finished shards wait for their
+     * predecessors, so their visitors should only hold the results which have to be merged.
+     * @tparam Factory returns a VisitorT by value, VisitorT must be movable
+     * @tparam Merge called with a VisitorT &
+     * @param make_visitor
+     * @param merge
+     * @return the error of the first shard (in file order) which failed, its visitor and all later ones
+     * are still merged
+     */
+    template <typename Factory, typename Merge>
+    StreamParserError readGamesOrdered(Factory make_visitor, Merge merge) {
+        using VisitorT = decltype(make_visitor());
+
+        const auto threads = static_cast<std::size_t>(std::max(options_.threads, 1));
+        const auto shards  = split(data_, threads * std::max(options_.shards_per_thread, 1));
+
+        std::vector<std::optional<VisitorT>> done(shards.size());
+        std::size_t next = 0;
+        std::mutex mutex;
+
+        return run(shards, threads, [&](std::size_t, std::size_t shard) {
+            auto visitor = make_visitor();
+            const auto error =
+                MappedParser(shards[shard].data(), shards[shard].size()).readGames(visitor);
+
+            const std::lock_guard<std::mutex> lock(mutex);
+
+            done[shard].emplace(std::move(visitor));
+
+            for (; next < shards.size() && done[next]; next++) {
+                merge(*done[next]);
+                done[next].reset();
+            }
+
+            return error;
+        });
+    }
+
+    /**
+     * @brief Splits the input into at most n shards of about the same size, which start at game boundaries.
+     * The shards are adjacent and cover the whole input.
+     * @param data
+     * @param n
+     * @return
+     */
+    static std::vector<std::string_view> split(std::string_view data, std::size_t n) {
+        std::vector<std::string_view> shards;
+
+        std::size_t start = 0;
+
+        for (std::size_t i = 1; i < n && start < data.size(); i++) {
+            const auto end = nextGame(data, std::max(start + 1, data.size() / n * i));
+
+            if (end >= data.size()) break;
+
+            shards.push_back(data.substr(start, end - start));
+            start = end;
+        }
+
+        if (start < data.size()) shards.push_back(data.substr(start));
+
+        return shards;
+    }
+
+   private:
+    // start of the first "[Event" after a blank line at or behind pos, or data.size()
+    static std::size_t nextGame(std::string_view data, std::size_t pos) {
+        constexpr std::string_view event = "\n[Event";
+
+        // the newline may be the one of the blank line itself
+        pos = pos > 0 ? pos - 1 : 0;
+
+        while ((pos = data.find(event, pos)) != std::string_view::npos) {
+            // walk back over the blank line, which may end with a carriage return
+            auto line = pos;
+            if (line > 0 && data[line - 1] == '\r') line--;
+            if (line > 0 && data[line - 1] == '\n') return pos + 1;
+
+            pos++;
+        }
+
+        return data.size();
+    }
+
+    // parse(worker, shard) is called for every shard, shards are handed out in file order
+    template <typename Parse>
+    static StreamParserError run(const std::vector<std::string_view> &shards, std::size_t threads, Parse parse) {
+        if (shards.empty()) return StreamParserError::NotEnoughData;
+
+        std::vector<StreamParserError> errors(shards.size());
+        std::atomic<std::size_t> next_shard{0};
+
+        const auto worker = [&](std::size_t id) {
+            for (auto shard = next_shard++; shard < shards.size(); shard = next_shard++) {
+                errors[shard] = parse(id, shard);
+            }
+        };
+
+        std::vector<std::thread> workers;
+
+        for (std::size_t i = 1; i < std::min(threads, shards.size()); i++) workers.emplace_back(worker, i);
+
+        worker(0);
+
+        for (auto &thread : workers) thread.join();
+
+        for (const auto &error : errors) {
+            if (error) return error;
+        }
+
+        return StreamParserError::None;
+    }
+
+    std::string_view data_;
+    Options options_;
+};
+
+/**
+ * @brief Byte offset, length and selected header values of every game in a PGN file. The index is built in one
+ * pass, can be saved next to the PGN and lets single games or ranges be parsed without reading the games
+ * before them. Game i spans [offset(i), offset(i + 1)), including the blank lines which follow it.
+ */
+class GameIndex {
+   public:
+    /**
+     * @brief Indexes every game read from the stream. Offsets are relative to the position of the stream
+     * when build is called, which should be the start of the file.
+     * @param stream
+     * @param headers values of these header keys are stored for every game, i.e. "White" and "Result"
+     * @param headers_only skip the movetext instead of tokenizing it, see Visitor::headersOnly
+     * @return
+     */
+    StreamParserError build(std::istream &stream, const std::vector<std::string> &headers = {},
+                            bool headers_only = false) {
+        StreamParser parser(stream);
+        return index(parser, headers, headers_only);
+    }
+
+    StreamParserError build(const MappedFile &file, const std::vector<std::string> &headers = {},
+                            bool headers_only = false) {
+        MappedParser parser(file);
+        return index(parser, headers, headers_only);
+    }
+
+    /**
+     * @brief Writes the index to a file, integers are stored in little endian.
+     * @param path
+     * @return false if the file couldn't be written or a header key is longer than 255 characters
+     */
+    bool save(const std::string &path) const {
+        for (const auto &key : keys_) {
+            if (key.size() > MAX_KEY) return false;
+        }
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
 
-                    if (!visitor->skip()) visitor->startMoves();
+        if (!file.is_open()) return false;
 
-                    return;
-            }
+        file.write(MAGIC, sizeof(MAGIC));
+        write(file, VERSION, 4);
+        write(file, size(), 8);
+        write(file, keys_.size(), 4);
+
+        for (const auto &key : keys_) {
+            write(file, key.size(), 4);
+            file.write(key.data(), key.size());
         }
-    }
 
-    void processBody() {
-        auto is_termination_symbol = false;
-        auto has_comment           = false;
+        for (const auto offset : offsets_) write(file, offset, 8);
 
-    start:
-        /*
-        Skip first move number or game termination
-        Also skip - * / to fix games
-        which directly start with a game termination
-        this https://github.com/Disservin/chess-library/issues/68
-        */
+        for (std::size_t i = 0; i + 1 < values_.size(); i++) write(file, values_[i + 1] - values_[i], 2);
 
-        while (auto c = stream_buffer.some()) {
-            if (*c == ' ' || is_digit(*c)) {
-                stream_buffer.advance();
-            } else if (*c == '-' || *c == '*' || c == '/') {
-                is_termination_symbol = true;
-                stream_buffer.advance();
-            } else if (*c == '{') {
-                has_comment = true;
+        file.write(strings_.data(), strings_.size());
 
-                // reading comment
-                stream_buffer.advance();
+        return bool(file);
+    }
 
-                while (auto k = stream_buffer.some()) {
-                    stream_buffer.advance();
+    /**
+     * @brief Reads an index written by save(), the current index is replaced.
+     * @param path
+     * @return false if the file couldn't be read or isn't an index, the index is empty then
+     */
+    bool load(const std::string &path) {
+        clear();
 
-                    if (*k == '}') {
-                        break;
-                    }
+        std::ifstream file(path, std::ios::binary);
 
-                    comment += *k;
-                }
+        if (!file.is_open()) return false;
 
-                // the game has no moves, but a comment followed by a game termination
-                if (!visitor->skip()) {
-                    visitor->move("", comment);
+        char magic[sizeof(MAGIC)];
+        std::uint64_t version = 0, games = 0, keys = 0;
 
-                    comment.clear();
-                }
-            } else {
-                break;
-            }
+        if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+        if (!read(file, version, 4) || version != VERSION) return false;
+        if (!read(file, games, 8) || !read(file, keys, 4)) return false;
+
+        for (std::uint64_t i = 0; i < keys; i++) {
+            std::uint64_t length = 0;
+            // checked before allocating, a corrupt length could ask for gigabytes
+            if (!read(file, length, 4) || length > MAX_KEY) return fail();
+
+            std::string key(length, '\0');
+            if (!file.read(key.data(), length)) return fail();
+
+            keys_.push_back(std::move(key));
         }
 
-        // we need to reparse the termination symbol
-        if (has_comment && !is_termination_symbol) {
-            goto start;
+        // don't trust the counts for the allocations, a truncated file just fails on the first missing read
+        for (std::uint64_t i = 0; i < games + 1; i++) {
+            std::uint64_t offset = 0;
+            if (!read(file, offset, 8)) return fail();
+            offsets_.push_back(offset);
         }
 
-        // game had no moves, so we can skip it and call endPgn
-        if (is_termination_symbol) {
-            onEnd();
-            return;
+        for (std::uint64_t i = 0; i < games * keys; i++) {
+            std::uint64_t length = 0;
+            if (!read(file, length, 2)) return fail();
+            values_.push_back(values_.back() + length);
         }
 
-        while (auto c = stream_buffer.some()) {
-            if (is_space(*c)) {
-                stream_buffer.advance();
-                continue;
-            }
+        strings_.resize(values_.back());
 
-            break;
-        }
+        if (!file.read(strings_.data(), strings_.size())) return fail();
 
-        while (auto cd = stream_buffer.some()) {
-            // Pgn are build up in the following way.
-            // {move_number} {move} {comment} {move} {comment} {move_number} ...
-            // So we need to skip the move_number then start reading the move, then save the comment
-            // then read the second move in the group. After that a move_number will follow again.
+        return true;
+    }
 
-            // [ is unexpected here, it probably is a new pgn and the current one is finished
-            if (*cd == '[') {
-                onEnd();
-                dont_advance_after_body = true;
-                // break;
-                break;
-            }
+    void clear() noexcept {
+        keys_.clear();
+        offsets_.clear();
+        values_.assign(1, 0);
+        strings_.clear();
+    }
 
-            // skip move number digits
-            while (auto c = stream_buffer.some()) {
-                if (is_space(*c) || is_digit(*c)) {
-                    stream_buffer.advance();
-                } else {
-                    break;
-                }
-            }
+    /**
+     * @brief Number of indexed games.
+     * @return
+     */
+    [[nodiscard]] std::size_t size() const noexcept { return offsets_.empty() ? 0 : offsets_.size() - 1; }
 
-            // skip dots
-            while (auto c = stream_buffer.some()) {
-                if (*c == '.') {
-                    stream_buffer.advance();
-                } else {
-                    break;
-                }
-            }
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
 
-            // skip spaces
-            while (auto c = stream_buffer.some()) {
-                if (is_space(*c)) {
-                    stream_buffer.advance();
-                } else {
-                    break;
-                }
-            }
+    /**
+     * @brief Byte offset of the first header of a game.
+     * @param game
+     * @return
+     */
+    [[nodiscard]] std::uint64_t offset(std::size_t game) const { return offsets_[game]; }
 
-            // parse move
-            if (parseMove()) {
-                break;
-            }
+    [[nodiscard]] std::uint64_t length(std::size_t game) const { return offsets_[game + 1] - offsets_[game]; }
 
-            // skip spaces
-            while (auto c = stream_buffer.some()) {
-                if (is_space(*c)) {
-                    stream_buffer.advance();
-                } else {
-                    break;
-                }
-            }
+    /**
+     * @brief The header keys whose values are stored.
+     * @return
+     */
+    [[nodiscard]] const std::vector<std::string> &keys() const noexcept { return keys_; }
 
-            // game termination
-            auto curr = stream_buffer.current();
+    /**
+     * @brief Value of a stored header, the view points into the index.
+     * @param game
+     * @param key
+     * @return an empty view if the game has no such header or the key wasn't selected when building the index
+     */
+    [[nodiscard]] std::string_view header(std::size_t game, std::string_view key) const {
+        const auto it = std::find(keys_.begin(), keys_.end(), key);
 
-            if (!curr.has_value()) {
-                onEnd();
-                break;
-            }
+        if (it == keys_.end()) return {};
 
-            // game termination
-            if (*curr == '*') {
-                onEnd();
-                stream_buffer.advance();
+        const auto i = game * keys_.size() + std::distance(keys_.begin(), it);
 
-                break;
-            }
+        return std::string_view(strings_).substr(values_[i], values_[i + 1] - values_[i]);
+    }
 
-            const auto peek = stream_buffer.peek();
+    /**
+     * @brief Parses count games starting at first from the file the index was built from.
+     * Only these games are read, count is clamped to the number of games left.
+     * @param stream
+     * @param vis
+     * @param first
+     * @param count
+     * @return
+     */
+    StreamParserError readGames(std::istream &stream, Visitor &vis, std::size_t first, std::size_t count = 1) const {
+        if (first >= size()) return StreamParserError::NotEnoughData;
 
-            if (*curr == '1') {
-                if (peek == '-') {
-                    stream_buffer.advance();
-                    stream_buffer.advance();
+        const auto last = std::min(size(), first + std::min(count, size() - first));
 
-                    onEnd();
-                    break;
-                } else if (peek == '/') {
-                    for (size_t i = 0; i <= 6; ++i) {
-                        stream_buffer.advance();
-                    }
+        std::string games(offsets_[last] - offsets_[first], '\0');
 
-                    onEnd();
-                    break;
-                }
-            }
+        stream.clear();
+        stream.seekg(static_cast<std::streamoff>(offsets_[first]));
+        stream.read(games.data(), static_cast<std::streamsize>(games.size()));
+        games.resize(static_cast<std::size_t>(stream.gcount()));
 
-            // might be 0-1 (game termination) or 0-0-0/0-0 (castling)
-            if (*curr == '0' && stream_buffer.peek() == '-') {
-                stream_buffer.advance();
-                stream_buffer.advance();
+        return MappedParser(games.data(), games.size()).readGames(vis);
+    }
 
-                const auto c = stream_buffer.current();
-                if (!c.has_value()) {
-                    onEnd();
+    StreamParserError readGames(const MappedFile &file, Visitor &vis, std::size_t first,
+                                std::size_t count = 1) const {
+        if (first >= size() || offsets_[first] >= file.data().size()) return StreamParserError::NotEnoughData;
 
-                    break;
-                }
+        const auto last = std::min(size(), first + std::min(count, size() - first));
 
-                // game termination
-                if (*c == '1') {
-                    onEnd();
-                    stream_buffer.advance();
+        const auto games = file.data().substr(offsets_[first], offsets_[last] - offsets_[first]);
 
-                    break;
-                }
-                // castling
-                else {
-                    if (!move.add('0') || !move.add('-')) {
-                        error = StreamParserError::ExceededMaxStringLength;
-                        return;
-                    }
+        return MappedParser(games.data(), games.size()).readGames(vis);
+    }
 
-                    if (parseMove()) {
-                        stream_buffer.advance();
-                        break;
-                    }
-                }
+   private:
+    static constexpr char MAGIC[4]         = {'P', 'G', 'N', 'I'};
+    static constexpr std::uint64_t VERSION = 1;
+
+    // header keys are short, an index with longer ones is rejected
+    static constexpr std::size_t MAX_KEY = 0xFF;
+    // longer header values are truncated to fit their 16 bit length
+    static constexpr std::size_t MAX_VALUE = 0xFFFF;
+
+    template <typename ParserT>
+    StreamParserError index(ParserT &parser, const std::vector<std::string> &headers, bool headers_only) {
+        class Builder : public Visitor {
+           public:
+            Builder(GameIndex &index, const ParserT &parser) : index_(index), parser_(parser) {
+                values_.resize(index.keys_.size());
             }
-        }
-    }
 
-    bool parseMove() {
-        // reading move
-        while (auto c = stream_buffer.some()) {
-            if (is_space(*c)) {
-                break;
+            void startPgn() override {
+                index_.offsets_.push_back(parser_.offset());
+                for (auto &value : values_) value.clear();
             }
 
-            if (!move.add(*c)) {
-                error = StreamParserError::ExceededMaxStringLength;
-                return true;
+            void header(std::string_view key, std::string_view value) override {
+                const auto it = std::find(index_.keys_.begin(), index_.keys_.end(), key);
+                if (it != index_.keys_.end()) values_[std::distance(index_.keys_.begin(), it)] = value;
             }
 
-            stream_buffer.advance();
-        }
+            void startMoves() override { skipPgn(true); }
 
-        return parseMoveAppendix();
-    }
+            void move(std::string_view, std::string_view) override {}
 
-    bool parseMoveAppendix() {
-        while (true) {
-            auto curr = stream_buffer.current();
+            void endPgn() override {
+                for (const auto &value : values_) {
+                    const auto length = std::min(value.size(), MAX_VALUE);
 
-            if (!curr.has_value()) {
-                onEnd();
-                return true;
+                    index_.strings_.append(value, 0, length);
+                    index_.values_.push_back(index_.values_.back() + length);
+                }
             }
 
-            switch (*curr) {
-                case '{': {
-                    // reading comment
-                    stream_buffer.advance();
-
-                    while (auto c = stream_buffer.some()) {
-                        stream_buffer.advance();
-
-                        if (*c == '}') {
-                            break;
-                        }
+           private:
+            GameIndex &index_;
+            const ParserT &parser_;
 
-                        comment += *c;
-                    }
-
-                    break;
-                }
-                case '(': {
-                    stream_buffer.skipUntil('(', ')');
-                    break;
-                }
-                case '$': {
-                    while (auto c = stream_buffer.some()) {
-                        if (is_space(*c)) {
-                            break;
-                        }
+            std::vector<std::string> values_;
+        };
 
-                        stream_buffer.advance();
-                    }
+        clear();
+        keys_ = headers;
 
-                    break;
-                }
-                case ' ': {
-                    while (auto c = stream_buffer.some()) {
-                        if (!is_space(*c)) {
-                            break;
-                        }
+        Builder builder(*this, parser);
+        builder.headersOnly(headers_only);
 
-                        stream_buffer.advance();
-                    }
+        const auto error = parser.readGames(builder);
 
-                    break;
-                }
-                default:
-                    callVisitorMoveFunction();
-                    return false;
-            }
-        }
-    }
+        if (offsets_.empty()) return error;
 
-    void onEnd() {
-        callVisitorMoveFunction();
-        visitor->endPgn();
-        visitor->skipPgn(false);
+        // a game cut short by an error has no endPgn
+        while (values_.size() < offsets_.size() * keys_.size() + 1) values_.push_back(values_.back());
 
-        reset_trackers();
+        offsets_.push_back(parser.offset());
 
-        pgn_end = true;
+        return error;
     }
 
-    bool is_space(const char c) noexcept {
-        switch (c) {
-            case ' ':
-            case '\t':
-            case '\n':
-            case '\r':
-                return true;
-            default:
-                return false;
-        }
+    bool fail() {
+        clear();
+        return false;
     }
 
-    bool is_digit(const char c) noexcept {
-        switch (c) {
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-                return true;
-            default:
-                return false;
-        }
+    static void write(std::ostream &stream, std::uint64_t value, int bytes) {
+        char buffer[8];
+        for (int i = 0; i < bytes; i++) buffer[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        stream.write(buffer, bytes);
     }
 
-    detail::StreamBuffer<BUFFER_SIZE> stream_buffer;
-
-    Visitor *visitor = nullptr;
-
-    // one time allocations
-    std::pair<detail::StringBuffer, detail::StringBuffer> header = {detail::StringBuffer{}, detail::StringBuffer{}};
-
-    detail::StringBuffer move = {};
-    std::string comment       = {};
+    static bool read(std::istream &stream, std::uint64_t &value, int bytes) {
+        unsigned char buffer[8];
+        if (!stream.read(reinterpret_cast<char *>(buffer), bytes)) return false;
 
-    // State
+        value = 0;
+        for (int i = 0; i < bytes; i++) value |= std::uint64_t(buffer[i]) << (8 * i);
 
-    StreamParserError error = StreamParserError::None;
+        return true;
+    }
 
-    bool in_header = true;
-    bool in_body   = false;
+    std::vector<std::string> keys_;
 
-    bool pgn_end = true;
+    // game i starts at offsets_[i], the last entry is the end of the input
+    std::vector<std::uint64_t> offsets_;
 
-    bool dont_advance_after_body = false;
+    // value of key k in game i is strings_[values_[i * keys + k], values_[i * keys + k + 1])
+    std::vector<std::uint64_t> values_ = {0};
+    std::string strings_;
 };
 }  // namespace chess::pgn
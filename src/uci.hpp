@@ -1,13 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <utility>
 
+#include "attacks_fwd.hpp"
 #include "board.hpp"
 #include "color.hpp"
 #include "move.hpp"
@@ -16,6 +21,11 @@
 namespace chess {
 class uci {
    public:
+    // longest possible SAN (e.g. "Qa1xb2+" or "exd8=Q#") and LAN (e.g. "Qa1xb2+" or "e7xd8=Q#") strings
+    static constexpr std::size_t MAX_SAN_LENGTH = 8;
+    // longest possible UCI string, e.g. "e7e8q"
+    static constexpr std::size_t MAX_UCI_LENGTH = 5;
+
     /**
      * @brief Converts an internal move to a UCI string
      * @param move
@@ -23,6 +33,19 @@ class uci {
      * @return
      */
     [[nodiscard]] static std::string moveToUci(const Move &move, bool chess960 = false) noexcept(false) {
+        char buffer[MAX_UCI_LENGTH];
+        return std::string(buffer, moveToUci(move, buffer, chess960));
+    }
+
+    /**
+     * @brief Writes the UCI string of a move to out, which must have room for MAX_UCI_LENGTH characters.
+     * No terminating null character is written.
+     * @param move
+     * @param out
+     * @param chess960
+     * @return the number of characters written
+     */
+    static std::size_t moveToUci(const Move &move, char *out, bool chess960 = false) noexcept {
         // Get the from and to squares
         Square from_sq = move.from();
         Square to_sq   = move.to();
@@ -33,18 +56,25 @@ class uci {
             to_sq = Square(to_sq > from_sq ? File::FILE_G : File::FILE_C, from_sq.rank());
         }
 
-        std::stringstream ss;
-
-        // Add the from and to squares to the string stream
-        ss << from_sq;
-        ss << to_sq;
+        char *end = writeSquare(to_sq, writeSquare(from_sq, out));
 
-        // If the move is a promotion, add the promoted piece to the string stream
+        // If the move is a promotion, add the promoted piece
         if (move.typeOf() == Move::PROMOTION) {
-            ss << static_cast<std::string>(move.promotionType());
+            *end++ = static_cast<char>(std::tolower(pieceSymbol(move.promotionType())));
         }
 
-        return ss.str();
+        return static_cast<std::size_t>(end - out);
+    }
+
+    /**
+     * @brief Appends the UCI string of a move to out, doesn't allocate if out has enough capacity.
+     * @param move
+     * @param out
+     * @param chess960
+     */
+    static void moveToUci(const Move &move, std::string &out, bool chess960 = false) {
+        char buffer[MAX_UCI_LENGTH];
+        out.append(buffer, moveToUci(move, buffer, chess960));
     }
 
     /**
@@ -53,7 +83,8 @@ class uci {
      * @param uci
      * @return
      */
-    [[nodiscard]] static Move uciToMove(const Board &board, const std::string &uci) noexcept(false) {
+    template <typename BoardT>
+    [[nodiscard]] static Move uciToMove(const BoardT &board, std::string_view uci) noexcept(false) {
         if (uci.length() < 4) {
             return Move::NO_MOVE;
         }
@@ -105,85 +136,147 @@ class uci {
     }
 
     /**
-     * @brief Converts a move to a SAN string
-     * @param board
-     * @param move
-     * @return
+     * @brief Why a SAN or UCI string couldn't be converted to a move.
      */
-    [[nodiscard]] static std::string moveToSan(const Board &board, const Move &move) noexcept(false) {
-        std::string san;
-        moveToRep<false>(board, move, san);
-        return san;
-    }
+    enum class ParseError : std::uint8_t {
+        NONE,
+        // the string is empty
+        EMPTY,
+        // the string isn't a move in the expected notation
+        INVALID_FORMAT,
+        // the promotion piece is missing, not allowed or given for a move which doesn't promote
+        INVALID_PROMOTION,
+        // no legal move matches the string
+        ILLEGAL_MOVE,
+        // more than one legal move matches the string
+        AMBIGUOUS_MOVE
+    };
 
     /**
-     * @brief Converts a move to a LAN string
-     * @param board
-     * @param move
-     * @return
+     * @brief Either a move or the reason why the string couldn't be parsed, like std::expected<Move, ParseError>.
+     * Never allocates.
      */
-    [[nodiscard]] static std::string moveToLan(const Board &board, const Move &move) noexcept(false) {
-        std::string lan;
-        moveToRep<true>(board, move, lan);
-        return lan;
-    }
-
-    class SanParseError : public std::exception {
+    class ParseResult {
        public:
-        explicit SanParseError(const char *message) : msg_(message) {}
-
-        explicit SanParseError(const std::string &message) : msg_(message) {}
-
-        virtual ~SanParseError() noexcept {}
-
-        virtual const char *what() const noexcept { return msg_.c_str(); }
+        ParseResult(Move move) noexcept : move_(move) {}
+        ParseResult(ParseError error) noexcept : error_(error) {}
+
+        [[nodiscard]] bool hasValue() const noexcept { return error_ == ParseError::NONE; }
+        explicit operator bool() const noexcept { return hasValue(); }
+
+        /**
+         * @brief The parsed move, only valid if hasValue() is true.
+         * @return
+         */
+        [[nodiscard]] Move value() const noexcept {
+            assert(hasValue());
+            return move_;
+        }
+
+        [[nodiscard]] Move valueOr(Move fallback) const noexcept { return hasValue() ? move_ : fallback; }
+
+        [[nodiscard]] ParseError error() const noexcept { return error_; }
+
+        /**
+         * @brief A static description of the error.
+         * @return
+         */
+        [[nodiscard]] const char *message() const noexcept {
+            switch (error_) {
+                case ParseError::NONE:
+                    return "No error";
+                case ParseError::EMPTY:
+                    return "Empty move";
+                case ParseError::INVALID_FORMAT:
+                    return "Invalid move format";
+                case ParseError::INVALID_PROMOTION:
+                    return "Invalid promotion";
+                case ParseError::ILLEGAL_MOVE:
+                    return "Illegal move";
+                case ParseError::AMBIGUOUS_MOVE:
+                    return "Ambiguous move";
+                default:
+                    assert(false);
+                    return "Unknown error";
+            }
+        }
 
-       protected:
-        std::string msg_;
+       private:
+        Move move_        = Move::NO_MOVE;
+        ParseError error_ = ParseError::NONE;
     };
 
-    class AmbiguousMoveError : public std::exception {
-       public:
-        explicit AmbiguousMoveError(const char *message) : msg_(message) {}
+    /**
+     * @brief Converts a UCI string to a legal move, without throwing.
+     * Unlike uciToMove the move is checked for legality.
+     * @param board
+     * @param uci
+     * @return the move or ParseError::EMPTY, INVALID_FORMAT, INVALID_PROMOTION or ILLEGAL_MOVE
+     */
+    template <typename BoardT>
+    [[nodiscard]] static ParseResult tryUciToMove(const BoardT &board, std::string_view uci) noexcept {
+        if (uci.empty()) return ParseError::EMPTY;
+        if (!isUciMove(uci)) return ParseError::INVALID_FORMAT;
 
-        explicit AmbiguousMoveError(const std::string &message) : msg_(message) {}
+        // a pawn reaching the last rank without a promotion piece
+        if (uci.size() == 4 && board.at(Square(uci.substr(0, 2))) == Piece(PieceType::PAWN, board.sideToMove()) &&
+            Square::back_rank(Square(uci.substr(2, 2)), ~board.sideToMove())) {
+            return ParseError::INVALID_PROMOTION;
+        }
 
-        virtual ~AmbiguousMoveError() noexcept {}
+        const auto move = uciToMove(board, uci);
 
-        virtual const char *what() const noexcept { return msg_.c_str(); }
+        // a promotion piece for a move which doesn't promote
+        if (move == Move::NO_MOVE) return ParseError::INVALID_PROMOTION;
 
-       protected:
-        std::string msg_;
-    };
+        if (!board.isPseudoLegal(move) || !board.isLegal(move)) return ParseError::ILLEGAL_MOVE;
+
+        return move;
+    }
 
     /**
-     * @brief Parse a san string and return the move.
-     * This function will throw a SanParseError if the san string is invalid.
+     * @brief Parse a san string and return the move or the reason it couldn't be parsed, without throwing
+     * and without building an error message. Works with CHESS_NO_EXCEPTIONS.
      * @param board
      * @param san
      * @return
      */
-    [[nodiscard]] static Move parseSan(const Board &board, std::string_view san) noexcept(false) {
+    template <typename BoardT>
+    [[nodiscard]] static ParseResult tryParseSan(const BoardT &board, std::string_view san) noexcept {
         Movelist moves;
 
-        return parseSan(board, san, moves);
+        return tryParseSan(board, san, moves);
     }
 
     /**
-     * @brief Parse a san string and return the move.
-     * This function will throw a SanParseError if the san string is invalid.
+     * @brief Parse a san string and return the move or the reason it couldn't be parsed, without throwing
+     * and without building an error message. Works with CHESS_NO_EXCEPTIONS.
      * @param board
      * @param san
-     * @param moves
+     * @param moves scratch space for the rare moves which aren't resolved from the attack tables
      * @return
      */
-    [[nodiscard]] static Move parseSan(const Board &board, std::string_view san, Movelist &moves) noexcept(false) {
-        if (san.empty()) {
-            return Move::NO_MOVE;
-        }
+    template <typename BoardT>
+    [[nodiscard]] static ParseResult tryParseSan(const BoardT &board, std::string_view san, Movelist &moves) noexcept {
+        if (san.empty()) return ParseError::EMPTY;
 
         static constexpr auto pt_to_pgt = [](PieceType pt) { return 1 << (pt); };
-        const SanMoveInformation info   = parseSanInfo(san);
+
+        SanMoveInformation info;
+
+        if (const auto error = parseSanInfo(san, info); error != ParseError::NONE) {
+            return error;
+        }
+
+        if (const auto move = parseSanDirect(board, info); move != Move::NO_MOVE) {
+            return move;
+        }
+
+        // a pawn reaching the last rank without a promotion piece
+        if (info.piece == PieceType::PAWN && info.promotion == PieceType::NONE &&
+            Square::back_rank(info.to, ~board.sideToMove())) {
+            return ParseError::INVALID_PROMOTION;
+        }
 
         if (info.capture) {
             movegen::legalmoves<movegen::MoveGenType::CAPTURE>(moves, board, pt_to_pgt(info.piece));
@@ -201,9 +294,7 @@ class uci {
                 }
             }
 
-#ifndef CHESS_NO_EXCEPTIONS
-            throw SanParseError("Failed to parse san. At step 2: " + std::string(san) + " " + board.getFen());
-#endif
+            return ParseError::ILLEGAL_MOVE;
         }
 
         Move matchingMove = Move::NO_MOVE;
@@ -245,9 +336,7 @@ class uci {
 
             // If we get here, the move matches our criteria
             if (foundMatch) {
-#ifndef CHESS_NO_EXCEPTIONS
-                throw AmbiguousMoveError("Ambiguous san: " + std::string(san) + " in " + board.getFen());
-#endif
+                return ParseError::AMBIGUOUS_MOVE;
             }
 
             matchingMove = move;
@@ -255,20 +344,201 @@ class uci {
         }
 
         if (!foundMatch) {
-#ifndef CHESS_NO_EXCEPTIONS
-            throw SanParseError("Failed to parse san. At step 3: " + std::string(san) + " " + board.getFen());
-#endif
+            return ParseError::ILLEGAL_MOVE;
         }
 
         return matchingMove;
     }
 
+    /**
+     * @brief Converts a move to a SAN string
+     * @param board
+     * @param move
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static std::string moveToSan(const BoardT &board, const Move &move) noexcept(false) {
+        char buffer[MAX_SAN_LENGTH];
+        return std::string(buffer, moveToSan(board, move, buffer));
+    }
+
+    /**
+     * @brief Writes the SAN string of a move to out, which must have room for MAX_SAN_LENGTH characters.
+     * No terminating null character is written and nothing is allocated.
+     * @param board
+     * @param move
+     * @param out
+     * @return the number of characters written
+     */
+    template <typename BoardT>
+    static std::size_t moveToSan(const BoardT &board, const Move &move, char *out) {
+        char *end = moveToRep<false>(board, move, out);
+        end       = writeCheckSymbol(board, move, end);
+        return static_cast<std::size_t>(end - out);
+    }
+
+    /**
+     * @brief Appends the SAN string of a move to out, doesn't allocate if out has enough capacity.
+     * @param board
+     * @param move
+     * @param out
+     */
+    template <typename BoardT>
+    static void moveToSan(const BoardT &board, const Move &move, std::string &out) {
+        char buffer[MAX_SAN_LENGTH];
+        out.append(buffer, moveToSan(board, move, buffer));
+    }
+
+    /**
+     * @brief Converts a move to a LAN string
+     * @param board
+     * @param move
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static std::string moveToLan(const BoardT &board, const Move &move) noexcept(false) {
+        char buffer[MAX_SAN_LENGTH];
+        return std::string(buffer, moveToLan(board, move, buffer));
+    }
+
+    /**
+     * @brief Writes the LAN string of a move to out, which must have room for MAX_SAN_LENGTH characters.
+     * No terminating null character is written and nothing is allocated.
+     * @param board
+     * @param move
+     * @param out
+     * @return the number of characters written
+     */
+    template <typename BoardT>
+    static std::size_t moveToLan(const BoardT &board, const Move &move, char *out) {
+        char *end = moveToRep<true>(board, move, out);
+        end       = writeCheckSymbol(board, move, end);
+        return static_cast<std::size_t>(end - out);
+    }
+
+    /**
+     * @brief Appends the LAN string of a move to out, doesn't allocate if out has enough capacity.
+     * @param board
+     * @param move
+     * @param out
+     */
+    template <typename BoardT>
+    static void moveToLan(const BoardT &board, const Move &move, std::string &out) {
+        char buffer[MAX_SAN_LENGTH];
+        out.append(buffer, moveToLan(board, move, buffer));
+    }
+
+    /**
+     * @brief Appends the SAN strings of a sequence of legal moves played from board to out,
+     * separated by separator. The position is copied once and advanced by each move,
+     * nothing is allocated if out has enough capacity.
+     * @param board
+     * @param moves any range of Move, e.g. a std::vector<Move> or a Movelist
+     * @param out
+     * @param separator
+     */
+    template <typename BoardT, typename Moves>
+    static void movesToSan(const BoardT &board, const Moves &moves, std::string &out, char separator = ' ') {
+        CopyMakeBoard position(board);
+        char buffer[MAX_SAN_LENGTH];
+        bool first = true;
+
+        for (const Move &move : moves) {
+            if (!first) out += separator;
+            first = false;
+
+            char *end        = moveToRep<false>(position, move, buffer);
+            const bool check = position.givesCheck(move);
+
+            position.makeMove(move);
+
+            if (check) end = writeMateOrCheck(position, end);
+
+            out.append(buffer, end);
+        }
+    }
+
+    class SanParseError : public std::exception {
+       public:
+        explicit SanParseError(const char *message) : msg_(message) {}
+
+        explicit SanParseError(const std::string &message) : msg_(message) {}
+
+        virtual ~SanParseError() noexcept {}
+
+        virtual const char *what() const noexcept { return msg_.c_str(); }
+
+       protected:
+        std::string msg_;
+    };
+
+    class AmbiguousMoveError : public std::exception {
+       public:
+        explicit AmbiguousMoveError(const char *message) : msg_(message) {}
+
+        explicit AmbiguousMoveError(const std::string &message) : msg_(message) {}
+
+        virtual ~AmbiguousMoveError() noexcept {}
+
+        virtual const char *what() const noexcept { return msg_.c_str(); }
+
+       protected:
+        std::string msg_;
+    };
+
+    /**
+     * @brief Parse a san string and return the move.
+     * This function will throw a SanParseError if the san string is invalid.
+     * @param board
+     * @param san
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Move parseSan(const BoardT &board, std::string_view san) noexcept(false) {
+        Movelist moves;
+
+        return parseSan(board, san, moves);
+    }
+
+    /**
+     * @brief Parse a san string and return the move.
+     * This function will throw a SanParseError if the san string is invalid.
+     * @param board
+     * @param san
+     * @param moves
+     * @return
+     */
+    template <typename BoardT>
+    [[nodiscard]] static Move parseSan(const BoardT &board, std::string_view san, Movelist &moves) noexcept(false) {
+        const auto result = tryParseSan(board, san, moves);
+
+        if (result) return result.value();
+
+#ifndef CHESS_NO_EXCEPTIONS
+        // the message is only built for the rare invalid moves
+        switch (result.error()) {
+            case ParseError::EMPTY:
+                break;
+            case ParseError::INVALID_FORMAT:
+                throw SanParseError("Failed to parse san. At step 0: " + std::string(san));
+            case ParseError::INVALID_PROMOTION:
+                throw SanParseError("Failed to parse promotion, during san conversion." + std::string(san));
+            case ParseError::AMBIGUOUS_MOVE:
+                throw AmbiguousMoveError("Ambiguous san: " + std::string(san) + " in " + board.getFen());
+            default:
+                throw SanParseError("Failed to parse san. At step 3: " + std::string(san) + " " + board.getFen());
+        }
+#endif
+
+        return Move::NO_MOVE;
+    }
+
     /**
      * @brief Check if a string is a valid UCI move. Must also have the correct length.
      * @param move
      * @return
      */
-    static bool isUciMove(const std::string &move) noexcept {
+    static bool isUciMove(std::string_view move) noexcept {
         bool is_uci = false;
 
         static constexpr auto is_digit     = [](char c) { return c >= '1' && c <= '8'; };
@@ -311,120 +581,272 @@ class uci {
         bool capture = false;
     };
 
-    [[nodiscard]] static SanMoveInformation parseSanInfo(std::string_view san) noexcept(false) {
-#ifndef CHESS_NO_EXCEPTIONS
-        if (san.length() < 2) {
-            throw SanParseError("Failed to parse san. At step 0: " + std::string(san));
+    // character classes of the SAN decoder, a character can belong to several classes
+    enum SanCharKind : std::uint8_t {
+        SAN_FILE      = 1 << 0,
+        SAN_RANK      = 1 << 1,
+        SAN_PIECE     = 1 << 2,
+        SAN_PROMOTION = 1 << 3,
+    };
+
+    struct SanChar {
+        std::uint8_t kind;
+        // the file or rank
+        std::uint8_t value;
+        // the piece type, kept apart since a lower case b is a file and a bishop
+        std::uint8_t piece;
+    };
+
+    static constexpr std::array<SanChar, 256> SAN_CHARS = []() constexpr {
+        std::array<SanChar, 256> table{};
+
+        for (int i = 0; i < 8; i++) {
+            table['a' + i] = {SAN_FILE, static_cast<std::uint8_t>(i), 0};
+            table['1' + i] = {SAN_RANK, static_cast<std::uint8_t>(i), 0};
         }
-#endif
-        constexpr auto parse_castle = [](std::string_view &san, SanMoveInformation &info, char castling_char) {
-            info.piece = PieceType::KING;
 
-            san.remove_prefix(3);
+        constexpr std::string_view upper = "PNBRQK";
+        constexpr std::string_view lower = "pnbrqk";
 
-            info.castling_short = san.length() == 0 || (san.length() >= 1 && san[0] != '-');
-            info.castling_long  = san.length() >= 2 && san[0] == '-' && san[1] == castling_char;
+        for (std::size_t i = 0; i < upper.size(); i++) {
+            const bool promotion = i != 0 && i != 5;
+            const auto piece     = static_cast<std::uint8_t>(i);
 
-            assert((info.castling_short && !info.castling_long) || (!info.castling_short && info.castling_long) ||
-                   (!info.castling_short && !info.castling_long));
-        };
+            table[static_cast<unsigned char>(upper[i])] = {
+                static_cast<std::uint8_t>(SAN_PIECE | (promotion ? SAN_PROMOTION : 0)), 0, piece};
 
-        static constexpr auto isRank = [](char c) { return c >= '1' && c <= '8'; };
-        static constexpr auto isFile = [](char c) { return c >= 'a' && c <= 'h'; };
-        static constexpr auto sw     = [](const char &c) { return std::string_view(&c, 1); };
+            // a lower case b is a file, except as promotion piece
+            auto &entry = table[static_cast<unsigned char>(lower[i])];
+            entry.kind |= (lower[i] != 'b' ? SAN_PIECE : 0) | (promotion ? SAN_PROMOTION : 0);
+            entry.piece = piece;
+        }
 
-        SanMoveInformation info;
+        return table;
+    }();
 
-        // set to 1 to skip piece type offset
-        std::size_t index = 1;
+    [[nodiscard]] static SanChar sanChar(char c) noexcept { return SAN_CHARS[static_cast<unsigned char>(c)]; }
 
+    // Decodes the token from the back, where its structure is fixed: the destination square and an optional
+    // promotion come last, everything in front of them is an optional piece, origin hints and capture sign.
+    [[nodiscard]] static ParseError parseSanInfo(std::string_view san, SanMoveInformation &info) noexcept {
+        if (san.length() < 2) {
+            return ParseError::INVALID_FORMAT;
+        }
+
+        // anything after the move is ignored, like check and annotation symbols
         if (san[0] == 'O' || san[0] == '0') {
-            parse_castle(san, info, san[0]);
-            return info;
-        } else if (isFile(san[0])) {
-            index--;
-            info.piece = PieceType::PAWN;
-        } else {
-            info.piece = PieceType(san);
+            const auto castle = san[0];
+
+            while (!san.empty() && san.back() != castle) {
+                san.remove_suffix(1);
+            }
+
+            info.piece          = PieceType::KING;
+            info.castling_short = san.length() == 3 && san[1] == '-';
+            info.castling_long  = san.length() == 5 && san[1] == '-' && san[3] == '-';
+
+            return info.castling_short || info.castling_long ? ParseError::NONE : ParseError::INVALID_FORMAT;
         }
 
-        File file_to = File::NO_FILE;
-        Rank rank_to = Rank::NO_RANK;
+        while (!san.empty() && san.back() != '=' && !(sanChar(san.back()).kind & (SAN_RANK | SAN_PROMOTION))) {
+            san.remove_suffix(1);
+        }
 
-        // check if san starts with a file, if so it will be start file
-        if (index < san.size() && isFile(san[index])) {
-            info.from_file = File(sw(san[index]));
-            index++;
+        if (san.length() < 2) {
+            return ParseError::INVALID_FORMAT;
         }
 
-        // check if san starts with a rank, if so it will be start rank
-        if (index < san.size() && isRank(san[index])) {
-            info.from_rank = Rank(sw(san[index]));
-            index++;
+        // promotion, the equal sign is optional
+        const bool equal_sign = san.back() == '=' || san[san.length() - 2] == '=';
+        const auto last       = sanChar(san.back());
+
+        // a lower case promotion piece needs the equal sign, "b8b" isn't a bishop promotion
+        const bool upper_case = san.back() >= 'A' && san.back() <= 'Z';
+
+        if ((last.kind & SAN_PROMOTION) && (equal_sign || upper_case)) {
+            info.promotion = PieceType(static_cast<PieceType::underlying>(last.piece));
+            san.remove_suffix(equal_sign ? 2 : 1);
+        } else if (equal_sign) {
+            return ParseError::INVALID_PROMOTION;
         }
 
-        // skip capture sign
-        if (index < san.size() && san[index] == 'x') {
-            info.capture = true;
-            index++;
+        if (san.length() < 2) {
+            return ParseError::INVALID_FORMAT;
         }
 
-        // to file
-        if (index < san.size() && isFile(san[index])) {
-            file_to = File(sw(san[index]));
-            index++;
+        const auto file_to = sanChar(san[san.length() - 2]);
+        const auto rank_to = sanChar(san[san.length() - 1]);
+
+        if (!(file_to.kind & SAN_FILE) || !(rank_to.kind & SAN_RANK)) {
+            return ParseError::INVALID_FORMAT;
         }
 
-        // to rank
-        if (index < san.size() && isRank(san[index])) {
-            rank_to = Rank(sw(san[index]));
-            index++;
+        info.to = Square(File(file_to.value), Rank(rank_to.value));
+        san.remove_suffix(2);
+
+        info.piece = PieceType::PAWN;
+
+        if (!san.empty() && (sanChar(san[0]).kind & SAN_PIECE)) {
+            info.piece = PieceType(static_cast<PieceType::underlying>(sanChar(san[0]).piece));
+            san.remove_prefix(1);
         }
 
-        // promotion
-        if (index < san.size() && san[index] == '=') {
-            index++;
-            info.promotion = PieceType(sw(san[index]));
+        if (!san.empty() && san.back() == 'x') {
+            info.capture = true;
+            san.remove_suffix(1);
+        }
 
-#ifndef CHESS_NO_EXCEPTIONS
-            if (info.promotion == PieceType::KING || info.promotion == PieceType::PAWN ||
-                info.promotion == PieceType::NONE)
-                throw SanParseError("Failed to parse promotion, during san conversion." + std::string(san));
-#endif
+        // at most the file and the rank of the origin are left, in this order
+        if (!san.empty() && (sanChar(san[0]).kind & SAN_FILE)) {
+            info.from_file = File(sanChar(san[0]).value);
+            san.remove_prefix(1);
+        }
 
-            index++;
+        if (!san.empty() && (sanChar(san[0]).kind & SAN_RANK)) {
+            info.from_rank = Rank(sanChar(san[0]).value);
+            san.remove_prefix(1);
         }
 
-        // for simple moves like Nf3, e4, etc. all the information is contained
-        // in the from file and rank. Thus we need to move it to the to file and rank.
-        if (file_to == File::NO_FILE && rank_to == Rank::NO_RANK) {
-            file_to = info.from_file;
-            rank_to = info.from_rank;
+        if (!san.empty()) {
+            return ParseError::INVALID_FORMAT;
+        }
+
+        if (info.promotion != PieceType::NONE && info.piece != PieceType::PAWN) {
+            return ParseError::INVALID_PROMOTION;
+        }
 
-            info.from_file = File::NO_FILE;
-            info.from_rank = Rank::NO_RANK;
+        // pawn captures name the origin file, pawns never need the rank alone
+        if (info.piece == PieceType::PAWN && info.from_file == File::NO_FILE &&
+            (info.capture || info.from_rank != Rank::NO_RANK)) {
+            return ParseError::INVALID_FORMAT;
         }
 
         // pawns which are not capturing stay on the same file
         if (info.piece == PieceType::PAWN && info.from_file == File::NO_FILE && !info.capture) {
-            info.from_file = file_to;
+            info.from_file = info.to.file();
         }
 
-        info.to = Square(file_to, rank_to);
-
         if (info.from_file != File::NO_FILE && info.from_rank != Rank::NO_RANK) {
             info.from = Square(info.from_file, info.from_rank);
         }
 
-        return info;
+        return ParseError::NONE;
     }
 
-    template <bool LAN = false>
-    static void moveToRep(Board board, const Move &move, std::string &str) {
-        if (handleCastling(move, str)) {
-            board.makeMove(move);
-            if (board.inCheck()) appendCheckSymbol(board, str);
-            return;
+    // Finds the move among the pieces which attack the target square, which is much cheaper than generating
+    // the moves. The candidates are pseudo legal by construction, so only their legality is checked.
+    // Returns Move::NO_MOVE for invalid or ambiguous moves, the move generation handles and reports those.
+    template <typename BoardT>
+    [[nodiscard]] static Move parseSanDirect(const BoardT &board, const SanMoveInformation &info) {
+        const auto stm = board.sideToMove();
+
+        if (info.castling_short || info.castling_long) {
+            const auto side = info.castling_short ? CastlingRights::Side::KING_SIDE : CastlingRights::Side::QUEEN_SIDE;
+
+            if (!board.castlingRights().has(stm, side)) {
+                return Move::NO_MOVE;
+            }
+
+            const auto king_sq = board.kingSq(stm);
+            const auto rook_sq = Square(board.castlingRights().getRookFile(stm, side), king_sq.rank());
+            const auto move    = Move::make<Move::CASTLING>(king_sq, rook_sq);
+
+            return board.isLegal(move) ? move : Move::NO_MOVE;
+        }
+
+        const auto to_piece  = board.at(info.to);
+        const auto enpassant = info.piece == PieceType::PAWN && info.capture && info.to == board.enpassantSq();
+
+        // the capture sign has to match the board, like the generated captures and quiets
+        if (info.capture != (to_piece != Piece::NONE || enpassant)) {
+            return Move::NO_MOVE;
+        }
+
+        if (to_piece != Piece::NONE && to_piece.color() == stm) {
+            return Move::NO_MOVE;
+        }
+
+        Bitboard from = 0ULL;
+
+        switch (info.piece.internal()) {
+            case PieceType::PAWN: {
+                // a pawn promotes exactly when it reaches the last rank
+                if ((info.promotion != PieceType::NONE) != Square::back_rank(info.to, ~stm)) {
+                    return Move::NO_MOVE;
+                }
+
+                if (info.capture) {
+                    from = attacks::pawn(~stm, info.to);
+                    break;
+                }
+
+                // the single push origin, or the double push origin behind an empty square
+                const auto to     = Bitboard::fromSquare(info.to).getBits();
+                const auto single = stm == Color::WHITE ? to >> 8 : to << 8;
+                const auto twice  = stm == Color::WHITE ? single >> 8 : single << 8;
+                const auto start  = Bitboard(stm == Color::WHITE ? Rank::RANK_2 : Rank::RANK_7);
+
+                from = Bitboard(single);
+
+                if (!(board.occ() & Bitboard(single))) from |= Bitboard(twice) & start;
+                break;
+            }
+            case PieceType::KNIGHT:
+                from = attacks::knight(info.to);
+                break;
+            case PieceType::BISHOP:
+                from = attacks::bishop(info.to, board.occ());
+                break;
+            case PieceType::ROOK:
+                from = attacks::rook(info.to, board.occ());
+                break;
+            case PieceType::QUEEN:
+                from = attacks::queen(info.to, board.occ());
+                break;
+            case PieceType::KING:
+                from = attacks::king(info.to);
+                break;
+            default:
+                return Move::NO_MOVE;
+        }
+
+        from &= board.pieces(info.piece, stm);
+
+        if (info.from_file != File::NO_FILE) from &= Bitboard(info.from_file);
+        if (info.from_rank != Rank::NO_RANK) from &= Bitboard(info.from_rank);
+
+        Move match = Move::NO_MOVE;
+
+        while (from) {
+            const auto sq = Square(from.pop());
+
+            Move move;
+
+            if (info.promotion != PieceType::NONE) {
+                move = Move::make<Move::PROMOTION>(sq, info.to, info.promotion);
+            } else if (enpassant) {
+                move = Move::make<Move::ENPASSANT>(sq, info.to);
+            } else {
+                move = Move::make<Move::NORMAL>(sq, info.to);
+            }
+
+            if (!board.isLegal(move)) continue;
+
+            // ambiguous
+            if (match != Move::NO_MOVE) return Move::NO_MOVE;
+
+            match = move;
+        }
+
+        return match;
+    }
+
+    // writes the SAN (LAN = false) or LAN of a move without the check symbol to out,
+    // returns the end of the written characters
+    template <bool LAN = false, typename BoardT>
+    static char *moveToRep(const BoardT &board, const Move &move, char *out) {
+        if (move.typeOf() == Move::CASTLING) {
+            return writeCastling(move, out);
         }
 
         const PieceType pt   = board.at(move.from()).type();
@@ -433,125 +855,126 @@ class uci {
         assert(pt != PieceType::NONE);
 
         if (pt != PieceType::PAWN) {
-            appendPieceSymbol(pt, str);
+            *out++ = pieceSymbol(pt);
         }
 
         if constexpr (LAN) {
-            appendSquare(move.from(), str);
+            out = writeSquare(move.from(), out);
         } else {
             if (pt == PieceType::PAWN) {
-                str += isCapture ? static_cast<std::string>(move.from().file()) : "";
+                if (isCapture) *out++ = fileSymbol(move.from().file());
             } else {
-                resolveAmbiguity(board, move, pt, str);
+                out = resolveAmbiguity(board, move, pt, out);
             }
         }
 
         if (isCapture) {
-            str += 'x';
+            *out++ = 'x';
         }
 
-        appendSquare(move.to(), str);
-
-        if (move.typeOf() == Move::PROMOTION) appendPromotion(move, str);
+        out = writeSquare(move.to(), out);
 
-        board.makeMove(move);
+        if (move.typeOf() == Move::PROMOTION) {
+            *out++ = '=';
+            *out++ = pieceSymbol(move.promotionType());
+        }
 
-        if (board.inCheck()) appendCheckSymbol(board, str);
+        return out;
     }
 
-    static bool handleCastling(const Move &move, std::string &str) {
-        if (move.typeOf() != Move::CASTLING) return false;
-
-        str = (move.to().file() > move.from().file()) ? "O-O" : "O-O-O";
-        return true;
+    static char *writeCastling(const Move &move, char *out) noexcept {
+        const std::string_view castling = move.to().file() > move.from().file() ? "O-O" : "O-O-O";
+        return std::copy(castling.begin(), castling.end(), out);
     }
 
-    static void appendPieceSymbol(PieceType pieceType, std::string &str) {
-        str += std::toupper(static_cast<std::string>(pieceType)[0]);
-    }
+    static char pieceSymbol(PieceType pieceType) noexcept { return "PNBRQK"[static_cast<int>(pieceType)]; }
 
-    static void appendSquare(Square square, std::string &str) {
-        str += static_cast<std::string>(square.file());
-        str += static_cast<std::string>(square.rank());
-    }
+    static char fileSymbol(File file) noexcept { return static_cast<char>('a' + static_cast<int>(file)); }
 
-    static void appendPromotion(const Move &move, std::string &str) {
-        str += '=';
-        str += std::toupper(static_cast<std::string>(move.promotionType())[0]);
-    }
+    static char rankSymbol(Rank rank) noexcept { return static_cast<char>('1' + static_cast<int>(rank)); }
 
-    static void appendCheckSymbol(Board &board, std::string &str) {
-        const auto gameState = board.isGameOver().second;
-        str += (gameState == GameResult::LOSE) ? '#' : '+';
+    static char *writeSquare(Square square, char *out) noexcept {
+        *out++ = fileSymbol(square.file());
+        *out++ = rankSymbol(square.rank());
+        return out;
     }
 
-    static void resolveAmbiguity(const Board &board, const Move &move, PieceType pieceType, std::string &str) {
-        Movelist moves;
-        movegen::legalmoves(moves, board, 1 << pieceType);
-
-        bool needFile         = false;
-        bool needRank         = false;
-        bool hasAmbiguousMove = false;
+    template <typename BoardT>
+    static char *writeCheckSymbol(const BoardT &board, const Move &move, char *out) {
+        if (!board.givesCheck(move)) return out;
 
-        for (const auto &m : moves) {
-            if (m != move && m.to() == move.to()) {
-                hasAmbiguousMove = true;
+        // only a check can be mate, the position after the move is copied without its history
+        CopyMakeBoard after(board);
+        after.makeMove(move);
 
-                /*
-                First, if the moving pieces can be distinguished by their originating files, the originating
-                file letter of the moving piece is inserted immediately after the moving piece letter.
+        return writeMateOrCheck(after, out);
+    }
 
-                Second (when the first step fails), if the moving pieces can be distinguished by their
-                originating ranks, the originating rank digit of the moving piece is inserted immediately after
-                the moving piece letter.
+    // board is the position after a checking move
+    template <typename BoardT>
+    static char *writeMateOrCheck(const BoardT &board, char *out) {
+        *out++ = movegen::countLegalMoves(board) == 0 ? '#' : '+';
+        return out;
+    }
 
-                Third (when both the first and the second steps fail), the two character square coordinate of
-                the originating square of the moving piece is inserted immediately after the moving piece
-                letter.
-                */
+    template <typename BoardT>
+    static char *resolveAmbiguity(const BoardT &board, const Move &move, PieceType pieceType, char *out) {
+        const auto to  = move.to();
+        const auto occ = board.occ();
+
+        // the other pieces of the same type which see the destination
+        Bitboard candidates = board.pieces(pieceType, board.sideToMove()) & ~Bitboard::fromSquare(move.from());
+
+        switch (pieceType.internal()) {
+            case PieceType::KNIGHT:
+                candidates &= attacks::knight(to);
+                break;
+            case PieceType::BISHOP:
+                candidates &= attacks::bishop(to, occ);
+                break;
+            case PieceType::ROOK:
+                candidates &= attacks::rook(to, occ);
+                break;
+            case PieceType::QUEEN:
+                candidates &= attacks::queen(to, occ);
+                break;
+            default:
+                return out;
+        }
 
-                if (isIdentifiableByType(moves, move, move.from().file())) {
-                    needFile = true;
-                    break;
-                }
+        // drop the pinned pieces which can't reach the destination, the legality check only runs
+        // when there is an ambiguity at all
+        Bitboard others = 0ull;
 
-                if (isIdentifiableByType(moves, move, move.from().rank())) {
-                    needRank = true;
-                    break;
-                }
-            }
+        while (candidates) {
+            const auto from = candidates.pop();
+            if (board.isLegal(Move::make<Move::NORMAL>(from, to))) others.set(from);
         }
 
-        if (needFile) str += static_cast<std::string>(move.from().file());
-        if (needRank) str += static_cast<std::string>(move.from().rank());
+        if (!others) return out;
 
-        // we weren't able to disambiguate the move by either file or rank, so we need to use both
-        if (hasAmbiguousMove && !needFile && !needRank) {
-            appendSquare(move.from(), str);
-        }
-    }
+        /*
+        First, if the moving pieces can be distinguished by their originating files, the originating
+        file letter of the moving piece is inserted immediately after the moving piece letter.
 
-    template <typename CoordinateType>
-    static bool isIdentifiableByType(const Movelist &moves, const Move move, CoordinateType type) {
-        static_assert(std::is_same_v<CoordinateType, File> || std::is_same_v<CoordinateType, Rank>,
-                      "CoordinateType must be either File or Rank");
+        Second (when the first step fails), if the moving pieces can be distinguished by their
+        originating ranks, the originating rank digit of the moving piece is inserted immediately after
+        the moving piece letter.
 
-        for (const auto &m : moves) {
-            if (m == move || m.to() != move.to()) {
-                continue;
-            }
+        Third (when both the first and the second steps fail), the two character square coordinate of
+        the originating square of the moving piece is inserted immediately after the moving piece
+        letter.
+        */
 
-            // file
-            if constexpr (std::is_same_v<CoordinateType, File>) {
-                if (type == m.from().file()) return false;
-            }
-            // rank
-            else {
-                if (type == m.from().rank()) return false;
-            }
+        if (!(others & attacks::MASK_FILE[static_cast<int>(move.from().file())])) {
+            *out++ = fileSymbol(move.from().file());
+        } else if (!(others & attacks::MASK_RANK[static_cast<int>(move.from().rank())])) {
+            *out++ = rankSymbol(move.from().rank());
+        } else {
+            out = writeSquare(move.from(), out);
         }
 
-        return true;
+        return out;
     }
 };
 }  // namespace chess
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "board_fwd.hpp"
 #include "coords.hpp"
 #include "piece.hpp"
 
@@ -227,7 +228,8 @@ class Zobrist {
     [[nodiscard]] static U64 sideToMove() noexcept { return RANDOM_ARRAY[780]; }
 
    public:
-    friend class Board;
+    template <typename, typename>
+    friend class BasicBoard;
 };
 
 }  // namespace chess
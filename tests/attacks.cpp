@@ -0,0 +1,59 @@
+#include <random>
+
+#include "../src/include.hpp"
+#include "doctest/doctest.hpp"
+
+using namespace chess;
+
+namespace {
+// Walks the rays one square at a time, independent of the slider backend.
+Bitboard slide(Square sq, Bitboard occupied, const std::array<std::pair<int, int>, 4> &directions) {
+    Bitboard attacks = 0ULL;
+
+    for (const auto &[dr, df] : directions) {
+        int r = sq.rank() + dr;
+        int f = sq.file() + df;
+
+        while (r >= 0 && r < 8 && f >= 0 && f < 8) {
+            const auto s = Square(static_cast<Rank>(r), static_cast<File>(f));
+            attacks.set(s.index());
+            if (occupied.check(s.index())) break;
+            r += dr;
+            f += df;
+        }
+    }
+
+    return attacks;
+}
+
+Bitboard slowRook(Square sq, Bitboard occupied) { return slide(sq, occupied, {{{1, 0}, {-1, 0}, {0, 1}, {0, -1}}}); }
+
+Bitboard slowBishop(Square sq, Bitboard occupied) {
+    return slide(sq, occupied, {{{1, 1}, {1, -1}, {-1, 1}, {-1, -1}}});
+}
+}  // namespace
+
+TEST_SUITE("Attacks") {
+    TEST_CASE("Sliders match a ray walk") {
+        std::mt19937_64 rng(42);
+
+        for (int i = 0; i < 500; i++) {
+            // sparse and dense occupancies
+            const Bitboard occupied = i % 2 ? rng() & rng() : rng() | rng();
+
+            for (Square sq = 0; sq < 64; ++sq) {
+                CHECK(attacks::rook(sq, occupied) == slowRook(sq, occupied));
+                CHECK(attacks::bishop(sq, occupied) == slowBishop(sq, occupied));
+                CHECK(attacks::queen(sq, occupied) == (slowRook(sq, occupied) | slowBishop(sq, occupied)));
+            }
+        }
+    }
+
+    TEST_CASE("Sliders on an empty board") {
+        CHECK(attacks::rook(Square::SQ_A1, 0ULL) == ((attacks::MASK_RANK[0] | attacks::MASK_FILE[0]) ^ 1ULL));
+        CHECK(attacks::bishop(Square::SQ_A1, 0ULL) == Bitboard(0x8040201008040200ULL));
+        CHECK(attacks::bishop(Square::SQ_H1, 0ULL) == Bitboard(0x0102040810204000ULL));
+        CHECK(attacks::rook(Square::SQ_D4, 0ULL).count() == 14);
+        CHECK(attacks::bishop(Square::SQ_D4, 0ULL).count() == 13);
+    }
+}
@@ -1,3 +1,4 @@
+#include <functional>
 #include <map>
 
 #include "../src/include.hpp"
@@ -5,6 +6,68 @@
 
 using namespace chess;
 
+namespace {
+// keeps the material balance up to date through the board hooks
+class MaterialBoard : public BasicBoard<MaterialBoard> {
+    using Base = BasicBoard<MaterialBoard>;
+    friend Base;
+
+   public:
+    MaterialBoard(std::string_view fen = constants::STARTPOS) : Base(fen) { material = evaluate(); }
+
+    void setFen(std::string_view fen) {
+        material = 0;
+        Base::setFen(fen);
+    }
+
+    int evaluate() const {
+        int score = 0;
+
+        for (int sq = 0; sq < 64; sq++) score += value(at(Square(sq)));
+
+        return score;
+    }
+
+    int material = 0;
+
+   protected:
+    void placePiece(Piece piece, Square sq) {
+        Base::placePiece(piece, sq);
+        material += value(piece);
+    }
+
+    void removePiece(Piece piece, Square sq) {
+        Base::removePiece(piece, sq);
+        material -= value(piece);
+    }
+
+   private:
+    static int value(Piece piece) {
+        constexpr int values[] = {1, 3, 3, 5, 9, 0};
+        if (piece == Piece::NONE) return 0;
+        return piece.color() == Color::WHITE ? values[piece.type()] : -values[piece.type()];
+    }
+};
+
+void checkMaterial(MaterialBoard &board, int depth) {
+    REQUIRE(board.material == board.evaluate());
+
+    if (depth == 0) return;
+
+    Movelist moves;
+    movegen::legalmoves(moves, board);
+
+    for (const auto &move : moves) {
+        board.makeMove(move);
+        checkMaterial(board, depth - 1);
+        board.unmakeMove(move);
+        REQUIRE(board.material == board.evaluate());
+    }
+}
+}  // namespace
+
+static_assert(!std::is_polymorphic_v<Board>);
+
 TEST_SUITE("Board") {
     TEST_CASE("Board makeMove/unmakeMove") {
         SUBCASE("makeMove") {
@@ -492,4 +555,115 @@ TEST_SUITE("Board") {
             CHECK("rr6/2kpp3/1ppnb1p1/p2Q1q1p/P4P1P/1PNN2P1/2PP4/1K2RR2 b E - 0 1" == newboard.getFen());
         }
     }
+
+    TEST_CASE("Board State Stacks") {
+        const auto fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+
+        SUBCASE("FixedBoard makeMove/unmakeMove") {
+            FixedBoard<> board(fen);
+
+            CHECK(perft::count(board, 3) == 97862);
+            CHECK(board.getFen() == fen);
+            CHECK(board.hash() == board.zobrist());
+        }
+
+        SUBCASE("FixedBoard copy") {
+            FixedBoard<16> board;
+
+            board.makeMove(uci::uciToMove(board, "g1f3"));
+            board.makeMove(uci::uciToMove(board, "g8f6"));
+
+            auto copy = board;
+
+            copy.makeMove(uci::uciToMove(copy, "f3g1"));
+            copy.makeMove(uci::uciToMove(copy, "f6g8"));
+
+            CHECK(copy.isRepetition(1));
+            CHECK(!board.isRepetition(1));
+
+            copy.unmakeMove(uci::uciToMove(board, "f6g8"));
+            copy.unmakeMove(uci::uciToMove(board, "f3g1"));
+
+            CHECK(copy.getFen() == board.getFen());
+            CHECK(copy.hash() == board.hash());
+        }
+
+        SUBCASE("ExternalStateStack") {
+            BoardState states[8];
+            BasicBoard<void, ExternalStateStack> board(ExternalStateStack(states, 8));
+
+            const auto move = uci::uciToMove(board, "e2e4");
+
+            board.makeMove(move);
+            CHECK(states[0].hash == Board().hash());
+
+            board.unmakeMove(move);
+            CHECK(board.getFen() == constants::STARTPOS);
+        }
+
+        SUBCASE("CopyMakeBoard") {
+            const std::function<std::uint64_t(const CopyMakeBoard &, int)> count = [&](const CopyMakeBoard &board,
+                                                                                      int depth) {
+                if (depth == 0) return std::uint64_t(1);
+
+                Movelist moves;
+                movegen::legalmoves(moves, board);
+
+                std::uint64_t nodes = 0;
+
+                for (const auto &move : moves) {
+                    auto child = board;
+                    child.makeMove(move);
+                    nodes += count(child, depth - 1);
+                }
+
+                return nodes;
+            };
+
+            CHECK(count(CopyMakeBoard(fen), 3) == 97862);
+            CHECK(!CopyMakeBoard().isRepetition(1));
+        }
+
+        SUBCASE("set960 without allocation") {
+            FixedBoard<> board("1rqbkrbn/1ppppp1p/1n6/p1N3p1/8/2P4P/PP1PPPP1/1RQBKRBN w FBfb - 0 9");
+            board.set960(true);
+
+            CHECK(board.getFen() == "1rqbkrbn/1ppppp1p/1n6/p1N3p1/8/2P4P/PP1PPPP1/1RQBKRBN w FBfb - 0 9");
+
+            Board reference("1rqbkrbn/1ppppp1p/1n6/p1N3p1/8/2P4P/PP1PPPP1/1RQBKRBN w FBfb - 0 9", true);
+            CHECK(perft::count(board, 3) == perft::count(reference, 3));
+        }
+
+        SUBCASE("set960 with a fen longer than the buffer") {
+            const auto fen = std::string("bqnb1rkr/pp3ppp/3ppn2/2p5/5P2/P2P4/NPP1P1PP/BQ1BNRKR w KQkq - 2 9");
+
+            // not stored, the current position is parsed again
+            FixedBoard<> board(fen + std::string(100, ' '));
+            board.set960(true);
+
+            Board reference(fen, true);
+
+            CHECK(board.getFen() == "bqnb1rkr/pp3ppp/3ppn2/2p5/5P2/P2P4/NPP1P1PP/BQ1BNRKR w HFhf - 2 9");
+            CHECK(board.getFen() == reference.getFen());
+            CHECK(perft::count(board, 3) == perft::count(reference, 3));
+        }
+    }
+
+    TEST_CASE("Board Hooks") {
+        SUBCASE("incremental updates") {
+            MaterialBoard board("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+            checkMaterial(board, 3);
+
+            board.setFen("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+            checkMaterial(board, 3);
+
+            board.setFen("8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1");
+            checkMaterial(board, 2);
+        }
+
+        SUBCASE("fromFen") {
+            auto board = MaterialBoard::fromFen("4k3/8/8/8/8/8/8/3QK3 w - - 0 1");
+            CHECK(board.material == 9);
+        }
+    }
 }
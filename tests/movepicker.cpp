@@ -0,0 +1,143 @@
+#include <set>
+
+#include "../src/include.hpp"
+#include "doctest/doctest.hpp"
+
+using namespace chess;
+
+namespace {
+std::vector<Move> pickAll(MovePicker<> &picker) {
+    std::vector<Move> moves;
+
+    for (auto move = picker.next(); move != Move::NO_MOVE; move = picker.next()) moves.push_back(move);
+
+    return moves;
+}
+
+void checkSameMoves(const Board &board, const std::vector<Move> &picked) {
+    Movelist legal;
+    movegen::legalmoves(legal, board);
+
+    std::set<std::uint16_t> unique;
+    for (const auto move : picked) unique.insert(move.move());
+
+    CHECK(unique.size() == picked.size());
+    CHECK(picked.size() == static_cast<std::size_t>(legal.size()));
+
+    for (const auto move : legal) {
+        CHECK(std::find(picked.begin(), picked.end(), move) != picked.end());
+    }
+}
+}  // namespace
+
+TEST_SUITE("MovePicker") {
+    const std::vector<std::string> fens = {
+        constants::STARTPOS,
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1",
+        "4k3/8/8/8/8/8/8/4K2q w - - 0 1",
+    };
+
+    TEST_CASE("Returns every legal move exactly once") {
+        for (const auto &fen : fens) {
+            const auto board = Board(fen);
+
+            MovePicker picker(board);
+            checkSameMoves(board, pickAll(picker));
+            CHECK(picker.stage() == MovePicker<>::Stage::DONE);
+            CHECK(picker.next() == Move::NO_MOVE);
+        }
+    }
+
+    TEST_CASE("Hash move and killers") {
+        for (const auto &fen : fens) {
+            const auto board = Board(fen);
+
+            Movelist legal;
+            movegen::legalmoves(legal, board);
+
+            Movelist quiets;
+            movegen::legalmoves<movegen::MoveGenType::QUIET>(quiets, board);
+
+            for (const auto hash_move : legal) {
+                const auto killer = quiets.empty() ? Move::NO_MOVE : quiets[quiets.size() - 1];
+
+                MovePicker picker(board, hash_move, {killer, killer});
+                const auto picked = pickAll(picker);
+
+                REQUIRE(!picked.empty());
+                CHECK(picked.front() == hash_move);
+                checkSameMoves(board, picked);
+            }
+        }
+    }
+
+    TEST_CASE("Illegal hash move and killers are skipped") {
+        const auto board = Board(constants::STARTPOS);
+
+        const auto illegal = std::array<Move, 5>{
+            Move::make(Square::SQ_E2, Square::SQ_E5),   Move::make(Square::SQ_E7, Square::SQ_E5),
+            Move::make(Square::SQ_E4, Square::SQ_E5),   Move::make(Square::SQ_B1, Square::SQ_D2),
+            Move::make<Move::CASTLING>(Square::SQ_E1, Square::SQ_H1),
+        };
+
+        for (const auto move : illegal) {
+            MovePicker picker(board, move, {move, Move::make(Square::SQ_A2, Square::SQ_A5)});
+            checkSameMoves(board, pickAll(picker));
+        }
+    }
+
+    TEST_CASE("Captures are MVV-LVA ordered before quiets") {
+        const auto board = Board("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+
+        MovePicker picker(board);
+        const auto picked = pickAll(picker);
+
+        Movelist captures;
+        movegen::legalmoves<movegen::MoveGenType::CAPTURE>(captures, board);
+
+        REQUIRE(picked.size() > static_cast<std::size_t>(captures.size()));
+
+        const auto value = [&](Move move) {
+            return int(board.at<PieceType>(move.to())) * 8 - int(board.at<PieceType>(move.from()));
+        };
+
+        for (int i = 0; i < captures.size(); i++) {
+            CHECK(board.isCapture(picked[i]));
+            if (i > 0) CHECK(value(picked[i - 1]) >= value(picked[i]));
+        }
+
+        for (std::size_t i = captures.size(); i < picked.size(); i++) {
+            CHECK(!board.isCapture(picked[i]));
+        }
+    }
+
+    TEST_CASE("Quiets are generated lazily") {
+        const auto board = Board("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+
+        MovePicker picker(board);
+
+        CHECK(picker.stage() == MovePicker<>::Stage::HASH);
+        CHECK(board.isCapture(picker.next()));
+        CHECK(picker.stage() == MovePicker<>::Stage::CAPTURES);
+    }
+
+    TEST_CASE("skipQuiets") {
+        const auto board = Board("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+        const auto killer = Move::make(Square::SQ_A2, Square::SQ_A3);
+
+        Movelist captures;
+        movegen::legalmoves<movegen::MoveGenType::CAPTURE>(captures, board);
+
+        MovePicker picker(board, Move::NO_MOVE, {killer, Move::NO_MOVE});
+        picker.skipQuiets();
+
+        const auto picked = pickAll(picker);
+
+        REQUIRE(picked.size() == static_cast<std::size_t>(captures.size()) + 1);
+        CHECK(picked.back() == killer);
+    }
+}
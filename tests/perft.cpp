@@ -104,4 +104,291 @@ TEST_SUITE("PERFT") {
             perft.benchPerft(board, test.depth, test.expected_node_count);
         }
     }
+
+    TEST_CASE("Threaded Divide") {
+        const Test test_positions[] = {
+            {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4865609, 5},
+            {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ", 4085603, 4},
+            {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - ", 11030083, 6},
+            {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 15833292, 5},
+            {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 2103487, 4},
+            {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 1", 3894594, 4}};
+
+        for (const auto& test : test_positions) {
+            for (int split_depth : {1, 3}) {
+                Board board(test.fen);
+
+                perft::Options options;
+                options.threads     = 4;
+                options.split_depth = split_depth;
+
+                const auto result = perft::divide(board, test.depth, options);
+
+                CHECK(result.nodes == test.expected_node_count);
+
+                Movelist moves;
+                movegen::legalmoves(moves, board);
+
+                REQUIRE(result.divide.size() == std::size_t(moves.size()));
+
+                for (const auto& entry : result.divide) {
+                    board.makeMove(entry.move);
+                    CHECK(entry.nodes == perft::count(board, test.depth - 1));
+                    board.unmakeMove(entry.move);
+                }
+            }
+        }
+    }
+
+    TEST_CASE("Hashed Perft") {
+        const Test test_positions[] = {
+            {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4865609, 5},
+            {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ", 4085603, 4},
+            {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - ", 11030083, 6},
+            {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 15833292, 5},
+            {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 2103487, 4},
+            {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 1", 3894594, 4}};
+
+        PerftTable table(4);
+
+        for (const auto& test : test_positions) {
+            Board board(test.fen);
+
+            table.clear();
+
+            CHECK(perft::count(board, test.depth, table) == test.expected_node_count);
+            CHECK(board.getFen() == Board(test.fen).getFen());
+
+            // transpositions need at least three plies above a hashed node
+            const auto stats = table.stats();
+            CHECK(stats.probes > 0);
+            if (test.depth >= 5) CHECK(stats.hits > 0);
+            CHECK(stats.hits + stats.collisions <= stats.probes);
+
+            // a second run is answered by the root entry
+            CHECK(perft::count(board, test.depth, table) == test.expected_node_count);
+            CHECK(table.stats().hits == stats.hits + 1);
+
+            // shared between threads
+            table.clear();
+
+            perft::Options options;
+            options.threads = 4;
+            options.table   = &table;
+
+            CHECK(perft::divide(board, test.depth, options).nodes == test.expected_node_count);
+        }
+
+        // a single entry table has to survive constant overwrites
+        PerftTable tiny(0);
+        Board board(constants::STARTPOS);
+
+        CHECK(tiny.size() == 1);
+        CHECK(perft::count(board, 5, tiny) == 4865609);
+        CHECK(tiny.stats().collisions > 0);
+    }
+
+    TEST_CASE("Threaded Divide Edge Cases") {
+        // checkmate, no root moves
+        Board board("rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3");
+
+        CHECK(perft::divide(board, 3).nodes == 0);
+        CHECK(perft::divide(board, 3).divide.empty());
+        CHECK(perft::divide(board, 0).nodes == 1);
+
+        // depth 1 is a plain move count
+        board.setFen(constants::STARTPOS);
+        CHECK(perft::divide(board, 1).nodes == 20);
+        CHECK(perft::divide(board, 1).divide.size() == 20);
+    }
+}
+
+namespace {
+void checkMoveCounts(Board& board, int depth) {
+    Movelist all, captures, quiets;
+    movegen::legalmoves(all, board);
+    movegen::legalmoves<movegen::MoveGenType::CAPTURE>(captures, board);
+    movegen::legalmoves<movegen::MoveGenType::QUIET>(quiets, board);
+
+    REQUIRE(movegen::countLegalMoves(board) == all.size());
+    REQUIRE(movegen::countLegalMoves<movegen::MoveGenType::CAPTURE>(board) == captures.size());
+    REQUIRE(movegen::countLegalMoves<movegen::MoveGenType::QUIET>(board) == quiets.size());
+
+    if (depth == 0) return;
+
+    for (const auto& move : all) {
+        board.makeMove(move);
+        checkMoveCounts(board, depth - 1);
+        board.unmakeMove(move);
+    }
+}
+
+// The reference: play every move and look at the position afterwards.
+Movelist filterChecks(Board& board, const Movelist& moves) {
+    Movelist checks;
+
+    for (const auto& move : moves) {
+        board.makeMove(move);
+        if (board.inCheck()) checks.add(move);
+        board.unmakeMove(move);
+    }
+
+    return checks;
+}
+
+bool sameMoves(Movelist a, Movelist b) {
+    const auto cmp = [](const Move& lhs, const Move& rhs) { return lhs.move() < rhs.move(); };
+    std::sort(a.begin(), a.end(), cmp);
+    std::sort(b.begin(), b.end(), cmp);
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+void checkGenTypes(Board& board, int depth) {
+    Movelist all, quiets, evasions, checks, quiet_checks;
+    movegen::legalmoves(all, board);
+    movegen::legalmoves<movegen::MoveGenType::QUIET>(quiets, board);
+    movegen::legalmoves<movegen::MoveGenType::EVASION>(evasions, board);
+    movegen::legalmoves<movegen::MoveGenType::CHECK>(checks, board);
+    movegen::legalmoves<movegen::MoveGenType::QUIET_CHECK>(quiet_checks, board);
+
+    REQUIRE(sameMoves(evasions, board.inCheck() ? all : Movelist{}));
+    REQUIRE(sameMoves(checks, filterChecks(board, all)));
+    REQUIRE(sameMoves(quiet_checks, filterChecks(board, quiets)));
+
+    Movelist gives_check;
+    for (const auto& move : all) {
+        if (board.givesCheck(move)) gives_check.add(move);
+    }
+
+    REQUIRE(sameMoves(gives_check, checks));
+
+    REQUIRE(movegen::countLegalMoves<movegen::MoveGenType::EVASION>(board) == evasions.size());
+    REQUIRE(movegen::countLegalMoves<movegen::MoveGenType::CHECK>(board) == checks.size());
+    REQUIRE(movegen::countLegalMoves<movegen::MoveGenType::QUIET_CHECK>(board) == quiet_checks.size());
+
+    if (depth == 0) return;
+
+    for (const auto& move : all) {
+        board.makeMove(move);
+        checkGenTypes(board, depth - 1);
+        board.unmakeMove(move);
+    }
+}
+
+bool contains(const Movelist& moves, Move move) { return std::find(moves.begin(), moves.end(), move) != moves.end(); }
+
+void checkPseudoLegal(Board& board, int depth) {
+    Movelist legal, pseudo;
+    movegen::legalmoves(legal, board);
+    movegen::pseudoLegalMoves(pseudo, board);
+
+    int legal_count = 0;
+
+    for (const auto& move : pseudo) {
+        REQUIRE(board.isPseudoLegal(move));
+        if (board.isLegal(move)) {
+            REQUIRE(contains(legal, move));
+            legal_count++;
+        }
+    }
+
+    REQUIRE(legal_count == legal.size());
+
+    // every other encodable move has to be rejected
+    int mismatches = 0;
+
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            const Move candidates[] = {Move::make<Move::NORMAL>(from, to), Move::make<Move::ENPASSANT>(from, to),
+                                       Move::make<Move::CASTLING>(from, to),
+                                       Move::make<Move::PROMOTION>(from, to, PieceType::QUEEN),
+                                       Move::make<Move::PROMOTION>(from, to, PieceType::KNIGHT)};
+
+            for (const auto move : candidates) {
+                if (!board.isPseudoLegal(move))
+                    mismatches += contains(pseudo, move);
+                else
+                    mismatches += board.isLegal(move) != contains(legal, move);
+            }
+        }
+    }
+
+    REQUIRE(mismatches == 0);
+
+    if (depth == 0) return;
+
+    for (const auto& move : legal) {
+        board.makeMove(move);
+        checkPseudoLegal(board, depth - 1);
+        board.unmakeMove(move);
+    }
+}
+}  // namespace
+
+TEST_CASE("Count Legal Moves") {
+    const Test test_positions[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0, 3},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ", 0, 2},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - ", 0, 3},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 0, 2},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 0, 2},
+        {"8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1", 0, 2}};
+
+    for (const auto& test : test_positions) {
+        Board board(test.fen);
+        checkMoveCounts(board, test.depth);
+    }
+
+    Board board("1rqbkrbn/1ppppp1p/1n6/p1N3p1/8/2P4P/PP1PPPP1/1RQBKRBN w FBfb - 0 9");
+    board.set960(true);
+    checkMoveCounts(board, 2);
+
+    // checkmate
+    board = Board("rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3");
+    CHECK(movegen::countLegalMoves(board) == 0);
+}
+
+TEST_CASE("Pseudo Legal Moves") {
+    const Test test_positions[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0, 2},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ", 0, 2},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - ", 0, 2},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 0, 2},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 0, 1},
+        {"8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1", 0, 2},
+        {"7k/4p3/8/2KP3r/8/8/8/8 b - - 0 1", 0, 2},
+        {"4k3/8/8/8/8/4q3/8/r3K2R w K - 0 1", 0, 1}};
+
+    for (const auto& test : test_positions) {
+        Board board(test.fen);
+        checkPseudoLegal(board, test.depth);
+    }
+
+    Board board("1rqbkrbn/1ppppp1p/1n6/p1N3p1/8/2P4P/PP1PPPP1/1RQBKRBN w FBfb - 0 9");
+    board.set960(true);
+    checkPseudoLegal(board, 1);
+}
+
+TEST_CASE("Evasion And Check Generation") {
+    const Test test_positions[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0, 3},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ", 0, 2},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - ", 0, 3},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 0, 2},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 0, 2},
+        // discovered checks by en passant, castling checks and promotions
+        {"8/8/8/R2pP2k/8/8/8/K7 w - d6 0 1", 0, 1},
+        {"5k2/8/8/8/8/8/8/4K2R w K - 0 1", 0, 1},
+        {"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 0, 1},
+        {"k7/2P5/8/8/8/8/5B2/4K3 w - - 0 1", 0, 2},
+        {"4k3/8/8/4N3/8/8/4R3/4K1B1 w - - 0 1", 0, 2}};
+
+    for (const auto& test : test_positions) {
+        Board board(test.fen);
+        checkGenTypes(board, test.depth);
+    }
+
+    Board board("1rqbkrbn/1ppppp1p/1n6/p1N3p1/8/2P4P/PP1PPPP1/1RQBKRBN w FBfb - 0 9");
+    board.set960(true);
+    checkGenTypes(board, 2);
 }
@@ -1,6 +1,9 @@
 #include <cassert>
 #include <fstream>
+#include <functional>
 #include <memory>
+#include <random>
+#include <sstream>
 #include <string_view>
 
 #include "../src/include.hpp"
@@ -607,3 +610,1024 @@ TEST_SUITE("PGN StreamParser") {
         CHECK(vis->gameCount() == 1);
     }
 }
+
+TEST_SUITE("PGN MappedParser") {
+    TEST_CASE("Same result as StreamParser") {
+        const auto files = {"basic.pgn",
+                            "backslash_header.pgn",
+                            "black2move.pgn",
+                            "book.pgn",
+                            "castling.pgn",
+                            "corrupted.pgn",
+                            "empty_body.pgn",
+                            "multiple.pgn",
+                            "newline.pgn",
+                            "no_moves.pgn",
+                            "no_moves_but_comment_followed_by_termination_marker.pgn",
+                            "no_moves_but_game_termination.pgn",
+                            "no_moves_but_game_termination_2.pgn",
+                            "no_moves_but_game_termination_3.pgn",
+                            "no_moves_but_game_termination_multiple.pgn",
+                            "no_moves_but_game_termination_multiple_2.pgn",
+                            "no_moves_two_games.pgn",
+                            "no_result.pgn",
+                            "skip.pgn",
+                            "square_bracket_in_header.pgn",
+                            "threefold_repetition.pgn",
+                            "variations.pgn"};
+
+        for (const auto name : files) {
+            const auto path = std::string("./tests/pgns/") + name;
+
+            auto file_stream = std::ifstream(path);
+            MyVisitor stream_vis;
+            const auto stream_error = pgn::StreamParser(file_stream).readGames(stream_vis);
+
+            const pgn::MappedFile file(path);
+            REQUIRE(file.isOpen());
+
+            MyVisitor mapped_vis;
+            const auto mapped_error = pgn::MappedParser(file).readGames(mapped_vis);
+
+            INFO(name);
+            CHECK(mapped_error == stream_error);
+            CHECK(mapped_vis.headers() == stream_vis.headers());
+            CHECK(mapped_vis.moves() == stream_vis.moves());
+            CHECK(mapped_vis.comments() == stream_vis.comments());
+            CHECK(mapped_vis.gameCount() == stream_vis.gameCount());
+            CHECK(mapped_vis.endCount() == stream_vis.endCount());
+        }
+    }
+
+    TEST_CASE("Views point into the input") {
+        class ViewVisitor : public pgn::Visitor {
+           public:
+            explicit ViewVisitor(std::string_view input) : input_(input) {}
+
+            void startPgn() {}
+            void header(std::string_view key, std::string_view value) { check(key), check(value); }
+            void startMoves() {}
+            void move(std::string_view move, std::string_view comment) { check(move), check(comment); }
+            void endPgn() {}
+
+            int outside = 0;
+
+           private:
+            void check(std::string_view token) {
+                if (token.empty()) return;
+                if (token.data() < input_.data() || token.data() + token.size() > input_.data() + input_.size()) {
+                    outside++;
+                }
+            }
+
+            std::string_view input_;
+        };
+
+        const pgn::MappedFile file("./tests/pgns/basic.pgn");
+
+        ViewVisitor vis(file.data());
+        pgn::MappedParser(file).readGames(vis);
+
+        CHECK(vis.outside == 0);
+    }
+
+    TEST_CASE("Carriage returns and escaped headers are copied") {
+        const std::string pgn =
+            "[Event \"a \\\"quoted\\\" name\"]\r\n[Result \"1-0\"]\r\n\r\n1. e4 {multi\r\nline} e5 2. Nf3 1-0\r\n";
+
+        MyVisitor vis;
+        pgn::MappedParser parser(pgn.data(), pgn.size());
+        CHECK(!parser.readGames(vis));
+
+        REQUIRE(vis.headers().size() == 2);
+        CHECK(vis.headers()[0] == "Event a \"quoted\" name");
+        CHECK(vis.headers()[1] == "Result 1-0");
+        CHECK(vis.moves() == std::vector<std::string>{"e4", "e5", "Nf3"});
+        CHECK(vis.comments() == std::vector<std::string>{"multi\nline"});
+    }
+
+    TEST_CASE("Missing file") {
+        const pgn::MappedFile file("./tests/pgns/does_not_exist.pgn");
+
+        MyVisitor vis;
+
+        CHECK(!file.isOpen());
+        CHECK(pgn::MappedParser(file).readGames(vis) == pgn::StreamParserError::NotEnoughData);
+    }
+}
+
+TEST_SUITE("PGN ParallelParser") {
+    // one string per game with all its headers and moves
+    class GameVisitor : public pgn::Visitor {
+       public:
+        void startPgn() { games.emplace_back(); }
+        void header(std::string_view key, std::string_view value) {
+            games.back() += std::string(key) + " " + std::string(value) + "\n";
+        }
+        void startMoves() {}
+        void move(std::string_view move, std::string_view) { games.back() += std::string(move) + " "; }
+        void endPgn() {}
+
+        std::vector<std::string> games;
+    };
+
+    std::string readFiles(int repeat) {
+        const auto files = {"basic.pgn", "black2move.pgn", "book.pgn",           "castling.pgn", "multiple.pgn",
+                            "newline.pgn", "skip.pgn",     "no_moves_two_games.pgn", "variations.pgn"};
+
+        std::string pgn;
+
+        for (int i = 0; i < repeat; i++) {
+            for (const auto name : files) {
+                auto file = std::ifstream(std::string("./tests/pgns/") + name);
+                pgn += std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                pgn += "\n";
+            }
+        }
+
+        return pgn;
+    }
+
+    std::vector<std::string> readSequential(const std::string& pgn) {
+        GameVisitor vis;
+        pgn::MappedParser(pgn.data(), pgn.size()).readGames(vis);
+        return vis.games;
+    }
+
+    TEST_CASE("Shards start at games") {
+        const auto pgn = readFiles(3);
+
+        for (std::size_t n = 1; n < 40; n++) {
+            const auto shards = pgn::ParallelParser::split(pgn, n);
+
+            REQUIRE(!shards.empty());
+            CHECK(shards.size() <= n);
+            CHECK(shards.front().data() == pgn.data());
+
+            std::size_t size = 0;
+
+            for (std::size_t i = 0; i < shards.size(); i++) {
+                if (i > 0) {
+                    CHECK(shards[i - 1].data() + shards[i - 1].size() == shards[i].data());
+                    CHECK(shards[i].substr(0, 6) == "[Event");
+                }
+
+                size += shards[i].size();
+            }
+
+            CHECK(size == pgn.size());
+        }
+    }
+
+    TEST_CASE("Blank lines with carriage returns") {
+        const std::string pgn =
+            "[Event \"a\"]\r\n\r\n1. e4 1-0\r\n\r\n[Event \"b\"]\r\n\r\n1. d4 0-1\r\n\r\n"
+            "[Event \"c\"]\r\n\r\n1. c4 *\r\n";
+
+        const auto shards = pgn::ParallelParser::split(pgn, 3);
+
+        REQUIRE(shards.size() == 3);
+        CHECK(shards[1].substr(0, 10) == "[Event \"b\"");
+        CHECK(shards[2].substr(0, 10) == "[Event \"c\"");
+    }
+
+    TEST_CASE("Same games as MappedParser") {
+        const auto pgn      = readFiles(20);
+        const auto expected = readSequential(pgn);
+
+        pgn::ParallelParser::Options options;
+        options.shards_per_thread = 8;
+
+        std::vector<GameVisitor> visitors(4);
+        CHECK(!pgn::ParallelParser(pgn.data(), pgn.size(), options).readGames(visitors));
+
+        std::vector<std::string> games;
+
+        for (const auto& vis : visitors) games.insert(games.end(), vis.games.begin(), vis.games.end());
+
+        auto sorted = expected;
+        std::sort(sorted.begin(), sorted.end());
+        std::sort(games.begin(), games.end());
+
+        CHECK(games.size() == expected.size());
+        CHECK(games == sorted);
+    }
+
+    TEST_CASE("Ordered merge") {
+        const auto pgn      = readFiles(20);
+        const auto expected = readSequential(pgn);
+
+        pgn::ParallelParser::Options options;
+        options.threads = 4;
+
+        std::vector<std::string> games;
+
+        const auto error = pgn::ParallelParser(pgn.data(), pgn.size(), options)
+                               .readGamesOrdered([] { return GameVisitor(); },
+                                                 [&](GameVisitor& vis) {
+                                                     games.insert(games.end(), vis.games.begin(), vis.games.end());
+                                                 });
+
+        CHECK(!error);
+        CHECK(games == expected);
+    }
+
+    TEST_CASE("Errors") {
+        std::vector<GameVisitor> visitors(2);
+
+        CHECK(pgn::ParallelParser(nullptr, 0).readGames(visitors) == pgn::StreamParserError::NotEnoughData);
+
+        const auto invalid = readFiles(5) + "[Event \"missing quote]\n\n1. e4 1-0\n\n" + readFiles(5);
+
+        pgn::ParallelParser::Options options;
+        options.shards_per_thread = 16;
+
+        CHECK(pgn::ParallelParser(invalid.data(), invalid.size(), options).readGames(visitors) ==
+              pgn::StreamParserError::InvalidHeaderMissingClosingQuote);
+    }
+}
+
+TEST_SUITE("PGN Tokenizer") {
+    template <bool In, char... Chars>
+    const char* slowFind(const char* first, const char* last) {
+        return std::find_if(first, last, [](char c) { return ((c == Chars) || ...) == In; });
+    }
+
+    TEST_CASE("Block scans match a byte loop") {
+        std::mt19937 rng(42);
+
+        // mostly letters, with a few stop characters at random distances
+        const std::string alphabet = "abcdefgh12345678 {}\n\r\"\\";
+
+        for (int i = 0; i < 2000; i++) {
+            std::string text(rng() % 100, 'x');
+
+            for (auto& c : text) c = rng() % 8 ? 'a' + rng() % 8 : alphabet[rng() % alphabet.size()];
+
+            for (std::size_t offset = 0; offset < std::min<std::size_t>(text.size(), 40); offset++) {
+                const auto first = text.data() + offset;
+                const auto last  = text.data() + text.size();
+
+                CHECK(pgn::detail::findFirst<true, true, '}'>(first, last) == slowFind<true, '}'>(first, last));
+                CHECK(pgn::detail::findFirst<true, true, ' ', '\n', '\r'>(first, last) ==
+                      slowFind<true, ' ', '\n', '\r'>(first, last));
+                CHECK(pgn::detail::findFirst<false, true, 'a', 'b', 'c', 'd', 'e'>(first, last) ==
+                      slowFind<false, 'a', 'b', 'c', 'd', 'e'>(first, last));
+            }
+        }
+    }
+
+    TEST_CASE("Tokens spanning stream buffer refills") {
+        const std::string pgn =
+            "[Event \"a long event name which is split by the buffer\"]\r\n[Result \"1-0\"]\r\n\r\n"
+            "1. e4 {a comment\r\nwith a carriage return} e5 2. Nf3 $1 (2. Nc3 (2. d4) Nc6) Nc6 1-0\r\n";
+
+        for (const auto stream_parser : {true, false}) {
+            MyVisitor vis;
+
+            if (stream_parser) {
+                std::istringstream stream(pgn);
+                CHECK(!SmallBufferStreamParser(stream).readGames(vis));
+            } else {
+                CHECK(!pgn::MappedParser(pgn.data(), pgn.size()).readGames(vis));
+            }
+
+            REQUIRE(vis.headers().size() == 2);
+            CHECK(vis.headers()[0] == "Event a long event name which is split by the buffer");
+            CHECK(vis.moves() == std::vector<std::string>{"e4", "e5", "Nf3", "Nc6"});
+            CHECK(vis.comments() == std::vector<std::string>{"a comment\nwith a carriage return"});
+        }
+    }
+}
+
+TEST_SUITE("PGN ReplayVisitor") {
+    class Replay : public pgn::ReplayVisitor<> {
+       public:
+        void startPgn() override {
+            pgn::ReplayVisitor<>::startPgn();
+            games.emplace_back();
+        }
+
+        void replay(Move move, const Board& board, std::string_view) override {
+            games.back().push_back(uci::moveToUci(move, board.chess960()));
+            fens.push_back(board.getFen());
+        }
+
+        void endPgn() override { invalid_games += invalid(); }
+
+        std::vector<std::vector<std::string>> games;
+        std::vector<std::string> fens;
+        int invalid_games = 0;
+    };
+
+    TEST_CASE("Same moves as parseSan") {
+        const auto files = {"basic.pgn", "castling.pgn", "multiple.pgn", "variations.pgn"};
+
+        for (const auto name : files) {
+            INFO(std::string(name));
+
+            const pgn::MappedFile file(std::string("./tests/pgns/") + name);
+
+            Replay replay;
+            MyVisitor2 san;
+
+            CHECK(!pgn::MappedParser(file).readGames(replay));
+            CHECK(!pgn::MappedParser(file).readGames(san));
+            CHECK(replay.invalid_games == 0);
+
+            // MyVisitor2 keeps the moves of the last game
+            Board board;
+
+            for (const auto& header : san.headers()) {
+                if (header.rfind("FEN ", 0) == 0) board.setFen(header.substr(4));
+            }
+
+            REQUIRE(replay.games.back().size() == san.moves().size());
+
+            for (std::size_t i = 0; i < san.moves().size(); i++) {
+                const auto move = uci::parseSan(board, san.moves()[i]);
+                board.makeMove(move);
+
+                CHECK(replay.games.back()[i] == uci::moveToUci(move));
+            }
+
+            CHECK(replay.fens.back() == board.getFen());
+        }
+    }
+
+    TEST_CASE("Invalid moves skip the rest of the game") {
+        const std::string pgn =
+            "[Event \"a\"]\n\n1. e4 e5 2. Nf6 Nc6 3. Nf3 *\n\n"
+            "[Event \"b\"]\n[FEN \"4k3/8/8/8/8/8/8/4K2R w K - 0 1\"]\n[SetUp \"1\"]\n\n1. O-O Kd7 *\n";
+
+        Replay replay;
+        CHECK(!pgn::MappedParser(pgn.data(), pgn.size()).readGames(replay));
+
+        REQUIRE(replay.games.size() == 2);
+        CHECK(replay.games[0] == std::vector<std::string>{"e2e4", "e7e5"});
+        CHECK(replay.games[1] == std::vector<std::string>{"e1g1", "e8d7"});
+        CHECK(replay.invalid_games == 1);
+        CHECK(replay.fens.back() == "8/3k4/8/8/8/8/8/5RK1 w - - 2 2");
+    }
+}
+
+TEST_SUITE("PGN Headers Only") {
+    TEST_CASE("Same headers as a full parse") {
+        const auto files = {"basic.pgn",
+                            "backslash_header.pgn",
+                            "black2move.pgn",
+                            "book.pgn",
+                            "castling.pgn",
+                            "empty_body.pgn",
+                            "multiple.pgn",
+                            "newline.pgn",
+                            "no_moves.pgn",
+                            "no_moves_but_game_termination.pgn",
+                            "no_moves_but_game_termination_2.pgn",
+                            "no_moves_but_game_termination_3.pgn",
+                            "no_moves_but_game_termination_multiple.pgn",
+                            "no_moves_but_game_termination_multiple_2.pgn",
+                            "no_moves_two_games.pgn",
+                            "no_result.pgn",
+                            "skip.pgn",
+                            "square_bracket_in_header.pgn",
+                            "threefold_repetition.pgn",
+                            "variations.pgn"};
+
+        for (const auto name : files) {
+            INFO(std::string(name));
+
+            const auto path = std::string("./tests/pgns/") + name;
+
+            MyVisitor2 full;
+            auto full_stream = std::ifstream(path);
+            const auto error = pgn::StreamParser(full_stream).readGames(full);
+
+            MyVisitor2 stream;
+            stream.headersOnly(true);
+            auto file_stream = std::ifstream(path);
+            CHECK(SmallBufferStreamParser(file_stream).readGames(stream) == error);
+
+            MyVisitor2 mapped;
+            mapped.headersOnly(true);
+            const pgn::MappedFile file(path);
+            CHECK(pgn::MappedParser(file).readGames(mapped) == error);
+
+            for (const auto* vis : {&stream, &mapped}) {
+                CHECK(vis->headers() == full.headers());
+                CHECK(vis->gameCount() == full.gameCount());
+                CHECK(vis->endCount() == full.endCount());
+                CHECK(vis->moveStartCount() == full.moveStartCount());
+                CHECK(vis->count() == 0);
+            }
+        }
+    }
+
+    TEST_CASE("Carriage returns and empty bodies") {
+        const std::string pgn =
+            "[Event \"a\"]\r\n\r\n1. e4 {a\r\nmultiline comment} e5 1-0\r\n\r\n[Event \"b\"]\r\n\r\n"
+            "[Event \"c\"]\r\n[Result \"*\"]\r\n\r\n*\r\n";
+
+        for (const auto stream_parser : {true, false}) {
+            MyVisitor2 vis;
+            vis.headersOnly(true);
+
+            if (stream_parser) {
+                std::istringstream stream(pgn);
+                CHECK(!SmallBufferStreamParser(stream).readGames(vis));
+            } else {
+                CHECK(!pgn::MappedParser(pgn.data(), pgn.size()).readGames(vis));
+            }
+
+            CHECK(vis.headers() == std::vector<std::string>{"Event a", "Event b", "Event c", "Result *"});
+            CHECK(vis.gameCount() == 3);
+            CHECK(vis.endCount() == 3);
+            CHECK(vis.count() == 0);
+        }
+    }
+}
+
+namespace {
+// every game's headers and moves, in order
+class GameCollector : public pgn::Visitor {
+   public:
+    void startPgn() override { games.emplace_back(); }
+
+    void header(std::string_view key, std::string_view value) override {
+        games.back().push_back(std::string(key) + " " + std::string(value));
+    }
+
+    void startMoves() override {}
+
+    void move(std::string_view move, std::string_view comment) override {
+        games.back().push_back(std::string(move));
+        if (!comment.empty()) games.back().push_back("{" + std::string(comment) + "}");
+    }
+
+    void endPgn() override {}
+
+    std::vector<std::vector<std::string>> games;
+};
+}  // namespace
+
+TEST_SUITE("PGN GameIndex") {
+    TEST_CASE("Seek every game") {
+        const auto files = {"multiple.pgn", "variations.pgn", "skip.pgn", "empty_body.pgn",
+                            "no_moves_two_games.pgn", "basic.pgn"};
+
+        for (const auto name : files) {
+            INFO(std::string(name));
+
+            const auto path = std::string("./tests/pgns/") + name;
+
+            GameCollector full;
+            auto full_stream = std::ifstream(path);
+            CHECK(!pgn::StreamParser(full_stream).readGames(full));
+
+            const pgn::MappedFile file(path);
+
+            for (const auto headers_only : {false, true}) {
+                pgn::GameIndex index;
+                auto stream = std::ifstream(path);
+                CHECK(!index.build(stream, {"White", "Result"}, headers_only));
+
+                pgn::GameIndex mapped_index;
+                CHECK(!mapped_index.build(file, {"White", "Result"}, headers_only));
+
+                REQUIRE(index.size() == full.games.size());
+                REQUIRE(mapped_index.size() == index.size());
+
+                for (std::size_t i = 0; i < index.size(); i++) {
+                    CHECK(index.offset(i) == mapped_index.offset(i));
+                    CHECK(index.length(i) == mapped_index.length(i));
+                    CHECK(file.data()[index.offset(i)] == '[');
+
+                    CHECK(index.header(i, "Event").empty());
+                    CHECK(index.header(i, "White") == mapped_index.header(i, "White"));
+
+                    const auto result = std::find(full.games[i].begin(), full.games[i].end(),
+                                                  "Result " + std::string(index.header(i, "Result")));
+                    CHECK(result != full.games[i].end());
+
+                    GameCollector game;
+                    auto seek_stream = std::ifstream(path);
+                    CHECK(!index.readGames(seek_stream, game, i));
+                    REQUIRE(game.games.size() == 1);
+                    CHECK(game.games[0] == full.games[i]);
+
+                    GameCollector mapped_game;
+                    CHECK(!index.readGames(file, mapped_game, i));
+                    CHECK(mapped_game.games == game.games);
+                }
+
+                GameCollector none;
+                CHECK(index.readGames(file, none, index.size()) == pgn::StreamParserError::NotEnoughData);
+
+                if (index.size() < 2) continue;
+
+                GameCollector rest;
+                CHECK(!index.readGames(file, rest, 1, 100));
+                CHECK(rest.games.size() == full.games.size() - 1);
+                CHECK(std::equal(rest.games.begin(), rest.games.end(), full.games.begin() + 1));
+            }
+        }
+    }
+
+    TEST_CASE("Save and load") {
+        const std::string path = "./tests/pgns/multiple.pgn";
+        const std::string index_path = "game_index_test.idx";
+
+        pgn::GameIndex index;
+        auto stream = std::ifstream(path);
+        CHECK(!index.build(stream, {"White", "Black", "Round"}));
+        CHECK(index.size() == 4);
+        CHECK(index.header(0, "White") == "New-cfe8ce842c");
+
+        REQUIRE(index.save(index_path));
+
+        pgn::GameIndex loaded;
+        REQUIRE(loaded.load(index_path));
+        CHECK(loaded.size() == index.size());
+        CHECK(loaded.keys() == index.keys());
+
+        for (std::size_t i = 0; i < index.size(); i++) {
+            CHECK(loaded.offset(i) == index.offset(i));
+            CHECK(loaded.length(i) == index.length(i));
+
+            for (const auto& key : index.keys()) CHECK(loaded.header(i, key) == index.header(i, key));
+        }
+
+        // truncated
+        std::string bytes;
+        {
+            std::ifstream in(index_path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        {
+            std::ofstream out(index_path, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), bytes.size() - 1);
+        }
+
+        CHECK(!loaded.load(index_path));
+        CHECK(loaded.empty());
+
+        // a corrupt key length, after magic, version, game and key count
+        {
+            std::ofstream out(index_path, std::ios::binary | std::ios::trunc);
+            bytes.replace(20, 4, "\xFF\xFF\xFF\xFF");
+            out.write(bytes.data(), bytes.size());
+        }
+
+        CHECK(!loaded.load(index_path));
+        CHECK(loaded.empty());
+
+        CHECK(!loaded.load(path));
+        CHECK(!loaded.load("./tests/pgns/does_not_exist.idx"));
+
+        std::remove(index_path.c_str());
+    }
+}
+
+namespace {
+// hands out the input a few bytes at a time
+class ChunkedSource : public pgn::InputSource {
+   public:
+    ChunkedSource(std::string data, std::size_t chunk) : data_(std::move(data)), chunk_(chunk) {}
+
+    std::size_t read(char* buffer, std::size_t size) override {
+        const auto bytes = std::min({size, chunk_, data_.size() - pos_});
+        std::copy_n(data_.data() + pos_, bytes, buffer);
+        pos_ += bytes;
+        return bytes;
+    }
+
+   private:
+    std::string data_;
+    std::size_t chunk_;
+    std::size_t pos_ = 0;
+};
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+const auto input_source_files = {"basic.pgn",
+                                 "backslash_header.pgn",
+                                 "book.pgn",
+                                 "castling.pgn",
+                                 "empty_body.pgn",
+                                 "multiple.pgn",
+                                 "newline.pgn",
+                                 "no_moves_but_game_termination_multiple.pgn",
+                                 "no_moves_two_games.pgn",
+                                 "skip.pgn",
+                                 "square_bracket_in_header.pgn",
+                                 "variations.pgn"};
+}  // namespace
+
+TEST_SUITE("PGN InputSource") {
+    TEST_CASE("Chunked source") {
+        for (const auto name : input_source_files) {
+            INFO(std::string(name));
+
+            const auto data = readFile(std::string("./tests/pgns/") + name);
+
+            GameCollector full;
+            const auto error = pgn::MappedParser(data.data(), data.size()).readGames(full);
+
+            for (const auto chunk : {std::size_t(1), std::size_t(3), std::size_t(1) << 20}) {
+                ChunkedSource source(data, chunk);
+
+                GameCollector chunked;
+                CHECK(SmallBufferStreamParser(source).readGames(chunked) == error);
+                CHECK(chunked.games == full.games);
+            }
+        }
+    }
+
+#if defined(CHESS_PGN_ZLIB)
+    TEST_CASE("Gzip source") {
+        const std::string path = "input_source_test.pgn.gz";
+
+        for (const auto name : input_source_files) {
+            INFO(std::string(name));
+
+            const auto data = readFile(std::string("./tests/pgns/") + name);
+
+            const auto out = gzopen(path.c_str(), "wb");
+            REQUIRE(out);
+            gzwrite(out, data.data(), static_cast<unsigned>(data.size()));
+            gzclose(out);
+
+            GameCollector full;
+            const auto error = pgn::MappedParser(data.data(), data.size()).readGames(full);
+
+            pgn::GzipSource source(path);
+            REQUIRE(source.isOpen());
+
+            GameCollector gzip;
+            CHECK(SmallBufferStreamParser(source).readGames(gzip) == error);
+            CHECK(gzip.games == full.games);
+            CHECK(!source.error());
+        }
+
+        // truncated
+        const auto compressed = readFile(path);
+        std::ofstream(path, std::ios::binary).write(compressed.data(), compressed.size() / 2);
+
+        pgn::GzipSource source(path);
+        GameCollector gzip;
+        pgn::StreamParser(source).readGames(gzip);
+        CHECK(source.error());
+
+        CHECK(!pgn::GzipSource("./tests/pgns/does_not_exist.pgn.gz").isOpen());
+
+        std::remove(path.c_str());
+    }
+#endif
+
+#if defined(CHESS_PGN_ZSTD)
+    TEST_CASE("Zstd source") {
+        const std::string path = "input_source_test.pgn.zst";
+
+        for (const auto name : input_source_files) {
+            INFO(std::string(name));
+
+            const auto data = readFile(std::string("./tests/pgns/") + name);
+
+            // two frames
+            std::string compressed;
+            for (const auto& part : {data.substr(0, data.size() / 2), data.substr(data.size() / 2)}) {
+                std::string frame(ZSTD_compressBound(part.size()), '\0');
+                frame.resize(ZSTD_compress(frame.data(), frame.size(), part.data(), part.size(), 3));
+                compressed += frame;
+            }
+
+            std::ofstream(path, std::ios::binary).write(compressed.data(), compressed.size());
+
+            GameCollector full;
+            const auto error = pgn::MappedParser(data.data(), data.size()).readGames(full);
+
+            pgn::ZstdSource source(path);
+            REQUIRE(source.isOpen());
+
+            GameCollector zstd;
+            CHECK(SmallBufferStreamParser(source).readGames(zstd) == error);
+            CHECK(zstd.games == full.games);
+            CHECK(!source.error());
+        }
+
+        // truncated
+        const auto compressed = readFile(path);
+        std::ofstream(path, std::ios::binary).write(compressed.data(), compressed.size() - 1);
+
+        pgn::ZstdSource source(path);
+        GameCollector zstd;
+        pgn::StreamParser(source).readGames(zstd);
+        CHECK(source.error());
+
+        CHECK(!pgn::ZstdSource("./tests/pgns/does_not_exist.pgn.zst").isOpen());
+
+        std::remove(path.c_str());
+    }
+#endif
+}
+
+TEST_SUITE("PGN Skip Comments") {
+    TEST_CASE("Same moves without the comments") {
+        for (const auto name : input_source_files) {
+            INFO(std::string(name));
+
+            const auto data = readFile(std::string("./tests/pgns/") + name);
+
+            GameCollector full;
+            const auto error = pgn::MappedParser(data.data(), data.size()).readGames(full);
+
+            // comments and the empty moves which only carry a comment are gone
+            for (auto& game : full.games) {
+                game.erase(std::remove_if(game.begin(), game.end(),
+                                          [](const std::string& token) { return token.empty() || token[0] == '{'; }),
+                           game.end());
+            }
+
+            GameCollector mapped;
+            mapped.skipComments(true);
+            CHECK(pgn::MappedParser(data.data(), data.size()).readGames(mapped) == error);
+            CHECK(mapped.games == full.games);
+
+            GameCollector stream;
+            stream.skipComments(true);
+            std::istringstream input(data);
+            CHECK(SmallBufferStreamParser(input).readGames(stream) == error);
+            CHECK(stream.games == full.games);
+        }
+    }
+}
+
+TEST_SUITE("PGN Annotations") {
+    using namespace std::chrono_literals;
+
+    TEST_CASE("Cutechess and fastchess comments") {
+        auto annotation = pgn::parseAnnotation("+0.35/18 1.2s");
+        CHECK(annotation.score == 35);
+        CHECK(!annotation.mate);
+        CHECK(annotation.depth == 18);
+        CHECK(annotation.time == 1200ms);
+        CHECK(!annotation.clock);
+
+        annotation = pgn::parseAnnotation("-0.71/23 6.157s");
+        CHECK(annotation.score == -71);
+        CHECK(annotation.time == 6157ms);
+
+        annotation = pgn::parseAnnotation("0.00/40 0.099s, Draw by insufficient mating material");
+        CHECK(annotation.score == 0);
+        CHECK(annotation.depth == 40);
+        CHECK(annotation.time == 99ms);
+
+        annotation = pgn::parseAnnotation("+M39/28 1.6s");
+        CHECK(!annotation.score);
+        CHECK(annotation.mate == 39);
+        CHECK(annotation.depth == 28);
+
+        CHECK(pgn::parseAnnotation("-M5/30 12ms").mate == -5);
+        CHECK(pgn::parseAnnotation("-M5/30 12ms").time == 12ms);
+        CHECK(pgn::parseAnnotation("+1.5/7").score == 150);
+        CHECK(pgn::parseAnnotation("+1.5/7").depth == 7);
+        CHECK(!pgn::parseAnnotation("+1.5/7").time);
+    }
+
+    TEST_CASE("Commands") {
+        auto annotation = pgn::parseAnnotation(" [%eval -0.07] [%clk 0:01:02.5] ");
+        CHECK(annotation.score == -7);
+        CHECK(annotation.clock == 62500ms);
+        CHECK(!annotation.depth);
+        CHECK(!annotation.time);
+
+        annotation = pgn::parseAnnotation("[%eval #-3] [%emt 0:00:05]");
+        CHECK(annotation.mate == -3);
+        CHECK(annotation.time == 5s);
+
+        annotation = pgn::parseAnnotation("Good move [%eval 0.357,22] [%clk 1:02:03]");
+        CHECK(annotation.score == 35);
+        CHECK(annotation.depth == 22);
+        CHECK(annotation.clock == 1h + 2min + 3s);
+
+        CHECK(pgn::parseAnnotation("[%clk 5]").clock == 5s);
+        CHECK(pgn::parseAnnotation("[%eval #4]").mate == 4);
+    }
+
+    TEST_CASE("Comments without engine output") {
+        for (const auto comment : {"", "book", "3 pawns up", " (0.78 → 2.75) Blunder. f6 was best. ",
+                                   "+0.35", "M/12", "[%eval]", "[%clk x]", "[%cal Ge2e4]"}) {
+            INFO(std::string(comment));
+            CHECK(pgn::parseAnnotation(comment).empty());
+        }
+
+        // long numbers don't overflow
+        CHECK(pgn::parseAnnotation("99999999999999999999999999/1").depth == 1);
+    }
+
+    TEST_CASE("AnnotationVisitor") {
+        class Evals : public pgn::AnnotationVisitor {
+           public:
+            void startPgn() override {}
+            void header(std::string_view, std::string_view) override {}
+            void startMoves() override {}
+            void endPgn() override {}
+
+            void annotatedMove(std::string_view, const pgn::Annotation& annotation, std::string_view) override {
+                moves++;
+                if (annotation.score || annotation.mate) scored++;
+                if (annotation.depth) depth += *annotation.depth;
+            }
+
+            int moves  = 0;
+            int scored = 0;
+            int depth  = 0;
+        };
+
+        auto file = std::ifstream("./tests/pgns/basic.pgn");
+        Evals vis;
+        CHECK(!pgn::StreamParser(file).readGames(vis));
+
+        // every move of the game has an engine comment
+        CHECK(vis.moves == 130);
+        CHECK(vis.scored == 130);
+        CHECK(vis.depth > 130);
+    }
+}
+
+namespace {
+// moves, NAGs and variation boundaries in the order the parser reports them
+class EventCollector : public pgn::Visitor {
+   public:
+    void startPgn() override { events.push_back("start"); }
+    void header(std::string_view, std::string_view) override {}
+    void startMoves() override {}
+
+    void move(std::string_view move, std::string_view comment) override {
+        events.push_back(std::string(move));
+        if (!comment.empty()) events.push_back("{" + std::string(comment) + "}");
+    }
+
+    void startVariation() override { events.push_back("("); }
+    void endVariation() override { events.push_back(")"); }
+    void nag(int nag) override { events.push_back("$" + std::to_string(nag)); }
+
+    void endPgn() override { events.push_back("end"); }
+
+    std::vector<std::string> events;
+};
+
+std::vector<std::string> parseEvents(const std::string& pgn, bool variations) {
+    EventCollector mapped;
+    mapped.variations(variations);
+    pgn::MappedParser(pgn.data(), pgn.size()).readGames(mapped);
+
+    EventCollector stream;
+    stream.variations(variations);
+    std::istringstream input(pgn);
+    SmallBufferStreamParser(input).readGames(stream);
+
+    CHECK(stream.events == mapped.events);
+
+    return mapped.events;
+}
+}  // namespace
+
+TEST_SUITE("PGN Variations") {
+    TEST_CASE("Variation events") {
+        const std::string pgn =
+            "[Event \"a\"]\n\n1. e4 {best} $1 (1. d4 d5 (1... Nf6 2. c4) 2. c4 $2) (1. c4) 1... e5 $14 2. Nf3 *\n\n"
+            "[Event \"b\"]\n\n1. d4 (1. e4 (1. c4 1-0\n";
+
+        CHECK(parseEvents(pgn, true) ==
+              std::vector<std::string>{"start", "e4", "{best}", "$1", "(", "d4", "d5", "(", "Nf6", "c4", ")", "c4",
+                                       "$2", ")", "(", "c4", ")", "e5", "$14", "Nf3", "end", "start", "d4", "(",
+                                       "e4", "(", "c4", ")", ")", "end"});
+
+        // skipped variations, the NAGs of the main line are still reported
+        CHECK(parseEvents(pgn, false) == std::vector<std::string>{"start", "e4", "{best}", "$1", "e5", "$14", "Nf3",
+                                                                  "end", "start", "d4", "end"});
+    }
+
+    TEST_CASE("Game tree") {
+        auto file = std::ifstream("./tests/pgns/variations.pgn");
+
+        class LastTree : public pgn::GameTreeVisitor<> {
+           public:
+            void endPgn() override {
+                if (!invalid()) trees.push_back(tree());
+            }
+
+            std::vector<pgn::GameTree> trees;
+        } vis;
+
+        CHECK(!pgn::StreamParser(file).readGames(vis));
+        REQUIRE(!vis.trees.empty());
+
+        const auto& tree = vis.trees[0];
+
+        // PlyCount 108
+        const auto main_line = tree.mainLine();
+        CHECK(main_line.size() == 108);
+
+        // every node is a legal move in its position
+        std::function<void(Board&, std::uint32_t)> walk = [&](Board& board, std::uint32_t node) {
+            for (auto child = tree[node].first_child; child != pgn::GameTree::NONE; child = tree[child].next_sibling) {
+                CHECK(tree[child].parent == node);
+
+                Movelist moves;
+                movegen::legalmoves(moves, board);
+                CHECK(std::find(moves.begin(), moves.end(), tree[child].move) != moves.end());
+
+                board.makeMove(tree[child].move);
+                walk(board, child);
+                board.unmakeMove(tree[child].move);
+            }
+        };
+
+        Board board;
+        walk(board, tree.root());
+
+        // 4. fxe5 (4. Nf3 f6 $5)
+        auto node = tree.root();
+        for (int i = 0; i < 7; i++) node = tree[node].first_child;
+
+        CHECK(uci::moveToSan(Board("r1bqkbnr/p1pp1ppp/1pn5/4p3/4PP2/3P4/PPP3PP/RNBQKBNR w KQkq - 1 4"),
+                             tree[node].move) == "fxe5");
+
+        const auto nf3 = tree[node].next_sibling;
+        REQUIRE(nf3 != pgn::GameTree::NONE);
+        CHECK(tree[nf3].next_sibling == pgn::GameTree::NONE);
+
+        const auto f6 = tree[nf3].first_child;
+        REQUIRE(f6 != pgn::GameTree::NONE);
+        CHECK(tree[f6].first_child == pgn::GameTree::NONE);
+        REQUIRE(tree[f6].nag_count == 1);
+        CHECK(tree.nag(f6, 0) == 5);
+
+        // 2... b6 $146
+        auto b6 = tree.root();
+        for (int i = 0; i < 4; i++) b6 = tree[b6].first_child;
+
+        REQUIRE(tree[b6].nag_count == 1);
+        CHECK(tree.nag(b6, 0) == 146);
+    }
+
+    TEST_CASE("Comments and invalid lines") {
+        const std::string pgn =
+            "[Event \"a\"]\n\n1. e4 {main} (1. d4 {side} 1... Ke2 2. c4) (1. c4 c5) 1... e5 {reply} 2. Qh5 *\n";
+
+        pgn::GameTreeVisitor<> vis;
+        CHECK(!pgn::MappedParser(pgn.data(), pgn.size()).readGames(vis));
+
+        const auto& tree = vis.tree();
+        CHECK(vis.invalid());
+
+        // the main line and the second variation are complete
+        CHECK(tree.mainLine().size() == 3);
+
+        const auto e4 = tree[tree.root()].first_child;
+        CHECK(tree.comment(e4) == "main");
+
+        const auto d4 = tree[e4].next_sibling;
+        CHECK(tree.comment(d4) == "side");
+        CHECK(tree[d4].first_child == pgn::GameTree::NONE);
+
+        const auto c4 = tree[d4].next_sibling;
+        REQUIRE(c4 != pgn::GameTree::NONE);
+        CHECK(tree[c4].first_child != pgn::GameTree::NONE);
+
+        CHECK(tree.comment(tree[e4].first_child) == "reply");
+        CHECK(tree.size() == 7);
+    }
+
+    TEST_CASE("Nested variations restore the board") {
+        const std::string pgn =
+            "[Event \"a\"]\n\n1. e4 e5 (1... c5 2. Nf3 (2. Ke3) (2. c3 d5) 2... d6 3. d4) 2. Nf3 Nc6 *\n";
+
+        pgn::GameTreeVisitor<> vis;
+        CHECK(!pgn::MappedParser(pgn.data(), pgn.size()).readGames(vis));
+
+        const auto& tree = vis.tree();
+        CHECK(vis.invalid());
+        CHECK(tree.mainLine().size() == 4);
+
+        const auto e4 = tree[tree.root()].first_child;
+        const auto c5 = tree[tree[e4].first_child].next_sibling;
+        REQUIRE(c5 != pgn::GameTree::NONE);
+
+        // 2. Nf3 d6 3. d4, the alternative 2. c3 d5 and nothing for the illegal 2. Ke3
+        const auto nf3 = tree[c5].first_child;
+        REQUIRE(nf3 != pgn::GameTree::NONE);
+        CHECK(tree[tree[nf3].first_child].first_child != pgn::GameTree::NONE);
+
+        const auto c3 = tree[nf3].next_sibling;
+        REQUIRE(c3 != pgn::GameTree::NONE);
+        CHECK(tree[c3].next_sibling == pgn::GameTree::NONE);
+        CHECK(tree[c3].first_child != pgn::GameTree::NONE);
+        CHECK(tree.size() == 11);
+    }
+}
@@ -1,3 +1,5 @@
+#include <random>
+
 #include "../src/include.hpp"
 #include "doctest/doctest.hpp"
 
@@ -605,4 +607,207 @@ TEST_SUITE("SAN Parser") {
         CHECK(uci::moveToSan(b, m) == "O-O+");
         CHECK(uci::parseSan(b, "O-O+") == m);
     }
+
+    TEST_CASE("Every legal move round trips through san") {
+        const std::vector<std::string> fens = {
+            constants::STARTPOS,
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+            "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+            "8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1",
+            "1Q2Q3/8/1Q2Q3/8/8/8/8/K1k5 w - - 0 1",
+            "4k3/1P1P4/8/8/8/8/1p1p4/4K3 w - - 0 1",
+        };
+
+        for (const auto &fen : fens) {
+            const auto board = Board(fen);
+
+            Movelist moves;
+            movegen::legalmoves(moves, board);
+
+            for (const auto move : moves) {
+                const auto san = uci::moveToSan(board, move);
+
+                INFO(fen, " ", san);
+                CHECK(uci::parseSan(board, san) == move);
+            }
+        }
+    }
+
+    TEST_CASE("SAN is unique along random games") {
+        const auto kiwipete = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+
+        std::mt19937 rng(7);
+
+        for (int game = 0; game < 200; game++) {
+            auto board = Board(game % 2 ? constants::STARTPOS : kiwipete);
+
+            for (int ply = 0; ply < 80; ply++) {
+                Movelist moves;
+                movegen::legalmoves(moves, board);
+                if (moves.empty()) break;
+
+                for (const auto move : moves) {
+                    const auto san = uci::moveToSan(board, move);
+
+                    INFO(board.getFen(), " ", san);
+                    REQUIRE(uci::parseSan(board, san) == move);
+                }
+
+                board.makeMove(moves[rng() % moves.size()]);
+            }
+        }
+    }
+
+    TEST_CASE("tryParseSan returns the move") {
+        const auto b = Board("8/8/6K1/4k3/4N3/p4r2/N3N3/8 w - - 3 82");
+
+        const auto result = uci::tryParseSan(b, "Nac3");
+        REQUIRE(result);
+        CHECK(result.value() == Move::make(Square::SQ_A2, Square::SQ_C3));
+        CHECK(uci::tryParseSan(b, "Nd4+").value() == Move::make(Square::SQ_E2, Square::SQ_D4));
+    }
+
+    TEST_CASE("tryParseSan reports errors without throwing") {
+        const auto b = Board("8/8/6K1/4k3/4N3/p4r2/N3N3/8 w - - 3 82");
+
+        CHECK(uci::tryParseSan(b, "").error() == uci::ParseError::EMPTY);
+        CHECK(uci::tryParseSan(b, "N").error() == uci::ParseError::INVALID_FORMAT);
+        CHECK(uci::tryParseSan(b, "Zf3").error() == uci::ParseError::INVALID_FORMAT);
+        CHECK(uci::tryParseSan(b, "N1").error() == uci::ParseError::INVALID_FORMAT);
+        CHECK(uci::tryParseSan(b, "O-").error() == uci::ParseError::INVALID_FORMAT);
+        CHECK(uci::tryParseSan(b, "e8=").error() == uci::ParseError::INVALID_PROMOTION);
+        CHECK(uci::tryParseSan(b, "e8=K").error() == uci::ParseError::INVALID_PROMOTION);
+        CHECK(uci::tryParseSan(b, "Nc3").error() == uci::ParseError::AMBIGUOUS_MOVE);
+        CHECK(uci::tryParseSan(b, "Nec4").error() == uci::ParseError::ILLEGAL_MOVE);
+        CHECK(uci::tryParseSan(b, "O-O").error() == uci::ParseError::ILLEGAL_MOVE);
+        CHECK(uci::tryParseSan(b, "Qd4").error() == uci::ParseError::ILLEGAL_MOVE);
+
+        CHECK_FALSE(uci::tryParseSan(b, "Nec4").hasValue());
+        CHECK(std::string(uci::tryParseSan(b, "Nc3").message()) == "Ambiguous move");
+    }
+
+    TEST_CASE("SAN tokens with loose notation") {
+        const auto b = Board("r3k2r/1P6/8/8/8/8/8/R3K2R w KQkq - 0 1");
+
+        CHECK(uci::parseSan(b, "b8Q") == Move::make<Move::PROMOTION>(Square::SQ_B7, Square::SQ_B8, PieceType::QUEEN));
+        CHECK(uci::parseSan(b, "bxa8=N+") ==
+              Move::make<Move::PROMOTION>(Square::SQ_B7, Square::SQ_A8, PieceType::KNIGHT));
+        CHECK(uci::parseSan(b, "Rd1!?") == Move::make(Square::SQ_A1, Square::SQ_D1));
+        CHECK(uci::parseSan(b, "O-O+") == Move::make<Move::CASTLING>(Square::SQ_E1, Square::SQ_H1));
+        CHECK(uci::parseSan(b, "0-0-0") == Move::make<Move::CASTLING>(Square::SQ_E1, Square::SQ_A1));
+
+        CHECK(uci::parseSan(b, "b8=b") == Move::make<Move::PROMOTION>(Square::SQ_B7, Square::SQ_B8, PieceType::BISHOP));
+        CHECK(uci::parseSan(b, "b8=B") == Move::make<Move::PROMOTION>(Square::SQ_B7, Square::SQ_B8, PieceType::BISHOP));
+        CHECK(uci::parseSan(b, "b8=n") == Move::make<Move::PROMOTION>(Square::SQ_B7, Square::SQ_B8, PieceType::KNIGHT));
+        CHECK(uci::parseSan(b, "bxa8=b") ==
+              Move::make<Move::PROMOTION>(Square::SQ_B7, Square::SQ_A8, PieceType::BISHOP));
+
+        CHECK(uci::tryParseSan(b, "b8b").error() == uci::ParseError::INVALID_FORMAT);
+        CHECK(uci::tryParseSan(b, "xb8").error() == uci::ParseError::INVALID_FORMAT);
+        CHECK(uci::tryParseSan(b, "b8").error() == uci::ParseError::INVALID_PROMOTION);
+        CHECK(uci::tryParseSan(b, "Rb8=Q").error() == uci::ParseError::INVALID_PROMOTION);
+    }
+
+    TEST_CASE("Capture sign has to match the board") {
+        const auto b = Board(constants::STARTPOS);
+
+        CHECK_THROWS_AS(static_cast<void>(uci::parseSan(b, "Nxf3")), uci::SanParseError);
+        CHECK_THROWS_AS(static_cast<void>(uci::parseSan(b, "exd3")), uci::SanParseError);
+        CHECK_THROWS_AS(static_cast<void>(uci::parseSan(b, "e5")), uci::SanParseError);
+        CHECK_THROWS_AS(static_cast<void>(uci::parseSan(b, "e8")), uci::SanParseError);
+    }
+
+    TEST_CASE("Buffer and append writers match the string writers") {
+        const std::vector<std::string> fens = {
+            constants::STARTPOS,
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+            "1Q2Q3/8/1Q2Q3/8/8/8/8/K1k5 w - - 0 1",
+            "4k3/1P1P4/8/8/8/8/1p1p4/4K3 w - - 0 1",
+            "8/8/8/8/8/8/PPPPPP2/k3K2R w K - 0 1",
+        };
+
+        for (const auto &fen : fens) {
+            const auto board = Board(fen);
+
+            Movelist moves;
+            movegen::legalmoves(moves, board);
+
+            for (const auto move : moves) {
+                INFO(fen, " ", uci::moveToUci(move));
+
+                char buffer[uci::MAX_SAN_LENGTH];
+
+                const auto san = uci::moveToSan(board, move);
+                CHECK(std::string(buffer, uci::moveToSan(board, move, buffer)) == san);
+
+                const auto lan = uci::moveToLan(board, move);
+                CHECK(std::string(buffer, uci::moveToLan(board, move, buffer)) == lan);
+
+                std::string appended = "1. ";
+                uci::moveToSan(board, move, appended);
+                appended += ' ';
+                uci::moveToLan(board, move, appended);
+                appended += ' ';
+                uci::moveToUci(move, appended);
+                CHECK(appended == "1. " + san + " " + lan + " " + uci::moveToUci(move));
+            }
+        }
+    }
+
+    TEST_CASE("Converting to a CopyMakeBoard keeps the position") {
+        auto board = Board("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+        board.makeMove(uci::uciToMove(board, "e1g1"));
+
+        const auto copy = CopyMakeBoard(board);
+
+        CHECK(copy.getFen() == board.getFen());
+        CHECK(copy.hash() == board.hash());
+    }
+
+    TEST_CASE("movesToSan writes a line") {
+        const auto board = Board(constants::STARTPOS);
+
+        std::vector<Move> line;
+        auto position = board;
+
+        for (const auto *san : {"f3", "e5", "g4", "Qh4#"}) {
+            line.push_back(uci::parseSan(position, san));
+            position.makeMove(line.back());
+        }
+
+        std::string out = "1.";
+        uci::movesToSan(board, line, out);
+        CHECK(out == "1.f3 e5 g4 Qh4#");
+
+        std::string csv;
+        uci::movesToSan(board, line, csv, ',');
+        CHECK(csv == "f3,e5,g4,Qh4#");
+
+        std::string empty;
+        uci::movesToSan(board, std::vector<Move>{}, empty);
+        CHECK(empty.empty());
+    }
+
+    TEST_CASE("movesToSan matches moveToSan") {
+        auto board = Board("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+        const auto start = board;
+
+        Movelist line;
+        std::string expected;
+
+        for (const auto *str : {"c4c5", "c7c6", "d2d4", "b2a1q", "d1a1", "e8c8"}) {
+            const auto move = uci::uciToMove(board, str);
+            if (!expected.empty()) expected += ' ';
+            expected += uci::moveToSan(board, move);
+            line.add(move);
+            board.makeMove(move);
+        }
+
+        std::string out;
+        uci::movesToSan(start, line, out);
+        CHECK(out == expected);
+    }
 }
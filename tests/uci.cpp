@@ -86,6 +86,36 @@ TEST_SUITE("UCI Move Conversion") {
     }
 }
 
+TEST_SUITE("UCI tryUciToMove") {
+    TEST_CASE("Legal moves are returned") {
+        const auto b = Board("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+
+        const auto result = uci::tryUciToMove(b, "c4c5");
+        REQUIRE(result);
+        CHECK(result.value() == Move::make(Square::SQ_C4, Square::SQ_C5));
+
+        const auto promotion = uci::tryUciToMove(Board("8/1P6/8/8/8/8/8/k1K5 w - - 0 1"), "b7b8n");
+        REQUIRE(promotion.hasValue());
+        CHECK(promotion.value() == Move::make<Move::PROMOTION>(Square::SQ_B7, Square::SQ_B8, PieceType::KNIGHT));
+    }
+
+    TEST_CASE("Errors are reported without throwing") {
+        // white is in check from the bishop on b6
+        const auto b = Board("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+
+        CHECK(uci::tryUciToMove(b, "").error() == uci::ParseError::EMPTY);
+        CHECK(uci::tryUciToMove(b, "e2").error() == uci::ParseError::INVALID_FORMAT);
+        CHECK(uci::tryUciToMove(b, "i2i4").error() == uci::ParseError::INVALID_FORMAT);
+        CHECK(uci::tryUciToMove(b, "c4c5q").error() == uci::ParseError::INVALID_PROMOTION);
+        CHECK(uci::tryUciToMove(b, "g2g3").error() == uci::ParseError::ILLEGAL_MOVE);
+        CHECK(uci::tryUciToMove(b, "h2h5").error() == uci::ParseError::ILLEGAL_MOVE);
+        CHECK(uci::tryUciToMove(b, "a7a8").error() == uci::ParseError::INVALID_PROMOTION);
+
+        CHECK(uci::tryUciToMove(b, "h2h5").valueOr(Move::NULL_MOVE) == Move::NULL_MOVE);
+        CHECK(std::string(uci::tryUciToMove(b, "h2h5").message()) == "Illegal move");
+    }
+}
+
 TEST_SUITE("UCI isUciMove Check") {
     TEST_CASE("Test valid standard moves") {
         CHECK(uci::isUciMove("e2e4"));  // Pawn push
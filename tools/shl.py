@@ -224,6 +224,12 @@ stl_headers = [
     "immintrin.h",
     "intrin.h",
     "nmmintrin.h",
+    "fcntl.h",
+    "sys/mman.h",
+    "sys/stat.h",
+    "unistd.h",
+    "zlib.h",
+    "zstd.h",
 ]
 
 